@@ -0,0 +1,126 @@
+// Startup benchmark for the station catalog loader.
+//
+//   webradio-catalog-bench generate <out.json> <count>
+//   webradio-catalog-bench <stations.json> [dom|sax|cache-cold|cache-warm]...
+//
+// Each mode runs in a forked child so that peak RSS (ru_maxrss) is
+// measured per mode. Without a mode list all four are run in order.
+// "dom" is the previous nlohmann::json DOM loader, kept for comparison.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "station_catalog.hpp"
+
+namespace {
+
+int generate(const std::string& path, size_t count) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out.is_open()) {
+        std::fprintf(stderr, "cannot write %s\n", path.c_str());
+        return 1;
+    }
+
+    std::mt19937 rng(1234);
+    out << "{\n";
+    for (size_t i = 0; i < count; ++i) {
+        out << "\t\"Station " << i << " " << (rng() % 100000) << "\":"
+            << "\"https://stream" << (rng() % 500) << ".example.com/live/" << i
+            << "_mp3?platform=web&skey=" << rng() << "\"";
+        out << (i + 1 < count ? ",\n" : "\n");
+    }
+    out << "}\n";
+    return 0;
+}
+
+size_t load_dom(const std::string& path) {
+    std::vector<Station> stations;
+    std::ifstream file(path);
+    nlohmann::json j;
+    file >> j;
+    for (auto& [name, url] : j.items()) {
+        stations.push_back({name, url.get<std::string>()});
+    }
+    return stations.size();
+}
+
+void run_mode(const std::string& path, const std::string& mode) {
+    if (mode == "cache-cold") {
+        std::remove(StationCatalog::cache_path_for(path).c_str());
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    size_t count = 0;
+    bool from_cache = false;
+    if (mode == "dom") {
+        count = load_dom(path);
+    } else {
+        StationCatalog catalog;
+        bool ok = (mode == "sax") ? catalog.parse_json(path) : catalog.load(path);
+        if (!ok) {
+            std::fprintf(stderr, "%s: %s\n", mode.c_str(), catalog.error().c_str());
+            std::exit(1);
+        }
+        // Materialize the list the TUI receives, as main() does
+        count = catalog.to_stations().size();
+        from_cache = catalog.loaded_from_cache();
+    }
+    auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    struct rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    std::printf("%-10s stations=%zu load_ms=%.2f peak_rss_kb=%ld%s\n",
+                mode.c_str(), count, elapsed, usage.ru_maxrss,
+                from_cache ? " (mmap cache)" : "");
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc >= 4 && std::string(argv[1]) == "generate") {
+        return generate(argv[2], std::strtoull(argv[3], nullptr, 10));
+    }
+    if (argc < 2) {
+        std::fprintf(stderr,
+            "usage: %s generate <out.json> <count>\n"
+            "       %s <stations.json> [dom|sax|cache-cold|cache-warm]...\n",
+            argv[0], argv[0]);
+        return 1;
+    }
+
+    std::string path = argv[1];
+    std::vector<std::string> modes;
+    for (int i = 2; i < argc; ++i) {
+        modes.emplace_back(argv[i]);
+    }
+    if (modes.empty()) {
+        modes = {"dom", "sax", "cache-cold", "cache-warm"};
+    }
+
+    for (const auto& mode : modes) {
+        std::fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+            run_mode(path, mode);
+            std::fflush(stdout);
+            _exit(0);
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
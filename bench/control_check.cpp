@@ -0,0 +1,164 @@
+// Self-check for ControlServer, the --daemon control socket.
+//
+//   webradio-control-check
+//
+// Starts a server on a socket in a temporary directory with a handler
+// that answers {"cmd":"ping"}, then checks over real connections that
+// malformed requests (non-string "cmd", non-string event names, missing
+// "cmd", non-JSON) get an error reply echoing "id" and leave the server
+// answering; that the socket is created mode 0600; that a second server
+// refuses a path a live one listens on, and a path that is not a socket,
+// without removing either; and that a socket left behind by a dead
+// server is replaced. Any failure exits with status 1. Linux only.
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+#include "control_server.hpp"
+#include "self_check.hpp"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using json = nlohmann::json;
+
+namespace {
+
+#ifdef __linux__
+sockaddr_un socket_address(const std::string& path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path.c_str());
+    return addr;
+}
+
+// One request line, one reply line; null on a closed or silent socket
+json request(const std::string& path, const std::string& line) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_un addr = socket_address(path);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return nullptr;
+    }
+    std::string out = line + "\n";
+    (void)!send(fd, out.data(), out.size(), MSG_NOSIGNAL);
+
+    std::string in;
+    char buf[4096];
+    while (in.find('\n') == std::string::npos) {
+        pollfd pfd{fd, POLLIN, 0};
+        if (poll(&pfd, 1, 2000) <= 0) {
+            break;
+        }
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n <= 0) {
+            break;
+        }
+        in.append(buf, static_cast<size_t>(n));
+    }
+    close(fd);
+    if (in.find('\n') == std::string::npos) {
+        return nullptr;
+    }
+    return json::parse(in.substr(0, in.find('\n')), nullptr, false);
+}
+
+bool is_error(const json& reply, int id) {
+    return reply.is_object() && reply.value("ok", true) == false && reply.contains("error") &&
+           reply.value("id", -1) == id;
+}
+
+bool answers_ping(const std::string& path) {
+    json reply = request(path, R"({"id":99,"cmd":"ping"})");
+    return reply.is_object() && reply.value("ok", false) && reply.value("pong", false) && reply.value("id", -1) == 99;
+}
+#endif
+
+} // namespace
+
+int main() {
+#ifdef __linux__
+    char dir_template[] = "/tmp/webradio-control-check-XXXXXX";
+    if (!mkdtemp(dir_template)) {
+        std::perror("mkdtemp");
+        return 1;
+    }
+    std::filesystem::path dir = dir_template;
+    std::string path = (dir / "control.sock").string();
+
+    ControlServer::Handler handler = [](const json& req) -> json {
+        if (req.at("cmd").get<std::string>() == "ping") {
+            return {{"pong", true}};
+        }
+        return {{"error", "unknown command"}};
+    };
+
+    {
+        ControlServer server;
+        bool started = server.start(path, handler);
+        check(started, "server starts " + server.error());
+        check(answers_ping(path), "answers a well-formed command");
+
+        check(is_error(request(path, R"({"id":1,"cmd":5})"), 1), "numeric \"cmd\" gets an error reply");
+        check(is_error(request(path, R"({"id":2,"cmd":{"nested":true}})"), 2), "object \"cmd\" gets an error reply");
+        check(is_error(request(path, R"({"id":3,"cmd":null})"), 3), "null \"cmd\" gets an error reply");
+        check(is_error(request(path, R"({"id":4})"), 4), "missing \"cmd\" gets an error reply");
+        check(is_error(request(path, R"({"id":5,"cmd":"subscribe","events":[1]})"), 5),
+              "non-string event name gets an error reply");
+        json garbage = request(path, "not json");
+        check(garbage.is_object() && garbage.value("ok", true) == false, "non-JSON line gets an error reply");
+        check(answers_ping(path), "server still answers after bad requests");
+
+        struct stat st {};
+        check(lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode) && (st.st_mode & 0777) == 0600,
+              "socket is created mode 0600");
+
+        ControlServer second;
+        bool refused = !second.start(path, handler);
+        check(refused, "second server refuses a live socket (" + second.error() + ")");
+        check(answers_ping(path), "live socket is left in place");
+
+        std::string file_path = (dir / "not-a-socket").string();
+        std::ofstream(file_path) << "keep me\n";
+        ControlServer third;
+        refused = !third.start(file_path, handler);
+        check(refused, "refuses a path that is not a socket (" + third.error() + ")");
+        check(std::filesystem::exists(file_path), "regular file is left in place");
+    }
+
+    // A server that died without unlinking its socket
+    std::string stale_path = (dir / "stale.sock").string();
+    int stale = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_un stale_addr = socket_address(stale_path);
+    bool bound = stale >= 0 && bind(stale, reinterpret_cast<sockaddr*>(&stale_addr), sizeof(stale_addr)) == 0;
+    if (stale >= 0) {
+        close(stale);
+    }
+    {
+        ControlServer server;
+        bool started = bound && server.start(stale_path, handler);
+        check(started, "replaces a stale socket " + server.error());
+        check(answers_ping(stale_path), "answers on the replaced socket");
+    }
+
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+
+    return check_summary();
+#else
+    std::fprintf(stderr, "webradio-control-check: Linux only\n");
+    return 1;
+#endif
+}
@@ -0,0 +1,124 @@
+// Self-check for Engine/Player: two players on one engine at once.
+//
+//   webradio-engine-check FILE FILE
+//
+// Plays both files (a few seconds of audio or more; any format FFmpeg
+// reads) at the same time through players of one Engine, each with a
+// NullSink, and checks that both publish their state, report their own
+// format and render audio; that stopping one leaves the other playing;
+// and that a third player whose stream fails to open publishes that it
+// stopped. Any failure exits with status 1.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "audio_sink.hpp"
+#include "engine.hpp"
+#include "self_check.hpp"
+
+namespace {
+
+// What one player's callbacks reported
+struct Reports {
+    std::mutex mutex;
+    std::string format;
+    std::string error;
+};
+
+PlayerCallbacks callbacks_for(Reports& reports) {
+    PlayerCallbacks callbacks;
+    callbacks.on_stream_format = [&reports](const std::string& format, int) {
+        std::lock_guard<std::mutex> lock(reports.mutex);
+        reports.format = format;
+    };
+    callbacks.on_error = [&reports](const std::string& message) {
+        std::lock_guard<std::mutex> lock(reports.mutex);
+        reports.error = message;
+    };
+    return callbacks;
+}
+
+// Polls until done() or timeout; true if done
+bool wait_until(const std::function<bool()>& done, std::chrono::milliseconds timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!done()) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
+}
+
+// True once the player publishes the state wanted (earlier changes are
+// skipped: a failing stream can publish "stopped" before "playing" is
+// taken)
+bool wait_state(Player& player, bool wanted, std::chrono::milliseconds timeout) {
+    return wait_until([&]() {
+        bool playing = false;
+        return player.take_state_change(playing) && playing == wanted;
+    }, timeout);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        std::fprintf(stderr, "usage: webradio-engine-check FILE FILE\n");
+        return 1;
+    }
+    constexpr auto TIMEOUT = std::chrono::seconds(10);
+
+    Engine engine;
+    Reports reports[3];
+    std::unique_ptr<Player> players[3];
+    for (int i = 0; i < 3; ++i) {
+        players[i] = engine.create_player(std::make_unique<NullSink>());
+        players[i]->set_callbacks(callbacks_for(reports[i]));
+    }
+    Player& one = *players[0];
+    Player& two = *players[1];
+    Player& broken = *players[2];
+
+    one.play(argv[1], "one");
+    two.play(argv[2], "two");
+    check(wait_state(one, true, TIMEOUT) && wait_state(two, true, TIMEOUT), "both players publish that they play");
+
+    // Both sinks pull audio from their own ring at the same time
+    bool rendering = wait_until([&]() { return one.playout_position() > 0 && two.playout_position() > 0; }, TIMEOUT);
+    check(rendering, "both players render audio at once");
+    check(one.is_playing() && two.is_playing(), "both players are playing");
+    for (int i = 0; i < 2; ++i) {
+        std::lock_guard<std::mutex> lock(reports[i].mutex);
+        check(!reports[i].format.empty() && reports[i].error.empty(),
+              std::string(argv[i + 1]) + " reports its format (" + reports[i].format + ")");
+    }
+    check(one.station_name() == "one" && two.station_name() == "two", "each player keeps its own station");
+
+    one.stop();
+    check(wait_state(one, false, TIMEOUT) && !one.is_playing(), "stopped player publishes that it stopped");
+    size_t before = two.playout_position();
+    bool advancing = wait_until([&]() { return two.playout_position() > before; }, TIMEOUT);
+    check(advancing && two.is_playing(), "other player keeps playing");
+
+    broken.play("/nonexistent/webradio-engine-check.mp3", "broken");
+    check(wait_state(broken, false, TIMEOUT) && !broken.is_playing(), "failing player publishes that it stopped");
+    {
+        std::lock_guard<std::mutex> lock(reports[2].mutex);
+        check(!reports[2].error.empty(), "failing player reports the error (" + reports[2].error + ")");
+    }
+    check(two.is_playing(), "other player is unaffected by the failure");
+
+    for (auto& player : players) {
+        player.reset();
+    }
+    engine.stop();
+
+    return check_summary();
+}
@@ -0,0 +1,547 @@
+// Icecast/SHOUTcast stand-in that serves local files as live streams with
+// scripted faults, for reproducible resilience tests without a network.
+//
+//   webradio-fault-server [options] FILE
+//
+//   --port N             listen on 127.0.0.1:N (default 8000)
+//   --bind ADDR          listen address (default 127.0.0.1)
+//   --bitrate KBPS       pacing rate of the stream (default 128)
+//   --metaint N          bytes of audio between metadata blocks (default 16000)
+//   --title-interval S   seconds between title changes (default 30)
+//   --shoutcast          answer "ICY 200 OK" instead of HTTP/1.0
+//   --fault "EVENT"      add a fault; repeatable, or ';'-separated
+//   --script FILE        read faults from FILE, one per line, # comments
+//
+// Events run relative to each connection's start, so every client (and
+// every reconnect) sees the same script:
+//
+//   TIME rate KBPS           cap the bandwidth from TIME on (0: unlimited)
+//   TIME burst KIB           send KIB at once (at 0: burst-on-connect)
+//   TIME stall DURATION      send nothing; the stream falls behind
+//   TIME latency DURATION    hold the data back, then catch up
+//   TIME disconnect          close the connection
+//   TIME storm DURATION      a new title in every metadata block
+//
+// TIME and DURATION take ms or s suffixes (plain numbers are seconds),
+// e.g. --fault "0 burst 64" --fault "10s stall 3s" --fault "30s disconnect".
+// The file loops. Metadata is only sent to clients that ask for it
+// (Icy-MetaData: 1). Each event is logged to stderr per client.
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <csignal>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <list>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "loopback_http.hpp"
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+enum class FaultType { Rate, Burst, Stall, Latency, Disconnect, Storm };
+
+struct Fault {
+    double at_s = 0.0;
+    FaultType type = FaultType::Stall;
+    double value = 0.0;         // kbit/s, KiB or seconds
+};
+
+struct Options {
+    std::string bind = "127.0.0.1";
+    int port = 8000;
+    double bitrate_kbps = 128.0;
+    size_t metaint = 16000;
+    double title_interval_s = 30.0;
+    bool shoutcast = false;
+    std::string file;
+    std::vector<Fault> faults;
+};
+
+std::atomic<bool> g_running{true};
+
+void signal_handler(int) {
+    g_running = false;
+}
+
+using Clock = std::chrono::steady_clock;
+
+// Bytes written per loop when the bandwidth is not capped
+constexpr double UNLIMITED_CHUNK = 262144.0;
+
+bool parse_seconds(const std::string& text, double& seconds) {
+    char* end = nullptr;
+    double value = std::strtod(text.c_str(), &end);
+    if (end == text.c_str()) {
+        return false;
+    }
+    std::string unit(end);
+    if (unit == "ms") {
+        seconds = value / 1000.0;
+    } else if (unit.empty() || unit == "s") {
+        seconds = value;
+    } else {
+        return false;
+    }
+    return seconds >= 0.0;
+}
+
+bool parse_fault(const std::string& line, Fault& fault, std::string& error) {
+    std::istringstream in(line);
+    std::string at, action, arg;
+    in >> at >> action >> arg;
+    if (!parse_seconds(at, fault.at_s)) {
+        error = "bad time in \"" + line + "\"";
+        return false;
+    }
+    bool needs_duration = false;
+    if (action == "rate") {
+        fault.type = FaultType::Rate;
+    } else if (action == "burst") {
+        fault.type = FaultType::Burst;
+    } else if (action == "stall") {
+        fault.type = FaultType::Stall;
+        needs_duration = true;
+    } else if (action == "latency") {
+        fault.type = FaultType::Latency;
+        needs_duration = true;
+    } else if (action == "storm") {
+        fault.type = FaultType::Storm;
+        needs_duration = true;
+    } else if (action == "disconnect") {
+        fault.type = FaultType::Disconnect;
+        return true;
+    } else {
+        error = "unknown action in \"" + line + "\"";
+        return false;
+    }
+    bool ok = needs_duration ? parse_seconds(arg, fault.value) : !arg.empty();
+    if (!needs_duration && ok) {
+        fault.value = std::atof(arg.c_str());
+    }
+    if (!ok) {
+        error = "bad argument in \"" + line + "\"";
+        return false;
+    }
+    return true;
+}
+
+bool add_faults(const std::string& text, char separator, Options& options, std::string& error) {
+    std::istringstream in(text);
+    std::string line;
+    while (std::getline(in, line, separator)) {
+        auto hash = line.find('#');
+        if (hash != std::string::npos) {
+            line.erase(hash);
+        }
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        Fault fault;
+        if (!parse_fault(line, fault, error)) {
+            return false;
+        }
+        options.faults.push_back(fault);
+    }
+    return true;
+}
+
+#ifdef __linux__
+
+std::string lower(std::string s) {
+    for (auto& c : s) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return s;
+}
+
+// One listener connection, run on its own thread
+class Session {
+public:
+    Session(int fd, int id, const Options& options) : fd_(fd), id_(id), options_(options) {}
+
+    void run() {
+        if (!read_request()) {
+            return;
+        }
+        file_.open(options_.file, std::ios::binary);
+        if (!file_ || !send_header()) {
+            return;
+        }
+        log("connected%s", metadata_ ? ", with metadata" : "");
+        stream();
+        log("closed after %.1f s, %llu bytes", elapsed_s(), static_cast<unsigned long long>(sent_audio_));
+    }
+
+private:
+#if defined(__GNUC__)
+    __attribute__((format(printf, 2, 3)))
+#endif
+    void log(const char* fmt, ...) {
+        char buf[256];
+        va_list args;
+        va_start(args, fmt);
+        std::vsnprintf(buf, sizeof(buf), fmt, args);
+        va_end(args);
+        std::fprintf(stderr, "[client %d +%6.2fs] %s\n", id_, elapsed_s(), buf);
+    }
+
+    double elapsed_s() const {
+        return std::chrono::duration<double>(Clock::now() - start_).count();
+    }
+
+    bool read_request() {
+        char buf[1024];
+        std::string request;
+        while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+            pollfd pfd{fd_, POLLIN, 0};
+            if (poll(&pfd, 1, 5000) <= 0) {
+                return false;
+            }
+            ssize_t n = read(fd_, buf, sizeof(buf));
+            if (n <= 0) {
+                return false;
+            }
+            request.append(buf, static_cast<size_t>(n));
+        }
+        metadata_ = lower(request).find("icy-metadata: 1") != std::string::npos;
+        return true;
+    }
+
+    bool send_header() {
+        std::string status = options_.shoutcast ? "ICY 200 OK\r\n" : "HTTP/1.0 200 OK\r\n";
+        std::string header = status +
+            "Content-Type: " + content_type_for(options_.file) + "\r\n"
+            "icy-name: webradio fault server\r\n"
+            "icy-genre: Test\r\n"
+            "icy-br: " + std::to_string(static_cast<int>(options_.bitrate_kbps)) + "\r\n"
+            "Cache-Control: no-cache\r\n";
+        if (metadata_) {
+            header += "icy-metaint: " + std::to_string(options_.metaint) + "\r\n";
+        }
+        header += "\r\n";
+        return send_all(header.data(), header.size());
+    }
+
+    bool send_all(const char* data, size_t size) {
+        size_t sent = 0;
+        while (sent < size) {
+            ssize_t n = send(fd_, data + sent, size - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    std::string title() {
+        double t = elapsed_s();
+        if (t < storm_until_s_) {
+            return "Storm " + std::to_string(++storm_count_);
+        }
+        int track = options_.title_interval_s > 0.0 ? static_cast<int>(t / options_.title_interval_s) + 1 : 1;
+        return std::filesystem::path(options_.file).stem().string() + " - Part " + std::to_string(track);
+    }
+
+    // Length byte (in 16-byte units) and a padded StreamTitle block; an
+    // unchanged title is sent as an empty block, like Icecast does
+    bool send_metadata() {
+        std::string text = title();
+        std::string block(1, '\0');
+        if (text != last_title_) {
+            last_title_ = text;
+            std::string body = "StreamTitle='" + text + "';";
+            body.resize(std::min<size_t>((body.size() + 15) / 16 * 16, 255 * 16), '\0');
+            block[0] = static_cast<char>(body.size() / 16);
+            block += body;
+        }
+        return send_all(block.data(), block.size());
+    }
+
+    // Audio from the looping file, split at metadata boundaries
+    bool send_audio(size_t size) {
+        char buf[16384];
+        while (size > 0) {
+            size_t chunk = std::min(size, sizeof(buf));
+            if (metadata_) {
+                chunk = std::min(chunk, options_.metaint - since_metadata_);
+            }
+            file_.read(buf, static_cast<std::streamsize>(chunk));
+            size_t n = static_cast<size_t>(file_.gcount());
+            if (n == 0) {
+                if (rewound_) {
+                    // Nothing to read right after a rewind: the file is
+                    // empty (truncated since startup); end the session
+                    return false;
+                }
+                file_.clear();
+                file_.seekg(0);
+                rewound_ = true;
+                continue;
+            }
+            rewound_ = false;
+            if (!send_all(buf, n)) {
+                return false;
+            }
+            size -= n;
+            sent_audio_ += n;
+            since_metadata_ += n;
+            if (metadata_ && since_metadata_ == options_.metaint) {
+                since_metadata_ = 0;
+                if (!send_metadata()) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    void stream() {
+        std::vector<Fault> pending = options_.faults;
+        std::stable_sort(pending.begin(), pending.end(), [](const Fault& a, const Fault& b) {
+            return a.at_s < b.at_s;
+        });
+        size_t next_fault = 0;
+
+        double rate_bytes_s = options_.bitrate_kbps * 1000.0 / 8.0;
+        double credit = 0.0;            // bytes the schedule allows now
+        double stall_until_s = 0.0;
+        double hold_until_s = 0.0;
+        double last_s = 0.0;
+
+        while (g_running) {
+            double now_s = elapsed_s();
+            for (; next_fault < pending.size() && pending[next_fault].at_s <= now_s; ++next_fault) {
+                const Fault& fault = pending[next_fault];
+                switch (fault.type) {
+                case FaultType::Rate:
+                    if (rate_bytes_s <= 0.0) {
+                        credit = 0.0;   // unlimited credit does not carry over
+                    }
+                    rate_bytes_s = fault.value * 1000.0 / 8.0;
+                    log("rate %.0f kbit/s", fault.value);
+                    break;
+                case FaultType::Burst:
+                    credit += fault.value * 1024.0;
+                    log("burst %.0f KiB", fault.value);
+                    break;
+                case FaultType::Stall:
+                    stall_until_s = now_s + fault.value;
+                    log("stall %.2f s", fault.value);
+                    break;
+                case FaultType::Latency:
+                    hold_until_s = now_s + fault.value;
+                    log("latency %.2f s", fault.value);
+                    break;
+                case FaultType::Storm:
+                    storm_until_s_ = now_s + fault.value;
+                    log("metadata storm %.2f s", fault.value);
+                    break;
+                case FaultType::Disconnect:
+                    log("disconnect");
+                    return;
+                }
+            }
+
+            // A stall pauses the schedule; latency only holds the data back
+            if (now_s >= stall_until_s) {
+                if (rate_bytes_s > 0.0) {
+                    credit += (now_s - last_s) * rate_bytes_s;
+                } else {
+                    credit = std::max(credit, UNLIMITED_CHUNK);
+                }
+            }
+            last_s = now_s;
+
+            if (now_s >= hold_until_s && credit >= 1.0) {
+                size_t size = static_cast<size_t>(credit);
+                if (!send_audio(size)) {
+                    return;
+                }
+                credit -= static_cast<double>(size);
+            }
+
+            // Tick; a hangup from the client ends the session
+            pollfd pfd{fd_, POLLIN, 0};
+            if (poll(&pfd, 1, rate_bytes_s > 0.0 ? 10 : 0) > 0) {
+                char buf[256];
+                if (read(fd_, buf, sizeof(buf)) <= 0) {
+                    return;
+                }
+            }
+        }
+    }
+
+    int fd_;
+    int id_;
+    const Options& options_;
+    Clock::time_point start_ = Clock::now();
+    std::ifstream file_;
+    bool rewound_ = false;      // the last read hit the end and rewound
+    bool metadata_ = false;
+    size_t since_metadata_ = 0;
+    uint64_t sent_audio_ = 0;
+    std::string last_title_;
+    double storm_until_s_ = 0.0;
+    int storm_count_ = 0;
+};
+
+int serve(const Options& options) {
+    int listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        std::perror("socket");
+        return 1;
+    }
+    int one = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(options.port));
+    if (inet_pton(AF_INET, options.bind.c_str(), &addr.sin_addr) != 1 ||
+        bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        listen(listen_fd, 16) < 0) {
+        std::fprintf(stderr, "cannot listen on %s:%d: %s\n", options.bind.c_str(), options.port,
+                     std::strerror(errno));
+        close(listen_fd);
+        return 1;
+    }
+    std::fprintf(stderr, "serving %s on http://%s:%d/ (%zu faults)\n", options.file.c_str(),
+                 options.bind.c_str(), options.port, options.faults.size());
+
+    struct Client {
+        std::thread thread;
+        std::atomic<bool> done{false};
+    };
+    std::list<Client> clients;
+    int next_id = 1;
+
+    while (g_running) {
+        // Reap finished sessions
+        for (auto it = clients.begin(); it != clients.end();) {
+            if (it->done) {
+                it->thread.join();
+                it = clients.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        pollfd pfd{listen_fd, POLLIN, 0};
+        if (poll(&pfd, 1, 200) <= 0) {
+            continue;
+        }
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        Client& client = clients.emplace_back();
+        int id = next_id++;
+        client.thread = std::thread([fd, id, &options, &client]() {
+            Session(fd, id, options).run();
+            close(fd);
+            client.done = true;
+        });
+    }
+
+    close(listen_fd);
+    for (auto& client : clients) {
+        client.thread.join();
+    }
+    return 0;
+}
+
+#endif
+
+int usage(const char* argv0) {
+    std::fprintf(stderr,
+        "usage: %s [--port N] [--bind ADDR] [--bitrate KBPS] [--metaint N]\n"
+        "       [--title-interval S] [--shoutcast] [--fault EVENT]... [--script FILE] FILE\n",
+        argv0);
+    return 1;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    std::string error;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--port" && has_value) {
+            options.port = std::atoi(argv[++i]);
+        } else if (arg == "--bind" && has_value) {
+            options.bind = argv[++i];
+        } else if (arg == "--bitrate" && has_value) {
+            options.bitrate_kbps = std::atof(argv[++i]);
+        } else if (arg == "--metaint" && has_value) {
+            options.metaint = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--title-interval" && has_value) {
+            options.title_interval_s = std::atof(argv[++i]);
+        } else if (arg == "--shoutcast") {
+            options.shoutcast = true;
+        } else if (arg == "--fault" && has_value) {
+            if (!add_faults(argv[++i], ';', options, error)) {
+                std::fprintf(stderr, "--fault: %s\n", error.c_str());
+                return 1;
+            }
+        } else if (arg == "--script" && has_value) {
+            std::ifstream script(argv[++i]);
+            std::stringstream text;
+            text << script.rdbuf();
+            if (!script || !add_faults(text.str(), '\n', options, error)) {
+                std::fprintf(stderr, "--script: %s\n", error.empty() ? "cannot read file" : error.c_str());
+                return 1;
+            }
+        } else if (!arg.empty() && arg[0] == '-') {
+            return usage(argv[0]);
+        } else {
+            options.file = arg;
+        }
+    }
+    if (options.file.empty()) {
+        return usage(argv[0]);
+    }
+    if (!std::ifstream(options.file, std::ios::binary)) {
+        std::fprintf(stderr, "cannot read %s\n", options.file.c_str());
+        return 1;
+    }
+    std::error_code ec;
+    if (std::filesystem::file_size(options.file, ec) == 0 && !ec) {
+        // Looping an empty file would never produce audio
+        std::fprintf(stderr, "%s is empty\n", options.file.c_str());
+        return 1;
+    }
+
+#ifdef __linux__
+    std::signal(SIGINT, signal_handler);
+    std::signal(SIGTERM, signal_handler);
+    return serve(options);
+#else
+    std::fprintf(stderr, "webradio-fault-server is only supported on Linux\n");
+    return 1;
+#endif
+}
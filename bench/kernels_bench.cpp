@@ -0,0 +1,485 @@
+// Microbenchmarks and checks for the audio path's inner loops: volume
+// (data_callback), stereo to mono (FFTSpectrum's sample buffer), the
+// radix-2 FFT, the spectrum analysis step and the playback ring's copy
+// paths, across buffer sizes and every ISA variant compiled in.
+//
+//   webradio-kernels-bench [--check-only] [--filter TEXT] [--min-time-ms N] [--json]
+//
+// The checks run first and compare each SIMD variant with its scalar
+// reference on random inputs (lengths, alignments, extreme values), the
+// FFT with a double-precision DFT, and the ring against a std::deque. Any
+// failure exits with status 1 before timing, so a SIMD change is
+// verified before it is measured.
+//
+// Timings: each case is repeated until it has run --min-time-ms (default
+// 100); the median of five such runs is reported as ns per call and
+// throughput in input samples (or bytes) per second.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "byte_ringbuffer.hpp"
+#include "dsp_kernels.hpp"
+#include "fft_spectrum.hpp"
+#include "self_check.hpp"
+
+namespace {
+
+// Keeps the compiler from dropping work whose result is unused
+inline void do_not_optimize(const void* p) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r"(p) : "memory");
+#else
+    static volatile const void* sink;
+    sink = p;
+#endif
+}
+
+struct Options {
+    bool check_only = false;
+    bool json = false;
+    std::string filter;
+    double min_time_ms = 100.0;
+};
+
+// ---- checks ----
+
+std::vector<int16_t> random_s16(std::mt19937& rng, size_t count) {
+    std::uniform_int_distribution<int> value(-32768, 32767);
+    std::uniform_int_distribution<int> pick(0, 15);
+    std::vector<int16_t> out(count);
+    for (auto& s : out) {
+        // Mostly random, with the extremes and zero mixed in
+        switch (pick(rng)) {
+        case 0: s = -32768; break;
+        case 1: s = 32767; break;
+        case 2: s = 0; break;
+        default: s = static_cast<int16_t>(value(rng)); break;
+        }
+    }
+    return out;
+}
+
+void check_volume(std::mt19937& rng) {
+#ifdef WEBRADIO_USE_SSE2
+    std::uniform_real_distribution<float> volume(0.0f, 1.0f);
+    for (int round = 0; round < 2000; round++) {
+        size_t count = rng() % 200;
+        size_t offset = rng() % 8;      // unaligned starts
+        float v = round == 0 ? 0.0f : round == 1 ? 1.0f : volume(rng);
+        std::vector<int16_t> input = random_s16(rng, count + offset);
+        std::vector<int16_t> scalar = input;
+        std::vector<int16_t> simd = input;
+        apply_volume_scalar(scalar.data() + offset, count, v);
+        apply_volume_sse2(simd.data() + offset, count, v);
+        for (size_t i = 0; i < input.size(); i++) {
+            // Scalar truncates, SSE2 rounds
+            if (std::abs(scalar[i] - simd[i]) > 1) {
+                check(false, "apply_volume_sse2",
+                      "sample " + std::to_string(i) + " of " + std::to_string(input.size()) +
+                      ": " + std::to_string(input[i]) + " * " + std::to_string(v) + " = " +
+                      std::to_string(simd[i]) + ", scalar " + std::to_string(scalar[i]));
+                return;
+            }
+        }
+    }
+#else
+    (void)rng;
+#endif
+}
+
+void check_stereo_to_mono(std::mt19937& rng) {
+#ifdef WEBRADIO_USE_SSE2
+    for (int round = 0; round < 2000; round++) {
+        size_t frames = rng() % 200;
+        size_t offset = rng() % 4;
+        std::vector<int16_t> input = random_s16(rng, (frames + offset) * 2);
+        std::vector<float> scalar(frames + 1, -7.0f);
+        std::vector<float> simd(frames + 1, -7.0f);
+        stereo_to_mono_scalar(input.data() + offset * 2, scalar.data() + 1, frames);
+        stereo_to_mono_sse2(input.data() + offset * 2, simd.data() + 1, frames);
+        // Bit-exact, and nothing written outside the output
+        if (std::memcmp(scalar.data(), simd.data(), scalar.size() * sizeof(float)) != 0) {
+            size_t i = 0;
+            while (scalar[i] == simd[i]) {
+                i++;
+            }
+            check(false, "stereo_to_mono_sse2",
+                  "frame " + std::to_string(i) + " of " + std::to_string(frames) + ": " +
+                  std::to_string(simd[i]) + ", scalar " + std::to_string(scalar[i]));
+            return;
+        }
+    }
+#else
+    (void)rng;
+#endif
+}
+
+void check_fft(std::mt19937& rng) {
+    std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+    for (size_t n : {2u, 8u, 64u, 256u, 2048u}) {
+        FftTables tables(n);
+        std::vector<float> input(n);
+        for (auto& x : input) {
+            x = value(rng);
+        }
+        std::vector<float> real(n);
+        std::vector<float> imag(n);
+        fft_radix2(tables, input.data(), real.data(), imag.data());
+
+        double max_error = 0.0;
+        for (size_t k = 0; k < n; k++) {
+            double ref_real = 0.0;
+            double ref_imag = 0.0;
+            for (size_t t = 0; t < n; t++) {
+                double angle = -2.0 * M_PI * static_cast<double>(k * t % n) / static_cast<double>(n);
+                ref_real += input[t] * std::cos(angle);
+                ref_imag += input[t] * std::sin(angle);
+            }
+            max_error = std::max({max_error, std::abs(ref_real - real[k]), std::abs(ref_imag - imag[k])});
+        }
+        // Float rounding grows with log2(n) stages over outputs of up to n
+        double tolerance = 1e-5 * static_cast<double>(n) * std::log2(static_cast<double>(n) + 1.0);
+        check(max_error <= tolerance, "fft_radix2",
+              "n=" + std::to_string(n) + " max error " + std::to_string(max_error) +
+              " against the DFT, tolerance " + std::to_string(tolerance));
+    }
+}
+
+void check_spectrum(std::mt19937& rng) {
+    std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+    auto a = std::make_unique<FFTSpectrum>();
+    auto b = std::make_unique<FFTSpectrum>();
+    std::vector<float> block(FFTSpectrum::FFT_SIZE);
+    std::array<float, FFTSpectrum::NUM_BARS> bars_a{};
+    std::array<float, FFTSpectrum::NUM_BARS> bars_b{};
+    bool updated = false;
+
+    for (int round = 0; round < 200; round++) {
+        // Noise at random levels, then silence
+        float level = round < 100 ? value(rng) : 0.0f;
+        for (auto& x : block) {
+            x = value(rng) * level;
+        }
+        a->analyze(block.data());
+        b->analyze(block.data());
+        a->get_spectrum(bars_a, updated);
+        b->get_spectrum(bars_b, updated);
+        for (int bar = 0; bar < FFTSpectrum::NUM_BARS; bar++) {
+            if (!(bars_a[bar] >= 0.0f && bars_a[bar] <= 1.0f) || bars_a[bar] != bars_b[bar]) {
+                check(false, "FFTSpectrum::analyze",
+                      "round " + std::to_string(round) + " bar " + std::to_string(bar) + " = " +
+                      std::to_string(bars_a[bar]) + " (twin " + std::to_string(bars_b[bar]) +
+                      "), expected the same value in [0, 1]");
+                return;
+            }
+        }
+    }
+    // A hundred silent blocks (3 s of display) bring every bar down
+    for (int bar = 0; bar < FFTSpectrum::NUM_BARS; bar++) {
+        check(bars_a[bar] == 0.0f, "FFTSpectrum::analyze",
+              "bar " + std::to_string(bar) + " still at " + std::to_string(bars_a[bar]) + " after silence");
+    }
+}
+
+void check_ring(std::mt19937& rng) {
+    auto ring = std::make_unique<ByteRingbuffer>();
+    std::deque<uint8_t> reference;
+    uint8_t next = 0;
+    std::vector<uint8_t> scratch(ByteRingbuffer::BUFFER_SIZE);
+
+    for (int round = 0; round < 20000; round++) {
+        // Sizes up to a third of the ring so both ends wrap often
+        size_t size = rng() % (ByteRingbuffer::BUFFER_SIZE / 3);
+        switch (rng() % 4) {
+        case 0: {
+            for (size_t i = 0; i < size; i++) {
+                scratch[i] = next++;
+            }
+            size_t written = ring->write(scratch.data(), size);
+            reference.insert(reference.end(), scratch.begin(), scratch.begin() + written);
+            next = static_cast<uint8_t>(next - (size - written));
+            break;
+        }
+        case 1: {
+            uint8_t* dst = nullptr;
+            size_t span = std::min(ring->reserve_write_contiguous(dst), size);
+            for (size_t i = 0; i < span; i++) {
+                dst[i] = next;
+                reference.push_back(next++);
+            }
+            ring->produce(span);
+            break;
+        }
+        case 2: {
+            size_t got = ring->read(scratch.data(), size);
+            if (got != std::min(size, reference.size()) ||
+                !std::equal(scratch.begin(), scratch.begin() + got, reference.begin())) {
+                check(false, "ByteRingbuffer::read", "round " + std::to_string(round) + " returned wrong bytes");
+                return;
+            }
+            reference.erase(reference.begin(), reference.begin() + got);
+            break;
+        }
+        default: {
+            const uint8_t* src = nullptr;
+            size_t span = std::min(ring->reserve_read_contiguous(src), size);
+            if (!std::equal(src, src + span, reference.begin())) {
+                check(false, "ByteRingbuffer::reserve_read_contiguous",
+                      "round " + std::to_string(round) + " exposed wrong bytes");
+                return;
+            }
+            ring->consume(span);
+            reference.erase(reference.begin(), reference.begin() + span);
+            break;
+        }
+        }
+        if (ring->read_available() != reference.size()) {
+            check(false, "ByteRingbuffer::read_available",
+                  std::to_string(ring->read_available()) + ", expected " + std::to_string(reference.size()));
+            return;
+        }
+    }
+}
+
+// ---- timing ----
+
+struct Timing {
+    std::string kernel;
+    std::string variant;
+    size_t size = 0;            // samples, frames or bytes per call
+    const char* unit = "";
+    double ns_per_call = 0.0;
+
+    double items_per_second() const { return ns_per_call > 0.0 ? size * 1e9 / ns_per_call : 0.0; }
+};
+
+class Runner {
+public:
+    explicit Runner(const Options& options) : options_(options) {}
+
+    void run(const std::string& kernel, const std::string& variant, size_t size, const char* unit,
+             const std::function<void()>& body) {
+        std::string name = kernel + "/" + variant + "/" + std::to_string(size);
+        if (!options_.filter.empty() && name.find(options_.filter) == std::string::npos) {
+            return;
+        }
+        using Clock = std::chrono::steady_clock;
+        const auto min_time = std::chrono::duration<double, std::milli>(options_.min_time_ms);
+
+        // Calibrate the batch so one timing covers min_time
+        uint64_t batch = 1;
+        for (;;) {
+            auto start = Clock::now();
+            for (uint64_t i = 0; i < batch; i++) {
+                body();
+            }
+            if (Clock::now() - start >= min_time / 10 || batch >= (1ull << 40)) {
+                break;
+            }
+            batch *= 2;
+        }
+        batch *= 10;
+
+        std::vector<double> runs;
+        for (int r = 0; r < 5; r++) {
+            auto start = Clock::now();
+            for (uint64_t i = 0; i < batch; i++) {
+                body();
+            }
+            runs.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count() /
+                           static_cast<double>(batch));
+        }
+        std::sort(runs.begin(), runs.end());
+
+        Timing timing{kernel, variant, size, unit, runs[runs.size() / 2]};
+        if (!options_.json) {
+            std::printf("%-18s %-7s %7zu %-7s %12.1f ns %10.1f M%s/s\n", kernel.c_str(), variant.c_str(),
+                        size, unit, timing.ns_per_call, timing.items_per_second() / 1e6, unit);
+            std::fflush(stdout);
+        }
+        timings_.push_back(std::move(timing));
+    }
+
+    const std::vector<Timing>& timings() const { return timings_; }
+
+private:
+    const Options& options_;
+    std::vector<Timing> timings_;
+};
+
+void time_kernels(Runner& runner) {
+    std::mt19937 rng(42);
+
+    // Volume: 10 ms of stereo is 882 samples; miniaudio periods vary
+    for (size_t count : {64u, 882u, 4096u, 65536u}) {
+        std::vector<int16_t> samples = random_s16(rng, count);
+        runner.run("apply_volume", "scalar", count, "sample", [&]() {
+            apply_volume_scalar(samples.data(), count, 0.5f);
+            do_not_optimize(samples.data());
+        });
+#ifdef WEBRADIO_USE_SSE2
+        runner.run("apply_volume", "sse2", count, "sample", [&]() {
+            apply_volume_sse2(samples.data(), count, 0.5f);
+            do_not_optimize(samples.data());
+        });
+#endif
+    }
+
+    for (size_t frames : {64u, 441u, 2048u, 16384u}) {
+        std::vector<int16_t> stereo = random_s16(rng, frames * 2);
+        std::vector<float> mono(frames);
+        runner.run("stereo_to_mono", "scalar", frames, "frame", [&]() {
+            stereo_to_mono_scalar(stereo.data(), mono.data(), frames);
+            do_not_optimize(mono.data());
+        });
+#ifdef WEBRADIO_USE_SSE2
+        runner.run("stereo_to_mono", "sse2", frames, "frame", [&]() {
+            stereo_to_mono_sse2(stereo.data(), mono.data(), frames);
+            do_not_optimize(mono.data());
+        });
+#endif
+    }
+
+    // push_samples is stereo_to_mono plus the sample ring bookkeeping
+    auto spectrum = std::make_unique<FFTSpectrum>();
+    for (size_t frames : {64u, 441u, 2048u}) {
+        std::vector<int16_t> stereo = random_s16(rng, frames * 2);
+        runner.run("push_samples", "build", frames, "frame", [&]() {
+            spectrum->push_samples(stereo.data(), frames);
+        });
+    }
+
+    std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+    for (size_t n : {256u, 1024u, 2048u, 4096u}) {
+        FftTables tables(n);
+        std::vector<float> input(n);
+        for (auto& x : input) {
+            x = value(rng);
+        }
+        std::vector<float> real(n);
+        std::vector<float> imag(n);
+        runner.run("fft_radix2", "scalar", n, "sample", [&]() {
+            fft_radix2(tables, input.data(), real.data(), imag.data());
+            do_not_optimize(real.data());
+        });
+    }
+
+    // Window + FFT + update_spectrum, as process_samples() runs it
+    {
+        std::vector<float> block(FFTSpectrum::FFT_SIZE);
+        for (auto& x : block) {
+            x = value(rng) * 0.5f;
+        }
+        runner.run("spectrum_analyze", "build", FFTSpectrum::FFT_SIZE, "sample", [&]() {
+            spectrum->analyze(block.data());
+        });
+    }
+
+    // Ring copy paths: decoder writes into it, the callback reads out
+    auto ring = std::make_unique<ByteRingbuffer>();
+    for (size_t chunk : {64u, 1764u, 16384u}) {
+        std::vector<uint8_t> data(chunk, 0x5a);
+        std::vector<uint8_t> out(chunk);
+        runner.run("ring_write_read", "copy", chunk, "byte", [&]() {
+            ring->write(data.data(), chunk);
+            ring->read(out.data(), chunk);
+            do_not_optimize(out.data());
+        });
+        runner.run("ring_write_read", "reserve", chunk, "byte", [&]() {
+            for (size_t done = 0; done < chunk;) {
+                uint8_t* dst = nullptr;
+                size_t span = std::min(ring->reserve_write_contiguous(dst), chunk - done);
+                std::memcpy(dst, data.data() + done, span);
+                ring->produce(span);
+                done += span;
+            }
+            for (size_t done = 0; done < chunk;) {
+                const uint8_t* src = nullptr;
+                size_t span = std::min(ring->reserve_read_contiguous(src), chunk - done);
+                std::memcpy(out.data() + done, src, span);
+                ring->consume(span);
+                done += span;
+            }
+            do_not_optimize(out.data());
+        });
+    }
+}
+
+int usage(const char* argv0) {
+    std::fprintf(stderr, "usage: %s [--check-only] [--filter TEXT] [--min-time-ms N] [--json]\n", argv0);
+    return 1;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--check-only") {
+            options.check_only = true;
+        } else if (arg == "--json") {
+            options.json = true;
+        } else if (arg == "--filter" && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if (arg == "--min-time-ms" && i + 1 < argc) {
+            options.min_time_ms = std::max(1.0, std::atof(argv[++i]));
+        } else {
+            return usage(argv[0]);
+        }
+    }
+
+    std::mt19937 rng(1234);
+    check_volume(rng);
+    check_stereo_to_mono(rng);
+    check_fft(rng);
+    check_spectrum(rng);
+    check_ring(rng);
+    if (g_failures > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+#ifdef WEBRADIO_USE_SSE2
+    const char* variants = "scalar, sse2";
+#else
+    const char* variants = "scalar";
+#endif
+    if (!options.json) {
+        std::printf("checks passed (variants: %s)\n", variants);
+    }
+    if (options.check_only) {
+        return 0;
+    }
+
+    Runner runner(options);
+    time_kernels(runner);
+
+    if (options.json) {
+        nlohmann::ordered_json out = nlohmann::ordered_json::array();
+        for (const auto& t : runner.timings()) {
+            out.push_back({
+                {"kernel", t.kernel},
+                {"variant", t.variant},
+                {"size", t.size},
+                {"unit", t.unit},
+                {"ns_per_call", t.ns_per_call},
+                {"items_per_second", t.items_per_second()},
+            });
+        }
+        std::printf("%s\n", out.dump(2).c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,194 @@
+#include "loopback_http.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+std::string content_type_for(const std::filesystem::path& path) {
+    std::string ext = path.extension().string();
+    for (auto& c : ext) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    if (ext == ".mp3") return "audio/mpeg";
+    if (ext == ".aac" || ext == ".aacp" || ext == ".adts") return "audio/aac";
+    if (ext == ".ogg" || ext == ".oga" || ext == ".opus") return "audio/ogg";
+    if (ext == ".flac") return "audio/flac";
+    if (ext == ".m4a" || ext == ".mp4") return "audio/mp4";
+    return "application/octet-stream";
+}
+
+LoopbackHttpServer::~LoopbackHttpServer() {
+    stop();
+}
+
+bool LoopbackHttpServer::start(const std::string& path) {
+#ifdef __linux__
+    stop();
+    error_.clear();
+    path_ = path;
+    content_type_ = content_type_for(path);
+
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        error_ = "socket failed";
+        return false;
+    }
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t len = sizeof(addr);
+    if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len) < 0 ||
+        ::listen(listen_fd_, 64) < 0) {
+        error_ = std::string("cannot listen on loopback: ") + std::strerror(errno);
+        stop();
+        return false;
+    }
+    port_ = ntohs(addr.sin_port);
+
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+        error_ = "eventfd failed";
+        stop();
+        return false;
+    }
+
+    stop_requested_ = false;
+    thread_ = std::thread([this]() { run(); });
+    return true;
+#else
+    (void)path;
+    error_ = "the loopback server is only supported on Linux";
+    return false;
+#endif
+}
+
+void LoopbackHttpServer::stop() {
+#ifdef __linux__
+    stop_requested_ = true;
+    if (wake_fd_ >= 0) {
+        uint64_t one = 1;
+        (void)!write(wake_fd_, &one, sizeof(one));
+    }
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    {
+        // Unblocks clients stuck sending to a reader that went away
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        for (int fd : client_fds_) {
+            shutdown(fd, SHUT_RDWR);
+        }
+    }
+    for (auto& client : client_threads_) {
+        client.join();
+    }
+    client_threads_.clear();
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        listen_fd_ = -1;
+    }
+    if (wake_fd_ >= 0) {
+        close(wake_fd_);
+        wake_fd_ = -1;
+    }
+#endif
+}
+
+std::string LoopbackHttpServer::url() const {
+    return "http://127.0.0.1:" + std::to_string(port_) + "/" +
+           std::filesystem::path(path_).filename().string();
+}
+
+void LoopbackHttpServer::run() {
+#ifdef __linux__
+    while (!stop_requested_) {
+        pollfd fds[2] = {
+            {wake_fd_, POLLIN, 0},
+            {listen_fd_, POLLIN, 0},
+        };
+        if (poll(fds, 2, -1) < 0) {
+            continue;
+        }
+        if (fds[0].revents & POLLIN) {
+            break;
+        }
+        int client;
+        while ((client = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC)) >= 0) {
+            {
+                std::lock_guard<std::mutex> lock(clients_mutex_);
+                client_fds_.push_back(client);
+            }
+            client_threads_.emplace_back([this, client]() {
+                serve(client);
+                std::lock_guard<std::mutex> lock(clients_mutex_);
+                client_fds_.erase(std::find(client_fds_.begin(), client_fds_.end(), client));
+                close(client);
+            });
+        }
+    }
+#endif
+}
+
+void LoopbackHttpServer::serve(int client) {
+#ifdef __linux__
+    // The request does not matter; every path gets the file
+    char buf[64 * 1024];
+    std::string request;
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+        ssize_t n = read(client, buf, sizeof(buf));
+        if (n <= 0) {
+            return;
+        }
+        request.append(buf, static_cast<size_t>(n));
+    }
+
+    std::string header =
+        "HTTP/1.0 200 OK\r\n"
+        "Content-Type: " + content_type_ + "\r\n"
+        "icy-name: webradio-bench\r\n"
+        "Cache-Control: no-cache\r\n"
+        "\r\n";
+
+    auto send_all = [&](const char* data, size_t size) {
+        size_t sent = 0;
+        while (sent < size) {
+            ssize_t n = send(client, data + sent, size - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    };
+
+    if (!send_all(header.data(), header.size())) {
+        return;
+    }
+    std::ifstream file(path_, std::ios::binary);
+    while (file && !stop_requested_) {
+        file.read(buf, sizeof(buf));
+        std::streamsize n = file.gcount();
+        if (n <= 0 || !send_all(buf, static_cast<size_t>(n))) {
+            break;
+        }
+    }
+#else
+    (void)client;
+#endif
+}
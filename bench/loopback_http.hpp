@@ -0,0 +1,52 @@
+#ifndef LOOPBACK_HTTP_HPP
+#define LOOPBACK_HTTP_HPP
+
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Serves one local file on 127.0.0.1 the way an Icecast mount serves a
+// live stream (HTTP/1.0, no Content-Length, not seekable), so the bench
+// runs FFmpeg's http protocol and socket reads like a real station.
+// Each client is served from its own thread, so many streams can read the
+// same file at once.
+class LoopbackHttpServer {
+public:
+    LoopbackHttpServer() = default;
+    ~LoopbackHttpServer();
+
+    LoopbackHttpServer(const LoopbackHttpServer&) = delete;
+    LoopbackHttpServer& operator=(const LoopbackHttpServer&) = delete;
+
+    // Listens on an ephemeral port. Returns false and sets error() on failure.
+    bool start(const std::string& path);
+    void stop();
+
+    // http://127.0.0.1:PORT/NAME
+    std::string url() const;
+    const std::string& error() const { return error_; }
+
+private:
+    void run();
+    void serve(int client);
+
+    std::string path_;
+    std::string content_type_;
+    std::string error_;
+    int port_ = 0;
+    int listen_fd_ = -1;
+    int wake_fd_ = -1;
+    std::atomic<bool> stop_requested_{false};
+    std::thread thread_;
+    std::mutex clients_mutex_;
+    std::vector<int> client_fds_;       // open connections, shut down by stop()
+    std::vector<std::thread> client_threads_;
+};
+
+// Content-Type an Icecast server would send for a file, by its extension
+std::string content_type_for(const std::filesystem::path& path);
+
+#endif // LOOPBACK_HTTP_HPP
@@ -0,0 +1,307 @@
+// Multi-station monitoring benchmark: N streams decoded at once by
+// MonitorEngine, once per decode pool size, as fast as the inputs deliver.
+//
+//   webradio-monitor-bench [--streams N] [--threads 1,2,4] [--slice P]
+//                          [--http] [--reactors N] [--json] FILE|URL...
+//
+// Inputs are dealt to the streams round-robin. Every stream of the same
+// input must decode to the same PCM (compared by hash) and none may fail;
+// otherwise the exit status is 1.
+//
+// --http serves each file from a loopback Icecast-style server, so the
+// streams connect over HTTP: with --reactors N (default 1) their sockets
+// are read by N reactor threads, with --reactors 0 by a fetch thread each.
+//
+// Per pool size: audio decoded, wall time, aggregate x realtime, pool CPU
+// time, streams per core (seconds of audio decoded per second of pool
+// CPU, i.e. how many real-time streams one core keeps up with), scaling
+// of the aggregate rate against the first pool size, tasks stolen, how
+// often a demuxer found its input buffer empty, and the most threads the
+// process had while the streams ran.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "loopback_http.hpp"
+#include "metrics.hpp"
+#include "monitor_engine.hpp"
+#include "stream_decoder.hpp"
+
+extern "C" {
+#include <libavutil/log.h>
+}
+
+namespace {
+
+struct Options {
+    size_t streams = 16;
+    std::vector<size_t> threads;
+    size_t slice = MonitorOptions().packets_per_slice;
+    size_t reactors = MonitorOptions().reactor_threads;
+    bool http = false;
+    bool json = false;
+    std::vector<std::string> inputs;
+};
+
+struct RunResult {
+    size_t threads = 0;
+    size_t streams = 0;
+    size_t failed = 0;
+    size_t mismatched = 0;      // streams whose PCM differs from their input's first stream
+    double audio_s = 0.0;
+    double wall_s = 0.0;
+    double cpu_s = 0.0;
+    uint64_t tasks = 0;
+    uint64_t steals = 0;
+    uint64_t input_waits = 0;
+    size_t os_threads = 0;      // peak, whole process
+    double scaling = 1.0;
+
+    double realtime() const { return wall_s > 0.0 ? audio_s / wall_s : 0.0; }
+    double streams_per_core() const { return cpu_s > 0.0 ? audio_s / cpu_s : 0.0; }
+};
+
+// What a stream decoded, order-sensitive; cheap next to decoding
+class PcmHash : public AudioAnalyzer {
+public:
+    void push_samples(const int16_t* stereo_samples, size_t frame_count) override {
+        uint64_t hash = hash_;
+        for (size_t i = 0; i < frame_count; i++) {
+            uint32_t frame = static_cast<uint16_t>(stereo_samples[2 * i]) |
+                             static_cast<uint32_t>(static_cast<uint16_t>(stereo_samples[2 * i + 1])) << 16;
+            hash = (hash ^ frame) * 0x100000001b3ull;
+        }
+        hash_ = hash;
+        frames_ += frame_count;
+    }
+
+    // Read after the stream finished
+    uint64_t hash() const { return hash_ ^ frames_; }
+
+private:
+    uint64_t hash_ = 0xcbf29ce484222325ull;
+    uint64_t frames_ = 0;
+};
+
+// Threads of this process, from /proc; 0 where there is none
+size_t process_threads() {
+    FILE* f = std::fopen("/proc/self/status", "r");
+    if (!f) {
+        return 0;
+    }
+    char line[256];
+    size_t threads = 0;
+    while (std::fgets(line, sizeof(line), f)) {
+        if (std::sscanf(line, "Threads: %zu", &threads) == 1) {
+            break;
+        }
+    }
+    std::fclose(f);
+    return threads;
+}
+
+bool run(const Options& options, size_t threads, RunResult& result) {
+    MonitorOptions monitor_options;
+    monitor_options.threads = threads;
+    monitor_options.packets_per_slice = options.slice;
+    monitor_options.reactor_threads = options.reactors;
+    MonitorEngine engine(monitor_options);
+
+    std::vector<PcmHash*> hashes;
+    std::vector<size_t> input_of;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < options.streams; i++) {
+        size_t input = i % options.inputs.size();
+        auto hash = std::make_unique<PcmHash>();
+        hashes.push_back(hash.get());
+        input_of.push_back(input);
+        engine.add_stream(options.inputs[input], "stream " + std::to_string(i), std::move(hash));
+    }
+    while (engine.active_streams() > 0) {
+        result.os_threads = std::max(result.os_threads, process_threads());
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    std::vector<MonitorStreamStatus> status = engine.status();
+    WorkStealingPool::Stats pool = engine.pool_stats();
+
+    result.threads = engine.threads();
+    result.streams = options.streams;
+    result.wall_s = std::chrono::duration<double>(end - start).count();
+    result.cpu_s = static_cast<double>(pool.cpu_ns) / 1e9;
+    result.tasks = pool.tasks;
+    result.steals = pool.steals;
+
+    // Hashes are only read once every stream has finished
+    std::map<size_t, uint64_t> expected;
+    for (size_t i = 0; i < status.size(); i++) {
+        const MonitorStreamStatus& s = status[i];
+        result.audio_s += static_cast<double>(s.audio_frames) / StreamDecoder::OUTPUT_SAMPLE_RATE;
+        result.input_waits += s.input_waits;
+        if (s.state == MonitorState::Failed) {
+            result.failed++;
+            std::fprintf(stderr, "%s (%s): %s\n", s.name.c_str(), s.url.c_str(), s.error.c_str());
+            continue;
+        }
+        auto [it, first] = expected.emplace(input_of[i], hashes[i]->hash());
+        if (!first && it->second != hashes[i]->hash()) {
+            result.mismatched++;
+            std::fprintf(stderr, "%s (%s): decoded PCM differs from the other streams of its input\n",
+                         s.name.c_str(), s.url.c_str());
+        }
+    }
+    return result.failed == 0 && result.mismatched == 0;
+}
+
+void print_table(const std::vector<RunResult>& results) {
+    std::printf("%d KiB input buffer per stream, %u hardware threads\n",
+                static_cast<int>(MonitorEngine::INPUT_BUFFER_SIZE / 1024), std::thread::hardware_concurrency());
+    std::printf("%7s %7s %9s %8s %9s %8s %16s %8s %8s %8s %8s %10s\n",
+                "threads", "streams", "audio_s", "wall_s", "realtime", "cpu_s", "streams/core", "scaling",
+                "tasks", "steals", "waits", "os_threads");
+    for (const auto& r : results) {
+        std::printf("%7zu %7zu %9.1f %8.2f %8.1fx %8.2f %16.1f %7.2fx %8llu %8llu %8llu %10zu\n",
+                    r.threads, r.streams, r.audio_s, r.wall_s, r.realtime(), r.cpu_s, r.streams_per_core(),
+                    r.scaling, static_cast<unsigned long long>(r.tasks),
+                    static_cast<unsigned long long>(r.steals), static_cast<unsigned long long>(r.input_waits),
+                    r.os_threads);
+    }
+}
+
+void print_json(const std::vector<RunResult>& results) {
+    nlohmann::ordered_json out = nlohmann::ordered_json::array();
+    for (const auto& r : results) {
+        out.push_back({
+            {"threads", r.threads},
+            {"streams", r.streams},
+            {"failed", r.failed},
+            {"mismatched", r.mismatched},
+            {"audio_s", r.audio_s},
+            {"wall_s", r.wall_s},
+            {"realtime", r.realtime()},
+            {"pool_cpu_s", r.cpu_s},
+            {"streams_per_core", r.streams_per_core()},
+            {"scaling", r.scaling},
+            {"tasks", r.tasks},
+            {"steals", r.steals},
+            {"input_waits", r.input_waits},
+            {"os_threads", r.os_threads},
+            {"input_buffer_bytes", MonitorEngine::INPUT_BUFFER_SIZE},
+        });
+    }
+    std::printf("%s\n", out.dump(2).c_str());
+}
+
+std::vector<size_t> parse_threads(const std::string& list) {
+    std::vector<size_t> threads;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t comma = list.find(',', start);
+        std::string item = list.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+        int n = std::atoi(item.c_str());
+        if (n > 0) {
+            threads.push_back(static_cast<size_t>(n));
+        }
+        if (comma == std::string::npos) {
+            break;
+        }
+        start = comma + 1;
+    }
+    return threads;
+}
+
+// 1, 2, 4, ... up to the hardware threads, and the hardware threads
+std::vector<size_t> default_threads() {
+    size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<size_t> threads;
+    for (size_t n = 1; n < cores; n *= 2) {
+        threads.push_back(n);
+    }
+    threads.push_back(cores);
+    return threads;
+}
+
+int usage(const char* argv0) {
+    std::fprintf(stderr,
+        "usage: %s [--streams N] [--threads 1,2,4] [--slice PACKETS] [--http] [--reactors N] [--json] FILE|URL...\n",
+        argv0);
+    return 1;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--json") {
+            options.json = true;
+        } else if (arg == "--streams" && i + 1 < argc) {
+            options.streams = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--threads" && i + 1 < argc) {
+            options.threads = parse_threads(argv[++i]);
+        } else if (arg == "--slice" && i + 1 < argc) {
+            options.slice = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--http") {
+            options.http = true;
+        } else if (arg == "--reactors" && i + 1 < argc) {
+            options.reactors = static_cast<size_t>(std::max(0, std::atoi(argv[++i])));
+        } else if (!arg.empty() && arg[0] == '-') {
+            return usage(argv[0]);
+        } else {
+            options.inputs.push_back(arg);
+        }
+    }
+    if (options.inputs.empty()) {
+        return usage(argv[0]);
+    }
+    if (options.threads.empty()) {
+        options.threads = default_threads();
+    }
+
+    av_log_set_level(AV_LOG_ERROR);
+    engine_metrics();
+
+    std::vector<std::unique_ptr<LoopbackHttpServer>> servers;
+    if (options.http) {
+        for (auto& input : options.inputs) {
+            auto server = std::make_unique<LoopbackHttpServer>();
+            if (!server->start(input)) {
+                std::fprintf(stderr, "%s: %s\n", input.c_str(), server->error().c_str());
+                return 1;
+            }
+            input = server->url();
+            servers.push_back(std::move(server));
+        }
+    }
+
+    std::vector<RunResult> results;
+    bool failed = false;
+    for (size_t threads : options.threads) {
+        RunResult result;
+        if (!run(options, threads, result)) {
+            failed = true;
+        }
+        if (!results.empty() && results.front().realtime() > 0.0) {
+            result.scaling = result.realtime() / results.front().realtime();
+        }
+        results.push_back(result);
+    }
+
+    if (options.json) {
+        print_json(results);
+    } else {
+        print_table(results);
+    }
+    return failed ? 1 : 0;
+}
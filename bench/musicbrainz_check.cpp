@@ -0,0 +1,174 @@
+// Self-check for MusicBrainzClient's lookup queue, run against a mocked
+// fetcher instead of the web service.
+//
+//   webradio-musicbrainz-check
+//
+// The fetcher holds its first request until released, so the queue can
+// be flooded while the worker is busy. Checks that the queue keeps the
+// MAX_QUEUED newest tracks and counts the rest as dropped (also in the
+// webradio_musicbrainz_dropped_lookups metric), that titles of the same
+// track coalesce into one request, that the newest track is fetched next,
+// and that every caller of a fetched track gets a result. Also feeds the
+// response parser and the cache loader null and mistyped fields, which
+// must fall back to defaults. Runs in about MIN_REQUEST_INTERVAL; any
+// failure exits with status 1. The cache goes to a temporary
+// XDG_CACHE_HOME, so the user's cache is never touched.
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "metrics.hpp"
+#include "musicbrainz.hpp"
+#include "self_check.hpp"
+
+namespace {
+
+std::string stream_title(int i) {
+    return "Artist " + std::to_string(i) + " - Title " + std::to_string(i);
+}
+
+// Answers every lookup with the title as album; the first call waits
+// until release()
+class MockFetcher {
+public:
+    bool fetch(const std::string& artist, const std::string& title, TrackInfo& out) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        calls_.push_back(artist + " - " + title);
+        cv_.notify_all();
+        cv_.wait(lock, [this]() { return released_; });
+        out.found = true;
+        out.album = title;
+        return true;
+    }
+
+    void release() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        released_ = true;
+        cv_.notify_all();
+    }
+
+    // Waits until count calls have started; false on timeout
+    bool wait_calls(size_t count, std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return cv_.wait_for(lock, timeout, [&]() { return calls_.size() >= count; });
+    }
+
+    std::vector<std::string> calls() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return calls_;
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<std::string> calls_;
+    bool released_ = false;
+};
+
+uint64_t metric_value(const std::string& name) {
+    std::string text = metrics_registry().openmetrics();
+    std::string prefix = name + "_total ";
+    size_t pos = text.find(prefix);
+    return pos == std::string::npos ? UINT64_MAX : std::strtoull(text.c_str() + pos + prefix.size(), nullptr, 10);
+}
+
+} // namespace
+
+int main() {
+    char cache_dir[] = "/tmp/webradio-mb-check-XXXXXX";
+    if (!mkdtemp(cache_dir)) {
+        std::perror("mkdtemp");
+        return 1;
+    }
+    setenv("XDG_CACHE_HOME", cache_dir, 1);
+
+    constexpr int FLOOD = static_cast<int>(MusicBrainzClient::MAX_QUEUED) + 5;
+    MockFetcher fetcher;
+    {
+        MusicBrainzClient client([&fetcher](const std::string& artist, const std::string& title, TrackInfo& out) {
+            return fetcher.fetch(artist, title, out);
+        });
+
+        // Track 0 occupies the worker; 1..FLOOD queue up behind it
+        check(!client.lookup(stream_title(0)).has_value(), "uncached title is queued");
+        check(fetcher.wait_calls(1, std::chrono::seconds(5)), "worker picks up the first lookup");
+        for (int i = 1; i <= FLOOD; ++i) {
+            client.lookup(stream_title(i));
+        }
+        // Same track as the newest one, spelled differently: no new request
+        std::string variant = "artist " + std::to_string(FLOOD) + " - Title " + std::to_string(FLOOD) + " (Radio Edit)";
+        client.lookup(variant);
+
+        uint64_t expected_drops = FLOOD - MusicBrainzClient::MAX_QUEUED;
+        check(client.dropped_lookups() == expected_drops, "oldest lookups beyond MAX_QUEUED are counted as dropped");
+        check(metric_value("webradio_musicbrainz_dropped_lookups") == expected_drops, "drops are exported as a metric");
+
+        fetcher.release();
+        bool second = fetcher.wait_calls(2, MusicBrainzClient::MIN_REQUEST_INTERVAL * 3);
+        std::vector<std::string> calls = fetcher.calls();
+        check(second && calls.size() >= 2 && calls[1] == "Artist " + std::to_string(FLOOD) + " - Title " + std::to_string(FLOOD),
+              "newest track is fetched next");
+
+        // Results for track 0 and both spellings of the newest track
+        std::set<std::string> results;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (results.size() < 3 && std::chrono::steady_clock::now() < deadline) {
+            MusicBrainzClient::Result result;
+            while (client.take_result(result)) {
+                results.insert(result.stream_title);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        check(results.count(stream_title(0)) == 1, "first lookup gets its result");
+        check(results.count(stream_title(FLOOD)) == 1 && results.count(variant) == 1,
+              "coalesced titles each get a result");
+        check(client.lookup(stream_title(0)).has_value(), "fetched track is answered from the cache");
+
+        client.stop();
+        calls = fetcher.calls();
+        bool dropped_fetched = false;
+        for (const auto& call : calls) {
+            for (uint64_t i = 1; i <= expected_drops; ++i) {
+                dropped_fetched |= call == stream_title(static_cast<int>(i));
+            }
+        }
+        check(!dropped_fetched, "dropped lookups are never fetched");
+    }
+
+    // MusicBrainz sends null for unknown fields; a damaged cache can hold
+    // anything. Neither may throw.
+    TrackInfo info;
+    bool parsed = parse_recording_search(
+        R"({"recordings":[{"score":100,"first-release-date":null,"releases":[{"title":null,"date":"1999-05-01"}],)"
+        R"("genres":null,"tags":[{"name":"rock","count":null}]}]})", info);
+    check(parsed && info.found && info.album.empty() && info.year == "1999" && info.genre == "rock",
+          "null and mistyped response fields fall back to defaults");
+    parsed = parse_recording_search(R"({"recordings":[{"score":"100"}]})", info);
+    check(parsed && !info.found, "non-numeric score is no match");
+    check(!parse_recording_search("[]", info), "non-object response is rejected");
+
+    std::string damaged_path = std::string(cache_dir) + "/damaged.json";
+    std::ofstream(damaged_path) << R"([{"key":"a - b","album":null,"year":1999,"found":"yes"},)"
+                                   R"({"key":5},{"key":"c - d","album":"X","found":true}])";
+    TrackInfoCache damaged(10);
+    bool loaded = damaged.load(damaged_path);
+    std::optional<TrackInfo> odd = damaged.get("a - b");
+    std::optional<TrackInfo> good = damaged.get("c - d");
+    check(loaded && odd && odd->album.empty() && odd->year.empty() && !odd->found && good && good->album == "X",
+          "cache entries with mistyped fields load with defaults");
+
+    std::error_code ec;
+    std::filesystem::remove_all(cache_dir, ec);
+
+    return check_summary();
+}
@@ -0,0 +1,453 @@
+// Stress test and throughput benchmark for ByteRingbuffer, the SPSC ring
+// between the decoder thread and the audio callback.
+//
+//   webradio-ring-stress [--seconds N] [--seed N] [--stress-only | --bench-only]
+//                        [--bench-mb N] [--json]
+//
+// Stress: a producer and a consumer thread run for --seconds (default 5)
+// through several patterns (tiny chunks, ring-sized chunks, slow
+// consumer, slow producer, everything mixed), picking write() or
+// reserve_write_contiguous()/produce() and read() or
+// reserve_read_contiguous()/consume() at random with random sizes, and
+// the consumer now and then calling consumer_clear(). Every byte's value
+// is a hash of its stream position, so the consumer verifies content and
+// order byte for byte; it also checks that no call reports more bytes
+// than the ring can hold and that the positions agree with its own
+// count. Any failure exits with status 1. Build with
+// -DWEBRADIO_RING_TSAN=ON to run it under ThreadSanitizer.
+//
+// Bench: both threads move --bench-mb MiB (default 1024) per chunk size
+// and copy path as fast as they can, yielding only when the ring is full
+// or empty; reports GiB/s and the latency of individual calls (every 64th
+// call timed) on each side.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "byte_ringbuffer.hpp"
+#include "metrics.hpp"
+
+namespace {
+
+constexpr size_t RING_CAPACITY = ByteRingbuffer::BUFFER_SIZE - 1;
+
+// Byte at stream position p
+inline uint8_t pattern_byte(uint64_t p) {
+    return static_cast<uint8_t>((p * 0x9E3779B97F4A7C15ull) >> 56);
+}
+
+struct Options {
+    double seconds = 5.0;
+    uint32_t seed = 1;
+    bool stress = true;
+    bool bench = true;
+    size_t bench_mb = 1024;
+    bool json = false;
+};
+
+// ---- stress ----
+
+struct Pattern {
+    const char* name;
+    size_t max_write;           // chunk sizes are 1 .. max_* (0 allowed too)
+    size_t max_read;
+    unsigned producer_pause;    // 1 in N operations yields or sleeps; 0 = never
+    unsigned consumer_pause;
+    unsigned clear_every;       // 1 in N consumer operations clears; 0 = never
+};
+
+const Pattern PATTERNS[] = {
+    {"tiny", 16, 16, 0, 0, 0},
+    {"ring-sized", RING_CAPACITY, RING_CAPACITY, 0, 0, 0},
+    {"slow-consumer", 4096, 1024, 0, 8, 0},
+    {"slow-producer", 1024, 4096, 8, 0, 0},
+    {"mixed", 70000, 70000, 64, 64, 5000},
+};
+
+struct StressResult {
+    std::string pattern;
+    uint64_t bytes = 0;
+    uint64_t writes = 0;
+    uint64_t reads = 0;
+    uint64_t clears = 0;
+    std::string failure;        // empty when the pattern passed
+};
+
+void pause(std::mt19937& rng) {
+    if (rng() % 4 == 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(rng() % 200));
+    } else {
+        std::this_thread::yield();
+    }
+}
+
+size_t chunk_size(std::mt19937& rng, size_t max) {
+    // Bias towards small chunks while still reaching max now and then
+    switch (rng() % 4) {
+    case 0: return rng() % (std::min<size_t>(max, 64) + 1);
+    case 1: return rng() % (std::min<size_t>(max, 4096) + 1);
+    default: return rng() % (max + 1);
+    }
+}
+
+StressResult run_pattern(const Pattern& pattern, double seconds, uint32_t seed) {
+    auto ring = std::make_unique<ByteRingbuffer>();
+    std::atomic<bool> stop{false};
+    std::atomic<bool> failed{false};
+    std::atomic<uint64_t> produced{0};      // final stream length, set once the producer exits
+    std::atomic<bool> producer_done{false};
+    StressResult result;
+    result.pattern = pattern.name;
+
+    auto fail = [&](std::string message) {
+        if (!failed.exchange(true)) {
+            result.failure = std::move(message);
+        }
+    };
+
+    std::thread producer([&]() {
+        std::mt19937 rng(seed * 2 + 1);
+        std::vector<uint8_t> scratch(pattern.max_write);
+        uint64_t pos = 0;
+        uint64_t writes = 0;
+        while (!stop.load(std::memory_order_relaxed) && !failed.load(std::memory_order_relaxed)) {
+            size_t want = chunk_size(rng, pattern.max_write);
+            size_t done = 0;
+            if (rng() % 2 == 0) {
+                for (size_t i = 0; i < want; i++) {
+                    scratch[i] = pattern_byte(pos + i);
+                }
+                done = ring->write(scratch.data(), want);
+            } else {
+                uint8_t* dst = nullptr;
+                size_t span = ring->reserve_write_contiguous(dst);
+                if (span > RING_CAPACITY || (span > 0) != (dst != nullptr)) {
+                    fail("reserve_write_contiguous returned " + std::to_string(span) + " bytes");
+                    break;
+                }
+                done = std::min(span, want);
+                for (size_t i = 0; i < done; i++) {
+                    dst[i] = pattern_byte(pos + i);
+                }
+                ring->produce(done);
+            }
+            if (done > want) {
+                fail("write returned " + std::to_string(done) + " of " + std::to_string(want) + " bytes");
+                break;
+            }
+            pos += done;
+            writes++;
+            if (ring->write_position() != static_cast<size_t>(pos)) {
+                fail("write_position " + std::to_string(ring->write_position()) + ", producer wrote " +
+                     std::to_string(pos));
+                break;
+            }
+            if (done == 0 || (pattern.producer_pause && rng() % pattern.producer_pause == 0)) {
+                pause(rng);
+            }
+        }
+        result.writes = writes;
+        produced.store(pos, std::memory_order_relaxed);
+        producer_done.store(true, std::memory_order_release);
+    });
+
+    std::thread consumer([&]() {
+        std::mt19937 rng(seed * 2 + 2);
+        std::vector<uint8_t> scratch(pattern.max_read);
+        uint64_t pos = 0;
+        uint64_t reads = 0;
+        uint64_t clears = 0;
+        uint64_t bytes = 0;
+        for (;;) {
+            if (failed.load(std::memory_order_relaxed)) {
+                break;
+            }
+            // Drain everything the producer wrote before stopping
+            if (producer_done.load(std::memory_order_acquire) &&
+                pos == produced.load(std::memory_order_relaxed)) {
+                break;
+            }
+            size_t available = ring->read_available();
+            if (available > RING_CAPACITY) {
+                fail("read_available " + std::to_string(available) + " exceeds capacity");
+                break;
+            }
+            if (pattern.clear_every && rng() % pattern.clear_every == 0) {
+                // Drops whatever is queued; positions stay continuous
+                ring->consumer_clear();
+                uint64_t skipped_to = ring->read_position();
+                if (skipped_to < pos) {
+                    fail("consumer_clear moved read_position back from " + std::to_string(pos) + " to " +
+                         std::to_string(skipped_to));
+                    break;
+                }
+                pos = skipped_to;
+                clears++;
+                continue;
+            }
+
+            size_t want = chunk_size(rng, pattern.max_read);
+            const uint8_t* data = nullptr;
+            size_t done = 0;
+            bool reserved = rng() % 2 == 0;
+            if (reserved) {
+                done = std::min(ring->reserve_read_contiguous(data), want);
+            } else {
+                done = ring->read(scratch.data(), want);
+                data = scratch.data();
+            }
+            if (done > want || done > RING_CAPACITY) {
+                fail("read returned " + std::to_string(done) + " of " + std::to_string(want) + " bytes");
+                break;
+            }
+            for (size_t i = 0; i < done; i++) {
+                if (data[i] != pattern_byte(pos + i)) {
+                    fail(std::string(reserved ? "reserve_read_contiguous" : "read") + " at stream byte " +
+                         std::to_string(pos + i) + ": got " + std::to_string(data[i]) + ", expected " +
+                         std::to_string(pattern_byte(pos + i)));
+                    break;
+                }
+            }
+            if (reserved) {
+                ring->consume(done);
+            }
+            pos += done;
+            bytes += done;
+            reads++;
+            if (ring->read_position() != static_cast<size_t>(pos)) {
+                fail("read_position " + std::to_string(ring->read_position()) + ", consumer read " +
+                     std::to_string(pos));
+                break;
+            }
+            if (done == 0 || (pattern.consumer_pause && rng() % pattern.consumer_pause == 0)) {
+                pause(rng);
+            }
+        }
+        result.reads = reads;
+        result.clears = clears;
+        result.bytes = bytes;
+    });
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+    while (std::chrono::steady_clock::now() < deadline && !failed.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    stop.store(true);
+    producer.join();
+    consumer.join();
+    return result;
+}
+
+// ---- bench ----
+
+struct BenchResult {
+    std::string path;           // "copy" (write/read) or "reserve"
+    size_t chunk = 0;
+    double seconds = 0.0;
+    uint64_t bytes = 0;
+    Histogram::Snapshot write_ns;
+    Histogram::Snapshot read_ns;
+
+    double gib_per_second() const { return seconds > 0.0 ? bytes / seconds / (1024.0 * 1024.0 * 1024.0) : 0.0; }
+};
+
+constexpr uint64_t LATENCY_SAMPLE_EVERY = 64;
+
+BenchResult run_bench(bool reserve, size_t chunk, uint64_t total) {
+    auto ring = std::make_unique<ByteRingbuffer>();
+    Histogram write_ns;
+    Histogram read_ns;
+    std::vector<uint8_t> source(chunk, 0x5a);
+    std::vector<uint8_t> sink(chunk);
+
+    auto write_once = [&](size_t len) -> size_t {
+        if (!reserve) {
+            return ring->write(source.data(), len);
+        }
+        uint8_t* dst = nullptr;
+        size_t span = std::min(ring->reserve_write_contiguous(dst), len);
+        std::memcpy(dst, source.data(), span);
+        ring->produce(span);
+        return span;
+    };
+    auto read_once = [&](size_t len) -> size_t {
+        if (!reserve) {
+            return ring->read(sink.data(), len);
+        }
+        const uint8_t* src = nullptr;
+        size_t span = std::min(ring->reserve_read_contiguous(src), len);
+        std::memcpy(sink.data(), src, span);
+        ring->consume(span);
+        return span;
+    };
+
+    uint64_t start_ns = metrics_now_ns();
+    std::thread producer([&]() {
+        uint64_t calls = 0;
+        for (uint64_t sent = 0; sent < total;) {
+            size_t len = static_cast<size_t>(std::min<uint64_t>(chunk, total - sent));
+            size_t done = 0;
+            if (++calls % LATENCY_SAMPLE_EVERY == 0) {
+                uint64_t t0 = metrics_now_ns();
+                done = write_once(len);
+                if (done > 0) {
+                    write_ns.record(metrics_now_ns() - t0);
+                }
+            } else {
+                done = write_once(len);
+            }
+            sent += done;
+            if (done == 0) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    uint64_t calls = 0;
+    for (uint64_t received = 0; received < total;) {
+        size_t done = 0;
+        if (++calls % LATENCY_SAMPLE_EVERY == 0) {
+            uint64_t t0 = metrics_now_ns();
+            done = read_once(chunk);
+            if (done > 0) {
+                read_ns.record(metrics_now_ns() - t0);
+            }
+        } else {
+            done = read_once(chunk);
+        }
+        received += done;
+        if (done == 0) {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+
+    BenchResult result;
+    result.path = reserve ? "reserve" : "copy";
+    result.chunk = chunk;
+    result.seconds = (metrics_now_ns() - start_ns) / 1e9;
+    result.bytes = total;
+    result.write_ns = write_ns.snapshot();
+    result.read_ns = read_ns.snapshot();
+    return result;
+}
+
+nlohmann::ordered_json latency_json(const Histogram::Snapshot& s) {
+    return {
+        {"samples", s.count},
+        {"p50_ns", s.quantile(0.5)},
+        {"p99_ns", s.quantile(0.99)},
+        {"max_ns", s.max},
+    };
+}
+
+int usage(const char* argv0) {
+    std::fprintf(stderr,
+                 "usage: %s [--seconds N] [--seed N] [--stress-only | --bench-only] [--bench-mb N] [--json]\n",
+                 argv0);
+    return 1;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--seconds" && i + 1 < argc) {
+            options.seconds = std::max(0.05, std::atof(argv[++i]));
+        } else if (arg == "--seed" && i + 1 < argc) {
+            options.seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--stress-only") {
+            options.bench = false;
+        } else if (arg == "--bench-only") {
+            options.stress = false;
+        } else if (arg == "--bench-mb" && i + 1 < argc) {
+            options.bench_mb = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--json") {
+            options.json = true;
+        } else {
+            return usage(argv[0]);
+        }
+    }
+
+    nlohmann::ordered_json out;
+    bool ok = true;
+
+    if (options.stress) {
+        const size_t count = sizeof(PATTERNS) / sizeof(PATTERNS[0]);
+        nlohmann::ordered_json stress = nlohmann::ordered_json::array();
+        for (size_t i = 0; i < count; i++) {
+            StressResult r = run_pattern(PATTERNS[i], options.seconds / count, options.seed + static_cast<uint32_t>(i));
+            if (!options.json) {
+                std::printf("stress %-14s %s  %8.1f MiB  %9llu writes  %9llu reads  %5llu clears\n",
+                            r.pattern.c_str(), r.failure.empty() ? "ok  " : "FAIL", r.bytes / (1024.0 * 1024.0),
+                            static_cast<unsigned long long>(r.writes), static_cast<unsigned long long>(r.reads),
+                            static_cast<unsigned long long>(r.clears));
+                std::fflush(stdout);
+            }
+            if (!r.failure.empty()) {
+                std::fprintf(stderr, "FAIL %s (seed %u): %s\n", r.pattern.c_str(),
+                             options.seed + static_cast<unsigned>(i), r.failure.c_str());
+                ok = false;
+            }
+            stress.push_back({
+                {"pattern", r.pattern},
+                {"ok", r.failure.empty()},
+                {"bytes", r.bytes},
+                {"writes", r.writes},
+                {"reads", r.reads},
+                {"clears", r.clears},
+                {"failure", r.failure},
+            });
+        }
+        out["stress"] = std::move(stress);
+    }
+
+    // A failed ring is not worth timing
+    if (options.bench && ok) {
+        nlohmann::ordered_json bench = nlohmann::ordered_json::array();
+        uint64_t total = static_cast<uint64_t>(options.bench_mb) * 1024 * 1024;
+        for (size_t chunk : {64u, 1764u, 16384u, 65536u}) {
+            for (bool reserve : {false, true}) {
+                BenchResult r = run_bench(reserve, chunk, total);
+                if (!options.json) {
+                    std::printf("bench  %-7s %6zu B  %7.2f GiB/s  write p50 %5llu ns p99 %6llu ns"
+                                "  read p50 %5llu ns p99 %6llu ns\n",
+                                r.path.c_str(), r.chunk, r.gib_per_second(),
+                                static_cast<unsigned long long>(r.write_ns.quantile(0.5)),
+                                static_cast<unsigned long long>(r.write_ns.quantile(0.99)),
+                                static_cast<unsigned long long>(r.read_ns.quantile(0.5)),
+                                static_cast<unsigned long long>(r.read_ns.quantile(0.99)));
+                    std::fflush(stdout);
+                }
+                bench.push_back({
+                    {"path", r.path},
+                    {"chunk_bytes", r.chunk},
+                    {"bytes", r.bytes},
+                    {"seconds", r.seconds},
+                    {"gib_per_second", r.gib_per_second()},
+                    {"write_latency", latency_json(r.write_ns)},
+                    {"read_latency", latency_json(r.read_ns)},
+                });
+            }
+        }
+        out["bench"] = std::move(bench);
+    }
+
+    if (options.json) {
+        out["ok"] = ok;
+        std::printf("%s\n", out.dump(2).c_str());
+    }
+    return ok ? 0 : 1;
+}
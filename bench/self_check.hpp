@@ -0,0 +1,34 @@
+#ifndef SELF_CHECK_HPP
+#define SELF_CHECK_HPP
+
+#include <cstdio>
+#include <string>
+
+// Pass/fail bookkeeping shared by the bench/ self-checks, which ctest
+// runs: one "ok  " or "FAIL" line per check, a footer, and exit status 1
+// if anything failed.
+
+inline int g_failures = 0;
+
+inline void check(bool ok, const std::string& what) {
+    std::printf("%s  %s\n", ok ? "ok  " : "FAIL", what.c_str());
+    if (!ok) {
+        ++g_failures;
+    }
+}
+
+// For checks run in loops: only failures are printed, to stderr
+inline void check(bool ok, const std::string& what, const std::string& detail) {
+    if (!ok) {
+        ++g_failures;
+        std::fprintf(stderr, "FAIL %s: %s\n", what.c_str(), detail.c_str());
+    }
+}
+
+// Prints the footer; returns main()'s exit status
+inline int check_summary() {
+    std::printf("%s\n", g_failures == 0 ? "all checks passed" : "FAILED");
+    return g_failures == 0 ? 0 : 1;
+}
+
+#endif // SELF_CHECK_HPP
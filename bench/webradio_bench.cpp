@@ -0,0 +1,645 @@
+// Headless pipeline benchmark: the player's demux/decode/resample path
+// (StreamDecoder) into the playback ring, drained by a counting consumer
+// instead of an audio device, as fast as the decoder can go.
+//
+//   webradio-bench [--http] [--seconds N] [--json] [--min-realtime X] FILE|URL...
+//   webradio-bench --realtime [--seconds N] [--reconnect] [--json] URL...
+//   common: [--record DIR] [--replay-speed X]
+//
+// --http serves each file from a loopback Icecast-style server so FFmpeg's
+// http protocol and socket reads are included. --seconds stops after N
+// seconds of audio per file. --min-realtime fails (exit 2) if any file
+// decodes slower than X times real time, for use as a regression gate.
+//
+// Per file: codec, audio seconds, x realtime, decode thread CPU as % of
+// one core at real-time playback, decode time per frame (p50/p99),
+// heap allocations per second of audio (glibc only), and ring stats.
+//
+// --realtime plays instead: the consumer takes 10 ms of audio every 10 ms
+// after the player's prebuffer, for --seconds of wall time (default 30).
+// Meant for live sources such as webradio-fault-server; reports startup
+// time (open to prebuffered), underruns, rebuffer ratio (silent time /
+// played time) and recovery time (length of each silent stretch).
+// --reconnect reopens the stream when it ends, the way tuning again does.
+//
+// A "replay:FILE" input plays a session recorded with webradio --record
+// (or --record here) at its original arrival times, scaled by
+// --replay-speed (0 = unpaced), so --realtime reproduces the underruns of
+// real traffic and a fix can be measured against the same trace.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include <time.h>
+
+#include "loopback_http.hpp"
+#include "metrics.hpp"
+#include "stream_decoder.hpp"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/log.h>
+}
+
+// Every heap allocation in the process, FFmpeg's included: glibc lets the
+// executable interpose malloc and friends
+#if defined(__GLIBC__)
+#define BENCH_COUNT_ALLOCATIONS 1
+
+static std::atomic<uint64_t> g_allocations{0};
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+
+void* malloc(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+void* calloc(size_t count, size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+void* realloc(void* ptr, size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+void* memalign(size_t alignment, size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+void* aligned_alloc(size_t alignment, size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+int posix_memalign(void** ptr, size_t alignment, size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    *ptr = __libc_memalign(alignment, size);
+    return *ptr ? 0 : 12;   // ENOMEM
+}
+void free(void* ptr) {
+    __libc_free(ptr);
+}
+}
+#endif
+
+namespace {
+
+// The player's prebuffer target before starting the device
+constexpr size_t PREBUFFER_TARGET = 65536;
+constexpr auto PLAYBACK_PERIOD = std::chrono::milliseconds(10);
+
+struct Options {
+    bool http = false;
+    bool json = false;
+    bool realtime = false;
+    bool reconnect = false;
+    double seconds = 0.0;           // 0: whole file
+    double min_realtime = 0.0;
+    double replay_speed = 1.0;
+    std::string record_dir;
+    std::vector<std::string> files;
+};
+
+struct Result {
+    std::string file;
+    std::string codec;
+    int sample_rate = 0;
+    int channels = 0;
+    bool passthrough = false;
+    double open_ms = 0.0;
+    double audio_s = 0.0;
+    double wall_s = 0.0;
+    double cpu_s = 0.0;
+    uint64_t packets = 0;
+    uint64_t frames = 0;
+    uint64_t input_bytes = 0;
+    uint64_t decode_p50_ns = 0;
+    uint64_t decode_p99_ns = 0;
+    uint64_t open_allocations = 0;
+    uint64_t decode_allocations = 0;
+    uint64_t ring_full_waits = 0;
+    uint64_t ring_empty_polls = 0;
+    size_t ring_max_fill = 0;
+
+    double realtime() const { return wall_s > 0.0 ? audio_s / wall_s : 0.0; }
+    double cpu_percent() const { return audio_s > 0.0 ? cpu_s / audio_s * 100.0 : 0.0; }
+    double allocations_per_audio_s() const {
+        return audio_s > 0.0 ? static_cast<double>(decode_allocations) / audio_s : 0.0;
+    }
+};
+
+uint64_t allocations() {
+#ifdef BENCH_COUNT_ALLOCATIONS
+    return g_allocations.load(std::memory_order_relaxed);
+#else
+    return 0;
+#endif
+}
+
+double thread_cpu_seconds() {
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+}
+
+// Histogram of the frames decoded since before
+Histogram::Snapshot since(const Histogram::Snapshot& after, const Histogram::Snapshot& before) {
+    Histogram::Snapshot diff = after;
+    for (size_t i = 0; i < diff.buckets.size(); ++i) {
+        diff.buckets[i] -= before.buckets[i];
+    }
+    diff.count -= before.count;
+    diff.sum -= before.sum;
+    return diff;
+}
+
+// Plays the device's role: empties the ring as fast as it fills and keeps
+// count. Spins (with yield) rather than sleeping so the decoder is never
+// the one waiting.
+class CountingSink {
+public:
+    explicit CountingSink(ByteRingbuffer& ring) : ring_(ring) {
+        thread_ = std::thread([this]() { run(); });
+    }
+    ~CountingSink() { finish(); }
+
+    void finish() {
+        stop_ = true;
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    uint64_t bytes() const { return bytes_.load(std::memory_order_acquire); }
+    uint64_t empty_polls() const { return empty_polls_; }
+    size_t max_fill() const { return max_fill_; }
+
+private:
+    void run() {
+        while (true) {
+            const uint8_t* src = nullptr;
+            size_t available = ring_.reserve_read_contiguous(src);
+            if (available == 0 || src == nullptr) {
+                if (stop_) {
+                    break;
+                }
+                empty_polls_++;
+                std::this_thread::yield();
+                continue;
+            }
+            max_fill_ = std::max(max_fill_, ring_.read_available());
+            // Touch the data like a device copy would
+            volatile uint8_t sink = src[available - 1];
+            (void)sink;
+            ring_.consume(available);
+            bytes_.fetch_add(available, std::memory_order_release);
+        }
+    }
+
+    ByteRingbuffer& ring_;
+    std::thread thread_;
+    std::atomic<bool> stop_{false};
+    std::atomic<uint64_t> bytes_{0};
+    uint64_t empty_polls_ = 0;      // sink thread until finish()
+    size_t max_fill_ = 0;
+};
+
+struct RealtimeResult {
+    std::string url;
+    std::string codec;
+    double startup_ms = 0.0;        // open until the prebuffer is full
+    double played_s = 0.0;          // since the prebuffer was full
+    double silent_s = 0.0;
+    uint64_t underruns = 0;         // periods that came up short
+    uint64_t reconnects = 0;
+    std::vector<double> recoveries_ms;
+
+    double rebuffer_ratio() const { return played_s > 0.0 ? silent_s / played_s : 0.0; }
+    double recovery_max_ms() const {
+        return recoveries_ms.empty() ? 0.0 : *std::max_element(recoveries_ms.begin(), recoveries_ms.end());
+    }
+    double recovery_mean_ms() const {
+        double sum = 0.0;
+        for (double ms : recoveries_ms) {
+            sum += ms;
+        }
+        return recoveries_ms.empty() ? 0.0 : sum / static_cast<double>(recoveries_ms.size());
+    }
+};
+
+// Plays the device's role at real-time pace, like data_callback: every
+// period it takes one period of audio and counts a short period as an
+// underrun. Starts once the ring holds the player's prebuffer target.
+class RealtimeSink {
+public:
+    explicit RealtimeSink(ByteRingbuffer& ring) : ring_(ring), opened_(std::chrono::steady_clock::now()) {
+        thread_ = std::thread([this]() { run(); });
+    }
+    ~RealtimeSink() { finish(); }
+
+    void finish() {
+        stop_ = true;
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    // After finish()
+    void fill(RealtimeResult& result) const {
+        result.startup_ms = startup_ms_;
+        result.played_s = played_s_;
+        result.silent_s = silent_s_;
+        result.underruns = underruns_;
+        result.recoveries_ms = recoveries_ms_;
+    }
+
+private:
+    void run() {
+        using Clock = std::chrono::steady_clock;
+        while (!stop_ && ring_.read_available() < PREBUFFER_TARGET) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (stop_) {
+            return;
+        }
+        auto started = Clock::now();
+        startup_ms_ = std::chrono::duration<double, std::milli>(started - opened_).count();
+
+        const size_t period_bytes = StreamDecoder::OUTPUT_BYTES_PER_SECOND *
+                                    static_cast<size_t>(PLAYBACK_PERIOD.count()) / 1000;
+        const double period_s = std::chrono::duration<double>(PLAYBACK_PERIOD).count();
+        auto next = started;
+        bool silent = false;
+        Clock::time_point silent_since;
+        while (!stop_) {
+            next += PLAYBACK_PERIOD;
+            std::this_thread::sleep_until(next);
+
+            size_t taken = 0;
+            while (taken < period_bytes) {
+                const uint8_t* src = nullptr;
+                size_t available = ring_.reserve_read_contiguous(src);
+                if (available == 0 || src == nullptr) {
+                    break;
+                }
+                size_t chunk = std::min(available, period_bytes - taken);
+                ring_.consume(chunk);
+                taken += chunk;
+            }
+
+            played_s_ += period_s;
+            if (taken < period_bytes) {
+                underruns_++;
+                silent_s_ += period_s * static_cast<double>(period_bytes - taken) / static_cast<double>(period_bytes);
+                if (!silent) {
+                    silent = true;
+                    silent_since = Clock::now();
+                }
+            } else if (silent) {
+                silent = false;
+                recoveries_ms_.push_back(std::chrono::duration<double, std::milli>(Clock::now() - silent_since).count());
+            }
+        }
+    }
+
+    ByteRingbuffer& ring_;
+    std::chrono::steady_clock::time_point opened_;
+    std::thread thread_;
+    std::atomic<bool> stop_{false};
+    // Sink thread until finish()
+    double startup_ms_ = 0.0;
+    double played_s_ = 0.0;
+    double silent_s_ = 0.0;
+    uint64_t underruns_ = 0;
+    std::vector<double> recoveries_ms_;
+};
+
+bool open_stream(StreamDecoder& decoder, const std::string& url, const Options& options) {
+    decoder.set_record_dir(options.record_dir);
+    decoder.set_replay_speed(options.replay_speed);
+    AVDictionary* opts = nullptr;
+    av_dict_set(&opts, "icy", "1", 0);
+    bool opened = decoder.open_input(url, &opts) && decoder.find_stream_info() && decoder.open_codec();
+    av_dict_free(&opts);
+    return opened;
+}
+
+bool run_realtime(const std::string& url, const Options& options, RealtimeResult& result) {
+    result.url = url;
+    auto ring = std::make_unique<ByteRingbuffer>();
+    std::atomic<bool> stop{false};
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::duration<double>(options.seconds > 0.0 ? options.seconds : 30.0);
+
+    RealtimeSink sink(*ring);
+    StreamDecoder decoder;
+    if (!open_stream(decoder, url, options)) {
+        std::fprintf(stderr, "%s: %s\n", url.c_str(), decoder.error().c_str());
+        return false;
+    }
+    result.codec = decoder.codec()->name;
+
+    // Stops at the deadline even while the ring is full or the server stalls
+    std::thread watchdog([&stop, deadline]() {
+        while (!stop && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        stop = true;
+    });
+    AVIOInterruptCB interrupt{[](void* opaque) -> int {
+        return static_cast<std::atomic<bool>*>(opaque)->load() ? 1 : 0;
+    }, &stop};
+    decoder.format_context()->interrupt_callback = interrupt;
+
+    while (!stop) {
+        if (decoder.read_packet()) {
+            if (decoder.is_audio_packet()) {
+                decoder.decode_packet(*ring, stop);
+            }
+            decoder.unref_packet();
+            continue;
+        }
+        if (!options.reconnect || stop) {
+            break;
+        }
+        // Like tuning the station again: keep the ring, open a new connection
+        result.reconnects++;
+        while (!stop && !open_stream(decoder, url, options)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        }
+        if (!stop) {
+            decoder.format_context()->interrupt_callback = interrupt;
+        }
+    }
+    stop = true;
+    watchdog.join();
+    sink.finish();
+    sink.fill(result);
+    return true;
+}
+
+bool run_file(const std::string& file, const Options& options, Result& result) {
+    result.file = file;
+
+    LoopbackHttpServer server;
+    std::string url = file;
+    // Recordings already carry their own network timing
+    if (options.http && file.rfind(REPLAY_URL_PREFIX, 0) != 0) {
+        if (!server.start(file)) {
+            std::fprintf(stderr, "%s: %s\n", file.c_str(), server.error().c_str());
+            return false;
+        }
+        url = server.url();
+    }
+
+    EngineMetrics& metrics = engine_metrics();
+    uint64_t start_allocations = allocations();
+    auto open_start = std::chrono::steady_clock::now();
+
+    StreamDecoder decoder;
+    if (!open_stream(decoder, url, options)) {
+        std::fprintf(stderr, "%s: %s\n", file.c_str(), decoder.error().c_str());
+        return false;
+    }
+    result.open_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - open_start).count();
+    result.codec = decoder.codec()->name;
+    result.sample_rate = decoder.codec_context()->sample_rate;
+    result.channels = decoder.codec_context()->ch_layout.nb_channels;
+    result.passthrough = decoder.passthrough();
+
+    auto ring = std::make_unique<ByteRingbuffer>();
+    std::atomic<bool> stop{false};
+    CountingSink sink(*ring);
+
+    uint64_t limit_bytes = options.seconds > 0.0
+        ? static_cast<uint64_t>(options.seconds * StreamDecoder::OUTPUT_BYTES_PER_SECOND)
+        : UINT64_MAX;
+    uint64_t start_bytes_in = metrics.bytes_in.value();
+    uint64_t start_packets = metrics.packets.value();
+    uint64_t start_frames = metrics.frames_decoded.value();
+    uint64_t start_pcm = metrics.pcm_bytes.value();
+    Histogram::Snapshot decode_before = metrics.decode_ns.snapshot();
+    uint64_t decode_allocations_start = allocations();
+    result.open_allocations = decode_allocations_start - start_allocations;
+
+    double cpu_start = thread_cpu_seconds();
+    auto wall_start = std::chrono::steady_clock::now();
+    while (metrics.pcm_bytes.value() - start_pcm < limit_bytes && decoder.read_packet()) {
+        if (decoder.is_audio_packet()) {
+            decoder.decode_packet(*ring, stop);
+        }
+        decoder.unref_packet();
+    }
+    // The run ends when the sink has taken everything
+    uint64_t produced = metrics.pcm_bytes.value() - start_pcm;
+    while (sink.bytes() < produced) {
+        std::this_thread::yield();
+    }
+    result.wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    result.cpu_s = thread_cpu_seconds() - cpu_start;
+    result.decode_allocations = allocations() - decode_allocations_start;
+    sink.finish();
+
+    result.audio_s = static_cast<double>(produced) / StreamDecoder::OUTPUT_BYTES_PER_SECOND;
+    result.input_bytes = metrics.bytes_in.value() - start_bytes_in;
+    result.packets = metrics.packets.value() - start_packets;
+    result.frames = metrics.frames_decoded.value() - start_frames;
+    Histogram::Snapshot decode = since(metrics.decode_ns.snapshot(), decode_before);
+    result.decode_p50_ns = decode.quantile(0.50);
+    result.decode_p99_ns = decode.quantile(0.99);
+    result.ring_full_waits = decoder.ring_full_waits();
+    result.ring_empty_polls = sink.empty_polls();
+    result.ring_max_fill = sink.max_fill();
+
+    decoder.close();
+    server.stop();
+    return true;
+}
+
+void print_table(const std::vector<Result>& results) {
+    std::printf("%-24s %-8s %6s %8s %9s %7s %9s %9s %10s %6s %8s\n",
+                "file", "codec", "in", "audio_s", "realtime", "cpu%", "p50_us", "p99_us",
+                "allocs/s", "waits", "max_fill");
+    for (const auto& r : results) {
+        std::string name = r.file.size() > 24 ? "..." + r.file.substr(r.file.size() - 21) : r.file;
+        char input[16];
+        std::snprintf(input, sizeof(input), "%dk/%d", r.sample_rate / 1000, r.channels);
+        std::printf("%-24s %-8s %6s %8.1f %8.1fx %6.2f%% %9.1f %9.1f %10.1f %6llu %7.0f%%\n",
+                    name.c_str(), r.codec.c_str(), input, r.audio_s, r.realtime(), r.cpu_percent(),
+                    r.decode_p50_ns / 1e3, r.decode_p99_ns / 1e3,
+#ifdef BENCH_COUNT_ALLOCATIONS
+                    r.allocations_per_audio_s(),
+#else
+                    0.0,
+#endif
+                    static_cast<unsigned long long>(r.ring_full_waits),
+                    100.0 * static_cast<double>(r.ring_max_fill) / ByteRingbuffer::BUFFER_SIZE);
+    }
+}
+
+void print_realtime(const std::vector<RealtimeResult>& results, bool json) {
+    if (json) {
+        nlohmann::ordered_json out = nlohmann::ordered_json::array();
+        for (const auto& r : results) {
+            out.push_back({
+                {"url", r.url},
+                {"codec", r.codec},
+                {"startup_ms", r.startup_ms},
+                {"played_s", r.played_s},
+                {"silent_s", r.silent_s},
+                {"rebuffer_ratio", r.rebuffer_ratio()},
+                {"underruns", r.underruns},
+                {"stalls", r.recoveries_ms.size()},
+                {"recovery_max_ms", r.recovery_max_ms()},
+                {"recovery_mean_ms", r.recovery_mean_ms()},
+                {"reconnects", r.reconnects},
+            });
+        }
+        std::printf("%s\n", out.dump(2).c_str());
+        return;
+    }
+    std::printf("%-32s %-8s %10s %8s %8s %9s %7s %12s %13s %6s\n",
+                "url", "codec", "startup_ms", "played_s", "silent_s", "rebuffer", "stalls",
+                "recovery_max", "recovery_mean", "recon");
+    for (const auto& r : results) {
+        std::string name = r.url.size() > 32 ? "..." + r.url.substr(r.url.size() - 29) : r.url;
+        std::printf("%-32s %-8s %10.1f %8.1f %8.2f %8.2f%% %7zu %10.0fms %11.0fms %6llu\n",
+                    name.c_str(), r.codec.c_str(), r.startup_ms, r.played_s, r.silent_s,
+                    100.0 * r.rebuffer_ratio(), r.recoveries_ms.size(), r.recovery_max_ms(),
+                    r.recovery_mean_ms(), static_cast<unsigned long long>(r.reconnects));
+    }
+}
+
+void print_json(const std::vector<Result>& results) {
+    nlohmann::ordered_json out = nlohmann::ordered_json::array();
+    for (const auto& r : results) {
+        out.push_back({
+            {"file", r.file},
+            {"codec", r.codec},
+            {"sample_rate", r.sample_rate},
+            {"channels", r.channels},
+            {"passthrough", r.passthrough},
+            {"open_ms", r.open_ms},
+            {"audio_s", r.audio_s},
+            {"wall_s", r.wall_s},
+            {"realtime", r.realtime()},
+            {"cpu_percent_at_realtime", r.cpu_percent()},
+            {"input_bytes", r.input_bytes},
+            {"packets", r.packets},
+            {"frames", r.frames},
+            {"decode_p50_ns", r.decode_p50_ns},
+            {"decode_p99_ns", r.decode_p99_ns},
+#ifdef BENCH_COUNT_ALLOCATIONS
+            {"open_allocations", r.open_allocations},
+            {"decode_allocations", r.decode_allocations},
+            {"allocations_per_audio_s", r.allocations_per_audio_s()},
+#endif
+            {"ring_full_waits", r.ring_full_waits},
+            {"ring_empty_polls", r.ring_empty_polls},
+            {"ring_max_fill_bytes", r.ring_max_fill},
+        });
+    }
+    std::printf("%s\n", out.dump(2).c_str());
+}
+
+int usage(const char* argv0) {
+    std::fprintf(stderr,
+        "usage: %s [--http] [--seconds N] [--json] [--min-realtime X] FILE|URL...\n"
+        "       %s --realtime [--seconds N] [--reconnect] [--json] URL...\n"
+        "       common: [--record DIR] [--replay-speed X], replay:FILE inputs\n", argv0, argv0);
+    return 1;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--http") {
+            options.http = true;
+        } else if (arg == "--json") {
+            options.json = true;
+        } else if (arg == "--realtime") {
+            options.realtime = true;
+        } else if (arg == "--reconnect") {
+            options.reconnect = true;
+        } else if (arg == "--seconds" && i + 1 < argc) {
+            options.seconds = std::atof(argv[++i]);
+        } else if (arg == "--min-realtime" && i + 1 < argc) {
+            options.min_realtime = std::atof(argv[++i]);
+        } else if (arg == "--record" && i + 1 < argc) {
+            options.record_dir = argv[++i];
+        } else if (arg == "--replay-speed" && i + 1 < argc) {
+            options.replay_speed = std::max(0.0, std::atof(argv[++i]));
+        } else if (!arg.empty() && arg[0] == '-') {
+            return usage(argv[0]);
+        } else {
+            options.files.push_back(arg);
+        }
+    }
+    if (options.files.empty()) {
+        return usage(argv[0]);
+    }
+
+    av_log_set_level(AV_LOG_ERROR);
+    engine_metrics();
+
+    if (options.realtime) {
+        std::vector<RealtimeResult> results;
+        bool failed = false;
+        for (const auto& url : options.files) {
+            RealtimeResult result;
+            if (run_realtime(url, options, result)) {
+                results.push_back(std::move(result));
+            } else {
+                failed = true;
+            }
+        }
+        print_realtime(results, options.json);
+        return failed ? 1 : 0;
+    }
+
+    std::vector<Result> results;
+    bool failed = false;
+    for (const auto& file : options.files) {
+        Result result;
+        if (run_file(file, options, result)) {
+            results.push_back(std::move(result));
+        } else {
+            failed = true;
+        }
+    }
+
+    if (options.json) {
+        print_json(results);
+    } else {
+        print_table(results);
+    }
+
+    if (failed) {
+        return 1;
+    }
+    for (const auto& r : results) {
+        if (options.min_realtime > 0.0 && r.realtime() < options.min_realtime) {
+            std::fprintf(stderr, "%s: %.1fx realtime, below --min-realtime %.1f\n",
+                         r.file.c_str(), r.realtime(), options.min_realtime);
+            return 2;
+        }
+    }
+    return 0;
+}
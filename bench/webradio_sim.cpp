@@ -0,0 +1,469 @@
+// Virtual-clock simulation of the playback pipeline: a Player tuned to a
+// session replay, with an AudioSink that calls Player::render() once per
+// device period like data_callback. Time is a VirtualClock, so an hour of
+// playback runs in however long the decoding takes.
+//
+//   webradio-sim [options] FILE|replay:FILE
+//
+// A media FILE is turned into synthetic network arrivals: --bitrate KBPS
+// (default 128) delivered in --chunk-ms pieces (default 20) after
+// --connect-ms (default 150), with an optional --burst KIB on connect,
+// up to --jitter-ms of random lateness per piece (--seed N), and --stall
+// AT:DURATION pauses in seconds (repeatable; the stream falls behind). The
+// file loops. A replay:FILE input uses a recorded session's arrivals.
+//
+// The player starts the device once it has prebuffered; the device renders
+// --period-ms (default 10) every period and --drift-ppm makes its clock
+// run fast (positive) or slow against the stream. Runs for --seconds of
+// simulated time (default 600) or until the stream ends.
+//
+// Reports time to first audio, the player's underruns, silent time and recovery times, all in
+// simulated time. --trace FILE writes the buffer-fill trace as CSV, one
+// row per device period; --json prints the summary as JSON;
+// --max-underruns N exits with status 2 above N underruns, for use in
+// regression tests.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include <unistd.h>
+
+#include "audio_sink.hpp"
+#include "engine.hpp"
+#include "metrics.hpp"
+#include "pipeline_clock.hpp"
+#include "session_io.hpp"
+#include "stream_decoder.hpp"
+
+extern "C" {
+#include <libavutil/log.h>
+}
+
+namespace {
+
+constexpr uint64_t NS_PER_MS = 1'000'000;
+constexpr uint64_t NS_PER_S = 1'000'000'000;
+
+struct Stall {
+    double at_s = 0.0;
+    double duration_s = 0.0;
+};
+
+struct Options {
+    std::string input;
+    double seconds = 600.0;
+    double period_ms = 10.0;
+    double drift_ppm = 0.0;
+    double bitrate_kbps = 128.0;
+    double chunk_ms = 20.0;
+    double connect_ms = 150.0;
+    double burst_kib = 0.0;
+    double jitter_ms = 0.0;
+    unsigned seed = 1;
+    std::vector<Stall> stalls;
+    std::string trace_file;
+    bool json = false;
+    long max_underruns = -1;
+};
+
+struct SimResult {
+    std::string input;
+    std::string codec;
+    double simulated_s = 0.0;
+    double wall_s = 0.0;
+    double startup_ms = 0.0;       // tune to first audio
+    double played_s = 0.0;
+    double silent_s = 0.0;
+    uint64_t underruns = 0;
+    uint64_t ring_full_waits = 0;
+    size_t min_fill = SIZE_MAX;     // after the device started
+    size_t max_fill = 0;
+    bool stream_ended = false;
+    std::vector<double> recoveries_ms;
+
+    double speedup() const { return wall_s > 0.0 ? simulated_s / wall_s : 0.0; }
+    double recovery_max_ms() const {
+        return recoveries_ms.empty() ? 0.0 : *std::max_element(recoveries_ms.begin(), recoveries_ms.end());
+    }
+};
+
+// The media file's bytes as a session recording: what a server sending
+// at a steady bitrate would deliver, with the configured faults
+bool write_synthetic_session(const Options& options, const std::filesystem::path& path, std::string& error) {
+    std::ifstream in(options.input, std::ios::binary);
+    std::vector<uint8_t> media((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (media.empty()) {
+        error = "cannot read " + options.input;
+        return false;
+    }
+
+    SessionWriter writer;
+    if (!writer.open(path, error)) {
+        return false;
+    }
+    // The URL is only a format hint for the demuxer
+    std::string url = "file:" + std::filesystem::absolute(options.input).string();
+    writer.write(SessionRecord::Url, url.data(), static_cast<uint32_t>(url.size()), 0);
+
+    uint64_t time_ns = static_cast<uint64_t>(options.connect_ms * NS_PER_MS);
+    writer.write(SessionRecord::Opened, nullptr, 0, time_ns);
+
+    size_t offset = 0;
+    auto send = [&](size_t size, uint64_t at_ns) {
+        while (size > 0) {
+            size_t chunk = std::min(size, media.size() - offset);
+            writer.write(SessionRecord::Data, media.data() + offset, static_cast<uint32_t>(chunk), at_ns);
+            offset = (offset + chunk) % media.size();
+            size -= chunk;
+        }
+    };
+    send(static_cast<size_t>(options.burst_kib * 1024), time_ns);
+
+    std::mt19937 rng(options.seed);
+    std::uniform_real_distribution<double> jitter(0.0, options.jitter_ms * NS_PER_MS);
+    uint64_t chunk_ns = static_cast<uint64_t>(options.chunk_ms * NS_PER_MS);
+    size_t chunk_bytes = std::max<size_t>(1, static_cast<size_t>(options.bitrate_kbps * 1000 / 8 * options.chunk_ms / 1000));
+    // Past the end of the run, so the stream does not end early
+    uint64_t end_ns = static_cast<uint64_t>((options.seconds + 60.0) * NS_PER_S);
+    uint64_t scheduled_ns = time_ns;
+    uint64_t last_arrival_ns = time_ns;
+    while (scheduled_ns < end_ns) {
+        uint64_t next_ns = scheduled_ns + chunk_ns;
+        for (const auto& stall : options.stalls) {
+            uint64_t at_ns = static_cast<uint64_t>(stall.at_s * NS_PER_S);
+            if (at_ns > scheduled_ns && at_ns <= next_ns) {
+                next_ns += static_cast<uint64_t>(stall.duration_s * NS_PER_S);
+            }
+        }
+        scheduled_ns = next_ns;
+        // Late pieces delay the ones behind them; TCP keeps the order
+        last_arrival_ns = std::max(last_arrival_ns, scheduled_ns + static_cast<uint64_t>(jitter(rng)));
+        send(chunk_bytes, last_arrival_ns);
+    }
+    int32_t eof = AVERROR_EOF;
+    writer.write(SessionRecord::End, &eof, sizeof(eof), last_arrival_ns);
+    // Writes after a failed one are dropped; close() reports the first
+    if (!writer.close()) {
+        error = writer.error();
+        return false;
+    }
+    return true;
+}
+
+// The audio device on the virtual clock: start() schedules a period of
+// Player::render() per period of the device's own clock, which runs
+// drift_ppm fast against the stream's. Timers run on the playback thread
+// while its decoder sleeps, so everything here is that thread's.
+class VirtualDeviceSink final : public AudioSink {
+public:
+    VirtualDeviceSink(VirtualClock& clock, const Options& options, SimResult& result, std::FILE* trace)
+        : clock_(clock)
+        , result_(result)
+        , trace_(trace)
+        , period_frames_(static_cast<uint32_t>(StreamDecoder::OUTPUT_SAMPLE_RATE * options.period_ms / 1000))
+        , period_s_(options.period_ms / 1000.0)
+        , period_ns_(static_cast<uint64_t>(options.period_ms * NS_PER_MS / (1.0 + options.drift_ppm / 1e6)))
+        , end_ns_(static_cast<uint64_t>(options.seconds * NS_PER_S))
+        , output_(size_t(period_frames_) * StreamDecoder::OUTPUT_BYTES_PER_FRAME)
+    {
+    }
+
+    bool open(Player& player, std::string& error) override {
+        (void)error;
+        player_ = &player;
+        return true;
+    }
+
+    bool start(std::string& error) override {
+        (void)error;
+        started_ = true;
+        timer_ = clock_.every(clock_.now_ns() + period_ns_, period_ns_,
+                              [this](uint64_t now_ns) { period(now_ns); });
+        return true;
+    }
+
+    void close() override {
+        if (timer_ != NO_TIMER) {
+            clock_.cancel(timer_);
+            timer_ = NO_TIMER;
+        }
+        if (!done_) {
+            stopped_ns_ = clock_.now_ns();
+        }
+    }
+
+    size_t latency_bytes() const override { return 0; }
+
+    // Control thread: the run reached --seconds
+    bool done() const { return done_.load(std::memory_order_acquire); }
+    // After the player stopped
+    bool started() const { return started_; }
+    uint64_t stopped_ns() const { return stopped_ns_; }
+
+private:
+    static constexpr size_t NO_TIMER = SIZE_MAX;
+
+    void period(uint64_t now_ns) {
+        // The decoder is asleep, so the fill cannot change under render()
+        size_t fill = player_->buffered_bytes();
+        player_->render(output_.data(), period_frames_, StreamDecoder::OUTPUT_SAMPLE_RATE);
+        size_t taken = std::min(fill, output_.size());
+
+        result_.played_s += period_s_;
+        result_.min_fill = std::min(result_.min_fill, fill);
+        result_.max_fill = std::max(result_.max_fill, fill);
+        if (taken > 0 && result_.startup_ms == 0.0) {
+            result_.startup_ms = static_cast<double>(now_ns) / NS_PER_MS;
+        }
+        if (taken < output_.size()) {
+            result_.silent_s += period_s_ * static_cast<double>(output_.size() - taken) /
+                                static_cast<double>(output_.size());
+            if (!silent_) {
+                silent_ = true;
+                silent_since_ns_ = now_ns;
+            }
+        } else if (silent_) {
+            silent_ = false;
+            result_.recoveries_ms.push_back(static_cast<double>(now_ns - silent_since_ns_) / NS_PER_MS);
+        }
+        if (trace_) {
+            std::fprintf(trace_, "%.3f,%zu,%zu\n", static_cast<double>(now_ns) / NS_PER_MS, fill, taken);
+        }
+
+        if (now_ns >= end_ns_) {
+            clock_.cancel(timer_);
+            timer_ = NO_TIMER;
+            stopped_ns_ = now_ns;
+            done_.store(true, std::memory_order_release);
+        }
+    }
+
+    VirtualClock& clock_;
+    SimResult& result_;
+    std::FILE* trace_;
+    const uint32_t period_frames_;
+    const double period_s_;
+    const uint64_t period_ns_;
+    const uint64_t end_ns_;
+    std::vector<uint8_t> output_;
+
+    Player* player_ = nullptr;
+    size_t timer_ = NO_TIMER;
+    bool started_ = false;
+    bool silent_ = false;
+    uint64_t silent_since_ns_ = 0;
+    uint64_t stopped_ns_ = 0;
+    std::atomic<bool> done_{false};
+};
+
+bool simulate(const Options& options, const std::string& url, SimResult& result, std::FILE* trace) {
+    VirtualClock clock;
+    set_pipeline_clock(&clock);
+    auto wall_start = std::chrono::steady_clock::now();
+    EngineMetrics& metrics = engine_metrics();
+    uint64_t underruns_before = metrics.underruns.value();
+    uint64_t ring_full_waits_before = metrics.ring_full_waits.value();
+
+    std::string error;
+    bool ok = false;
+    {
+        Engine engine;
+        auto sink = std::make_unique<VirtualDeviceSink>(clock, options, result, trace);
+        VirtualDeviceSink& device = *sink;
+        std::unique_ptr<Player> player = engine.create_player(std::move(sink));
+        PlayerCallbacks callbacks;
+        callbacks.on_stream_format = [&](const std::string& format, int) { result.codec = format; };
+        callbacks.on_error = [&](const std::string& message) { error = message; };
+        player->set_callbacks(std::move(callbacks));
+
+        // From here on only the playback thread touches the clock; this
+        // thread waits in real time for the run to end
+        player->play(url, options.input);
+        while (player->is_playing() && !device.done()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        player->stop();
+
+        ok = device.started();
+        result.stream_ended = ok && !device.done();
+        result.simulated_s = static_cast<double>(device.stopped_ns()) / NS_PER_S;
+    }
+    set_pipeline_clock(nullptr);
+
+    if (!ok) {
+        std::fprintf(stderr, "%s: %s\n", options.input.c_str(), error.empty() ? "no audio" : error.c_str());
+        return false;
+    }
+    result.wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    result.underruns = metrics.underruns.value() - underruns_before;
+    result.ring_full_waits = metrics.ring_full_waits.value() - ring_full_waits_before;
+    if (result.min_fill == SIZE_MAX) {
+        result.min_fill = 0;
+    }
+    return true;
+}
+
+void print_result(const SimResult& r, bool json) {
+    if (json) {
+        nlohmann::ordered_json out = {
+            {"input", r.input},
+            {"codec", r.codec},
+            {"simulated_s", r.simulated_s},
+            {"wall_s", r.wall_s},
+            {"speedup", r.speedup()},
+            {"startup_ms", r.startup_ms},
+            {"played_s", r.played_s},
+            {"silent_s", r.silent_s},
+            {"underruns", r.underruns},
+            {"stalls", r.recoveries_ms.size()},
+            {"recovery_max_ms", r.recovery_max_ms()},
+            {"ring_min_fill_bytes", r.min_fill},
+            {"ring_max_fill_bytes", r.max_fill},
+            {"ring_full_waits", r.ring_full_waits},
+            {"stream_ended", r.stream_ended},
+        };
+        std::printf("%s\n", out.dump(2).c_str());
+        return;
+    }
+    std::printf("input        %s (%s)\n", r.input.c_str(), r.codec.c_str());
+    std::printf("simulated    %.1f s in %.2f s (%.0fx)\n", r.simulated_s, r.wall_s, r.speedup());
+    std::printf("startup      %.1f ms\n", r.startup_ms);
+    std::printf("played       %.1f s, %.2f s silent, %llu underruns\n",
+                r.played_s, r.silent_s, static_cast<unsigned long long>(r.underruns));
+    std::printf("stalls       %zu, longest %.0f ms\n", r.recoveries_ms.size(), r.recovery_max_ms());
+    std::printf("ring fill    %zu..%zu bytes, %llu full waits\n", r.min_fill, r.max_fill,
+                static_cast<unsigned long long>(r.ring_full_waits));
+    if (r.stream_ended) {
+        std::printf("stream ended before the run did\n");
+    }
+}
+
+bool parse_stall(const std::string& text, Stall& stall) {
+    size_t colon = text.find(':');
+    if (colon == std::string::npos) {
+        return false;
+    }
+    stall.at_s = std::atof(text.substr(0, colon).c_str());
+    stall.duration_s = std::atof(text.substr(colon + 1).c_str());
+    return stall.at_s >= 0.0 && stall.duration_s > 0.0;
+}
+
+int usage(const char* argv0) {
+    std::fprintf(stderr,
+        "usage: %s [--seconds N] [--period-ms N] [--drift-ppm N] [--bitrate KBPS]\n"
+        "          [--chunk-ms N] [--connect-ms N] [--burst KIB] [--jitter-ms N] [--seed N]\n"
+        "          [--stall AT:DURATION]... [--trace FILE] [--json] [--max-underruns N]\n"
+        "          FILE|replay:FILE\n", argv0);
+    return 1;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--seconds" && has_value) {
+            options.seconds = std::atof(argv[++i]);
+        } else if (arg == "--period-ms" && has_value) {
+            options.period_ms = std::atof(argv[++i]);
+        } else if (arg == "--drift-ppm" && has_value) {
+            options.drift_ppm = std::atof(argv[++i]);
+        } else if (arg == "--bitrate" && has_value) {
+            options.bitrate_kbps = std::atof(argv[++i]);
+        } else if (arg == "--chunk-ms" && has_value) {
+            options.chunk_ms = std::atof(argv[++i]);
+        } else if (arg == "--connect-ms" && has_value) {
+            options.connect_ms = std::atof(argv[++i]);
+        } else if (arg == "--burst" && has_value) {
+            options.burst_kib = std::atof(argv[++i]);
+        } else if (arg == "--jitter-ms" && has_value) {
+            options.jitter_ms = std::atof(argv[++i]);
+        } else if (arg == "--seed" && has_value) {
+            options.seed = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (arg == "--stall" && has_value) {
+            Stall stall;
+            if (!parse_stall(argv[++i], stall)) {
+                std::fprintf(stderr, "--stall: expected AT:DURATION in seconds\n");
+                return 1;
+            }
+            options.stalls.push_back(stall);
+        } else if (arg == "--trace" && has_value) {
+            options.trace_file = argv[++i];
+        } else if (arg == "--json") {
+            options.json = true;
+        } else if (arg == "--max-underruns" && has_value) {
+            options.max_underruns = std::atol(argv[++i]);
+        } else if (!arg.empty() && arg[0] == '-') {
+            return usage(argv[0]);
+        } else {
+            options.input = arg;
+        }
+    }
+    if (options.input.empty() || options.seconds <= 0.0 || options.period_ms <= 0.0 ||
+        options.bitrate_kbps <= 0.0 || options.chunk_ms <= 0.0) {
+        return usage(argv[0]);
+    }
+
+    av_log_set_level(AV_LOG_ERROR);
+    engine_metrics();
+
+    std::string url = options.input;
+    std::filesystem::path synthetic;
+    if (url.rfind(REPLAY_URL_PREFIX, 0) != 0) {
+        synthetic = std::filesystem::temp_directory_path() /
+                    ("webradio-sim-" + std::to_string(getpid()) + ".wrs");
+        std::string error;
+        if (!write_synthetic_session(options, synthetic, error)) {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        url = REPLAY_URL_PREFIX + synthetic.string();
+    }
+
+    std::FILE* trace = nullptr;
+    if (!options.trace_file.empty()) {
+        trace = std::fopen(options.trace_file.c_str(), "w");
+        if (!trace) {
+            std::fprintf(stderr, "cannot write %s\n", options.trace_file.c_str());
+            return 1;
+        }
+        std::fprintf(trace, "time_ms,fill_bytes,taken_bytes\n");
+    }
+
+    SimResult result;
+    result.input = options.input;
+    bool ok = simulate(options, url, result, trace);
+    if (trace) {
+        std::fclose(trace);
+    }
+    if (!synthetic.empty()) {
+        std::error_code ec;
+        std::filesystem::remove(synthetic, ec);
+    }
+    if (!ok) {
+        return 1;
+    }
+
+    print_result(result, options.json);
+    if (options.max_underruns >= 0 && result.underruns > static_cast<uint64_t>(options.max_underruns)) {
+        std::fprintf(stderr, "%llu underruns, above --max-underruns %ld\n",
+                     static_cast<unsigned long long>(result.underruns), options.max_underruns);
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,33 @@
+#include "app_paths.hpp"
+
+#include <cstdlib>
+#include <system_error>
+
+std::filesystem::path user_cache_dir() {
+    if (const char* xdg_cache = std::getenv("XDG_CACHE_HOME"); xdg_cache && *xdg_cache) {
+        return std::filesystem::path(xdg_cache) / "webradio";
+    }
+    if (const char* home = std::getenv("HOME"); home && *home) {
+        return std::filesystem::path(home) / ".cache" / "webradio";
+    }
+    return {};
+}
+
+std::filesystem::path user_data_dir() {
+    if (const char* xdg_data = std::getenv("XDG_DATA_HOME"); xdg_data && *xdg_data) {
+        return std::filesystem::path(xdg_data) / "webradio";
+    }
+    if (const char* home = std::getenv("HOME"); home && *home) {
+        return std::filesystem::path(home) / ".local" / "share" / "webradio";
+    }
+    return {};
+}
+
+bool ensure_directory(const std::filesystem::path& dir) {
+    if (dir.empty()) {
+        return false;
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    return std::filesystem::is_directory(dir, ec);
+}
@@ -0,0 +1,22 @@
+#ifndef APP_PATHS_HPP
+#define APP_PATHS_HPP
+
+#include <filesystem>
+
+// Per-user cache directory:
+//   $XDG_CACHE_HOME/webradio (if XDG_CACHE_HOME is set)
+//   otherwise ~/.cache/webradio
+// Returns an empty path if neither variable is available.
+// The directory is not created.
+std::filesystem::path user_cache_dir();
+
+// Per-user data directory (for files worth keeping, unlike the cache):
+//   $XDG_DATA_HOME/webradio (if XDG_DATA_HOME is set)
+//   otherwise ~/.local/share/webradio
+// Returns an empty path if neither variable is available.
+std::filesystem::path user_data_dir();
+
+// Creates the directory (and parents) if needed. Returns false on failure.
+bool ensure_directory(const std::filesystem::path& dir);
+
+#endif // APP_PATHS_HPP
@@ -0,0 +1,347 @@
+#include "async_log.hpp"
+#include "thread_name.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Rings allocated up front: UI, playback and a few workers
+constexpr size_t PREALLOCATED_BUFFERS = 4;
+constexpr size_t LOG_TEXT_BYTES = 232;
+constexpr auto FLUSH_INTERVAL = std::chrono::milliseconds(250);
+
+struct LogSlot {
+    uint64_t time_ns;           // wall clock
+    const char* source;
+    uint16_t length;
+    LogLevel level;
+    char text[LOG_TEXT_BYTES];
+};
+
+struct LogBuffer {
+    std::atomic<bool> in_use{false};
+    std::atomic<uint64_t> head{0};          // written by the owning thread
+    std::atomic<uint64_t> tail{0};          // written by the writer thread
+    std::atomic<uint64_t> dropped{0};       // ring full
+    std::atomic<uint64_t> suppressed{0};    // over the rate limit
+    std::array<LogSlot, LOG_RING_SLOTS> slots;
+};
+
+std::mutex g_buffers_mutex;
+std::vector<std::unique_ptr<LogBuffer>> g_buffers;     // never shrinks
+
+LogBuffer* acquire_buffer() {
+    std::lock_guard<std::mutex> lock(g_buffers_mutex);
+    for (auto& buffer : g_buffers) {
+        bool expected = false;
+        if (buffer->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            return buffer.get();
+        }
+    }
+    g_buffers.push_back(std::make_unique<LogBuffer>());
+    g_buffers.back()->in_use.store(true, std::memory_order_relaxed);
+    return g_buffers.back().get();
+}
+
+// The calling thread's ring and rate limit; the ring goes back to the
+// pool when the thread exits, after the writer has drained it or not
+struct ThreadSlot {
+    LogBuffer* buffer = nullptr;
+    double tokens = LOG_RATE_BURST;
+    uint64_t last_refill_ns = 0;
+    bool admitted = false;      // log_admit() took the next message's token
+
+    ~ThreadSlot() {
+        if (buffer) {
+            buffer->in_use.store(false, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ThreadSlot t_slot;
+
+// Writer state
+std::mutex g_writer_mutex;
+std::condition_variable g_writer_cv;
+bool g_writer_stop = false;
+std::thread g_writer;
+std::filesystem::path g_path;
+std::ofstream g_file;
+uint64_t g_file_bytes = 0;
+
+struct Entry {
+    uint64_t time_ns;
+    LogLevel level;
+    const char* source;
+    std::string text;
+};
+
+constexpr char LEVEL_LETTERS[] = {'E', 'W', 'I', 'D'};
+
+void append_timestamp(std::string& out, uint64_t time_ns) {
+    std::time_t seconds = static_cast<std::time_t>(time_ns / 1000000000ULL);
+    std::tm tm{};
+#ifdef _WIN32
+    localtime_s(&tm, &seconds);
+#else
+    localtime_r(&seconds, &tm);
+#endif
+    char buf[32];
+    size_t n = std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+    std::snprintf(buf + n, sizeof(buf) - n, ".%03u",
+                  static_cast<unsigned>((time_ns / 1000000ULL) % 1000));
+    out += buf;
+}
+
+bool open_file(std::string& error) {
+    std::error_code ec;
+    g_file_bytes = std::filesystem::exists(g_path, ec) ? std::filesystem::file_size(g_path, ec) : 0;
+    if (ec) {
+        g_file_bytes = 0;
+    }
+    g_file.open(g_path, std::ios::app | std::ios::binary);
+    if (!g_file) {
+        error = "cannot open " + g_path.string();
+        return false;
+    }
+    return true;
+}
+
+// path -> path.1 -> path.2 ...; the oldest is overwritten
+void rotate() {
+    g_file.close();
+    std::error_code ec;
+    for (int i = LOG_ROTATED_FILES - 1; i >= 1; --i) {
+        std::filesystem::path from = g_path;
+        from += "." + std::to_string(i);
+        std::filesystem::path to = g_path;
+        to += "." + std::to_string(i + 1);
+        std::filesystem::rename(from, to, ec);
+    }
+    std::filesystem::path first = g_path;
+    first += ".1";
+    std::filesystem::rename(g_path, first, ec);
+    std::string error;
+    open_file(error);
+}
+
+void flush_batch() {
+    std::vector<LogBuffer*> buffers;
+    {
+        std::lock_guard<std::mutex> lock(g_buffers_mutex);
+        for (const auto& buffer : g_buffers) {
+            buffers.push_back(buffer.get());
+        }
+    }
+
+    std::vector<Entry> entries;
+    uint64_t dropped = 0;
+    uint64_t suppressed = 0;
+    for (LogBuffer* buffer : buffers) {
+        uint64_t tail = buffer->tail.load(std::memory_order_relaxed);
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        for (; tail != head; ++tail) {
+            const LogSlot& slot = buffer->slots[tail & (LOG_RING_SLOTS - 1)];
+            entries.push_back({slot.time_ns, slot.level, slot.source, std::string(slot.text, slot.length)});
+        }
+        buffer->tail.store(tail, std::memory_order_release);
+        dropped += buffer->dropped.exchange(0, std::memory_order_relaxed);
+        suppressed += buffer->suppressed.exchange(0, std::memory_order_relaxed);
+    }
+    if (entries.empty() && dropped == 0 && suppressed == 0) {
+        return;
+    }
+
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.time_ns < b.time_ns;
+    });
+    uint64_t now_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    if (dropped > 0) {
+        entries.push_back({now_ns, LogLevel::Warning, "log",
+                           std::to_string(dropped) + " messages dropped (ring full)"});
+    }
+    if (suppressed > 0) {
+        entries.push_back({now_ns, LogLevel::Warning, "log",
+                           std::to_string(suppressed) + " messages suppressed (rate limit)"});
+    }
+
+    std::string out;
+    out.reserve(entries.size() * 96);
+    for (const auto& entry : entries) {
+        append_timestamp(out, entry.time_ns);
+        out += ' ';
+        out += LEVEL_LETTERS[static_cast<size_t>(entry.level)];
+        out += ' ';
+        out += entry.source ? entry.source : "?";
+        out += ": ";
+        out += entry.text;
+        out += '\n';
+    }
+
+    if (g_file_bytes > 0 && g_file_bytes + out.size() > LOG_MAX_FILE_BYTES) {
+        rotate();
+    }
+    if (g_file) {
+        g_file.write(out.data(), static_cast<std::streamsize>(out.size()));
+        g_file.flush();
+        g_file_bytes += out.size();
+    }
+}
+
+void writer_run() {
+    set_thread_name("log");
+    std::unique_lock<std::mutex> lock(g_writer_mutex);
+    while (!g_writer_stop) {
+        g_writer_cv.wait_for(lock, FLUSH_INTERVAL, []() { return g_writer_stop; });
+        lock.unlock();
+        flush_batch();
+        lock.lock();
+    }
+    lock.unlock();
+    // Whatever was logged before log_stop() returned
+    flush_batch();
+}
+
+// Takes a token from the calling thread's bucket, or counts the message
+// as suppressed
+bool take_token(ThreadSlot& slot) {
+    if (!slot.buffer) {
+        slot.buffer = acquire_buffer();
+    }
+    uint64_t now_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+    slot.tokens = std::min(LOG_RATE_BURST,
+                           slot.tokens + static_cast<double>(now_ns - slot.last_refill_ns) * LOG_RATE_PER_SECOND / 1e9);
+    slot.last_refill_ns = now_ns;
+    if (slot.tokens < 1.0) {
+        slot.buffer->suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    slot.tokens -= 1.0;
+    return true;
+}
+
+} // namespace
+
+bool log_level_from_string(const std::string& name, LogLevel& level) {
+    if (name == "error") {
+        level = LogLevel::Error;
+    } else if (name == "warning") {
+        level = LogLevel::Warning;
+    } else if (name == "info") {
+        level = LogLevel::Info;
+    } else if (name == "debug") {
+        level = LogLevel::Debug;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool log_start(const std::filesystem::path& path, LogLevel level, std::string& error) {
+    log_stop();
+
+    g_path = path;
+    if (!open_file(error)) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_buffers_mutex);
+        while (g_buffers.size() < PREALLOCATED_BUFFERS) {
+            g_buffers.push_back(std::make_unique<LogBuffer>());
+        }
+    }
+
+    // Early returns from main must not leave the writer running
+    static bool registered = false;
+    if (!registered) {
+        std::atexit(log_stop);
+        registered = true;
+    }
+
+    g_writer_stop = false;
+    g_writer = std::thread(writer_run);
+    g_log_level.store(static_cast<int>(level), std::memory_order_relaxed);
+    return true;
+}
+
+void log_stop() {
+    g_log_level.store(-1, std::memory_order_relaxed);
+    if (!g_writer.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_writer_mutex);
+        g_writer_stop = true;
+    }
+    g_writer_cv.notify_one();
+    g_writer.join();
+    g_file.close();
+}
+
+void log_write(LogLevel level, const char* source, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    log_vwrite(level, source, fmt, args);
+    va_end(args);
+}
+
+bool log_admit(LogLevel level) {
+    if (!log_enabled(level)) {
+        return false;
+    }
+    ThreadSlot& slot = t_slot;
+    if (slot.admitted) {
+        return true;
+    }
+    slot.admitted = take_token(slot);
+    return slot.admitted;
+}
+
+void log_vwrite(LogLevel level, const char* source, const char* fmt, va_list args) {
+    if (!log_enabled(level)) {
+        return;
+    }
+
+    ThreadSlot& slot = t_slot;
+    if (!std::exchange(slot.admitted, false) && !take_token(slot)) {
+        return;
+    }
+    LogBuffer& buffer = *slot.buffer;
+
+    uint64_t head = buffer.head.load(std::memory_order_relaxed);
+    if (head - buffer.tail.load(std::memory_order_acquire) >= LOG_RING_SLOTS) {
+        buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    LogSlot& entry = buffer.slots[head & (LOG_RING_SLOTS - 1)];
+    entry.time_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    entry.source = source;
+    entry.level = level;
+    int n = std::vsnprintf(entry.text, sizeof(entry.text), fmt, args);
+    size_t length = n < 0 ? 0 : std::min(static_cast<size_t>(n), sizeof(entry.text) - 1);
+    // FFmpeg lines end in a newline; the writer adds its own
+    while (length > 0 && (entry.text[length - 1] == '\n' || entry.text[length - 1] == '\r')) {
+        --length;
+    }
+    if (length == 0) {
+        return;
+    }
+    entry.length = static_cast<uint16_t>(length);
+    buffer.head.store(head + 1, std::memory_order_release);
+}
@@ -0,0 +1,72 @@
+#ifndef ASYNC_LOG_HPP
+#define ASYNC_LOG_HPP
+
+#include <atomic>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+// Log file written by a background thread.
+//
+// log_write() formats straight into a slot of the calling thread's own
+// ring (single producer, single consumer) and returns; apart from the
+// first message of a thread, which picks a ring from the pool, it never
+// takes a lock, allocates or touches the file. The writer thread drains
+// every ring a few times a second, sorts the batch by time and appends it
+// to the file, rotating it at LOG_MAX_FILE_BYTES into path.1 .. path.N.
+//
+// When a ring is full, or a thread logs faster than LOG_RATE_PER_SECOND
+// (with bursts up to LOG_RATE_BURST), messages are dropped and the writer
+// records how many. Messages longer than a slot are truncated.
+//
+// Do not log from the audio callback: even a wait-free write costs a
+// vsnprintf.
+
+enum class LogLevel : uint8_t {
+    Error,
+    Warning,
+    Info,
+    Debug,
+};
+
+inline constexpr size_t LOG_RING_SLOTS = 512;              // per thread, power of two
+inline constexpr double LOG_RATE_PER_SECOND = 50.0;
+inline constexpr double LOG_RATE_BURST = 200.0;
+inline constexpr uint64_t LOG_MAX_FILE_BYTES = 1024 * 1024;
+inline constexpr int LOG_ROTATED_FILES = 3;
+
+// Most verbose level written, or -1 while logging is off
+inline std::atomic<int> g_log_level{-1};
+
+inline bool log_enabled(LogLevel level) {
+    return static_cast<int>(level) <= g_log_level.load(std::memory_order_relaxed);
+}
+
+// "error", "warning", "info", "debug"
+bool log_level_from_string(const std::string& name, LogLevel& level);
+
+// Start the writer thread. Returns false and sets error if path cannot be
+// opened. log_stop() also runs at exit.
+bool log_start(const std::filesystem::path& path, LogLevel level, std::string& error);
+
+// Write out everything still buffered and stop the writer thread
+void log_stop();
+
+// source is shown with the message; it must be a string literal (only the
+// pointer is stored)
+void log_write(LogLevel level, const char* source, const char* fmt, ...)
+#if defined(__GNUC__)
+    __attribute__((format(printf, 3, 4)))
+#endif
+    ;
+void log_vwrite(LogLevel level, const char* source, const char* fmt, va_list args);
+
+// For a message built from pieces (FFmpeg's log lines): takes its rate
+// limit token before the pieces are formatted. False if the message is
+// over the limit (counted as suppressed); otherwise the calling thread's
+// next log_write() is let through without taking another.
+bool log_admit(LogLevel level);
+
+#endif // ASYNC_LOG_HPP
@@ -0,0 +1,16 @@
+#ifndef AUDIO_ANALYZER_HPP
+#define AUDIO_ANALYZER_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Sees every block of audio a Player hands to its sink, after volume, on
+// the sink's thread. Implementations must not block or allocate there.
+class AudioAnalyzer {
+public:
+    virtual ~AudioAnalyzer() = default;
+
+    virtual void push_samples(const int16_t* stereo_samples, size_t frame_count) = 0;
+};
+
+#endif // AUDIO_ANALYZER_HPP
@@ -0,0 +1,125 @@
+#include "audio_sink.hpp"
+#include "engine.hpp"
+#include "pipeline_clock.hpp"
+#include "stream_decoder.hpp"
+#include "thread_name.hpp"
+#include "trace.hpp"
+
+#include <vector>
+
+#define MINIAUDIO_IMPLEMENTATION
+#include "miniaudio.h"
+
+struct DeviceSink::Device {
+    ma_device device;
+};
+
+static void device_callback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount) {
+    (void)pInput;
+
+    Player* player = static_cast<Player*>(pDevice->pUserData);
+    if (!player) return;
+
+    // miniaudio creates a new thread per device; name it on its first call
+    static thread_local bool thread_named = false;
+    if (!thread_named) {
+        set_thread_name("audio");
+        thread_named = true;
+    }
+    TRACE_THREAD_NAME("audio callback");
+    player->render(static_cast<uint8_t*>(pOutput), frameCount, pDevice->sampleRate);
+}
+
+DeviceSink::DeviceSink() : device_(std::make_unique<Device>()) {}
+
+DeviceSink::~DeviceSink() {
+    close();
+}
+
+bool DeviceSink::open(Player& player, std::string& error) {
+    close();
+
+    constexpr int OUTPUT_SAMPLE_RATE = StreamDecoder::OUTPUT_SAMPLE_RATE;
+
+    ma_device_config deviceConfig = ma_device_config_init(ma_device_type_playback);
+    deviceConfig.playback.format = ma_format_s16;
+    deviceConfig.playback.channels = StreamDecoder::OUTPUT_CHANNELS;
+    deviceConfig.sampleRate = OUTPUT_SAMPLE_RATE;
+    deviceConfig.dataCallback = device_callback;
+    deviceConfig.pUserData = &player;
+
+    ma_result result = ma_device_init(nullptr, &deviceConfig, &device_->device);
+    if (result != MA_SUCCESS) {
+        error = std::string("audio device init failed: ") + ma_result_description(result);
+        return false;
+    }
+    opened_ = true;
+
+    // Audio handed to the device is heard roughly one full device buffer later
+    ma_device& device = device_->device;
+    uint64_t internal_frames = static_cast<uint64_t>(device.playback.internalPeriodSizeInFrames) *
+                               device.playback.internalPeriods;
+    uint64_t internal_rate = device.playback.internalSampleRate ? device.playback.internalSampleRate : OUTPUT_SAMPLE_RATE;
+    latency_bytes_ = static_cast<size_t>(internal_frames * OUTPUT_SAMPLE_RATE / internal_rate) *
+                     StreamDecoder::OUTPUT_BYTES_PER_FRAME;
+    return true;
+}
+
+bool DeviceSink::start(std::string& error) {
+    ma_result result = ma_device_start(&device_->device);
+    if (result != MA_SUCCESS) {
+        error = std::string("audio device start failed: ") + ma_result_description(result);
+        return false;
+    }
+    return true;
+}
+
+void DeviceSink::close() {
+    if (opened_) {
+        ma_device_stop(&device_->device);
+        ma_device_uninit(&device_->device);
+        opened_ = false;
+    }
+}
+
+NullSink::~NullSink() {
+    close();
+}
+
+bool NullSink::open(Player& player, std::string& error) {
+    (void)error;
+    close();
+    player_ = &player;
+    return true;
+}
+
+bool NullSink::start(std::string& error) {
+    (void)error;
+    stop_requested_ = false;
+    thread_ = std::thread([this]() {
+        set_thread_name("null sink");
+        run();
+    });
+    return true;
+}
+
+void NullSink::close() {
+    stop_requested_ = true;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void NullSink::run() {
+    constexpr uint32_t SAMPLE_RATE = StreamDecoder::OUTPUT_SAMPLE_RATE;
+    constexpr uint64_t PERIOD_NS = uint64_t(PERIOD_FRAMES) * 1'000'000'000ull / SAMPLE_RATE;
+    std::vector<uint8_t> period(PERIOD_FRAMES * StreamDecoder::OUTPUT_BYTES_PER_FRAME);
+
+    PipelineClock& clock = pipeline_clock();
+    uint64_t next_ns = clock.now_ns();
+    while (!stop_requested_) {
+        player_->render(period.data(), PERIOD_FRAMES, SAMPLE_RATE);
+        next_ns += PERIOD_NS;
+        clock.sleep_until_ns(next_ns);
+    }
+}
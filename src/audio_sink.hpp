@@ -0,0 +1,70 @@
+#ifndef AUDIO_SINK_HPP
+#define AUDIO_SINK_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+class Player;
+
+// Where a Player's audio goes. The sink pulls PCM (StreamDecoder's output
+// format: s16 stereo at OUTPUT_SAMPLE_RATE) with Player::render() on its
+// own thread and clock. The player's playback thread opens it once the
+// stream decodes, starts it after prebuffering and closes it when the
+// stream ends.
+class AudioSink {
+public:
+    virtual ~AudioSink() = default;
+
+    virtual bool open(Player& player, std::string& error) = 0;
+    virtual bool start(std::string& error) = 0;
+    virtual void close() = 0;
+
+    // Bytes rendered but not yet audible (device buffering); valid after open()
+    virtual size_t latency_bytes() const = 0;
+};
+
+// The default audio device, through miniaudio
+class DeviceSink : public AudioSink {
+public:
+    DeviceSink();
+    ~DeviceSink() override;
+
+    bool open(Player& player, std::string& error) override;
+    bool start(std::string& error) override;
+    void close() override;
+    size_t latency_bytes() const override { return latency_bytes_; }
+
+private:
+    struct Device;
+    std::unique_ptr<Device> device_;
+    bool opened_ = false;
+    size_t latency_bytes_ = 0;
+};
+
+// Renders in PERIOD_FRAMES blocks on its own thread, paced by
+// pipeline_clock(), and discards the audio. For players nobody listens to
+// (daemon tests, benchmarks, monitoring).
+class NullSink : public AudioSink {
+public:
+    static constexpr uint32_t PERIOD_FRAMES = 441;     // 10 ms
+
+    ~NullSink() override;
+
+    bool open(Player& player, std::string& error) override;
+    bool start(std::string& error) override;
+    void close() override;
+    size_t latency_bytes() const override { return 0; }
+
+private:
+    void run();
+
+    Player* player_ = nullptr;
+    std::thread thread_;
+    std::atomic<bool> stop_requested_{false};
+};
+
+#endif // AUDIO_SINK_HPP
@@ -7,19 +7,23 @@
 #include <cstdint>
 #include <cstring>
 
-class ByteRingbuffer {
+// Single-producer single-consumer byte ring. Size must be a power of two.
+template <size_t Size>
+class BasicByteRingbuffer {
 public:
-    static constexpr size_t BUFFER_SIZE = 262144; // 256KB
+    static_assert(Size >= 2 && (Size & (Size - 1)) == 0, "ring size must be a power of two");
+
+    static constexpr size_t BUFFER_SIZE = Size;
     static constexpr size_t BUFFER_MASK = BUFFER_SIZE - 1;
 
-    ByteRingbuffer() : head_(0), tail_(0) {
+    BasicByteRingbuffer() : head_(0), tail_(0) {
         // Initialize buffer to silence (zeros)
         std::memset(buffer_, 0, BUFFER_SIZE);
     }
 
     // Delete copy/move
-    ByteRingbuffer(const ByteRingbuffer&) = delete;
-    ByteRingbuffer& operator=(const ByteRingbuffer&) = delete;
+    BasicByteRingbuffer(const BasicByteRingbuffer&) = delete;
+    BasicByteRingbuffer& operator=(const BasicByteRingbuffer&) = delete;
 
     // Write data to buffer. Returns bytes actually written (may be less than requested if buffer full)
     size_t write(const uint8_t* src, size_t len) {
@@ -145,6 +149,16 @@ public:
         return BUFFER_SIZE - (tail & BUFFER_MASK);
     }
 
+    // Total bytes ever produced / consumed. Both only grow (modulo SIZE_MAX
+    // wrap), so they can be used as positions in the audio byte stream.
+    size_t write_position() const {
+        return head_.load(std::memory_order_acquire);
+    }
+
+    size_t read_position() const {
+        return tail_.load(std::memory_order_acquire);
+    }
+
     // Clear buffer from consumer side (call before starting new stream)
     void consumer_clear() {
         // Acquire head, release tail to synchronize with producer
@@ -173,4 +187,7 @@ private:
     alignas(64) uint8_t buffer_[BUFFER_SIZE];
 };
 
+// The playback ring: about 1.5 s of 44.1 kHz s16 stereo
+using ByteRingbuffer = BasicByteRingbuffer<262144>;
+
 #endif // BYTE_RINGBUFFER_HPP
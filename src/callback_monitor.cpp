@@ -0,0 +1,53 @@
+#include "callback_monitor.hpp"
+
+#include <algorithm>
+
+bool CallbackMonitor::drain() {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t head = head_.load(std::memory_order_acquire);
+    if (tail == head) {
+        return false;
+    }
+
+    if (window_.capacity() < WINDOW) {
+        window_.reserve(WINDOW);
+    }
+    for (; tail != head; ++tail) {
+        const Sample& sample = ring_[tail & (RING_SIZE - 1)];
+        if (window_.size() < WINDOW) {
+            window_.push_back(sample.duration_ns);
+        } else {
+            window_[window_next_] = sample.duration_ns;
+        }
+        window_next_ = (window_next_ + 1) % WINDOW;
+        if (sample.budget_ns > 0 && sample.duration_ns > sample.budget_ns) {
+            ++misses_;
+        }
+        last_budget_ns_ = sample.budget_ns;
+        ++callbacks_;
+    }
+    tail_.store(tail, std::memory_order_release);
+    return true;
+}
+
+CallbackMonitor::Stats CallbackMonitor::stats() const {
+    Stats s;
+    s.budget_ns = last_budget_ns_;
+    s.callbacks = callbacks_;
+    s.misses = misses_;
+    s.dropped = dropped_.load(std::memory_order_relaxed);
+    if (window_.empty()) {
+        return s;
+    }
+
+    std::vector<uint32_t> sorted = window_;
+    auto rank = [&](double q) {
+        size_t i = static_cast<size_t>(q * static_cast<double>(sorted.size() - 1) + 0.5);
+        std::nth_element(sorted.begin(), sorted.begin() + static_cast<long>(i), sorted.end());
+        return sorted[i];
+    };
+    s.p50_ns = rank(0.50);
+    s.p99_ns = rank(0.99);
+    s.max_ns = *std::max_element(sorted.begin(), sorted.end());
+    return s;
+}
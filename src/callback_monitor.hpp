@@ -0,0 +1,80 @@
+#ifndef CALLBACK_MONITOR_HPP
+#define CALLBACK_MONITOR_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Deadline monitoring for the audio callback.
+//
+// The callback records its entry/exit timestamps and the period budget
+// (frames / sample rate) into a fixed single-producer ring: a relaxed
+// load, a store and a release store, no locks or allocation. If the
+// ring is full the sample is dropped and counted. The UI thread drains
+// the ring into a window of the most recent callbacks, from which
+// stats() computes p50/p99/max.
+//
+// miniaudio drives the callback from one thread, so one monitor is one
+// producer.
+class CallbackMonitor {
+public:
+    static constexpr size_t RING_SIZE = 4096;      // power of two; ~40 s of 10 ms periods
+    static constexpr size_t WINDOW = 2048;         // callbacks in the stats window
+
+    struct Stats {
+        uint32_t p50_ns = 0;
+        uint32_t p99_ns = 0;
+        uint32_t max_ns = 0;
+        uint32_t budget_ns = 0;     // period of the latest callback
+        uint64_t callbacks = 0;     // since start
+        uint64_t misses = 0;        // callbacks that ran past their period
+        uint64_t dropped = 0;       // samples lost to a full ring
+    };
+
+    // Callback thread only
+    void record(uint64_t start_ns, uint64_t end_ns, uint32_t frames, uint32_t sample_rate) {
+        uint64_t duration = end_ns - start_ns;
+        uint64_t budget = sample_rate ? uint64_t(frames) * 1000000000ull / sample_rate : 0;
+        Sample sample{
+            static_cast<uint32_t>(duration > UINT32_MAX ? UINT32_MAX : duration),
+            static_cast<uint32_t>(budget > UINT32_MAX ? UINT32_MAX : budget),
+        };
+
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) == RING_SIZE) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        ring_[head & (RING_SIZE - 1)] = sample;
+        head_.store(head + 1, std::memory_order_release);
+    }
+
+    // UI thread: move pending samples into the window. Returns true if
+    // there were any.
+    bool drain();
+
+    // UI thread
+    Stats stats() const;
+
+private:
+    struct Sample {
+        uint32_t duration_ns;
+        uint32_t budget_ns;
+    };
+
+    std::array<Sample, RING_SIZE> ring_{};
+    alignas(64) std::atomic<size_t> head_{0};      // written by the callback
+    alignas(64) std::atomic<size_t> tail_{0};      // written by the UI thread
+    std::atomic<uint64_t> dropped_{0};
+
+    // UI thread only
+    std::vector<uint32_t> window_;
+    size_t window_next_ = 0;
+    uint32_t last_budget_ns_ = 0;
+    uint64_t callbacks_ = 0;
+    uint64_t misses_ = 0;
+};
+
+#endif // CALLBACK_MONITOR_HPP
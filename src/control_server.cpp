@@ -0,0 +1,437 @@
+#include "control_server.hpp"
+#include "thread_name.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using json = nlohmann::json;
+
+static constexpr size_t MAX_CLIENTS = 32;
+static constexpr size_t MAX_LINE = 64 * 1024;
+// Events are skipped for a client with this much output still unsent
+static constexpr size_t EVENT_BACKLOG_LIMIT = 64 * 1024;
+// Replies too: a client this far behind is disconnected
+static constexpr size_t OUTPUT_LIMIT = 1024 * 1024;
+// Events queued while the server thread is busy; oldest dropped first
+static constexpr size_t MAX_PENDING_EVENTS = 1024;
+
+ControlServer::~ControlServer() {
+    stop();
+}
+
+bool ControlServer::start(const std::filesystem::path& socket_path, Handler handler) {
+#ifdef __linux__
+    stop();
+    error_.clear();
+    handler_ = std::move(handler);
+
+    std::string path = socket_path.string();
+    sockaddr_un addr{};
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        error_ = "invalid socket path: " + path;
+        return false;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    if (!remove_stale_socket(path, addr)) {
+        return false;
+    }
+
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        error_ = "socket failed";
+        return false;
+    }
+    // Anyone who can connect can control playback: create the socket 0600
+    // rather than chmod it after bind, which leaves a window
+    mode_t old_mask = umask(S_IRWXG | S_IRWXO | S_IXUSR);
+    int bound = bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    int bind_errno = errno;
+    umask(old_mask);
+    if (bound < 0) {
+        error_ = "cannot bind " + path + ": " + std::strerror(bind_errno);
+        stop();
+        return false;
+    }
+    socket_path_ = path;
+    if (::listen(listen_fd_, 8) < 0) {
+        error_ = "listen failed";
+        stop();
+        return false;
+    }
+
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+        error_ = "eventfd failed";
+        stop();
+        return false;
+    }
+
+    stop_requested_ = false;
+    thread_ = std::thread([this]() {
+        set_thread_name("control");
+        run();
+    });
+    return true;
+#else
+    (void)socket_path;
+    (void)handler;
+    error_ = "the control socket is only supported on Linux";
+    return false;
+#endif
+}
+
+void ControlServer::stop() {
+#ifdef __linux__
+    stop_requested_ = true;
+    if (wake_fd_ >= 0) {
+        uint64_t one = 1;
+        (void)!write(wake_fd_, &one, sizeof(one));
+    }
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    for (auto& client : clients_) {
+        close_client(client);
+    }
+    clients_.clear();
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        listen_fd_ = -1;
+    }
+    if (!socket_path_.empty()) {
+        unlink(socket_path_.c_str());
+        socket_path_.clear();
+    }
+    if (wake_fd_ >= 0) {
+        close(wake_fd_);
+        wake_fd_ = -1;
+    }
+    std::lock_guard<std::mutex> lock(events_mutex_);
+    pending_events_.clear();
+#endif
+}
+
+bool ControlServer::remove_stale_socket(const std::string& path, const sockaddr_un& addr) {
+#ifdef __linux__
+    struct stat st {};
+    if (lstat(path.c_str(), &st) != 0) {
+        return true;
+    }
+    if (!S_ISSOCK(st.st_mode)) {
+        error_ = path + " exists and is not a socket";
+        return false;
+    }
+
+    // A socket someone still accepts on belongs to a running daemon
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe < 0) {
+        error_ = "socket failed";
+        return false;
+    }
+    bool live = connect(probe, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0;
+    close(probe);
+    if (live) {
+        error_ = path + " is in use by another daemon";
+        return false;
+    }
+
+    // Left behind by a previous run; bind would fail on it
+    if (unlink(path.c_str()) != 0 && errno != ENOENT) {
+        error_ = "cannot remove stale " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    return true;
+#else
+    (void)path;
+    (void)addr;
+    return false;
+#endif
+}
+
+int ControlServer::event_index(const std::string& name) {
+    for (size_t i = 0; i < EVENT_COUNT; i++) {
+        if (name == EVENTS[i]) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+void ControlServer::publish(const char* event, json fields) {
+#ifdef __linux__
+    int index = event_index(event);
+    if (index < 0 || wake_fd_ < 0 || !has_subscribers(event)) {
+        return;
+    }
+    fields["event"] = event;
+    std::string line = fields.dump() + "\n";
+    {
+        std::lock_guard<std::mutex> lock(events_mutex_);
+        if (pending_events_.size() >= MAX_PENDING_EVENTS) {
+            pending_events_.pop_front();
+        }
+        pending_events_.emplace_back(index, std::move(line));
+    }
+    uint64_t one = 1;
+    (void)!write(wake_fd_, &one, sizeof(one));
+#else
+    (void)event;
+    (void)fields;
+#endif
+}
+
+bool ControlServer::has_subscribers(const char* event) const {
+    int index = event_index(event);
+    return index >= 0 && subscribers_[index].load(std::memory_order_relaxed) > 0;
+}
+
+void ControlServer::run() {
+#ifdef __linux__
+    std::vector<pollfd> fds;
+    while (!stop_requested_) {
+        fds.clear();
+        fds.push_back({wake_fd_, POLLIN, 0});
+        fds.push_back({listen_fd_, POLLIN, 0});
+        for (const auto& client : clients_) {
+            fds.push_back({client.fd, static_cast<short>(POLLIN | (client.out.empty() ? 0 : POLLOUT)), 0});
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            continue;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            uint64_t count;
+            (void)!read(wake_fd_, &count, sizeof(count));
+            if (stop_requested_) {
+                break;
+            }
+            drain_events();
+        }
+
+        // Only clients that were polled; accepted ones join next round
+        for (size_t i = 0; i + 2 < fds.size(); i++) {
+            Client& client = clients_[i];
+            short revents = fds[i + 2].revents;
+            if (client.fd < 0 || revents == 0) {
+                continue;
+            }
+            bool ok = true;
+            if (revents & (POLLIN | POLLHUP | POLLERR)) {
+                ok = read_client(client);
+            }
+            if (ok && !client.out.empty()) {
+                ok = write_client(client);
+            }
+            if (!ok) {
+                close_client(client);
+            }
+        }
+        clients_.erase(std::remove_if(clients_.begin(), clients_.end(),
+                                      [](const Client& client) { return client.fd < 0; }),
+                       clients_.end());
+
+        if (fds[1].revents & POLLIN) {
+            accept_clients();
+        }
+    }
+#endif
+}
+
+void ControlServer::accept_clients() {
+#ifdef __linux__
+    int fd;
+    while ((fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        if (clients_.size() >= MAX_CLIENTS) {
+            static const char busy[] = "{\"error\":\"too many clients\",\"ok\":false}\n";
+            (void)!send(fd, busy, sizeof(busy) - 1, MSG_NOSIGNAL);
+            close(fd);
+            continue;
+        }
+        Client client;
+        client.fd = fd;
+        clients_.push_back(std::move(client));
+    }
+#endif
+}
+
+bool ControlServer::read_client(Client& client) {
+#ifdef __linux__
+    char buf[4096];
+    for (;;) {
+        ssize_t n = read(client.fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (n == 0) {
+            // Half-closed: still answer what was already sent
+            if (!client.in.empty() && client.in.size() <= MAX_LINE) {
+                handle_line(client, client.in);
+            }
+            write_client(client);
+            return false;
+        }
+        if (n < 0) {
+            return false;
+        }
+        client.in.append(buf, static_cast<size_t>(n));
+
+        size_t start = 0;
+        size_t newline;
+        while ((newline = client.in.find('\n', start)) != std::string::npos) {
+            std::string line = client.in.substr(start, newline - start);
+            start = newline + 1;
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (!line.empty()) {
+                handle_line(client, line);
+            }
+        }
+        client.in.erase(0, start);
+        if (client.in.size() > MAX_LINE) {
+            return false;
+        }
+    }
+    return client.out.size() <= OUTPUT_LIMIT;
+#else
+    (void)client;
+    return false;
+#endif
+}
+
+bool ControlServer::write_client(Client& client) {
+#ifdef __linux__
+    while (!client.out.empty()) {
+        ssize_t n = send(client.fd, client.out.data(), client.out.size(), MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        client.out.erase(0, static_cast<size_t>(n));
+    }
+    return true;
+#else
+    (void)client;
+    return false;
+#endif
+}
+
+void ControlServer::handle_line(Client& client, const std::string& line) {
+    json request = json::parse(line, nullptr, false);
+    json reply;
+    if (request.is_discarded() || !request.is_object()) {
+        reply = {{"error", "expected a JSON object per line"}};
+    } else if (request.contains("cmd") && !request["cmd"].is_string()) {
+        reply = {{"error", "\"cmd\" must be a string"}};
+    } else {
+        try {
+            std::string cmd = request.value("cmd", "");
+            if (cmd == "subscribe" || cmd == "unsubscribe") {
+                reply = subscribe(client, request, cmd == "subscribe");
+            } else if (cmd.empty()) {
+                reply = {{"error", "missing \"cmd\""}};
+            } else {
+                reply = handler_(request);
+            }
+        } catch (const json::exception& e) {
+            // Wrong argument types in the request
+            reply = {{"error", std::string("bad request: ") + e.what()}};
+        }
+    }
+    if (!reply.is_object()) {
+        reply = json::object();
+    }
+    reply["ok"] = !reply.contains("error");
+    if (request.is_object() && request.contains("id")) {
+        reply["id"] = request["id"];
+    }
+    client.out += reply.dump() + "\n";
+}
+
+json ControlServer::subscribe(Client& client, const json& request, bool on) {
+    uint32_t mask = 0;
+    if (!request.contains("events")) {
+        mask = (1u << EVENT_COUNT) - 1;
+    } else {
+        for (const auto& name : request.at("events")) {
+            int index = event_index(name.get<std::string>());
+            if (index < 0) {
+                return {{"error", "unknown event: " + name.get<std::string>()}};
+            }
+            mask |= 1u << index;
+        }
+    }
+
+    uint32_t events = on ? (client.events | mask) : (client.events & ~mask);
+    for (size_t i = 0; i < EVENT_COUNT; i++) {
+        bool was = client.events & (1u << i);
+        bool now = events & (1u << i);
+        if (was != now) {
+            subscribers_[i].fetch_add(now ? 1 : -1, std::memory_order_relaxed);
+        }
+    }
+    client.events = events;
+
+    json subscribed = json::array();
+    for (size_t i = 0; i < EVENT_COUNT; i++) {
+        if (events & (1u << i)) {
+            subscribed.push_back(EVENTS[i]);
+        }
+    }
+    return {{"events", subscribed}};
+}
+
+void ControlServer::drain_events() {
+    std::deque<std::pair<int, std::string>> events;
+    {
+        std::lock_guard<std::mutex> lock(events_mutex_);
+        events.swap(pending_events_);
+    }
+    for (const auto& [index, line] : events) {
+        for (auto& client : clients_) {
+            if (client.fd >= 0 && (client.events & (1u << index)) && client.out.size() < EVENT_BACKLOG_LIMIT) {
+                client.out += line;
+            }
+        }
+    }
+    for (auto& client : clients_) {
+        if (client.fd >= 0 && !client.out.empty() && !write_client(client)) {
+            close_client(client);
+        }
+    }
+}
+
+void ControlServer::close_client(Client& client) {
+#ifdef __linux__
+    if (client.fd >= 0) {
+        close(client.fd);
+        client.fd = -1;
+    }
+#endif
+    for (size_t i = 0; i < EVENT_COUNT; i++) {
+        if (client.events & (1u << i)) {
+            subscribers_[i].fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+    client.events = 0;
+}
@@ -0,0 +1,91 @@
+#ifndef CONTROL_SERVER_HPP
+#define CONTROL_SERVER_HPP
+
+#include <atomic>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+struct sockaddr_un;
+
+// Control channel for --daemon: JSON lines on a UNIX domain socket.
+//
+// Each client sends one JSON object per line, e.g. {"id":1,"cmd":"status"},
+// and gets one reply line per request, in order, echoing "id" and carrying
+// "ok" (false with "error" on failure). {"cmd":"subscribe","events":[...]}
+// and {"cmd":"unsubscribe",...} are handled here; every other command goes
+// to the handler, which runs on the server thread so commands are answered
+// while the decoder is busy. Events from publish() are pushed to the
+// clients subscribed to them as {"event":NAME,...} lines. A client that
+// stops reading misses events rather than stalling the others. Linux only.
+class ControlServer {
+public:
+    // Event names clients can subscribe to
+    static constexpr const char* EVENTS[] = {"metadata", "levels", "state", "stations"};
+    static constexpr size_t EVENT_COUNT = sizeof(EVENTS) / sizeof(EVENTS[0]);
+
+    // Returns the reply fields; a reply with "error" is sent with "ok": false
+    using Handler = std::function<nlohmann::json(const nlohmann::json& request)>;
+
+    ControlServer() = default;
+    ~ControlServer();
+
+    ControlServer(const ControlServer&) = delete;
+    ControlServer& operator=(const ControlServer&) = delete;
+
+    bool start(const std::filesystem::path& socket_path, Handler handler);
+    void stop();
+
+    // Queue an event for its subscribers; any thread. fields must be an object.
+    void publish(const char* event, nlohmann::json fields);
+
+    // Lets publishers skip building events nobody listens to
+    bool has_subscribers(const char* event) const;
+
+    const std::string& error() const { return error_; }
+
+private:
+    struct Client {
+        int fd = -1;
+        std::string in;
+        std::string out;
+        uint32_t events = 0;    // bit per EVENTS entry
+    };
+
+    static int event_index(const std::string& name);
+
+    // Unlinks a socket file at path that nobody accepts on any more;
+    // false with error_ set if path is live or not a socket
+    bool remove_stale_socket(const std::string& path, const sockaddr_un& addr);
+
+    void run();
+    void accept_clients();
+    bool read_client(Client& client);
+    bool write_client(Client& client);
+    void handle_line(Client& client, const std::string& line);
+    nlohmann::json subscribe(Client& client, const nlohmann::json& request, bool on);
+    void drain_events();
+    void close_client(Client& client);
+
+    std::string error_;
+    std::string socket_path_;
+    Handler handler_;
+    int listen_fd_ = -1;
+    int wake_fd_ = -1;
+    std::thread thread_;
+    std::atomic<bool> stop_requested_{false};
+
+    std::vector<Client> clients_;   // server thread only
+    std::atomic<int> subscribers_[EVENT_COUNT] = {};
+
+    std::mutex events_mutex_;
+    std::deque<std::pair<int, std::string>> pending_events_;   // event index, line
+};
+
+#endif // CONTROL_SERVER_HPP
@@ -0,0 +1,144 @@
+#include "dsp_kernels.hpp"
+
+#include <cmath>
+
+#ifdef WEBRADIO_USE_SSE2
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <emmintrin.h>
+#endif
+#endif
+
+void apply_volume_scalar(int16_t* samples, size_t count, float volume) {
+    for (size_t i = 0; i < count; ++i) {
+        samples[i] = static_cast<int16_t>(samples[i] * volume);
+    }
+}
+
+#ifdef WEBRADIO_USE_SSE2
+// 8 x int16 per iteration:
+// int16 -> int32 -> float -> scale -> int32 -> int16 (saturated)
+void apply_volume_sse2(int16_t* samples, size_t count, float volume) {
+    const __m128 vol_vec = _mm_set1_ps(volume);
+    size_t i = 0;
+    for (; i + 7 < count; i += 8) {
+        __m128i s16 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&samples[i]));
+        // Sign-extend int16 -> int32 using arithmetic shift to fill upper bits
+        __m128i sign = _mm_srai_epi16(s16, 15);
+        __m128i lo_i32 = _mm_unpacklo_epi16(s16, sign);
+        __m128i hi_i32 = _mm_unpackhi_epi16(s16, sign);
+        // Convert to float, scale, convert back, pack with saturation
+        __m128i result = _mm_packs_epi32(
+            _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(lo_i32), vol_vec)),
+            _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(hi_i32), vol_vec)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&samples[i]), result);
+    }
+    // Scalar tail for remaining samples
+    apply_volume_scalar(samples + i, count - i, volume);
+}
+#endif
+
+void stereo_to_mono_scalar(const int16_t* stereo, float* mono, size_t frames) {
+    for (size_t i = 0; i < frames; ++i) {
+        float left = stereo[i * 2] / 32768.0f;
+        float right = stereo[i * 2 + 1] / 32768.0f;
+        mono[i] = (left + right) * 0.5f;
+    }
+}
+
+#ifdef WEBRADIO_USE_SSE2
+// 4 frames per iteration
+void stereo_to_mono_sse2(const int16_t* stereo, float* mono, size_t frames) {
+    const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    size_t i = 0;
+    for (; i + 3 < frames; i += 4) {
+        // Load 8 int16 samples (4 stereo frames: L0 R0 L1 R1 L2 R2 L3 R3)
+        __m128i samples_i16 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&stereo[i * 2]));
+
+        // Unpack to int32: L0 R0 L1 R1 and L2 R2 L3 R3
+        __m128i lower_i32 = _mm_unpacklo_epi16(samples_i16, _mm_srai_epi16(samples_i16, 15));
+        __m128i upper_i32 = _mm_unpackhi_epi16(samples_i16, _mm_srai_epi16(samples_i16, 15));
+
+        // Convert to float and scale to -1.0 to 1.0 range
+        __m128 lower_f = _mm_mul_ps(_mm_cvtepi32_ps(lower_i32), scale);
+        __m128 upper_f = _mm_mul_ps(_mm_cvtepi32_ps(upper_i32), scale);
+
+        // Separate channels: L0 L1 L2 L3 and R0 R1 R2 R3
+        __m128 left_channels = _mm_shuffle_ps(lower_f, upper_f, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 right_channels = _mm_shuffle_ps(lower_f, upper_f, _MM_SHUFFLE(3, 1, 3, 1));
+
+        // Average left and right to get mono
+        _mm_storeu_ps(&mono[i], _mm_mul_ps(_mm_add_ps(left_channels, right_channels), half));
+    }
+    stereo_to_mono_scalar(stereo + i * 2, mono + i, frames - i);
+}
+#endif
+
+FftTables::FftTables(size_t n)
+    : size(n)
+    , bit_reverse(n)
+    , twiddle_real(n / 2)
+    , twiddle_imag(n / 2)
+{
+    int bits = 0;
+    while ((size_t(1) << bits) < n) {
+        ++bits;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        size_t x = i;
+        size_t r = 0;
+        for (int b = 0; b < bits; ++b) {
+            r = (r << 1) | (x & 1);
+            x >>= 1;
+        }
+        bit_reverse[i] = r;
+    }
+
+    for (size_t k = 0; k < n / 2; ++k) {
+        float angle = -2.0f * static_cast<float>(M_PI) * static_cast<float>(k) / static_cast<float>(n);
+        twiddle_real[k] = std::cos(angle);
+        twiddle_imag[k] = std::sin(angle);
+    }
+}
+
+void fft_radix2(const FftTables& tables, const float* input, float* real, float* imag) {
+    const size_t n = tables.size;
+    for (size_t i = 0; i < n; ++i) {
+        real[i] = input[tables.bit_reverse[i]];
+        imag[i] = 0.0f;
+    }
+
+    for (size_t len = 2; len <= n; len <<= 1) {
+        size_t half = len >> 1;
+        size_t stride = n / len;
+
+        for (size_t start = 0; start < n; start += len) {
+            size_t tw = 0;
+            for (size_t i = 0; i < half; ++i, tw += stride) {
+                size_t a = start + i;
+                size_t b = a + half;
+
+                float wr = tables.twiddle_real[tw];
+                float wi = tables.twiddle_imag[tw];
+
+                float br = real[b];
+                float bi = imag[b];
+
+                float tr = wr * br - wi * bi;
+                float ti = wr * bi + wi * br;
+
+                float ar = real[a];
+                float ai = imag[a];
+
+                real[a] = ar + tr;
+                imag[a] = ai + ti;
+                real[b] = ar - tr;
+                imag[b] = ai - ti;
+            }
+        }
+    }
+}
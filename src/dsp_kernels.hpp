@@ -0,0 +1,57 @@
+#ifndef DSP_KERNELS_HPP
+#define DSP_KERNELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Per-sample kernels of the audio path, each as a scalar reference and,
+// where the build enables it (WEBRADIO_USE_SSE2), a SIMD variant. The
+// unsuffixed functions pick the fastest variant compiled in.
+// webradio-kernels-bench checks every variant against the scalar one and
+// times them.
+
+// In-place gain on s16 samples, volume in [0, 1]. The scalar version
+// truncates and the SSE2 one rounds, so they can differ by one step.
+void apply_volume_scalar(int16_t* samples, size_t count, float volume);
+#ifdef WEBRADIO_USE_SSE2
+void apply_volume_sse2(int16_t* samples, size_t count, float volume);
+#endif
+
+inline void apply_volume(int16_t* samples, size_t count, float volume) {
+#ifdef WEBRADIO_USE_SSE2
+    apply_volume_sse2(samples, count, volume);
+#else
+    apply_volume_scalar(samples, count, volume);
+#endif
+}
+
+// Interleaved stereo s16 to mono float in [-1, 1); variants are bit-exact
+void stereo_to_mono_scalar(const int16_t* stereo, float* mono, size_t frames);
+#ifdef WEBRADIO_USE_SSE2
+void stereo_to_mono_sse2(const int16_t* stereo, float* mono, size_t frames);
+#endif
+
+inline void stereo_to_mono(const int16_t* stereo, float* mono, size_t frames) {
+#ifdef WEBRADIO_USE_SSE2
+    stereo_to_mono_sse2(stereo, mono, frames);
+#else
+    stereo_to_mono_scalar(stereo, mono, frames);
+#endif
+}
+
+// Bit-reversal permutation and twiddle factors for an n-point radix-2 FFT
+struct FftTables {
+    explicit FftTables(size_t n);
+
+    size_t size;
+    std::vector<size_t> bit_reverse;
+    std::vector<float> twiddle_real;    // n / 2 entries
+    std::vector<float> twiddle_imag;
+};
+
+// Unscaled complex spectrum of tables.size real samples (iterative
+// decimation in time); real and imag receive tables.size values each
+void fft_radix2(const FftTables& tables, const float* input, float* real, float* imag);
+
+#endif // DSP_KERNELS_HPP
@@ -0,0 +1,470 @@
+#include "engine.hpp"
+#include "async_log.hpp"
+#include "metrics.hpp"
+#include "pipeline_clock.hpp"
+#include "stream_decoder.hpp"
+#include "thread_name.hpp"
+#include "trace.hpp"
+#include "dsp_kernels.hpp"
+
+#include <cctype>
+#include <cstdarg>
+#include <cstring>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavutil/log.h>
+#include <libavcodec/avcodec.h>
+}
+
+static LogLevel log_level_for_ffmpeg(int level) {
+    if (level <= AV_LOG_ERROR) return LogLevel::Error;
+    if (level <= AV_LOG_WARNING) return LogLevel::Warning;
+    if (level <= AV_LOG_INFO) return LogLevel::Info;
+    return LogLevel::Debug;
+}
+
+// A log line FFmpeg is writing in pieces on this thread
+struct FfmpegLogLine {
+    char text[256];
+    size_t length = 0;
+    LogLevel level = LogLevel::Info;
+    // Adds the "[http @ 0x...] " context prefix at the start of each line
+    int print_prefix = 1;
+    // The rest of the line is dropped: over the rate limit, or too long
+    bool skipping = false;
+};
+
+static thread_local FfmpegLogLine t_ffmpeg_line;
+
+// FFmpeg messages go to the log file (stderr would draw over the TUI),
+// minus the connection milestones the tune timeline listens for. Pieces
+// of a line are collected until its newline and logged as one message.
+static void ffmpeg_log_callback(void* ptr, int level, const char* fmt, va_list vl) {
+    if (tune_timeline_log_hook(level, fmt)) {
+        return;
+    }
+#ifdef FFMPEG_DEBUG_LOGGING
+    va_list copy;
+    va_copy(copy, vl);
+    av_log_default_callback(ptr, level, fmt, copy);
+    va_end(copy);
+#endif
+    LogLevel log_level = log_level_for_ffmpeg(level);
+    if (level > AV_LOG_DEBUG || !log_enabled(log_level)) {
+        return;
+    }
+
+    FfmpegLogLine& line = t_ffmpeg_line;
+    if (line.length == 0 && !line.skipping) {
+        // The rate limit decides before anything is formatted
+        line.level = log_level;
+        line.skipping = !log_admit(log_level);
+    }
+    if (line.skipping) {
+        // FFmpeg ends its lines in the format string
+        size_t fmt_length = std::strlen(fmt);
+        if (fmt_length > 0 && fmt[fmt_length - 1] == '\n') {
+            line.skipping = false;
+            line.print_prefix = 1;
+        }
+        return;
+    }
+
+    av_log_format_line2(ptr, level, fmt, vl, line.text + line.length, sizeof(line.text) - line.length,
+                        &line.print_prefix);
+    line.length += std::strlen(line.text + line.length);
+    bool ended = line.print_prefix != 0;
+    if (ended || line.length + 1 >= sizeof(line.text)) {
+        log_write(line.level, "ffmpeg", "%s", line.text);
+        line.length = 0;
+        line.skipping = !ended;
+    }
+}
+
+Engine::Engine(EngineOptions options) : options_(std::move(options)) {
+    av_log_set_callback(ffmpeg_log_callback);
+}
+
+Engine::~Engine() {
+    stop();
+}
+
+std::unique_ptr<Player> Engine::create_player(std::unique_ptr<AudioSink> sink) {
+    return std::make_unique<Player>(*this, std::move(sink));
+}
+
+void Engine::stop() {
+    playlist_resolver_.stop();
+}
+
+Player::Player(Engine& engine, std::unique_ptr<AudioSink> sink)
+    : engine_(engine)
+    , sink_(std::move(sink))
+{
+}
+
+Player::~Player() {
+    stop();
+}
+
+void Player::play(const std::string& url, const std::string& station_name) {
+    stop();
+    // The only way to reconnect is to tune the same station again
+    if (url == current_url_) {
+        engine_metrics().reconnects.add();
+        log_write(LogLevel::Info, "engine", "reconnect %s", station_name.c_str());
+    } else {
+        log_write(LogLevel::Info, "engine", "tune %s (%s)", station_name.c_str(), url.c_str());
+    }
+    uint64_t now_ns = pipeline_clock().now_ns();
+    tune_timeline_.begin(station_name, url, now_ns);
+    tune_started_ns_.store(now_ns, std::memory_order_relaxed);
+    ttfa_pending_.store(true, std::memory_order_relaxed);
+    current_url_ = url;
+    station_name_ = station_name;
+    stop_requested_ = false;
+    playing_ = true;
+
+    pending_playing_state_ = true;
+    has_playing_state_update_ = true;
+
+    playback_thread_ = std::thread([this]() {
+        set_thread_name("playback");
+        TRACE_THREAD_NAME("playback");
+        play_stream(current_url_);
+        // The stream failed or ended without stop(): the player is stopped
+        if (!stop_requested_) {
+            playing_ = false;
+            ttfa_pending_ = false;
+            pending_playing_state_ = false;
+            has_playing_state_update_ = true;
+        }
+    });
+}
+
+void Player::stop() {
+    stop_requested_ = true;
+    playing_ = false;
+    ttfa_pending_ = false;
+
+    if (playback_thread_.joinable()) {
+        playback_thread_.join();
+    }
+
+    // Titles still waiting for their audio belong to the old stream
+    metadata_events_.clear();
+    metadata_events_.push_now(MetadataEvent{});
+
+    pending_playing_state_ = false;
+    has_playing_state_update_ = true;
+}
+
+bool Player::take_state_change(bool& playing) {
+    if (!has_playing_state_update_.exchange(false)) {
+        return false;
+    }
+    playing = pending_playing_state_.load();
+    return true;
+}
+
+void Player::render(uint8_t* output, uint32_t frames, uint32_t sample_rate) {
+    TRACE_SCOPE("callback");
+    EngineMetrics& metrics = engine_metrics();
+    PipelineClock& clock = pipeline_clock();
+    uint64_t callback_start = clock.now_ns();
+
+    constexpr size_t bytesPerFrame = StreamDecoder::OUTPUT_BYTES_PER_FRAME;
+    size_t bytesToWrite = static_cast<size_t>(frames) * bytesPerFrame;
+
+    // copy PCM data to audio playback buffer
+    size_t bytesRead = 0;
+    while (bytesRead < bytesToWrite) {
+        const uint8_t* src = nullptr;
+        size_t available = ring_.reserve_read_contiguous(src);
+        if (available == 0 || src == nullptr) {
+            break;
+        }
+
+        size_t chunk = std::min(available, bytesToWrite - bytesRead);
+        std::memcpy(output + bytesRead, src, chunk);
+        ring_.consume(chunk);
+        bytesRead += chunk;
+    }
+
+    if (bytesRead < bytesToWrite) {
+        std::memset(output + bytesRead, 0, bytesToWrite - bytesRead);
+        if (playing_.load(std::memory_order_relaxed)) {
+            metrics.underruns.add();
+        }
+    }
+    if (bytesRead > 0 && ttfa_pending_.load(std::memory_order_relaxed) &&
+        ttfa_pending_.exchange(false, std::memory_order_relaxed)) {
+        metrics.ttfa_ns.record(callback_start - tune_started_ns_.load(std::memory_order_relaxed));
+        tune_timeline_.mark(TuneMark::FirstAudio, callback_start);
+    }
+
+    if (bytesRead > 0) {
+        float volume = volume_.load();
+        if (volume <= 0.99f) {
+            apply_volume(reinterpret_cast<int16_t*>(output), bytesRead / 2, volume);
+        }
+    }
+
+    if (analyzer_ && bytesRead > 0) {
+        const int16_t* samples = reinterpret_cast<const int16_t*>(output);
+        analyzer_->push_samples(samples, bytesRead / bytesPerFrame);
+    }
+
+    uint64_t callback_end = clock.now_ns();
+    metrics.callbacks.add();
+    metrics.callback_ns.record(callback_end - callback_start);
+    if ((callback_end - callback_start) * sample_rate > uint64_t(frames) * 1000000000ull) {
+        metrics.deadline_misses.add();
+    }
+    callback_monitor_.record(callback_start, callback_end, frames, sample_rate);
+}
+
+void Player::report_error(const std::string& message) {
+    if (callbacks_.on_error) {
+        callbacks_.on_error(message);
+    }
+}
+
+// Emit a MetadataEvent if FFmpeg flagged a metadata update since the
+// last call. For ICY streams the demuxer copies each new metadata block
+// into fmt_ctx->metadata and raises AVFMT_EVENT_FLAG_METADATA_UPDATED
+// inside av_read_frame, so checking the flags right after every read
+// catches a change at the packet that carried it. force re-reads the
+// dictionaries regardless (used once after opening the stream).
+void Player::emit_metadata_changes(AVFormatContext* fmt_ctx, int audio_stream_idx, const AVPacket* packet, bool force) {
+    AVStream* stream = audio_stream_idx >= 0 ? fmt_ctx->streams[audio_stream_idx] : nullptr;
+    bool updated = (fmt_ctx->event_flags & AVFMT_EVENT_FLAG_METADATA_UPDATED) ||
+        (stream && (stream->event_flags & AVSTREAM_EVENT_FLAG_METADATA_UPDATED));
+    if (!updated && !force) {
+        return;
+    }
+    fmt_ctx->event_flags &= ~AVFMT_EVENT_FLAG_METADATA_UPDATED;
+    if (stream) {
+        stream->event_flags &= ~AVSTREAM_EVENT_FLAG_METADATA_UPDATED;
+    }
+
+    auto check_metadata = [&](const char* key) -> const char* {
+        AVDictionaryEntry* t = nullptr;
+        if (stream) {
+            t = av_dict_get(stream->metadata, key, nullptr, 0);
+        }
+        if (!t) {
+            t = av_dict_get(fmt_ctx->metadata, key, nullptr, 0);
+        }
+        return (t && t->value) ? t->value : nullptr;
+    };
+
+    // Stream title (e.g., "a-ha - The Sun Always Shines on T.V.")
+    const char* title = check_metadata("StreamTitle");
+    const char* genre = check_metadata("icy-genre");
+    if (!genre) {
+        genre = check_metadata("cy-genre");
+    }
+
+    bool changed = false;
+    if (title && last_title_ != title) {
+        last_title_ = title;
+        changed = true;
+    }
+    if (genre && last_genre_ != genre) {
+        last_genre_ = genre;
+        changed = true;
+    }
+    if (!changed) {
+        return;
+    }
+
+    MetadataEvent event;
+    event.title = last_title_;
+    event.genre = last_genre_;
+    if (packet) {
+        event.byte_offset = packet->pos >= 0 ? packet->pos : avio_tell(fmt_ctx->pb);
+        if (stream && packet->pts != AV_NOPTS_VALUE) {
+            event.pts_us = av_rescale_q(packet->pts, stream->time_base, AVRational{1, 1000000});
+        }
+    } else if (fmt_ctx->pb) {
+        event.byte_offset = avio_tell(fmt_ctx->pb);
+    }
+    // Tag with the ring position of the first byte of audio decoded after
+    // this point, so the UI shows it when that audio is actually heard
+    metadata_events_.push(ring_.write_position(), std::move(event));
+}
+
+bool Player::play_stream(const std::string& url) {
+    // Playlist stations: open the listed streams directly instead of
+    // letting FFmpeg fetch the playlist on every tune
+    std::vector<std::string> candidates;
+    if (playlist_kind_for_url(url) != PlaylistKind::None) {
+        candidates = engine_.playlist_resolver().resolve(url, &stop_requested_);
+    }
+    if (candidates.empty()) {
+        candidates.push_back(url);
+    }
+
+    StreamDecoder decoder;
+    decoder.set_record_dir(engine_.options().record_dir);
+    decoder.set_replay_speed(engine_.options().replay_speed);
+    bool opened = false;
+    {
+        // Connection milestones come from FFmpeg's log while opening
+        ScopedNetworkCapture network_capture(tune_timeline_);
+        for (const auto& candidate : candidates) {
+            if (stop_requested_) {
+                return true;
+            }
+
+            AVDictionary* opts = nullptr;
+            av_dict_set(&opts, "icy", "1", 0);
+            opened = decoder.open_input(candidate, &opts);
+            av_dict_free(&opts);
+            if (opened) {
+                engine_metrics().stream_opens.add();
+                tune_timeline_.mark(TuneMark::InputOpened, pipeline_clock().now_ns());
+                if (const SessionIo* session = decoder.session()) {
+                    log_write(LogLevel::Info, "engine", "%s %s",
+                              session->replaying() ? "replaying" : "recording to",
+                              session->path().c_str());
+                }
+                break;
+            }
+            engine_metrics().stream_open_failures.add();
+            log_write(LogLevel::Warning, "engine", "%s", decoder.error().c_str());
+        }
+    }
+
+    if (!opened) {
+        report_error(decoder.error());
+        return false;
+    }
+
+    if (!decoder.find_stream_info()) {
+        log_write(LogLevel::Error, "engine", "%s", decoder.error().c_str());
+        report_error(decoder.error());
+        return false;
+    }
+    tune_timeline_.mark(TuneMark::StreamInfo, pipeline_clock().now_ns());
+
+    last_title_.clear();
+    last_genre_.clear();
+
+    if (!decoder.open_codec()) {
+        log_write(LogLevel::Error, "engine", "%s", decoder.error().c_str());
+        report_error(decoder.error());
+        return false;
+    }
+    tune_timeline_.mark(TuneMark::CodecOpened, pipeline_clock().now_ns());
+    AVFormatContext* fmt_ctx = decoder.format_context();
+    int audio_stream_idx = decoder.audio_stream_index();
+
+    // Metadata already present in the response headers / first block
+    emit_metadata_changes(fmt_ctx, audio_stream_idx, nullptr, true);
+
+    if (callbacks_.on_stream_format) {
+        std::string format_info = decoder.codec()->name;
+        if (!format_info.empty()) {
+            format_info[0] = std::toupper(format_info[0]);
+        }
+
+        int bitrate_kbps = decoder.codec_context()->bit_rate / 1000;
+        if (bitrate_kbps > 0) {
+            format_info = format_info + " " + std::to_string(bitrate_kbps) + "kbps";
+        }
+        callbacks_.on_stream_format(format_info, bitrate_kbps);
+    }
+
+    std::string sink_error;
+    if (!sink_->open(*this, sink_error)) {
+        log_write(LogLevel::Error, "engine", "%s", sink_error.c_str());
+        report_error(sink_error);
+        return false;
+    }
+    tune_timeline_.mark(TuneMark::DeviceOpened, pipeline_clock().now_ns());
+    sink_latency_bytes_ = sink_->latency_bytes();
+
+    ring_.consumer_clear();
+    constexpr size_t PREBUFFER_TARGET = 65536;
+
+    EngineMetrics& metrics = engine_metrics();
+    while (!stop_requested_ && ring_.read_available() < PREBUFFER_TARGET) {
+        if (!decoder.read_packet()) break;
+
+        emit_metadata_changes(fmt_ctx, audio_stream_idx, decoder.packet(), false);
+
+        if (decoder.is_audio_packet() && !decoder.decode_packet(ring_, stop_requested_)) {
+            log_write(LogLevel::Warning, "engine", "%s", decoder.error().c_str());
+        }
+        decoder.unref_packet();
+
+        size_t filled = ring_.read_available();
+        metrics.ring_fill_bytes.set(static_cast<double>(filled));
+        int percent = static_cast<int>((filled * 100) / ByteRingbuffer::BUFFER_SIZE);
+        if (percent > 100) percent = 100;
+        pending_buffer_percent_ = percent;
+    }
+
+    if (stop_requested_) {
+        sink_->close();
+        return true;
+    }
+
+    tune_timeline_.mark(TuneMark::Prebuffered, pipeline_clock().now_ns());
+
+    if (!sink_->start(sink_error)) {
+        log_write(LogLevel::Error, "engine", "%s", sink_error.c_str());
+        report_error(sink_error);
+        sink_->close();
+        return false;
+    }
+
+    tune_timeline_.mark(TuneMark::DeviceStarted, pipeline_clock().now_ns());
+    input_bytes_ = 0;
+    uint64_t last_buffer_update_ns = pipeline_clock().now_ns();
+    int old_buffer_percent = 0;
+    while (!stop_requested_) {
+        if (!decoder.read_packet()) {
+            if (!stop_requested_) {
+                log_write(LogLevel::Warning, "engine", "%s", decoder.error().c_str());
+                report_error(decoder.error());
+            }
+            break;
+        }
+
+        input_bytes_.fetch_add(decoder.packet()->size, std::memory_order_relaxed);
+        emit_metadata_changes(fmt_ctx, audio_stream_idx, decoder.packet(), false);
+
+        if (decoder.is_audio_packet()) {
+            if (!decoder.decode_packet(ring_, stop_requested_)) {
+                log_write(LogLevel::Warning, "engine", "%s", decoder.error().c_str());
+                decoder.unref_packet();
+                continue;
+            }
+            metrics.ring_fill_bytes.set(static_cast<double>(ring_.read_available()));
+
+            uint64_t now_buffer_ns = pipeline_clock().now_ns();
+            if (now_buffer_ns - last_buffer_update_ns >= 1'000'000'000) {
+                size_t filled = ring_.read_available();
+                int percent = static_cast<int>((filled * 100) / ByteRingbuffer::BUFFER_SIZE);
+                if (percent > 100) percent = 100;
+                if (old_buffer_percent != percent) {
+                    pending_buffer_percent_ = percent;
+                    old_buffer_percent = percent;
+                }
+                last_buffer_update_ns = now_buffer_ns;
+            }
+        }
+        decoder.unref_packet();
+    }
+
+    sink_->close();
+    decoder.close();
+
+    ring_.consumer_clear();
+    return true;
+}
@@ -0,0 +1,164 @@
+#ifndef ENGINE_HPP
+#define ENGINE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "audio_analyzer.hpp"
+#include "audio_sink.hpp"
+#include "byte_ringbuffer.hpp"
+#include "callback_monitor.hpp"
+#include "metadata_events.hpp"
+#include "playlist_resolver.hpp"
+#include "tune_timeline.hpp"
+
+struct AVFormatContext;
+struct AVPacket;
+
+// The playback engine as a library (webradio_core). An Engine holds what
+// its players share: the playlist cache, the recording options and the
+// routing of FFmpeg's log. Each Player is one station pipeline (playback
+// thread, decoder, ring buffer, sink, analyzer) with state of its own, so
+// several can run in one process. The TUI and --daemon are both clients.
+//
+// A player's play(), stop() and take_*()/release_metadata() calls belong
+// to one controlling thread (a UI loop or a control thread). The decoder
+// runs on the player's playback thread and render() on the sink's.
+// engine_metrics() stays process-wide and counts for all players.
+
+struct EngineOptions {
+    std::filesystem::path record_dir;   // record every stream here (--record)
+    double replay_speed = 1.0;          // pacing of replay: URLs
+};
+
+// Called on the playback thread
+struct PlayerCallbacks {
+    // Codec and nominal bitrate, once the stream decodes ("Mp3 128kbps")
+    std::function<void(const std::string& format, int kbps)> on_stream_format;
+    // The stream failed to open or stopped with an error
+    std::function<void(const std::string& message)> on_error;
+};
+
+class Engine;
+
+class Player {
+public:
+    Player(Engine& engine, std::unique_ptr<AudioSink> sink);
+    ~Player();
+
+    Player(const Player&) = delete;
+    Player& operator=(const Player&) = delete;
+
+    // Set while stopped
+    void set_callbacks(PlayerCallbacks callbacks) { callbacks_ = std::move(callbacks); }
+    void set_analyzer(AudioAnalyzer* analyzer) { analyzer_ = analyzer; }
+
+    // Stops the current stream and tunes url on the playback thread
+    void play(const std::string& url, const std::string& station_name);
+    void stop();
+
+    bool is_playing() const { return playing_.load(); }
+    const std::string& station_name() const { return station_name_; }
+
+    // 0..1, applied in render()
+    void set_volume(float volume) { volume_.store(volume); }
+    float volume() const { return volume_.load(); }
+
+    // Ring buffer position that is audible now: what render() has consumed,
+    // minus what is still queued in the sink
+    size_t playout_position() const {
+        return ring_.read_position() - sink_latency_bytes_.load(std::memory_order_relaxed);
+    }
+
+    // Decoded audio waiting in the ring for render()
+    size_t buffered_bytes() const { return ring_.read_available(); }
+
+    // Titles are handed to fn once the audio they arrived with is audible
+    template <typename Fn>
+    size_t release_metadata(Fn&& fn) {
+        return metadata_events_.release(playout_position(), std::forward<Fn>(fn));
+    }
+
+    // Returns true once per play/stop, and when the stream fails or ends,
+    // with the new state
+    bool take_state_change(bool& playing);
+    // Ring fill in percent since the last call, or -1 if unchanged
+    int take_buffer_percent() { return pending_buffer_percent_.exchange(-1); }
+    // Compressed input bytes read since the last call
+    uint64_t take_input_bytes() { return input_bytes_.exchange(0, std::memory_order_relaxed); }
+
+    TuneTimeline& tune_timeline() { return tune_timeline_; }
+    CallbackMonitor& callback_monitor() { return callback_monitor_; }
+
+    // Sink thread: fill output with frames of PCM from the ring (silence
+    // when it runs dry), apply volume and feed the analyzer
+    void render(uint8_t* output, uint32_t frames, uint32_t sample_rate);
+
+private:
+    bool play_stream(const std::string& url);
+    void emit_metadata_changes(AVFormatContext* fmt_ctx, int audio_stream_idx, const AVPacket* packet, bool force);
+    void report_error(const std::string& message);
+
+    Engine& engine_;
+    std::unique_ptr<AudioSink> sink_;
+    AudioAnalyzer* analyzer_ = nullptr;
+    PlayerCallbacks callbacks_;
+
+    std::thread playback_thread_;
+    std::atomic<bool> stop_requested_{false};
+    std::atomic<bool> playing_{false};
+    std::atomic<float> volume_{1.0f};
+    std::string current_url_;
+    std::string station_name_;
+
+    ByteRingbuffer ring_;
+    std::atomic<size_t> sink_latency_bytes_{0};
+    MetadataEventQueue metadata_events_;
+    std::string last_title_;    // last metadata emitted (playback thread only)
+    std::string last_genre_;
+
+    std::atomic<int> pending_buffer_percent_{-1};
+    std::atomic<bool> pending_playing_state_{false};
+    std::atomic<bool> has_playing_state_update_{false};
+    std::atomic<uint64_t> input_bytes_{0};
+
+    // Time to first audio: set by play(), consumed by the first render()
+    // that hands stream audio to the sink
+    std::atomic<uint64_t> tune_started_ns_{0};
+    std::atomic<bool> ttfa_pending_{false};
+    TuneTimeline tune_timeline_;
+    CallbackMonitor callback_monitor_;
+};
+
+class Engine {
+public:
+    // Installs the FFmpeg log callback: FFmpeg messages go to the async
+    // log, and connection milestones to the tuning player's timeline
+    explicit Engine(EngineOptions options = EngineOptions());
+    ~Engine();
+
+    Engine(const Engine&) = delete;
+    Engine& operator=(const Engine&) = delete;
+
+    // Players must be destroyed before their engine
+    std::unique_ptr<Player> create_player(std::unique_ptr<AudioSink> sink);
+
+    PlaylistResolver& playlist_resolver() { return playlist_resolver_; }
+    const EngineOptions& options() const { return options_; }
+
+    // Stops background work (playlist fetches); players first
+    void stop();
+
+private:
+    EngineOptions options_;
+    PlaylistResolver playlist_resolver_;
+};
+
+#endif // ENGINE_HPP
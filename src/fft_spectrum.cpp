@@ -1,14 +1,12 @@
 #include "fft_spectrum.hpp"
+#include "dsp_kernels.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
 #include <algorithm>
 #include <chrono>
 #include <cmath>
 #include <cstring>
 
-#ifdef _MSC_VER
-	#include <intrin.h>
-#else
-	#include <emmintrin.h>  // SSE2
-#endif
 
 // Separate attack (rising) and decay (falling) factors like cava
 // Attack: how fast bars rise (lower = faster rise)
@@ -20,112 +18,28 @@ static constexpr float DECAY_FACTOR = 0.85f;    // Slow fall
 static constexpr float MIN_FREQ = 30.0f;   // Hz - lower for better bass response
 static constexpr float MAX_FREQ = 16000.0f; // Hz
 
-#ifdef WEBRADIO_USE_SSE2
-void FFTSpectrum::SampleBuffer::push_mono(const int16_t* stereo, size_t frames) {
-	size_t write = write_pos.load(std::memory_order_relaxed);
-	size_t read = read_pos.load(std::memory_order_acquire);
-
-	// SSE2 optimized version - process 4 frames at a time
-	const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
-	const __m128 half = _mm_set1_ps(0.5f);
-
-	size_t i = 0;
-
-	// Process 4 frames at a time with SSE2
-	for (; i + 3 < frames; i += 4) {
-		// Load 8 int16 samples (4 stereo frames: L0 R0 L1 R1 L2 R2 L3 R3)
-		__m128i samples_i16 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&stereo[i * 2]));
-
-		// Unpack lower 4 int16 to int32 (L0 R0 L1 R1)
-		__m128i lower_i32 = _mm_unpacklo_epi16(samples_i16, _mm_srai_epi16(samples_i16, 15));
-		// Unpack upper 4 int16 to int32 (L2 R2 L3 R3)
-		__m128i upper_i32 = _mm_unpackhi_epi16(samples_i16, _mm_srai_epi16(samples_i16, 15));
-
-		// Convert to float
-		__m128 lower_f = _mm_cvtepi32_ps(lower_i32);  // L0 R0 L1 R1
-		__m128 upper_f = _mm_cvtepi32_ps(upper_i32);  // L2 R2 L3 R3
-
-		// Scale to -1.0 to 1.0 range
-		lower_f = _mm_mul_ps(lower_f, scale);
-		upper_f = _mm_mul_ps(upper_f, scale);
-
-		// Shuffle to separate left and right channels
-		// lower: L0 R0 L1 R1 -> L0 L1 R0 R1
-		// upper: L2 R2 L3 R3 -> L2 L3 R2 R3
-		__m128 lower_shuffled = _mm_shuffle_ps(lower_f, lower_f, _MM_SHUFFLE(3, 1, 2, 0));
-		__m128 upper_shuffled = _mm_shuffle_ps(upper_f, upper_f, _MM_SHUFFLE(3, 1, 2, 0));
-
-		// Combine to get all left and all right channels
-		// left_channels: L0 L1 L2 L3
-		__m128 left_channels = _mm_shuffle_ps(lower_shuffled, upper_shuffled, _MM_SHUFFLE(2, 0, 2, 0));
-		// right_channels: R0 R1 R2 R3
-		__m128 right_channels = _mm_shuffle_ps(lower_shuffled, upper_shuffled, _MM_SHUFFLE(3, 1, 3, 1));
-
-		// Average left and right to get mono
-		__m128 sum = _mm_add_ps(left_channels, right_channels);
-		__m128 mono = _mm_mul_ps(sum, half);
-
-		// Store mono samples to ring buffer
-		alignas(16) float mono_samples[4];
-		_mm_store_ps(mono_samples, mono);
-
-		for (int j = 0; j < 4; ++j) {
-			samples[write] = mono_samples[j];
-			write = (write + 1) & SampleBuffer::MASK;
-
-			// If buffer is full, advance read position (overwrite oldest)
-			if (write == read) {
-				read = (read + 1) & SampleBuffer::MASK;
-			}
-		}
-	}
-
-	// Process remaining frames with scalar code
-	for (; i < frames; ++i) {
-		// Convert stereo s16 to mono float (-1.0 to 1.0)
-		float left = stereo[i * 2] / 32768.0f;
-		float right = stereo[i * 2 + 1] / 32768.0f;
-		float mono = (left + right) * 0.5f;
-
-		samples[write] = mono;
-		write = (write + 1) & SampleBuffer::MASK;
-
-		// If buffer is full, advance read position (overwrite oldest)
-		if (write == read) {
-			read = (read + 1) & SampleBuffer::MASK;
-		}
-	}
-
-	read_pos.store(read, std::memory_order_relaxed);
-	write_pos.store(write, std::memory_order_release);
-}
-
-#else
-
 void FFTSpectrum::SampleBuffer::push_mono(const int16_t* stereo, size_t frames) {
     size_t write = write_pos.load(std::memory_order_relaxed);
     size_t read = read_pos.load(std::memory_order_acquire);
 
-    for (size_t i = 0; i < frames; ++i) {
-        // Convert stereo s16 to mono float (-1.0 to 1.0)
-        float left = stereo[i * 2] / 32768.0f;
-        float right = stereo[i * 2 + 1] / 32768.0f;
-        float mono = (left + right) * 0.5f;
-        
-        samples[write] = mono;
-        
-        write = (write + 1) & SampleBuffer::MASK;
-        
-        // If buffer is full, advance read position (overwrite oldest)
-        if (write == read) {
-            read = (read + 1) & SampleBuffer::MASK;
-        }
+    // Only the newest SIZE - 1 samples can be kept
+    if (frames > MASK) {
+        stereo += (frames - MASK) * 2;
+        frames = MASK;
     }
+    // Convert straight into the ring, in up to two contiguous pieces
+    size_t first = std::min(frames, SIZE - write);
+    stereo_to_mono(stereo, &samples[write], first);
+    stereo_to_mono(stereo + first * 2, &samples[0], frames - first);
+
+    // If buffer is full, advance read position (overwrite oldest)
+    size_t used = std::min(((write - read) & MASK) + frames, MASK);
+    write = (write + frames) & MASK;
+    read = (write - used) & MASK;
 
     read_pos.store(read, std::memory_order_relaxed);
     write_pos.store(write, std::memory_order_release);
 }
-#endif
 
 size_t FFTSpectrum::SampleBuffer::available() const {
     size_t write = write_pos.load(std::memory_order_acquire);
@@ -156,9 +70,7 @@ FFTSpectrum::FFTSpectrum()
     , fft_imag_(FFT_SIZE / 2 + 1)
     , fft_work_real_(FFT_SIZE)
     , fft_work_imag_(FFT_SIZE)
-    , bit_reverse_(FFT_SIZE)
-    , twiddle_real_(FFT_SIZE / 2)
-    , twiddle_imag_(FFT_SIZE / 2)
+    , fft_tables_(FFT_SIZE)
     , smoothed_magnitudes_(NUM_BARS, 0.0f)
     , bar_peaks_(NUM_BARS, MIN_PEAK)
     , window_(FFT_SIZE)
@@ -166,7 +78,6 @@ FFTSpectrum::FFTSpectrum()
 {
     init_window();
     init_bar_ranges();
-    init_fft_tables();
     spectrum_data_.updated.store(false);
 }
 
@@ -231,65 +142,8 @@ void FFTSpectrum::init_bar_ranges() {
     }
 }
 
-void FFTSpectrum::init_fft_tables() {
-    int bits = 0;
-    while ((1 << bits) < FFT_SIZE) {
-        ++bits;
-    }
-
-    for (size_t i = 0; i < FFT_SIZE; ++i) {
-        size_t x = i;
-        size_t r = 0;
-        for (int b = 0; b < bits; ++b) {
-            r = (r << 1) | (x & 1);
-            x >>= 1;
-        }
-        bit_reverse_[i] = r;
-    }
-
-    for (size_t k = 0; k < FFT_SIZE / 2; ++k) {
-        float angle = -2.0f * static_cast<float>(M_PI) * static_cast<float>(k) / static_cast<float>(FFT_SIZE);
-        twiddle_real_[k] = std::cos(angle);
-        twiddle_imag_[k] = std::sin(angle);
-    }
-}
-
 void FFTSpectrum::fft_inplace() {
-    for (size_t i = 0; i < FFT_SIZE; ++i) {
-        size_t j = bit_reverse_[i];
-        fft_work_real_[i] = fft_input_[j];
-        fft_work_imag_[i] = 0.0f;
-    }
-
-    for (size_t len = 2; len <= FFT_SIZE; len <<= 1) {
-        size_t half = len >> 1;
-        size_t stride = FFT_SIZE / len;
-
-        for (size_t start = 0; start < FFT_SIZE; start += len) {
-            size_t tw = 0;
-            for (size_t i = 0; i < half; ++i, tw += stride) {
-                size_t a = start + i;
-                size_t b = a + half;
-
-                float wr = twiddle_real_[tw];
-                float wi = twiddle_imag_[tw];
-
-                float br = fft_work_real_[b];
-                float bi = fft_work_imag_[b];
-
-                float tr = wr * br - wi * bi;
-                float ti = wr * bi + wi * br;
-
-                float ar = fft_work_real_[a];
-                float ai = fft_work_imag_[a];
-
-                fft_work_real_[a] = ar + tr;
-                fft_work_imag_[a] = ai + ti;
-                fft_work_real_[b] = ar - tr;
-                fft_work_imag_[b] = ai - ti;
-            }
-        }
-    }
+    fft_radix2(fft_tables_, fft_input_.data(), fft_work_real_.data(), fft_work_imag_.data());
 
     constexpr float scale = 1.0f / static_cast<float>(FFT_SIZE);
     for (size_t k = 0; k <= FFT_SIZE / 2; ++k) {
@@ -399,13 +253,24 @@ void FFTSpectrum::process_samples()
 		sample_buffer_.read_block(fft_input_.data(), FFT_SIZE);
 		//sample_buffer_mutex.unlock();
 
-		// Read block of samples
-        compute_fft();
-        update_spectrum();
+        analyze_input();
         last_update = now;
     }
 }
 
+void FFTSpectrum::analyze(const float* block) {
+    std::copy(block, block + FFT_SIZE, fft_input_.begin());
+    analyze_input();
+}
+
+void FFTSpectrum::analyze_input() {
+    TRACE_SCOPE("fft");
+    uint64_t start_ns = metrics_now_ns();
+    compute_fft();
+    update_spectrum();
+    engine_metrics().fft_ns.record(metrics_now_ns() - start_ns);
+}
+
 void FFTSpectrum::get_spectrum(std::array<float, NUM_BARS>& out_bars, bool& out_updated) {
     // Copy current data
     for (int i = 0; i < NUM_BARS; ++i) {
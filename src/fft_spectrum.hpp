@@ -8,10 +8,13 @@
 #include <vector>
 #include <mutex>	
 
+#include "audio_analyzer.hpp"
+#include "dsp_kernels.hpp"
+
 // Simple FFT implementation using DFT (no external dependencies)
 // Optimized for real-time audio visualization
 
-class FFTSpectrum {
+class FFTSpectrum : public AudioAnalyzer {
 public:
     static constexpr int NUM_BARS = 16;
     static constexpr int FFT_SIZE = 2048;
@@ -24,12 +27,17 @@ public:
     };
 
     FFTSpectrum();
-    ~FFTSpectrum();
+    ~FFTSpectrum() override;
     
     // Called from audio callback thread - lock-free
- 	void push_samples(const int16_t* stereo_samples, size_t frame_count);
+ 	void push_samples(const int16_t* stereo_samples, size_t frame_count) override;
  
 	void process_samples();
+
+    // One analysis step (window, FFT, bars) on FFT_SIZE mono samples, as
+    // process_samples() runs it; lets webradio-kernels-bench time it
+    // without the update pacing
+    void analyze(const float* block);
     
     // Called from main thread to get latest spectrum
     void get_spectrum(std::array<float, NUM_BARS>& out_bars, bool& out_updated);
@@ -60,9 +68,7 @@ private:
     std::vector<float> fft_imag_;
     std::vector<float> fft_work_real_;
     std::vector<float> fft_work_imag_;
-    std::vector<size_t> bit_reverse_;
-    std::vector<float> twiddle_real_;
-    std::vector<float> twiddle_imag_;
+    FftTables fft_tables_;
     std::vector<float> smoothed_magnitudes_;
     
     // Autogain: track recent peaks per bar for normalization
@@ -80,8 +86,8 @@ private:
     void update_spectrum();
     void init_window();
     void init_bar_ranges();
-    void init_fft_tables();
     void fft_inplace();
+    void analyze_input();
     
 };
 
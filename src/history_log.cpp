@@ -0,0 +1,637 @@
+#include "history_log.hpp"
+#include "app_paths.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr char LOG_MAGIC[8] = {'W', 'R', 'H', 'I', 'S', 'T', '0', '1'};
+constexpr char HEAP_MAGIC[8] = {'W', 'R', 'H', 'S', 'T', 'R', '0', '1'};
+constexpr uint32_t FORMAT_VERSION = 1;
+constexpr size_t INITIAL_LOG_BYTES = 64 * 1024;
+constexpr size_t INITIAL_HEAP_BYTES = 64 * 1024;
+constexpr auto LOCK_RETRY_INTERVAL = std::chrono::milliseconds(50);
+
+struct LogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t count;
+    uint64_t reserved;
+};
+
+struct HeapHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t used;      // bytes in use, including this header
+    uint64_t reserved2;
+};
+
+static_assert(sizeof(LogHeader) == 32 && sizeof(HeapHeader) == 32);
+
+uint64_t fnv1a(std::string_view s) {
+    uint64_t h = 1469598103934665603ULL;
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// Lowercase ASCII letters/digits; UTF-8 bytes are kept as word characters
+template <typename Fn>
+void for_each_token(std::string_view text, Fn&& fn) {
+    std::string token;
+    for (size_t i = 0; i <= text.size(); ++i) {
+        unsigned char c = i < text.size() ? static_cast<unsigned char>(text[i]) : 0;
+        if (c >= 0x80 || std::isalnum(c)) {
+            token.push_back(static_cast<char>(std::tolower(c)));
+        } else if (!token.empty()) {
+            fn(token);
+            token.clear();
+        }
+    }
+}
+
+// Exclusive flock() for a scope; nothing for the in-memory log
+class FileLock {
+public:
+    explicit FileLock(int fd) : fd_(fd) {
+#ifdef __linux__
+        while (fd_ >= 0 && ::flock(fd_, LOCK_EX) != 0 && errno == EINTR) {
+        }
+#endif
+    }
+    ~FileLock() {
+#ifdef __linux__
+        if (fd_ >= 0) {
+            ::flock(fd_, LOCK_UN);
+        }
+#endif
+    }
+
+    FileLock(const FileLock&) = delete;
+    FileLock& operator=(const FileLock&) = delete;
+
+private:
+    int fd_;
+};
+
+// Exclusive flock() if it is free. Errors other than contention count as
+// locked and the write goes ahead, as FileLock does.
+bool try_lock_file(int fd) {
+#ifdef __linux__
+    int rc;
+    while ((rc = ::flock(fd, LOCK_EX | LOCK_NB)) != 0 && errno == EINTR) {
+    }
+    return rc == 0 || errno != EWOULDBLOCK;
+#else
+    (void)fd;
+    return true;
+#endif
+}
+
+void unlock_file(int fd) {
+#ifdef __linux__
+    if (fd >= 0) {
+        ::flock(fd, LOCK_UN);
+    }
+#else
+    (void)fd;
+#endif
+}
+
+// YYYY-MM-DD, local midnight
+bool parse_date(std::string_view text, int64_t& out) {
+    std::tm tm{};
+    int year = 0, month = 0, day = 0;
+    std::string s(text);
+    if (std::sscanf(s.c_str(), "%4d-%2d-%2d", &year, &month, &day) != 3 || month < 1 || month > 12 || day < 1 || day > 31) {
+        return false;
+    }
+    tm.tm_year = year - 1900;
+    tm.tm_mon = month - 1;
+    tm.tm_mday = day;
+    tm.tm_isdst = -1;
+    std::time_t t = std::mktime(&tm);
+    if (t == static_cast<std::time_t>(-1)) {
+        return false;
+    }
+    out = static_cast<int64_t>(t);
+    return true;
+}
+
+} // namespace
+
+bool HistoryLog::Mapping::map_file(const std::filesystem::path& path, size_t min_size) {
+#ifdef __linux__
+    int file = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (file < 0) {
+        return false;
+    }
+    struct stat st {};
+    if (fstat(file, &st) != 0) {
+        ::close(file);
+        return false;
+    }
+    size_t size = std::max(static_cast<size_t>(st.st_size), min_size);
+    if (static_cast<size_t>(st.st_size) < size && ftruncate(file, static_cast<off_t>(size)) != 0) {
+        ::close(file);
+        return false;
+    }
+    void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    if (p == MAP_FAILED) {
+        ::close(file);
+        return false;
+    }
+    fd = file;
+    data = static_cast<char*>(p);
+    capacity = size;
+    return true;
+#else
+    (void)path;
+    (void)min_size;
+    return false;
+#endif
+}
+
+bool HistoryLog::Mapping::map_anonymous(size_t size) {
+#ifdef __linux__
+    void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+    data = static_cast<char*>(p);
+#else
+    data = static_cast<char*>(std::calloc(size, 1));
+    if (!data) {
+        return false;
+    }
+#endif
+    fd = -1;
+    capacity = size;
+    return true;
+}
+
+bool HistoryLog::Mapping::reserve(size_t size) {
+    if (size <= capacity) {
+        return true;
+    }
+    size_t new_capacity = std::max(capacity * 2, size);
+#ifdef __linux__
+    // capacity is the file size here (sync() ran under the lock), so this
+    // never truncates what another process wrote
+    if (fd >= 0 && ftruncate(fd, static_cast<off_t>(new_capacity)) != 0) {
+        return false;
+    }
+    void* p = ::mremap(data, capacity, new_capacity, MREMAP_MAYMOVE);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+    data = static_cast<char*>(p);
+#else
+    char* p = static_cast<char*>(std::realloc(data, new_capacity));
+    if (!p) {
+        return false;
+    }
+    std::memset(p + capacity, 0, new_capacity - capacity);
+    data = p;
+#endif
+    capacity = new_capacity;
+    return true;
+}
+
+bool HistoryLog::Mapping::sync() {
+#ifdef __linux__
+    if (fd < 0) {
+        return true;
+    }
+    struct stat st {};
+    if (fstat(fd, &st) != 0) {
+        return false;
+    }
+    auto size = static_cast<size_t>(st.st_size);
+    if (size <= capacity) {
+        return true;
+    }
+    void* p = ::mremap(data, capacity, size, MREMAP_MAYMOVE);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+    data = static_cast<char*>(p);
+    capacity = size;
+#endif
+    return true;
+}
+
+void HistoryLog::Mapping::unmap() {
+#ifdef __linux__
+    if (data) {
+        ::munmap(data, capacity);
+    }
+    if (fd >= 0) {
+        ::close(fd);
+    }
+#else
+    std::free(data);
+#endif
+    fd = -1;
+    data = nullptr;
+    capacity = 0;
+}
+
+HistoryLog::~HistoryLog() {
+    close();
+}
+
+void HistoryLog::close() {
+    if (lock_waiter_.joinable()) {
+        stop_lock_waiter_ = true;
+        lock_waiter_.join();
+    }
+    // Plays still waiting for the lock are worth a wait on the way out
+    if (lock_acquired_.exchange(false)) {
+        write_pending();
+        unlock_file(records_.fd);
+    } else if (!pending_.empty()) {
+        FileLock lock(records_.fd);
+        write_pending();
+    }
+
+    records_.unmap();
+    strings_.unmap();
+    count_ = 0;
+    heap_end_ = 0;
+    string_offsets_.clear();
+    interned_.clear();
+    tokens_.clear();
+    sorted_tokens_.clear();
+    tokens_sorted_ = true;
+    uses_.clear();
+}
+
+bool HistoryLog::open(const std::filesystem::path& dir) {
+    close();
+
+    if (ensure_directory(dir)
+        && records_.map_file(dir / "history.log", INITIAL_LOG_BYTES)
+        && strings_.map_file(dir / "history.strings", INITIAL_HEAP_BYTES)) {
+        // Another process may be creating the headers or appending
+        FileLock lock(records_.fd);
+        if (records_.sync() && strings_.sync() && validate()) {
+            return true;
+        }
+    }
+
+    // Unusable or foreign files are left untouched; keep history for this run only
+    close();
+    open_in_memory();
+    return false;
+}
+
+bool HistoryLog::open_in_memory() {
+    return records_.map_anonymous(INITIAL_LOG_BYTES)
+        && strings_.map_anonymous(INITIAL_HEAP_BYTES)
+        && validate();
+}
+
+bool HistoryLog::validate() {
+    auto* log = reinterpret_cast<LogHeader*>(records_.data);
+    auto* heap = reinterpret_cast<HeapHeader*>(strings_.data);
+
+    // New (zero-filled) files get fresh headers
+    if (log->version == 0 && log->count == 0) {
+        std::memcpy(log->magic, LOG_MAGIC, sizeof(LOG_MAGIC));
+        log->version = FORMAT_VERSION;
+        log->record_size = sizeof(Record);
+    }
+    if (heap->version == 0 && heap->used == 0) {
+        std::memcpy(heap->magic, HEAP_MAGIC, sizeof(HEAP_MAGIC));
+        heap->version = FORMAT_VERSION;
+        heap->used = sizeof(HeapHeader);
+    }
+
+    if (std::memcmp(log->magic, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0 || log->version != FORMAT_VERSION
+        || log->record_size != sizeof(Record)
+        || std::memcmp(heap->magic, HEAP_MAGIC, sizeof(HEAP_MAGIC)) != 0 || heap->version != FORMAT_VERSION
+        || heap->used < sizeof(HeapHeader) || heap->used > strings_.capacity) {
+        return false;
+    }
+
+    // A record past the end of the file can only come from a torn write
+    size_t max_records = (records_.capacity - sizeof(LogHeader)) / sizeof(Record);
+    if (log->count > max_records) {
+        log->count = max_records;
+    }
+
+    heap_end_ = sizeof(HeapHeader);
+    count_ = 0;
+    return catch_up();
+}
+
+bool HistoryLog::catch_up() {
+    if (!records_.sync() || !strings_.sync()) {
+        return false;
+    }
+    const auto* log = reinterpret_cast<const LogHeader*>(records_.data);
+    const auto* heap = reinterpret_cast<const HeapHeader*>(strings_.data);
+
+    size_t used = static_cast<size_t>(std::min<uint64_t>(heap->used, strings_.capacity));
+    while (heap_end_ + sizeof(uint32_t) <= used) {
+        uint32_t length;
+        std::memcpy(&length, strings_.data + heap_end_, sizeof(length));
+        if (heap_end_ + sizeof(uint32_t) + length > used) {
+            break;
+        }
+        auto id = static_cast<uint32_t>(string_offsets_.size());
+        string_offsets_.push_back(static_cast<uint32_t>(heap_end_));
+        interned_.emplace(fnv1a(string_at(id)), id);
+        index_string(id);
+        heap_end_ += sizeof(uint32_t) + length;
+    }
+
+    size_t max_records = (records_.capacity - sizeof(LogHeader)) / sizeof(Record);
+    size_t count = static_cast<size_t>(std::min<uint64_t>(log->count, max_records));
+    for (; count_ < count; ++count_) {
+        index_record(static_cast<uint32_t>(count_));
+    }
+    return true;
+}
+
+size_t HistoryLog::size() const {
+    return count_;
+}
+
+std::string_view HistoryLog::string_at(uint32_t id) const {
+    if (id >= string_offsets_.size()) {
+        return {};
+    }
+    const auto* heap = reinterpret_cast<const HeapHeader*>(strings_.data);
+    uint32_t offset = string_offsets_[id];
+    uint32_t length;
+    std::memcpy(&length, strings_.data + offset, sizeof(length));
+    if (offset + sizeof(uint32_t) + length > heap->used) {
+        return {};
+    }
+    return {strings_.data + offset + sizeof(uint32_t), length};
+}
+
+HistoryLog::Entry HistoryLog::entry(size_t index) const {
+    Record record;
+    std::memcpy(&record, records_.data + sizeof(LogHeader) + index * sizeof(Record), sizeof(record));
+    return {std::string(string_at(record.title)), std::string(string_at(record.station)), record.played_at};
+}
+
+int64_t HistoryLog::played_at(size_t index) const {
+    int64_t t;
+    std::memcpy(&t, records_.data + sizeof(LogHeader) + index * sizeof(Record) + offsetof(Record, played_at), sizeof(t));
+    return t;
+}
+
+size_t HistoryLog::lower_bound(int64_t t) const {
+    size_t lo = 0;
+    size_t hi = size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (played_at(mid) < t) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+uint32_t HistoryLog::intern(std::string_view s) {
+    uint64_t hash = fnv1a(s);
+    auto [first, last] = interned_.equal_range(hash);
+    for (auto it = first; it != last; ++it) {
+        if (string_at(it->second) == s) {
+            return it->second;
+        }
+    }
+
+    uint64_t offset = reinterpret_cast<const HeapHeader*>(strings_.data)->used;
+    uint64_t end = offset + sizeof(uint32_t) + s.size();
+    if (end > UINT32_MAX || string_offsets_.size() == UINT32_MAX || !strings_.reserve(static_cast<size_t>(end))) {
+        return UINT32_MAX;
+    }
+
+    auto length = static_cast<uint32_t>(s.size());
+    std::memcpy(strings_.data + offset, &length, sizeof(length));
+    std::memcpy(strings_.data + offset + sizeof(length), s.data(), s.size());
+    // Publish only after the bytes are in place
+    reinterpret_cast<HeapHeader*>(strings_.data)->used = end;
+
+    auto id = static_cast<uint32_t>(string_offsets_.size());
+    string_offsets_.push_back(static_cast<uint32_t>(offset));
+    interned_.emplace(hash, id);
+    index_string(id);
+    heap_end_ = end;
+    return id;
+}
+
+bool HistoryLog::append(std::string_view title, std::string_view station, int64_t played_at) {
+    if (!records_.data || !strings_.data) {
+        return false;
+    }
+    pending_.push_back({std::string(title), std::string(station), played_at});
+    return flush();
+}
+
+bool HistoryLog::flush() {
+    if (pending_.empty()) {
+        return true;
+    }
+    if (records_.fd >= 0) {
+        if (lock_waiter_.joinable()) {
+            if (!lock_acquired_.load(std::memory_order_acquire)) {
+                return true;
+            }
+            lock_waiter_.join();
+            lock_acquired_ = false;
+        } else if (!try_lock_file(records_.fd)) {
+            start_lock_waiter();
+            return true;
+        }
+    }
+    bool ok = write_pending();
+    unlock_file(records_.fd);
+    return ok;
+}
+
+void HistoryLog::start_lock_waiter() {
+    stop_lock_waiter_ = false;
+    lock_acquired_ = false;
+    int fd = records_.fd;
+    lock_waiter_ = std::thread([this, fd]() {
+        while (!stop_lock_waiter_.load(std::memory_order_relaxed)) {
+            if (try_lock_file(fd)) {
+                lock_acquired_.store(true, std::memory_order_release);
+                return;
+            }
+            std::this_thread::sleep_for(LOCK_RETRY_INTERVAL);
+        }
+    });
+}
+
+bool HistoryLog::write_pending() {
+    bool ok = catch_up();
+    for (const auto& play : pending_) {
+        ok = ok && write_record(play.title, play.station, play.played_at);
+    }
+    pending_.clear();
+    return ok;
+}
+
+bool HistoryLog::write_record(std::string_view title, std::string_view station, int64_t played_at) {
+    uint32_t title_id = intern(title);
+    uint32_t station_id = intern(station);
+    if (title_id == UINT32_MAX || station_id == UINT32_MAX) {
+        return false;
+    }
+
+    size_t count = size();
+    if (count == UINT32_MAX || !records_.reserve(sizeof(LogHeader) + (count + 1) * sizeof(Record))) {
+        return false;
+    }
+
+    // Keep records in time order even if the wall clock steps back
+    if (count > 0) {
+        played_at = std::max(played_at, this->played_at(count - 1));
+    }
+
+    Record record{played_at, title_id, station_id};
+    std::memcpy(records_.data + sizeof(LogHeader) + count * sizeof(Record), &record, sizeof(record));
+    reinterpret_cast<LogHeader*>(records_.data)->count = count + 1;
+
+    index_record(static_cast<uint32_t>(count));
+    count_ = count + 1;
+    return true;
+}
+
+void HistoryLog::index_string(uint32_t id) {
+    uses_.emplace_back();
+    for_each_token(string_at(id), [&](const std::string& token) {
+        auto [it, inserted] = tokens_.try_emplace(token);
+        if (inserted) {
+            tokens_sorted_ = false;
+        }
+        // Repeated words in one string are listed once
+        if (it->second.empty() || it->second.back() != id) {
+            it->second.push_back(id);
+        }
+    });
+}
+
+void HistoryLog::index_record(uint32_t record) {
+    Record r;
+    std::memcpy(&r, records_.data + sizeof(LogHeader) + size_t(record) * sizeof(Record), sizeof(r));
+    if (r.title < uses_.size()) {
+        uses_[r.title].push_back(record);
+    }
+    if (r.station != r.title && r.station < uses_.size()) {
+        uses_[r.station].push_back(record);
+    }
+}
+
+void HistoryLog::match_token(std::string_view token, std::vector<uint64_t>& bits) const {
+    if (!tokens_sorted_) {
+        sorted_tokens_.clear();
+        sorted_tokens_.reserve(tokens_.size());
+        for (const auto& entry : tokens_) {
+            sorted_tokens_.push_back(entry.first);
+        }
+        std::sort(sorted_tokens_.begin(), sorted_tokens_.end());
+        tokens_sorted_ = true;
+    }
+
+    std::fill(bits.begin(), bits.end(), 0);
+    auto it = std::lower_bound(sorted_tokens_.begin(), sorted_tokens_.end(), token);
+    for (; it != sorted_tokens_.end() && it->substr(0, token.size()) == token; ++it) {
+        for (uint32_t id : tokens_.find(std::string(*it))->second) {
+            for (uint32_t record : uses_[id]) {
+                bits[record >> 6] |= uint64_t(1) << (record & 63);
+            }
+        }
+    }
+}
+
+HistoryLog::SearchResult HistoryLog::search(std::string_view query) const {
+    SearchResult result;
+    size_t first = 0;
+    size_t last = size();
+    std::vector<std::string> terms;
+
+    size_t pos = 0;
+    while (pos < query.size()) {
+        size_t end = query.find(' ', pos);
+        if (end == std::string_view::npos) end = query.size();
+        std::string_view word = query.substr(pos, end - pos);
+        pos = end + 1;
+        if (word.empty()) continue;
+
+        bool after = word.rfind("after:", 0) == 0;
+        bool before = word.rfind("before:", 0) == 0;
+        if (after || before) {
+            int64_t t;
+            if (!parse_date(word.substr(after ? 6 : 7), t)) {
+                result.error = "Bad date (use YYYY-MM-DD): " + std::string(word);
+                return result;
+            }
+            if (after) {
+                first = std::max(first, lower_bound(t));
+            } else {
+                last = std::min(last, lower_bound(t));
+            }
+            continue;
+        }
+        for_each_token(word, [&](const std::string& token) { terms.push_back(token); });
+    }
+
+    if (first >= last) {
+        return result;
+    }
+
+    if (terms.empty()) {
+        result.records.reserve(last - first);
+        for (size_t i = last; i > first; --i) {
+            result.records.push_back(static_cast<uint32_t>(i - 1));
+        }
+        return result;
+    }
+
+    // One bit per record; terms are ANDed
+    size_t words = (size() + 63) / 64;
+    std::vector<uint64_t> matches(words, ~uint64_t(0));
+    std::vector<uint64_t> term_bits(words);
+    for (const auto& term : terms) {
+        match_token(term, term_bits);
+        for (size_t w = 0; w < words; ++w) {
+            matches[w] &= term_bits[w];
+        }
+    }
+
+    for (size_t i = last; i > first; --i) {
+        size_t record = i - 1;
+        if ((matches[record >> 6] >> (record & 63)) & 1) {
+            result.records.push_back(static_cast<uint32_t>(record));
+        }
+    }
+    return result;
+}
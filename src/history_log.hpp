@@ -0,0 +1,142 @@
+#ifndef HISTORY_LOG_HPP
+#define HISTORY_LOG_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Append-only song history kept in two memory-mapped files:
+//   history.log      header + fixed 16-byte records (time, title, station)
+//   history.strings  header + interned strings ([u32 length][bytes])
+// A title or station name is stored once however often it is played;
+// records refer to it by string id (its position in the heap).
+//
+// Records are appended in time order, so the record array is its own
+// time index (lower_bound() is a binary search). The search index maps
+// lowercase word tokens to the strings containing them and each string
+// to the records that use it; it is rebuilt when the log is opened and
+// kept up to date by append(). Queries combine per-term record bitsets.
+//
+// append() does no I/O beyond writing into the mappings: a hash lookup
+// per string, one record copy, and index pushes. Files grow by doubling.
+// If the files cannot be opened the log runs in anonymous memory.
+//
+// Several processes may share the files. Writes hold an exclusive flock()
+// on history.log and first index whatever the others appended since, so
+// strings are not stored twice and records stay in order; size() only
+// counts records this process has indexed. append() never waits for the
+// lock: while another process holds it, plays queue in memory and a
+// helper thread retries the lock; flush() writes them once it has it.
+//
+// Not thread-safe; used from the UI thread (the helper only takes the
+// lock). entry() copies the strings out, since a write may move the
+// mappings.
+class HistoryLog {
+public:
+    struct Entry {
+        std::string title;
+        std::string station;
+        int64_t played_at = 0;   // unix seconds
+    };
+
+    struct SearchResult {
+        std::vector<uint32_t> records;   // newest first
+        std::string error;
+    };
+
+    HistoryLog() = default;
+    ~HistoryLog();
+
+    HistoryLog(const HistoryLog&) = delete;
+    HistoryLog& operator=(const HistoryLog&) = delete;
+
+    // Open (or create) the log in dir. On failure the log stays usable
+    // in memory and false is returned.
+    bool open(const std::filesystem::path& dir);
+    void close();
+
+    // Writes the play, or queues it if another process holds the lock
+    bool append(std::string_view title, std::string_view station, int64_t played_at);
+    // Writes queued plays once the helper got the lock; call every tick
+    bool flush();
+    bool has_pending() const { return !pending_.empty(); }
+
+    size_t size() const;
+    Entry entry(size_t index) const;
+    bool persistent() const { return records_.fd >= 0; }
+
+    // First record played at or after t
+    size_t lower_bound(int64_t t) const;
+
+    // Words (AND) matched as prefixes of words in the title or station.
+    // after:YYYY-MM-DD and before:YYYY-MM-DD narrow the time range.
+    SearchResult search(std::string_view query) const;
+
+private:
+    struct Record {
+        int64_t played_at;
+        uint32_t title;     // string id
+        uint32_t station;
+    };
+    static_assert(sizeof(Record) == 16);
+
+    // Growable shared mapping of a file, or anonymous memory
+    struct Mapping {
+        int fd = -1;
+        char* data = nullptr;
+        size_t capacity = 0;
+
+        bool map_file(const std::filesystem::path& path, size_t min_size);
+        bool map_anonymous(size_t size);
+        bool reserve(size_t size);
+        // Follows the file if another process extended it
+        bool sync();
+        void unmap();
+    };
+
+    struct PendingEntry {
+        std::string title;
+        std::string station;
+        int64_t played_at;
+    };
+
+    bool open_in_memory();
+    bool validate();
+    // Indexes strings and records appended since the last call
+    bool catch_up();
+    void start_lock_waiter();
+    // Under the lock: catch up, then write pending_
+    bool write_pending();
+    bool write_record(std::string_view title, std::string_view station, int64_t played_at);
+    uint32_t intern(std::string_view s);   // UINT32_MAX if the heap is full
+    std::string_view string_at(uint32_t id) const;
+    int64_t played_at(size_t index) const;
+    void index_string(uint32_t id);
+    void index_record(uint32_t record);
+    void match_token(std::string_view token, std::vector<uint64_t>& bits) const;
+
+    Mapping records_;
+    Mapping strings_;
+    size_t count_ = 0;          // records indexed
+    size_t heap_end_ = 0;       // heap bytes indexed
+
+    std::vector<PendingEntry> pending_;     // plays waiting for the lock
+    std::thread lock_waiter_;
+    std::atomic<bool> lock_acquired_{false};
+    std::atomic<bool> stop_lock_waiter_{false};
+
+    std::vector<uint32_t> string_offsets_;                      // string id -> heap offset
+    std::unordered_multimap<uint64_t, uint32_t> interned_;      // hash -> string id
+    std::unordered_map<std::string, std::vector<uint32_t>> tokens_;  // token -> string ids
+    mutable std::vector<std::string_view> sorted_tokens_;       // keys of tokens_, for prefix search
+    mutable bool tokens_sorted_ = true;
+    std::vector<std::vector<uint32_t>> uses_;                   // string id -> records
+};
+
+#endif // HISTORY_LOG_HPP
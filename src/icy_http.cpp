@@ -0,0 +1,324 @@
+#include "icy_http.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+#ifndef WEBRADIO_VERSION
+#define WEBRADIO_VERSION "0.0.0"
+#endif
+
+namespace {
+
+constexpr size_t MAX_HEADER_BYTES = 16 * 1024;
+constexpr int MAX_REDIRECTS = 3;
+// A connection attempt gives way to the host's next address after this
+constexpr auto ADDRESS_TIMEOUT = std::chrono::seconds(5);
+
+NetReactor::Clock::duration time_left(NetReactor::Clock::time_point deadline) {
+    return std::max(NetReactor::Clock::duration::zero(), deadline - NetReactor::Clock::now());
+}
+
+} // namespace
+
+bool parse_url(const std::string& url, ParsedUrl& out) {
+    size_t scheme_end = url.find("://");
+    if (scheme_end == std::string::npos) return false;
+
+    std::string scheme = url.substr(0, scheme_end);
+    std::transform(scheme.begin(), scheme.end(), scheme.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (scheme == "https") {
+        out.tls = true;
+    } else if (scheme != "http") {
+        return false;
+    }
+
+    size_t host_start = scheme_end + 3;
+    size_t path_start = url.find_first_of("/?", host_start);
+    std::string authority = url.substr(host_start, path_start == std::string::npos ? std::string::npos : path_start - host_start);
+    out.path = path_start == std::string::npos ? "/" : url.substr(path_start);
+    if (out.path.front() == '?') out.path.insert(0, "/");
+
+    // Drop user:pass@
+    if (size_t at = authority.rfind('@'); at != std::string::npos) {
+        authority.erase(0, at + 1);
+    }
+
+    out.port = out.tls ? "443" : "80";
+    if (!authority.empty() && authority.front() == '[') {
+        size_t close = authority.find(']');
+        if (close == std::string::npos) return false;
+        out.host = authority.substr(1, close - 1);
+        if (close + 1 < authority.size() && authority[close + 1] == ':') {
+            out.port = authority.substr(close + 2);
+        }
+    } else if (size_t colon = authority.rfind(':'); colon != std::string::npos) {
+        out.host = authority.substr(0, colon);
+        out.port = authority.substr(colon + 1);
+    } else {
+        out.host = authority;
+    }
+    return !out.host.empty() && !out.port.empty();
+}
+
+std::string header_value(const std::string& lower_headers, const std::string& headers, const char* name) {
+    std::string needle = std::string("\n") + name + ":";
+    size_t pos = lower_headers.find(needle);
+    if (pos == std::string::npos) return {};
+    size_t begin = pos + needle.size();
+    size_t end = headers.find_first_of("\r\n", begin);
+    std::string value = headers.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+    size_t first = value.find_first_not_of(" \t");
+    size_t last = value.find_last_not_of(" \t");
+    return first == std::string::npos ? std::string{} : value.substr(first, last - first + 1);
+}
+
+int response_status(const std::string& headers) {
+    size_t space = headers.find(' ');
+    return space == std::string::npos ? 0 : std::atoi(headers.c_str() + space + 1);
+}
+
+std::string redirect_target(const std::string& location, const std::string& from_url) {
+    if (location.empty() || location.front() != '/') {
+        return location;
+    }
+    ParsedUrl current;
+    parse_url(from_url, current);
+    std::string host = current.host.find(':') == std::string::npos ? current.host : "[" + current.host + "]";
+    return std::string(current.tls ? "https://" : "http://") + host + ":" + current.port + location;
+}
+
+// StreamTitle='Artist - Title';StreamUrl='...';
+std::string parse_stream_title(const std::string& metadata) {
+    static constexpr std::string_view key = "StreamTitle='";
+    size_t begin = metadata.find(key);
+    if (begin == std::string::npos) return {};
+    begin += key.size();
+    // Titles may contain quotes; the field ends at "';"
+    size_t end = metadata.find("';", begin);
+    if (end == std::string::npos) {
+        end = metadata.rfind('\'');
+        if (end == std::string::npos || end < begin) end = metadata.find('\0', begin);
+    }
+    std::string title = metadata.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+    while (!title.empty() && (title.back() == '\0' || std::isspace(static_cast<unsigned char>(title.back())))) {
+        title.pop_back();
+    }
+    return title;
+}
+
+void IcyMetadataSplitter::reset(size_t metaint) {
+    metaint_ = metaint;
+    audio_left_ = metaint;
+    meta_left_ = 0;
+    have_length_ = false;
+    metadata_.clear();
+}
+
+void IcyMetadataSplitter::audio_read(size_t len) {
+    if (metaint_ > 0) {
+        audio_left_ -= std::min(len, audio_left_);
+    }
+}
+
+size_t IcyMetadataSplitter::metadata_wanted() const {
+    if (metaint_ == 0 || audio_left_ > 0) {
+        return 0;
+    }
+    return have_length_ ? meta_left_ : 1;
+}
+
+bool IcyMetadataSplitter::feed_metadata(const uint8_t* data, size_t len) {
+    bool complete = false;
+    while (len > 0 && metadata_wanted() > 0) {
+        if (!have_length_) {
+            // Length byte: the block is 16 times that
+            meta_left_ = static_cast<size_t>(*data) * 16;
+            have_length_ = true;
+            metadata_.clear();
+            ++data;
+            --len;
+        } else {
+            size_t take = std::min(meta_left_, len);
+            metadata_.append(reinterpret_cast<const char*>(data), take);
+            meta_left_ -= take;
+            data += take;
+            len -= take;
+            complete = meta_left_ == 0;
+        }
+        if (have_length_ && meta_left_ == 0) {
+            // Back to audio; an empty block (length 0) just means "no change"
+            have_length_ = false;
+            audio_left_ = metaint_;
+        }
+    }
+    return complete;
+}
+
+std::string icy_request(const ParsedUrl& url) {
+    return "GET " + url.path + " HTTP/1.0\r\n"
+           "Host: " + url.host + "\r\n"
+           "User-Agent: webradio/" WEBRADIO_VERSION "\r\n"
+           "Accept: */*\r\n"
+           "Icy-MetaData: 1\r\n"
+           "Connection: close\r\n\r\n";
+}
+
+ReactorCall<bool> open_icy_stream(NetReactor& reactor, NetSocket& socket, std::string url,
+                                  NetReactor::Clock::time_point deadline, int recv_buffer,
+                                  IcyResponse& response, std::string& error) {
+    for (int redirects = 0;; ++redirects) {
+        socket.close();
+        ParsedUrl parsed;
+        if (!parse_url(url, parsed)) {
+            error = "not an http(s) URL: " + url;
+            co_return false;
+        }
+        if (parsed.tls && !reactor.ssl_context()) {
+            error = "https needs OpenSSL";
+            co_return false;
+        }
+
+        std::vector<NetAddress> addrs = co_await reactor.resolve(parsed.host, parsed.port);
+        if (addrs.empty()) {
+            error = "cannot resolve " + parsed.host;
+            co_return false;
+        }
+        // Each address in turn; all but the last get ADDRESS_TIMEOUT
+        int err = 0;
+        bool connected = false;
+        for (size_t i = 0; i < addrs.size() && !connected; ++i) {
+            if (!socket.connect(addrs[i], recv_buffer)) {
+                err = errno;
+                continue;
+            }
+            NetReactor::Clock::duration timeout = time_left(deadline);
+            if (i + 1 < addrs.size()) {
+                timeout = std::min(timeout, NetReactor::Clock::duration(ADDRESS_TIMEOUT));
+            }
+            WaitResult r = co_await reactor.io(socket.fd(), EPOLLOUT, timeout);
+            if (r == WaitResult::Cancelled) {
+                error = "cancelled";
+                co_return false;
+            }
+            err = r == WaitResult::Timeout ? ETIMEDOUT : socket.connect_error();
+            connected = err == 0;
+            if (!connected && NetReactor::Clock::now() >= deadline) {
+                break;
+            }
+        }
+        if (!connected) {
+            socket.close();
+            error = "cannot connect to " + parsed.host + ": " + std::strerror(err);
+            co_return false;
+        }
+
+        if (parsed.tls) {
+            int handshake = socket.start_tls(reactor.ssl_context(), parsed.host) ? socket.handshake() : -1;
+            while (handshake == 0) {
+                WaitResult r = co_await reactor.io(socket.fd(), socket.want_read() ? EPOLLIN : EPOLLOUT,
+                                                   time_left(deadline));
+                if (r == WaitResult::Cancelled) {
+                    error = "cancelled";
+                    co_return false;
+                }
+                handshake = r == WaitResult::Timeout ? -1 : socket.handshake();
+            }
+            if (handshake != 1) {
+                socket.close();
+                error = "TLS handshake with " + parsed.host + " failed";
+                co_return false;
+            }
+        }
+
+        std::string request = icy_request(parsed);
+        size_t sent = 0;
+        while (sent < request.size()) {
+            long n = socket.write(request.data() + sent, request.size() - sent);
+            if (n > 0) {
+                sent += static_cast<size_t>(n);
+                continue;
+            }
+            if (n != NetSocket::IO_WOULD_BLOCK) {
+                break;
+            }
+            WaitResult r = co_await reactor.io(socket.fd(), EPOLLOUT, time_left(deadline));
+            if (r == WaitResult::Cancelled) {
+                error = "cancelled";
+                co_return false;
+            }
+            if (r == WaitResult::Timeout) {
+                break;
+            }
+        }
+        if (sent < request.size()) {
+            socket.close();
+            error = "cannot send the request to " + parsed.host;
+            co_return false;
+        }
+
+        // Response head; what follows it is the start of the body
+        std::string head;
+        size_t header_end = std::string::npos;
+        while (header_end == std::string::npos && head.size() <= MAX_HEADER_BYTES) {
+            size_t old_size = head.size();
+            head.resize(old_size + 2048);
+            long n = socket.read(head.data() + old_size, 2048);
+            head.resize(old_size + static_cast<size_t>(std::max(0L, n)));
+            if (n > 0) {
+                header_end = head.find("\r\n\r\n", old_size >= 3 ? old_size - 3 : 0);
+                continue;
+            }
+            if (n != NetSocket::IO_WOULD_BLOCK) {
+                break;
+            }
+            WaitResult r = co_await reactor.io(socket.fd(), EPOLLIN, time_left(deadline));
+            if (r == WaitResult::Cancelled) {
+                error = "cancelled";
+                co_return false;
+            }
+            if (r == WaitResult::Timeout) {
+                break;
+            }
+        }
+        if (header_end == std::string::npos) {
+            socket.close();
+            error = "no response from " + parsed.host;
+            co_return false;
+        }
+
+        std::string headers = head.substr(0, header_end + 2);
+        std::string lower = headers;
+        std::transform(lower.begin(), lower.end(), lower.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        int status = response_status(headers);
+        if (status == 301 || status == 302 || status == 303 || status == 307 || status == 308) {
+            std::string location = header_value(lower, headers, "location");
+            if (location.empty() || redirects == MAX_REDIRECTS) {
+                socket.close();
+                error = "bad redirect from " + parsed.host;
+                co_return false;
+            }
+            url = redirect_target(location, url);
+            continue;
+        }
+        if (status != 200) {
+            socket.close();
+            error = "HTTP status " + std::to_string(status) + " from " + parsed.host;
+            co_return false;
+        }
+        response.url = url;
+        response.metaint = static_cast<size_t>(
+            std::strtoul(header_value(lower, headers, "icy-metaint").c_str(), nullptr, 10));
+        response.body = head.substr(header_end + 4);
+        co_return true;
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef ICY_HTTP_HPP
+#define ICY_HTTP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "net_reactor.hpp"
+
+// Small pieces of HTTP/ICY shared by the clients that talk to stations
+// over their own sockets on a NetReactor (StationTitleWatcher, monitored
+// streams).
+
+struct ParsedUrl {
+    bool tls = false;
+    std::string host;
+    std::string port;
+    std::string path;
+};
+
+// http:// and https:// only; false for anything else
+bool parse_url(const std::string& url, ParsedUrl& out);
+
+// Value of header name (lowercase) in a response head, trimmed. lower_headers
+// is headers lowercased, so the lookup is case-insensitive.
+std::string header_value(const std::string& lower_headers, const std::string& headers, const char* name);
+
+// Status code of "HTTP/1.x 200 OK" or "ICY 200 OK", 0 if unparsable
+int response_status(const std::string& headers);
+
+// Location of a redirect, made absolute against the URL it came from
+std::string redirect_target(const std::string& location, const std::string& from_url);
+
+// StreamTitle of one ICY metadata block, empty if it has none
+std::string parse_stream_title(const std::string& metadata);
+
+// HTTP/1.0 GET with Icy-MetaData: 1; 1.0 so the body is never chunked
+std::string icy_request(const ParsedUrl& url);
+
+// A station's 200 response to icy_request
+struct IcyResponse {
+    std::string url;        // the URL that answered, after redirects
+    size_t metaint = 0;     // icy-metaint; 0: no inline metadata
+    std::string body;       // start of the body, read along with the head
+};
+
+// Opens an http(s) URL for a reactor task: resolves the host, connects to
+// each of its addresses in turn until one answers, does TLS for https
+// (false if the reactor has no SSL context), sends icy_request and reads
+// the response head, following up to 3 redirects. Gives up at deadline.
+// recv_buffer, if not 0, is the socket's SO_RCVBUF. True with socket
+// connected and response filled in; false with error set, also when the
+// task is cancelled.
+ReactorCall<bool> open_icy_stream(NetReactor& reactor, NetSocket& socket, std::string url,
+                                  NetReactor::Clock::time_point deadline, int recv_buffer,
+                                  IcyResponse& response, std::string& error);
+
+// Splits an ICY body (icy-metaint) into audio and metadata blocks, so the
+// audio can be read straight into its destination: read at most
+// audio_left() bytes as audio, then metadata_wanted() bytes into
+// feed_metadata(), and so on.
+class IcyMetadataSplitter {
+public:
+    // metaint 0: the body is all audio
+    void reset(size_t metaint);
+
+    // Audio bytes before the next metadata block; 0 while in one
+    size_t audio_left() const { return metaint_ == 0 ? SIZE_MAX : audio_left_; }
+    void audio_read(size_t len);
+
+    // Bytes still to read of the current block, its length byte included
+    size_t metadata_wanted() const;
+    // Returns true when data completed a non-empty block; its text is then
+    // in metadata()
+    bool feed_metadata(const uint8_t* data, size_t len);
+    const std::string& metadata() const { return metadata_; }
+
+private:
+    size_t metaint_ = 0;
+    size_t audio_left_ = 0;
+    size_t meta_left_ = 0;
+    bool have_length_ = false;
+    std::string metadata_;
+};
+
+#endif // ICY_HTTP_HPP
@@ -0,0 +1,20 @@
+#ifndef METADATA_EVENTS_HPP
+#define METADATA_EVENTS_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "playout_event_queue.hpp"
+
+// A stream metadata change, emitted once at the point FFmpeg parsed it
+struct MetadataEvent {
+    std::string title;
+    std::string genre;
+    int64_t byte_offset = -1;   // input byte position of the packet that carried it
+    int64_t pts_us = -1;        // that packet's PTS in microseconds, -1 if unknown
+};
+
+// Metadata events are released when the audio they belong to is heard
+using MetadataEventQueue = PlayoutEventQueue<MetadataEvent>;
+
+#endif // METADATA_EVENTS_HPP
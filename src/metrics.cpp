@@ -0,0 +1,197 @@
+#include "metrics.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+
+#include <nlohmann/json.hpp>
+
+namespace {
+
+// Bucket bounds (seconds) for exposed duration histograms
+constexpr double BUCKET_BOUNDS[] = {
+    0.00001, 0.000025, 0.00005, 0.0001, 0.00025, 0.0005,
+    0.001, 0.0025, 0.005, 0.01, 0.025, 0.05,
+    0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0,
+};
+
+std::string format_number(double v) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.9g", v);
+    return buf;
+}
+
+std::string escape_help(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '\\') out += "\\\\";
+        else if (c == '\n') out += "\\n";
+        else out += c;
+    }
+    return out;
+}
+
+} // namespace
+
+uint64_t Histogram::bucket_upper(size_t index) {
+    size_t shift = index / SUB_BUCKETS;
+    size_t sub = index % SUB_BUCKETS;
+    if (shift == 0) return index;
+    // Values whose top SUB_BUCKET_BITS + 1 bits are sub + SUB_BUCKETS
+    uint64_t base = static_cast<uint64_t>(sub + SUB_BUCKETS) << (shift - 1);
+    return base + (uint64_t(1) << (shift - 1)) - 1;
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+    Snapshot s;
+    s.buckets.resize(BUCKET_COUNT);
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        s.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+        s.count += s.buckets[i];
+    }
+    // Bucket counts are the source of truth; sum/max may be a few
+    // records ahead of them while the audio thread is writing
+    s.sum = sum_.load(std::memory_order_relaxed);
+    s.max = max_.load(std::memory_order_relaxed);
+    return s;
+}
+
+uint64_t Histogram::Snapshot::quantile(double q) const {
+    if (count == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(std::ceil(q * static_cast<double>(count)));
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            uint64_t upper = bucket_upper(i);
+            return upper < max ? upper : max;
+        }
+    }
+    return max;
+}
+
+uint64_t Histogram::Snapshot::count_at_or_below(uint64_t limit) const {
+    uint64_t total = 0;
+    for (size_t i = 0; i < buckets.size() && bucket_upper(i) <= limit; ++i) {
+        total += buckets[i];
+    }
+    return total;
+}
+
+Counter& MetricsRegistry::counter(const std::string& name, const std::string& help) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    counters_.emplace_back();
+    families_.push_back({name, help, Type::Counter, counters_.size() - 1});
+    return counters_.back();
+}
+
+Gauge& MetricsRegistry::gauge(const std::string& name, const std::string& help) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    gauges_.emplace_back();
+    families_.push_back({name, help, Type::Gauge, gauges_.size() - 1});
+    return gauges_.back();
+}
+
+Histogram& MetricsRegistry::histogram(const std::string& name, const std::string& help, double scale) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    histograms_.emplace_back();
+    families_.push_back({name, help, Type::Histogram, histograms_.size() - 1, scale});
+    return histograms_.back();
+}
+
+std::string MetricsRegistry::openmetrics() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string out;
+    for (const auto& f : families_) {
+        const char* type = f.type == Type::Counter ? "counter"
+                         : f.type == Type::Gauge ? "gauge" : "histogram";
+        out += "# TYPE " + f.name + " " + type + "\n";
+        out += "# HELP " + f.name + " " + escape_help(f.help) + "\n";
+        switch (f.type) {
+        case Type::Counter:
+            out += f.name + "_total " + std::to_string(counters_[f.index].value()) + "\n";
+            break;
+        case Type::Gauge:
+            out += f.name + " " + format_number(gauges_[f.index].value()) + "\n";
+            break;
+        case Type::Histogram: {
+            auto snap = histograms_[f.index].snapshot();
+            for (double bound : BUCKET_BOUNDS) {
+                auto limit = static_cast<uint64_t>(bound / f.scale);
+                out += f.name + "_bucket{le=\"" + format_number(bound) + "\"} "
+                     + std::to_string(snap.count_at_or_below(limit)) + "\n";
+            }
+            out += f.name + "_bucket{le=\"+Inf\"} " + std::to_string(snap.count) + "\n";
+            out += f.name + "_count " + std::to_string(snap.count) + "\n";
+            out += f.name + "_sum " + format_number(static_cast<double>(snap.sum) * f.scale) + "\n";
+            break;
+        }
+        }
+    }
+    out += "# EOF\n";
+    return out;
+}
+
+std::string MetricsRegistry::json() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    nlohmann::json metrics = nlohmann::json::object();
+    for (const auto& f : families_) {
+        switch (f.type) {
+        case Type::Counter:
+            metrics[f.name] = counters_[f.index].value();
+            break;
+        case Type::Gauge:
+            metrics[f.name] = gauges_[f.index].value();
+            break;
+        case Type::Histogram: {
+            auto snap = histograms_[f.index].snapshot();
+            auto scaled = [&](uint64_t v) { return static_cast<double>(v) * f.scale; };
+            metrics[f.name] = {
+                {"count", snap.count},
+                {"sum", scaled(snap.sum)},
+                {"p50", scaled(snap.quantile(0.50))},
+                {"p90", scaled(snap.quantile(0.90))},
+                {"p99", scaled(snap.quantile(0.99))},
+                {"max", scaled(snap.max)},
+            };
+            break;
+        }
+        }
+    }
+    nlohmann::json doc = {
+        {"timestamp", static_cast<int64_t>(std::time(nullptr))},
+        {"metrics", metrics},
+    };
+    return doc.dump(2);
+}
+
+MetricsRegistry& metrics_registry() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+EngineMetrics& engine_metrics() {
+    static EngineMetrics metrics = [] {
+        auto& r = metrics_registry();
+        return EngineMetrics{
+            r.counter("webradio_stream_bytes_in", "Compressed stream bytes read"),
+            r.counter("webradio_stream_packets", "Demuxed packets"),
+            r.counter("webradio_decoded_frames", "Decoded audio frames"),
+            r.histogram("webradio_decode_seconds", "Decode time per frame", 1e-9),
+            r.counter("webradio_pcm_bytes", "Decoded PCM bytes written to the playback ring"),
+            r.counter("webradio_callbacks", "Audio device callbacks"),
+            r.histogram("webradio_callback_seconds", "Audio callback duration", 1e-9),
+            r.counter("webradio_callback_deadline_misses", "Audio callbacks that took longer than their period"),
+            r.counter("webradio_underruns", "Callbacks that ran out of buffered audio"),
+            r.gauge("webradio_ring_fill_bytes", "Bytes buffered between decoder and device"),
+            r.counter("webradio_ring_full_waits", "Decoder waits for space in the playback ring"),
+            r.counter("webradio_stream_opens", "Streams opened"),
+            r.counter("webradio_stream_open_failures", "Failed stream open attempts"),
+            r.counter("webradio_reconnects", "Re-opens of the stream that was already playing"),
+            r.histogram("webradio_ttfa_seconds", "Time from tune request to first audio", 1e-9),
+            r.histogram("webradio_fft_seconds", "Spectrum analysis time per update", 1e-9),
+        };
+    }();
+    return metrics;
+}
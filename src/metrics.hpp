@@ -0,0 +1,149 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Process-wide metrics: counters, gauges and histograms that are cheap
+// enough to update from the audio callback. Updates are single relaxed
+// atomic operations (no locks, no allocation); only registration and
+// exposition take the registry mutex.
+
+inline uint64_t metrics_now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+class Counter {
+public:
+    void add(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+class Gauge {
+public:
+    void set(double v) { value_.store(v, std::memory_order_relaxed); }
+    double value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<double> value_{0.0};
+};
+
+// Log-linear histogram in the HdrHistogram layout: values below 64 get
+// exact buckets, above that each power of two is split into 32 linear
+// sub-buckets (about 3% relative error). Covers 0 .. 2^40 - 1, which is
+// ~18 minutes when recording nanoseconds; larger values are clamped.
+class Histogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 5;
+    static constexpr size_t SUB_BUCKETS = size_t(1) << SUB_BUCKET_BITS;
+    static constexpr int MAX_BITS = 40;
+    static constexpr size_t BUCKET_COUNT = (MAX_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+    static constexpr uint64_t MAX_VALUE = (uint64_t(1) << MAX_BITS) - 1;
+
+    struct Snapshot {
+        std::vector<uint64_t> buckets;
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+
+        // Upper bound of the bucket holding quantile q (0..1)
+        uint64_t quantile(double q) const;
+        // Values recorded in buckets that end at or below limit
+        uint64_t count_at_or_below(uint64_t limit) const;
+    };
+
+    void record(uint64_t value) {
+        if (value > MAX_VALUE) value = MAX_VALUE;
+        buckets_[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+        uint64_t seen = max_.load(std::memory_order_relaxed);
+        while (value > seen && !max_.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    Snapshot snapshot() const;
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+
+    static size_t bucket_index(uint64_t value) {
+        int msb = 63 - __builtin_clzll(value | 1);
+        int shift = msb > SUB_BUCKET_BITS ? msb - SUB_BUCKET_BITS : 0;
+        return static_cast<size_t>(shift) * SUB_BUCKETS + static_cast<size_t>(value >> shift);
+    }
+    static uint64_t bucket_upper(size_t index);
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+class MetricsRegistry {
+public:
+    // Names follow OpenMetrics conventions without the type suffix;
+    // counters are exposed as <name>_total. Histograms record integer
+    // values and are exposed multiplied by scale (1e-9: ns -> seconds).
+    Counter& counter(const std::string& name, const std::string& help);
+    Gauge& gauge(const std::string& name, const std::string& help);
+    Histogram& histogram(const std::string& name, const std::string& help, double scale);
+
+    // OpenMetrics text exposition, terminated by # EOF
+    std::string openmetrics() const;
+    // One JSON object; histograms as count/sum/p50/p90/p99/max
+    std::string json() const;
+
+private:
+    enum class Type { Counter, Gauge, Histogram };
+    struct Family {
+        std::string name;
+        std::string help;
+        Type type;
+        size_t index;
+        double scale = 1.0;
+    };
+
+    mutable std::mutex mutex_;
+    std::vector<Family> families_;
+    std::deque<Counter> counters_;     // deque: references stay valid
+    std::deque<Gauge> gauges_;
+    std::deque<Histogram> histograms_;
+};
+
+MetricsRegistry& metrics_registry();
+
+// The playback engine's metrics
+struct EngineMetrics {
+    Counter& bytes_in;
+    Counter& packets;
+    Counter& frames_decoded;
+    Histogram& decode_ns;          // per decoded frame
+    Counter& pcm_bytes;            // decoded output written to the ring
+    Counter& callbacks;
+    Histogram& callback_ns;
+    Counter& deadline_misses;      // callbacks that ran past their period
+    Counter& underruns;            // callbacks that ran out of audio
+    Gauge& ring_fill_bytes;
+    Counter& ring_full_waits;      // decoder waits for ring space
+    Counter& stream_opens;
+    Counter& stream_open_failures;
+    Counter& reconnects;
+    Histogram& ttfa_ns;            // tune request -> first audio handed to the device
+    Histogram& fft_ns;
+};
+
+EngineMetrics& engine_metrics();
+
+#endif // METRICS_HPP
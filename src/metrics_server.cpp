@@ -0,0 +1,281 @@
+#include "metrics_server.hpp"
+#include "metrics.hpp"
+#include "thread_name.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// A scraper that does not send its request, or read the response, within
+// this long is dropped; requests are answered inline on the one thread
+static constexpr int REQUEST_TIMEOUT_MS = 1000;
+
+MetricsServer::~MetricsServer() {
+    stop();
+}
+
+bool MetricsServer::start(const std::string& listen, const std::filesystem::path& json_path,
+                          std::chrono::seconds interval) {
+#ifdef __linux__
+    stop();
+    error_.clear();
+    json_path_ = json_path;
+    interval_ = interval.count() > 0 ? interval : std::chrono::seconds(1);
+
+    if (!listen.empty() && !open_listener(listen)) {
+        return false;
+    }
+
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+        error_ = "eventfd failed";
+        stop();
+        return false;
+    }
+
+    stop_requested_ = false;
+    thread_ = std::thread([this]() {
+        set_thread_name("metrics");
+        run();
+    });
+    return true;
+#else
+    (void)listen;
+    (void)json_path;
+    (void)interval;
+    error_ = "metrics export is only supported on Linux";
+    return false;
+#endif
+}
+
+void MetricsServer::stop() {
+#ifdef __linux__
+    stop_requested_ = true;
+    if (wake_fd_ >= 0) {
+        uint64_t one = 1;
+        (void)!write(wake_fd_, &one, sizeof(one));
+    }
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        listen_fd_ = -1;
+    }
+    if (!unix_path_.empty()) {
+        unlink(unix_path_.c_str());
+        unix_path_.clear();
+    }
+    if (wake_fd_ >= 0) {
+        close(wake_fd_);
+        wake_fd_ = -1;
+    }
+#endif
+}
+
+bool MetricsServer::open_listener(const std::string& listen) {
+#ifdef __linux__
+    if (listen.rfind("unix:", 0) == 0) {
+        std::string path = listen.substr(5);
+        sockaddr_un addr{};
+        if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+            error_ = "invalid socket path: " + path;
+            return false;
+        }
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+        listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0) {
+            error_ = "socket failed";
+            return false;
+        }
+        // A stale socket from a previous run would make bind fail
+        unlink(path.c_str());
+        if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            error_ = "cannot bind " + path + ": " + std::strerror(errno);
+            close(listen_fd_);
+            listen_fd_ = -1;
+            return false;
+        }
+        unix_path_ = path;
+    } else {
+        auto colon = listen.rfind(':');
+        if (colon == std::string::npos) {
+            error_ = "expected HOST:PORT or unix:PATH, got " + listen;
+            return false;
+        }
+        std::string host = listen.substr(0, colon);
+        if (host.empty()) {
+            host = "127.0.0.1";
+        }
+        int port = std::atoi(listen.c_str() + colon + 1);
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        if (port <= 0 || port > 65535 || inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) {
+            error_ = "invalid listen address: " + listen;
+            return false;
+        }
+
+        listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0) {
+            error_ = "socket failed";
+            return false;
+        }
+        int one = 1;
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            error_ = "cannot bind " + listen + ": " + std::strerror(errno);
+            close(listen_fd_);
+            listen_fd_ = -1;
+            return false;
+        }
+    }
+
+    if (::listen(listen_fd_, 8) < 0) {
+        error_ = "listen failed";
+        close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+    return true;
+#else
+    (void)listen;
+    return false;
+#endif
+}
+
+void MetricsServer::run() {
+#ifdef __linux__
+    auto next_dump = std::chrono::steady_clock::now() + interval_;
+
+    while (!stop_requested_) {
+        int timeout_ms = -1;
+        if (!json_path_.empty()) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                next_dump - std::chrono::steady_clock::now()).count();
+            timeout_ms = remaining > 0 ? static_cast<int>(remaining) : 0;
+        }
+
+        pollfd fds[2] = {
+            {wake_fd_, POLLIN, 0},
+            {listen_fd_, POLLIN, 0},
+        };
+        int ret = poll(fds, listen_fd_ >= 0 ? 2 : 1, timeout_ms);
+        if (ret < 0) {
+            continue;
+        }
+        if (fds[0].revents & POLLIN) {
+            break;
+        }
+
+        if (listen_fd_ >= 0 && (fds[1].revents & POLLIN)) {
+            int client;
+            while ((client = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                serve(client);
+                close(client);
+            }
+        }
+
+        if (!json_path_.empty() && std::chrono::steady_clock::now() >= next_dump) {
+            write_json();
+            next_dump = std::chrono::steady_clock::now() + interval_;
+        }
+    }
+
+    // Final snapshot so short runs still leave a file behind
+    if (!json_path_.empty()) {
+        write_json();
+    }
+#endif
+}
+
+void MetricsServer::serve(int client) {
+#ifdef __linux__
+    // client is non-blocking; every wait counts against one deadline, so
+    // a scraper trickling bytes cannot hold the thread either
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(REQUEST_TIMEOUT_MS);
+    auto wait = [&](short events) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        pollfd pfd{client, events, 0};
+        return remaining > 0 && poll(&pfd, 1, static_cast<int>(remaining)) > 0;
+    };
+
+    // Read until the end of the request headers; the request itself does
+    // not matter, every path gets the metrics
+    char buf[2048];
+    std::string request;
+    while (request.find("\r\n\r\n") == std::string::npos &&
+           request.find("\n\n") == std::string::npos && request.size() < 8192) {
+        if (!wait(POLLIN)) {
+            return;
+        }
+        ssize_t n = read(client, buf, sizeof(buf));
+        if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        request.append(buf, static_cast<size_t>(n));
+    }
+
+    std::string body = metrics_registry().openmetrics();
+    std::string response =
+        "HTTP/1.0 200 OK\r\n"
+        "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+        "Content-Length: " + std::to_string(body.size()) + "\r\n"
+        "Connection: close\r\n"
+        "\r\n" + body;
+
+    size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t n = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (!wait(POLLOUT)) {
+                return;
+            }
+            continue;
+        }
+        if (n <= 0) {
+            return;
+        }
+        sent += static_cast<size_t>(n);
+    }
+#else
+    (void)client;
+#endif
+}
+
+void MetricsServer::write_json() {
+    std::filesystem::path tmp = json_path_;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        if (!out) {
+            return;
+        }
+        out << metrics_registry().json() << "\n";
+        if (!out) {
+            return;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, json_path_, ec);
+}
@@ -0,0 +1,48 @@
+#ifndef METRICS_SERVER_HPP
+#define METRICS_SERVER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+// Serves metrics_registry() to scrapers and/or dumps it to a file.
+//
+// listen is "HOST:PORT", ":PORT" (loopback) or "unix:/path/to/socket";
+// any request on it gets the OpenMetrics text (HTTP/1.0, one request per
+// connection). If json_path is set the JSON snapshot is written there
+// every interval, atomically (temp file + rename). One background
+// thread; requests are answered inline since they only format text.
+// Linux only.
+class MetricsServer {
+public:
+    MetricsServer() = default;
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    bool start(const std::string& listen, const std::filesystem::path& json_path,
+               std::chrono::seconds interval);
+    void stop();
+
+    const std::string& error() const { return error_; }
+
+private:
+    bool open_listener(const std::string& listen);
+    void run();
+    void serve(int client);
+    void write_json();
+
+    std::string error_;
+    std::string unix_path_;
+    std::filesystem::path json_path_;
+    std::chrono::seconds interval_{10};
+    int listen_fd_ = -1;
+    int wake_fd_ = -1;
+    std::thread thread_;
+    std::atomic<bool> stop_requested_{false};
+};
+
+#endif // METRICS_SERVER_HPP
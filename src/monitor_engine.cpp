@@ -0,0 +1,812 @@
+#include "monitor_engine.hpp"
+#include "async_log.hpp"
+#include "byte_ringbuffer.hpp"
+#include "icy_http.hpp"
+#include "pipeline_clock.hpp"
+#include "station.hpp"
+#include "stream_decoder.hpp"
+#include "thread_name.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavformat/avio.h>
+#include <libavutil/dict.h>
+#include <libavutil/mem.h>
+#include <libavutil/opt.h>
+}
+
+namespace {
+
+// The demuxer reads in blocks of this size...
+constexpr int DEMUX_IO_BUFFER_SIZE = 4096;
+// ...and a decode task is queued once this much input is buffered, so a
+// packet rarely has to wait for the network mid-read
+constexpr size_t READ_AHEAD = 8192;
+// Probing reads further ahead before the first packet, and a probe that
+// ran dry is retried once this much more has arrived
+constexpr size_t PROBE_AHEAD = 16384;
+// Poll interval of the fetch thread while the input buffer is full, and
+// of the demuxer when it runs dry mid-packet
+constexpr uint64_t INPUT_WAIT_NS = 1'000'000;
+
+// Reactor fetches: connecting through the response headers, and how
+// long a connection may go silent
+constexpr auto CONNECT_TIMEOUT = std::chrono::seconds(15);
+constexpr auto STALL_TIMEOUT = std::chrono::seconds(30);
+constexpr size_t MAX_METAINT = 1024 * 1024;
+// A reactor fetch parked on a full input buffer is woken once this much
+// is free again, not after every demuxer read
+constexpr size_t WAKE_SPACE = MonitorEngine::INPUT_BUFFER_SIZE / 2;
+
+constexpr float LEVEL_FLOOR_DB = -120.0f;
+
+float to_db(double amplitude) {
+    if (amplitude <= 0.0) {
+        return LEVEL_FLOOR_DB;
+    }
+    return std::max(LEVEL_FLOOR_DB, static_cast<float>(20.0 * std::log10(amplitude / 32768.0)));
+}
+
+// http and https (with OpenSSL) are fetched by the reactor; anything else
+// FFmpeg opens on a fetch thread
+bool reactor_can_fetch(const NetReactor& reactor, const std::string& url) {
+    ParsedUrl parsed;
+    return parse_url(url, parsed) && (!parsed.tls || reactor.ssl_context());
+}
+
+} // namespace
+
+void LevelMeter::push_samples(const int16_t* stereo_samples, size_t frame_count) {
+    while (frame_count > 0) {
+        size_t frames = std::min(frame_count, WINDOW_FRAMES - window_frames_);
+        int peak = window_peak_;
+        double sum_sq = 0.0;
+        for (size_t i = 0; i < frames * 2; i++) {
+            int sample = stereo_samples[i];
+            peak = std::max(peak, sample < 0 ? -sample : sample);
+            sum_sq += static_cast<double>(sample) * sample;
+        }
+        window_peak_ = peak;
+        window_sum_sq_ += sum_sq;
+        window_frames_ += frames;
+        stereo_samples += frames * 2;
+        frame_count -= frames;
+
+        if (window_frames_ == WINDOW_FRAMES) {
+            peak_db_.store(to_db(window_peak_), std::memory_order_relaxed);
+            rms_db_.store(to_db(std::sqrt(window_sum_sq_ / (WINDOW_FRAMES * 2))), std::memory_order_relaxed);
+            silent_frames_ = window_peak_ < SILENCE_PEAK ? silent_frames_ + WINDOW_FRAMES : 0;
+            silent_seconds_.store(static_cast<double>(silent_frames_) / WINDOW_FRAMES, std::memory_order_relaxed);
+            window_frames_ = 0;
+            window_peak_ = 0;
+            window_sum_sq_ = 0.0;
+        }
+    }
+}
+
+const char* monitor_state_name(MonitorState state) {
+    switch (state) {
+    case MonitorState::Connecting: return "connecting";
+    case MonitorState::Running: return "running";
+    case MonitorState::Ended: return "ended";
+    case MonitorState::Failed: return "failed";
+    }
+    return "unknown";
+}
+
+// One monitored stream. A reactor task (or, for what the reactor cannot
+// open, the fetch thread) fills input; decode tasks on the pool drain it,
+// one at a time. Tasks hold a reference, so a stream removed while its
+// task is queued lives until that task has run.
+struct MonitorEngine::Stream : public AudioAnalyzer, public std::enable_shared_from_this<MonitorEngine::Stream> {
+    Stream(int stream_id, const std::string& stream_url, const std::string& stream_name,
+           std::unique_ptr<AudioAnalyzer> stream_analyzer, WorkStealingPool& stream_pool,
+           PlaylistResolver& resolver, size_t slice_packets)
+        : id(stream_id)
+        , url(stream_url)
+        , name(stream_name)
+        , analyzer(std::move(stream_analyzer))
+        , pool(stream_pool)
+        , playlist_resolver(resolver)
+        , packets_per_slice(std::max<size_t>(1, slice_packets))
+    {
+    }
+
+    ~Stream() override {
+        close_demuxer();
+    }
+
+    // net: the reactor to fetch on, nullptr for a fetch thread
+    void start(NetReactor* net) {
+        if (!net) {
+            start_fetch_thread({});
+            return;
+        }
+        reactor = net;
+        bool spawned;
+        {
+            // Under the mutex: read_input may want the id as soon as the
+            // task runs, and the task clears fetch_task_running under it
+            std::lock_guard<std::mutex> lock(mutex);
+            fetch_task = net->spawn(fetch_async(shared_from_this()));
+            spawned = fetch_task != 0;
+            fetch_task_running = spawned;
+        }
+        if (!spawned) {
+            finish(MonitorState::Failed, "network reactor has stopped");
+        }
+    }
+
+    void start_fetch_thread(std::vector<std::string> candidates) {
+        fetch_thread = std::thread([this, candidates = std::move(candidates)]() mutable {
+            set_thread_name("monitor fetch");
+            fetch(std::move(candidates));
+        });
+    }
+
+    // Stops fetching and waits out a queued or running decode task
+    void shutdown() {
+        stop_requested = true;
+        if (reactor) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                reactor->cancel(fetch_task);
+            }
+            while (fetch_task_running.load()) {
+                pipeline_clock().sleep_for_ns(INPUT_WAIT_NS);
+            }
+        }
+        // The reactor task may have handed over to a thread before it ended
+        if (fetch_thread.joinable()) {
+            fetch_thread.join();
+        }
+        while (task_state.load() != TASK_IDLE) {
+            pipeline_clock().sleep_for_ns(INPUT_WAIT_NS);
+        }
+    }
+
+    // Decoded PCM: levels first, then the caller's analyzer
+    void push_samples(const int16_t* stereo_samples, size_t frame_count) override {
+        levels.push_samples(stereo_samples, frame_count);
+        if (analyzer) {
+            analyzer->push_samples(stereo_samples, frame_count);
+        }
+        audio_frames.fetch_add(frame_count, std::memory_order_relaxed);
+    }
+
+    bool ready() const {
+        return input_ended.load() || input.read_available() >= (opened.load() ? READ_AHEAD : PROBE_AHEAD);
+    }
+
+    void submit() {
+        pool.submit([self = shared_from_this()]() { self->run_slice(); });
+    }
+
+    // Fetcher, after new input: queues a decode task if none is
+    // queued or running and there is enough to decode, otherwise tells
+    // the running task to look again before it goes idle
+    void notify() {
+        int state = task_state.load();
+        for (;;) {
+            if (state == TASK_IDLE) {
+                if (stop_requested.load() || finished.load() || !ready()) {
+                    return;
+                }
+                if (task_state.compare_exchange_weak(state, TASK_QUEUED)) {
+                    submit();
+                    return;
+                }
+            } else if (state == TASK_QUEUED) {
+                if (task_state.compare_exchange_weak(state, TASK_NOTIFIED)) {
+                    return;
+                }
+            } else {
+                return;
+            }
+        }
+    }
+
+    void run_slice() {
+        // Input notified before this point is seen by this slice
+        task_state.exchange(TASK_QUEUED);
+        if (stop_requested.load() || !decode_slice()) {
+            task_state = TASK_IDLE;
+            return;
+        }
+        if (ready()) {
+            // Out of budget: back of the queue, behind the other streams
+            submit();
+            return;
+        }
+        for (;;) {
+            int state = TASK_QUEUED;
+            if (task_state.compare_exchange_strong(state, TASK_IDLE)) {
+                return;
+            }
+            // Notified while decoding: the new input may be enough now
+            task_state.exchange(TASK_QUEUED);
+            if (ready()) {
+                submit();
+                return;
+            }
+        }
+    }
+
+    // False once the stream is finished
+    bool decode_slice() {
+        if (!opened.load()) {
+            if (!open_demuxer()) {
+                if (probe_starved) {
+                    // Out of input while probing: start over from the first
+                    // byte once notify() finds PROBE_AHEAD more
+                    close_demuxer();
+                    probe_starved = false;
+                    probe_pos = 0;
+                    return true;
+                }
+                if (!stop_requested.load()) {
+                    finish(MonitorState::Failed, decoder.error());
+                }
+                return false;
+            }
+            opened = true;
+            state = MonitorState::Running;
+        }
+
+        for (size_t n = 0; n < packets_per_slice; n++) {
+            if (stop_requested.load()) {
+                return false;
+            }
+            size_t buffered = input.read_available() + (probe_data.size() - probe_pos);
+            if (!input_ended.load() && buffered < READ_AHEAD) {
+                break;
+            }
+            if (!decoder.read_packet()) {
+                if (!stop_requested.load()) {
+                    bool clean = decoder.last_error() == AVERROR_EOF;
+                    finish(clean ? MonitorState::Ended : MonitorState::Failed, decoder.error());
+                }
+                return false;
+            }
+            if (decoder.is_audio_packet() && !decoder.decode_packet(*this)) {
+                decode_errors++;
+            }
+            decoder.unref_packet();
+        }
+        return true;
+    }
+
+    bool open_demuxer() {
+        auto* buffer = static_cast<unsigned char*>(av_malloc(DEMUX_IO_BUFFER_SIZE));
+        if (buffer) {
+            demux_io = avio_alloc_context(buffer, DEMUX_IO_BUFFER_SIZE, 0, this, read_input, nullptr, nullptr);
+        }
+        if (!demux_io) {
+            av_free(buffer);
+            std::lock_guard<std::mutex> lock(mutex);
+            error = "cannot allocate I/O context";
+            return false;
+        }
+        demux_io->seekable = 0;
+
+        std::string input_url;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            input_url = connected_url;
+        }
+        if (!decoder.open_input(demux_io, input_url) || !decoder.find_stream_info() || !decoder.open_codec()) {
+            return false;
+        }
+        // find_stream_info settles for what it got when a read fails
+        if (probe_starved) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        codec = decoder.codec()->name;
+        return true;
+    }
+
+    void close_demuxer() {
+        decoder.close();
+        if (demux_io) {
+            av_freep(&demux_io->buffer);
+            avio_context_free(&demux_io);
+        }
+    }
+
+    void finish(MonitorState final_state, const std::string& message) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            error = message;
+            // Nothing reads the input any more; let the connection go
+            if (reactor) {
+                reactor->cancel(fetch_task);
+            }
+        }
+        state = final_state;
+        finished = true;
+        log_write(final_state == MonitorState::Failed ? LogLevel::Warning : LogLevel::Info,
+                  "monitor", "%s %s: %s", name.c_str(), monitor_state_name(final_state), message.c_str());
+        // A finished stream keeps only its status
+        close_demuxer();
+    }
+
+    // Demuxer input. While probing, every byte read is kept, and running
+    // dry returns EAGAIN rather than holding the pool worker: FFmpeg cannot
+    // resume a probe, so the open starts over on a later task with the
+    // kept bytes replayed first. Once open, tasks are only queued with
+    // READ_AHEAD bytes buffered, so waiting here mid-packet is the
+    // exception. Both are counted.
+    static int read_input(void* opaque, uint8_t* buf, int size) {
+        auto* stream = static_cast<Stream*>(opaque);
+        if (size_t n = stream->replay_probe(buf, static_cast<size_t>(size)); n > 0) {
+            return static_cast<int>(n);
+        }
+        for (;;) {
+            size_t n = stream->take_input(buf, static_cast<size_t>(size));
+            if (n > 0) {
+                stream->wake_fetch();
+                return static_cast<int>(n);
+            }
+            if (stream->stop_requested.load()) {
+                return AVERROR_EXIT;
+            }
+            if (stream->input_ended.load()) {
+                // The last bytes may have landed just before the end flag
+                n = stream->take_input(buf, static_cast<size_t>(size));
+                if (n > 0) {
+                    return static_cast<int>(n);
+                }
+                int err = stream->input_error.load();
+                return err < 0 ? err : AVERROR_EOF;
+            }
+            stream->input_waits.fetch_add(1, std::memory_order_relaxed);
+            if (!stream->opened.load()) {
+                stream->probe_starved = true;
+                return AVERROR(EAGAIN);
+            }
+            pipeline_clock().sleep_for_ns(INPUT_WAIT_NS);
+        }
+    }
+
+    // Bytes an earlier probe read that this one has not yet
+    size_t replay_probe(uint8_t* buf, size_t size) {
+        size_t n = std::min(size, probe_data.size() - probe_pos);
+        if (n == 0) {
+            return 0;
+        }
+        std::memcpy(buf, probe_data.data() + probe_pos, n);
+        probe_pos += n;
+        if (opened.load() && probe_pos == probe_data.size() && !probe_data.empty()) {
+            std::vector<uint8_t>().swap(probe_data);
+            probe_pos = 0;
+        }
+        return n;
+    }
+
+    // From the input buffer, kept for a retry while probing
+    size_t take_input(uint8_t* buf, size_t size) {
+        size_t n = input.read(buf, size);
+        if (n > 0 && !opened.load()) {
+            probe_data.insert(probe_data.end(), buf, buf + n);
+            probe_pos += n;
+        }
+        return n;
+    }
+
+    // Reactor fetch parked on a full buffer: resume it once the demuxer
+    // has made room. Both sides swap the flag, so either the fetch sees
+    // the room before it parks or the demuxer sees it parked.
+    void wake_fetch() {
+        if (input.write_available() >= WAKE_SPACE && fetch_parked.exchange(false)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            reactor->wake(fetch_task);
+        }
+    }
+
+    // Empty candidates: resolve url here
+    void fetch(std::vector<std::string> candidates) {
+        if (candidates.empty() && playlist_kind_for_url(url) != PlaylistKind::None) {
+            candidates = playlist_resolver.resolve(url, &stop_requested);
+        }
+        if (candidates.empty()) {
+            candidates.push_back(url);
+        }
+
+        AVIOInterruptCB interrupt{};
+        interrupt.callback = [](void* opaque) -> int {
+            return static_cast<std::atomic<bool>*>(opaque)->load() ? 1 : 0;
+        };
+        interrupt.opaque = &stop_requested;
+
+        AVIOContext* io = nullptr;
+        int ret = AVERROR(EINVAL);
+        for (const auto& candidate : candidates) {
+            if (stop_requested.load()) {
+                return;
+            }
+            AVDictionary* opts = nullptr;
+            av_dict_set(&opts, "icy", "1", 0);
+            ret = avio_open2(&io, candidate.c_str(), AVIO_FLAG_READ, &interrupt, &opts);
+            av_dict_free(&opts);
+            if (ret >= 0) {
+                std::lock_guard<std::mutex> lock(mutex);
+                connected_url = candidate;
+                break;
+            }
+        }
+        if (!io) {
+            if (!stop_requested.load()) {
+                char err[AV_ERROR_MAX_STRING_SIZE] = {};
+                av_strerror(ret, err, sizeof(err));
+                finish(MonitorState::Failed, "cannot open " + url + ": " + err);
+            }
+            return;
+        }
+
+        while (!stop_requested.load()) {
+            uint8_t* dst = nullptr;
+            size_t space = input.reserve_write_contiguous(dst);
+            if (space == 0 || dst == nullptr) {
+                pipeline_clock().sleep_for_ns(INPUT_WAIT_NS);
+                continue;
+            }
+            int n = avio_read_partial(io, dst, static_cast<int>(std::min<size_t>(space, INT_MAX)));
+            if (n <= 0) {
+                input_error = n == 0 ? AVERROR_EOF : n;
+                break;
+            }
+            input.produce(static_cast<size_t>(n));
+            input_bytes.fetch_add(static_cast<uint64_t>(n), std::memory_order_relaxed);
+            read_title(io);
+            notify();
+        }
+        avio_closep(&io);
+        input_ended = true;
+        notify();
+    }
+
+    // The http protocol exports each ICY block it strips as "metadata"
+    void read_title(AVIOContext* io) {
+        AVDictionary* dict = nullptr;
+        if (av_opt_get_dict_val(io, "metadata", AV_OPT_SEARCH_CHILDREN, &dict) < 0 || !dict) {
+            return;
+        }
+        av_opt_set_dict_val(io, "metadata", nullptr, AV_OPT_SEARCH_CHILDREN);
+        if (const AVDictionaryEntry* entry = av_dict_get(dict, "StreamTitle", nullptr, 0)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            title = entry->value;
+        }
+        av_dict_free(&dict);
+    }
+
+    // The fetch thread's job as a reactor task, for http(s) streams: speaks
+    // HTTP/ICY itself, strips the metadata blocks and parks while input is
+    // full, so no thread waits on the connection. Playlists are resolved
+    // on the reactor's helper thread; if none of their streams is http(s)
+    // (or it fails to resolve and is not either) the stream moves to a
+    // fetch thread.
+    static ReactorTask fetch_async(std::shared_ptr<Stream> self) {
+        Stream& s = *self;
+        NetReactor& reactor = *s.reactor;
+        // However the task ends, even freed by a stopping reactor
+        struct Done {
+            Stream& stream;
+            bool handed_over = false;
+            ~Done() {
+                if (!handed_over) {
+                    stream.input_ended = true;
+                    stream.notify();
+                }
+                std::lock_guard<std::mutex> lock(stream.mutex);
+                stream.fetch_task_running = false;
+            }
+        } done{s};
+
+        std::vector<std::string> candidates;
+        if (playlist_kind_for_url(s.url) != PlaylistKind::None) {
+            auto resolve = [&]() { candidates = s.playlist_resolver.resolve(s.url, &s.stop_requested); };
+            if (co_await reactor.offload(resolve) == WaitResult::Cancelled) {
+                co_return;
+            }
+        }
+        if (candidates.empty()) {
+            candidates.push_back(s.url);
+        }
+        if (std::none_of(candidates.begin(), candidates.end(),
+                         [&](const std::string& c) { return reactor_can_fetch(reactor, c); })) {
+            if (!s.stop_requested.load()) {
+                done.handed_over = true;
+                s.start_fetch_thread(std::move(candidates));
+            }
+            co_return;
+        }
+
+        NetSocket socket;
+        IcyResponse response;
+        std::string error;
+        bool connected = false;
+        for (const auto& candidate : candidates) {
+            if (!reactor_can_fetch(reactor, candidate)) {
+                continue;
+            }
+            auto deadline = NetReactor::Clock::now() + CONNECT_TIMEOUT;
+            connected = co_await open_icy_stream(reactor, socket, candidate, deadline, 0, response, error);
+            // Cancelled: stopping, or nothing reads the stream any more
+            if (s.stop_requested.load() || s.finished.load()) {
+                co_return;
+            }
+            if (connected && response.metaint > MAX_METAINT) {
+                error = "icy-metaint " + std::to_string(response.metaint) + " out of range";
+                connected = false;
+            }
+            if (connected) {
+                break;
+            }
+        }
+
+        if (!connected) {
+            s.finish(MonitorState::Failed, "cannot open " + s.url + ": " + error);
+            co_return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            s.connected_url = response.url;
+        }
+
+        IcyMetadataSplitter splitter;
+        splitter.reset(response.metaint);
+        // Body bytes that came with the head; they fit, the buffer is empty
+        const auto* data = reinterpret_cast<const uint8_t*>(response.body.data());
+        size_t len = response.body.size();
+        while (len > 0) {
+            size_t take = std::min(len, splitter.audio_left());
+            if (take > 0) {
+                take = s.input.write(data, take);
+                splitter.audio_read(take);
+                s.input_bytes.fetch_add(take, std::memory_order_relaxed);
+            } else {
+                take = std::min(len, splitter.metadata_wanted());
+                if (splitter.feed_metadata(data, take)) {
+                    s.set_title(parse_stream_title(splitter.metadata()));
+                }
+            }
+            data += take;
+            len -= take;
+        }
+        std::string().swap(response.body);
+        s.notify();
+
+        // Audio goes straight into the input buffer; never more than the
+        // splitter allows, so a metadata block is never read as audio
+        uint8_t metadata[512];
+        while (!s.stop_requested.load()) {
+            long n;
+            if (size_t audio_left = splitter.audio_left(); audio_left > 0) {
+                uint8_t* dst = nullptr;
+                size_t space = s.input.reserve_write_contiguous(dst);
+                if (space == 0 || dst == nullptr) {
+                    s.fetch_parked.exchange(true);
+                    if (s.input.write_available() >= WAKE_SPACE) {
+                        s.fetch_parked.exchange(false);
+                        continue;
+                    }
+                    if (co_await reactor.park() == WaitResult::Cancelled) {
+                        co_return;
+                    }
+                    continue;
+                }
+                n = socket.read(dst, std::min(space, audio_left));
+                if (n > 0) {
+                    s.input.produce(static_cast<size_t>(n));
+                    splitter.audio_read(static_cast<size_t>(n));
+                    s.input_bytes.fetch_add(static_cast<uint64_t>(n), std::memory_order_relaxed);
+                    s.notify();
+                    continue;
+                }
+            } else {
+                n = socket.read(metadata, std::min(sizeof(metadata), splitter.metadata_wanted()));
+                if (n > 0) {
+                    if (splitter.feed_metadata(metadata, static_cast<size_t>(n))) {
+                        s.set_title(parse_stream_title(splitter.metadata()));
+                    }
+                    continue;
+                }
+            }
+            if (n == NetSocket::IO_WOULD_BLOCK) {
+                WaitResult r = co_await reactor.io(socket.fd(), EPOLLIN, STALL_TIMEOUT);
+                if (r == WaitResult::Cancelled) {
+                    co_return;
+                }
+                if (r == WaitResult::Timeout) {
+                    s.input_error = AVERROR(ETIMEDOUT);
+                    break;
+                }
+                continue;
+            }
+            s.input_error = n == 0 ? AVERROR_EOF : AVERROR(EIO);
+            break;
+        }
+    }
+
+    void set_title(std::string stream_title) {
+        if (stream_title.empty()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        title = std::move(stream_title);
+    }
+
+    MonitorStreamStatus snapshot() const {
+        MonitorStreamStatus s;
+        s.id = id;
+        s.name = name;
+        s.url = url;
+        s.state = state.load();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            s.error = error;
+            s.codec = codec;
+            s.title = title;
+        }
+        s.input_bytes = input_bytes.load(std::memory_order_relaxed);
+        s.audio_frames = audio_frames.load(std::memory_order_relaxed);
+        s.input_waits = input_waits.load(std::memory_order_relaxed);
+        s.peak_db = levels.peak_db();
+        s.rms_db = levels.rms_db();
+        s.silent_seconds = levels.silent_seconds();
+        return s;
+    }
+
+    const int id;
+    const std::string url;
+    const std::string name;
+    std::unique_ptr<AudioAnalyzer> analyzer;
+    LevelMeter levels;
+    WorkStealingPool& pool;
+    PlaylistResolver& playlist_resolver;
+    const size_t packets_per_slice;
+
+    std::thread fetch_thread;
+    // Reactor fetches: fetch_task is written under mutex
+    NetReactor* reactor = nullptr;
+    uint64_t fetch_task = 0;
+    std::atomic<bool> fetch_task_running{false};
+    std::atomic<bool> fetch_parked{false};
+    std::atomic<bool> stop_requested{false};
+    // Idle, or a decode task is queued or running (notified: input
+    // arrived meanwhile)
+    enum { TASK_IDLE, TASK_QUEUED, TASK_NOTIFIED };
+    std::atomic<int> task_state{TASK_IDLE};
+    std::atomic<bool> opened{false};
+    std::atomic<bool> finished{false};
+    std::atomic<MonitorState> state{MonitorState::Connecting};
+
+    // Compressed input: fetcher -> demuxer
+    BasicByteRingbuffer<INPUT_BUFFER_SIZE> input;
+    std::atomic<bool> input_ended{false};
+    std::atomic<int> input_error{0};
+
+    std::atomic<uint64_t> input_bytes{0};
+    std::atomic<uint64_t> audio_frames{0};
+    std::atomic<uint64_t> input_waits{0};
+
+    mutable std::mutex mutex;
+    std::string connected_url;
+    std::string error;
+    std::string codec;
+    std::string title;
+
+    // Decode tasks only
+    StreamDecoder decoder;
+    AVIOContext* demux_io = nullptr;
+    uint64_t decode_errors = 0;
+    // Input read while probing, for the next attempt if this one runs dry
+    std::vector<uint8_t> probe_data;
+    size_t probe_pos = 0;
+    bool probe_starved = false;
+};
+
+MonitorEngine::MonitorEngine(MonitorOptions options)
+    : options_(options)
+    , pool_(options.threads, "monitor")
+{
+    for (size_t i = 0; i < options_.reactor_threads; i++) {
+        auto reactor = std::make_unique<NetReactor>("netio " + std::to_string(i));
+        if (!reactor->start()) {
+            // Streams fall back to fetch threads
+            log_write(LogLevel::Warning, "monitor", "network reactor: %s", reactor->error().c_str());
+            break;
+        }
+        reactors_.push_back(std::move(reactor));
+    }
+}
+
+MonitorEngine::~MonitorEngine() {
+    stop();
+}
+
+int MonitorEngine::add_stream(const std::string& url, const std::string& name,
+                              std::unique_ptr<AudioAnalyzer> analyzer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int id = next_id_++;
+    auto stream = std::make_shared<Stream>(id, url, name, std::move(analyzer), pool_,
+                                           playlist_resolver_, options_.packets_per_slice);
+    // Streams are dealt to the reactors round-robin
+    NetReactor* reactor = nullptr;
+    if (!reactors_.empty()) {
+        NetReactor* next = reactors_[static_cast<size_t>(id) % reactors_.size()].get();
+        if (playlist_kind_for_url(url) != PlaylistKind::None || reactor_can_fetch(*next, url)) {
+            reactor = next;
+        }
+    }
+    stream->start(reactor);
+    streams_.push_back(std::move(stream));
+    return id;
+}
+
+bool MonitorEngine::remove_stream(int id) {
+    std::shared_ptr<Stream> stream;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = std::find_if(streams_.begin(), streams_.end(),
+                               [id](const std::shared_ptr<Stream>& s) { return s->id == id; });
+        if (it == streams_.end()) {
+            return false;
+        }
+        stream = std::move(*it);
+        streams_.erase(it);
+    }
+    stream->shutdown();
+    return true;
+}
+
+std::vector<MonitorStreamStatus> MonitorEngine::status() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<MonitorStreamStatus> result;
+    result.reserve(streams_.size());
+    for (const auto& stream : streams_) {
+        result.push_back(stream->snapshot());
+    }
+    return result;
+}
+
+size_t MonitorEngine::active_streams() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<size_t>(std::count_if(streams_.begin(), streams_.end(),
+                                             [](const std::shared_ptr<Stream>& s) { return !s->finished.load(); }));
+}
+
+void MonitorEngine::stop() {
+    std::vector<std::shared_ptr<Stream>> streams;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        streams.swap(streams_);
+    }
+    // Signal all first, so the fetchers wind down together; stopping the
+    // resolver releases any still waiting for a playlist
+    for (auto& stream : streams) {
+        stream->stop_requested = true;
+    }
+    playlist_resolver_.stop();
+    for (auto& stream : streams) {
+        stream->shutdown();
+    }
+    streams.clear();
+    pool_.stop();
+    for (auto& reactor : reactors_) {
+        reactor->stop();
+    }
+}
@@ -0,0 +1,135 @@
+#ifndef MONITOR_ENGINE_HPP
+#define MONITOR_ENGINE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "audio_analyzer.hpp"
+#include "net_reactor.hpp"
+#include "playlist_resolver.hpp"
+#include "work_stealing_pool.hpp"
+
+// Levels of one stream, for dead-air and clipping alarms. Published once
+// per second of audio; readable from any thread.
+class LevelMeter : public AudioAnalyzer {
+public:
+    static constexpr size_t WINDOW_FRAMES = 44100;
+    // Peak below this (about -60 dBFS) counts as silence
+    static constexpr int SILENCE_PEAK = 32;
+
+    void push_samples(const int16_t* stereo_samples, size_t frame_count) override;
+
+    // Last full window, dBFS (-inf for digital silence)
+    float peak_db() const { return peak_db_.load(std::memory_order_relaxed); }
+    float rms_db() const { return rms_db_.load(std::memory_order_relaxed); }
+    // Length of the silence the stream is in now, 0 when it is not
+    double silent_seconds() const { return silent_seconds_.load(std::memory_order_relaxed); }
+
+private:
+    // Decoding thread only
+    size_t window_frames_ = 0;
+    int window_peak_ = 0;
+    double window_sum_sq_ = 0.0;
+    uint64_t silent_frames_ = 0;
+
+    std::atomic<float> peak_db_{-1000.0f};
+    std::atomic<float> rms_db_{-1000.0f};
+    std::atomic<double> silent_seconds_{0.0};
+};
+
+enum class MonitorState {
+    Connecting,     // resolving, connecting or probing
+    Running,
+    Ended,          // the stream closed
+    Failed,         // could not be opened or decoded; see error
+};
+
+const char* monitor_state_name(MonitorState state);
+
+struct MonitorStreamStatus {
+    int id = 0;
+    std::string name;
+    std::string url;
+    MonitorState state = MonitorState::Connecting;
+    std::string error;
+    std::string codec;
+    std::string title;          // ICY StreamTitle
+    uint64_t input_bytes = 0;
+    uint64_t audio_frames = 0;  // decoded, at 44.1 kHz
+    uint64_t input_waits = 0;   // times the demuxer found the input buffer empty
+    float peak_db = 0.0f;
+    float rms_db = 0.0f;
+    double silent_seconds = 0.0;
+};
+
+struct MonitorOptions {
+    size_t threads = 0;             // decode pool size; 0 = one per hardware thread
+    size_t packets_per_slice = 32;  // packets a decode task takes before yielding its worker
+    size_t reactor_threads = 1;     // NetReactors for http(s) streams; 0 = a fetch thread per stream
+};
+
+// Decodes many streams at once for monitoring, with no audio output. The
+// decoding runs on a fixed WorkStealingPool: a stream's decode task is
+// queued when its input buffer holds enough compressed data for a few
+// packets, decodes up to packets_per_slice of them into the stream's
+// LevelMeter (and analyzer, if any), and gives the worker back. Per
+// stream that costs a 32 KiB input buffer and the decoder state, instead
+// of a 256 KiB playback ring and an audio device.
+//
+// The demuxer reads the input buffer through a custom AVIOContext, so it
+// never touches the network. http(s) connections are read by coroutines
+// on reactor_threads NetReactors (streams dealt round-robin), which speak
+// HTTP/ICY themselves and take the ICY titles out of the stream; the
+// thread count stays the same however many streams there are. Anything
+// else (local files, other protocols, https without OpenSSL) is opened by
+// FFmpeg on a fetch thread per stream, since its reads block.
+//
+// engine_metrics() counts the decoding of all monitored streams.
+class MonitorEngine {
+public:
+    static constexpr size_t INPUT_BUFFER_SIZE = 32768;
+
+    explicit MonitorEngine(MonitorOptions options = MonitorOptions());
+    ~MonitorEngine();
+
+    MonitorEngine(const MonitorEngine&) = delete;
+    MonitorEngine& operator=(const MonitorEngine&) = delete;
+
+    // Starts monitoring url (a stream, playlist or local file). analyzer,
+    // if given, sees the stream's 44.1 kHz s16 stereo PCM on pool threads,
+    // one call at a time. Returns the stream's id.
+    int add_stream(const std::string& url, const std::string& name,
+                   std::unique_ptr<AudioAnalyzer> analyzer = nullptr);
+    // Stops and forgets the stream; false for an unknown id
+    bool remove_stream(int id);
+
+    std::vector<MonitorStreamStatus> status() const;
+    // Streams neither ended nor failed
+    size_t active_streams() const;
+
+    size_t threads() const { return pool_.size(); }
+    size_t reactor_threads() const { return reactors_.size(); }
+    WorkStealingPool::Stats pool_stats() const { return pool_.stats(); }
+
+    // Stops every stream and the pool
+    void stop();
+
+    struct Stream;
+
+private:
+    MonitorOptions options_;
+    PlaylistResolver playlist_resolver_;
+    WorkStealingPool pool_;
+    std::vector<std::unique_ptr<NetReactor>> reactors_;
+
+    mutable std::mutex mutex_;
+    std::vector<std::shared_ptr<Stream>> streams_;
+    int next_id_ = 1;
+};
+
+#endif // MONITOR_ENGINE_HPP
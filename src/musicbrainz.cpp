@@ -0,0 +1,469 @@
+#include "musicbrainz.hpp"
+#include "app_paths.hpp"
+#include "async_log.hpp"
+#include "metrics.hpp"
+#include "thread_name.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+
+#include <nlohmann/json.hpp>
+
+extern "C" {
+#include <libavformat/avio.h>
+#include <libavutil/dict.h>
+}
+
+#ifndef WEBRADIO_VERSION
+#define WEBRADIO_VERSION "0.0.0"
+#endif
+
+using json = nlohmann::json;
+
+static constexpr const char* DEFAULT_BASE_URL = "https://musicbrainz.org";
+static constexpr const char* USER_AGENT = "webradio/" WEBRADIO_VERSION " ( https://github.com/lartom/webradio )";
+static constexpr int FETCH_TIMEOUT_US = 5000000;
+static constexpr size_t MAX_RESPONSE_BYTES = 1024 * 1024;
+static constexpr int MIN_SCORE = 80;
+static constexpr std::chrono::seconds MAX_BACKOFF{60};
+
+namespace {
+
+std::string trim_copy(const std::string& s) {
+    size_t begin = 0;
+    size_t end = s.size();
+    while (begin < end && std::isspace(static_cast<unsigned char>(s[begin]))) ++begin;
+    while (end > begin && std::isspace(static_cast<unsigned char>(s[end - 1]))) --end;
+    return s.substr(begin, end - begin);
+}
+
+// Lowercase, drop (...) and [...] groups, collapse runs of whitespace
+std::string normalize_part(const std::string& s) {
+    std::string out;
+    out.reserve(s.size());
+    int depth = 0;
+    bool pending_space = false;
+    for (char c : s) {
+        if (c == '(' || c == '[') {
+            ++depth;
+            continue;
+        }
+        if ((c == ')' || c == ']') && depth > 0) {
+            --depth;
+            continue;
+        }
+        if (depth > 0) continue;
+
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            pending_space = !out.empty();
+            continue;
+        }
+        if (pending_space) {
+            out.push_back(' ');
+            pending_space = false;
+        }
+        out.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+    }
+    return out;
+}
+
+std::string url_encode(const std::string& s) {
+    static const char hex[] = "0123456789ABCDEF";
+    std::string out;
+    out.reserve(s.size() * 3);
+    for (unsigned char c : s) {
+        if (std::isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+            out.push_back(static_cast<char>(c));
+        } else {
+            out.push_back('%');
+            out.push_back(hex[c >> 4]);
+            out.push_back(hex[c & 15]);
+        }
+    }
+    return out;
+}
+
+// Quoted Lucene phrase; only '"' and '\' need escaping inside quotes
+std::string lucene_phrase(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') out.push_back('\\');
+        out.push_back(c);
+    }
+    out.push_back('"');
+    return out;
+}
+
+// Typed fields of a JSON object; fallback when the field is missing, null
+// or of another type (json::value() throws on a type mismatch)
+std::string string_field(const json& object, const char* key, const std::string& fallback = {}) {
+    auto it = object.find(key);
+    return it != object.end() && it->is_string() ? it->get<std::string>() : fallback;
+}
+
+int int_field(const json& object, const char* key, int fallback) {
+    auto it = object.find(key);
+    return it != object.end() && it->is_number() ? it->get<int>() : fallback;
+}
+
+bool bool_field(const json& object, const char* key, bool fallback) {
+    auto it = object.find(key);
+    return it != object.end() && it->is_boolean() ? it->get<bool>() : fallback;
+}
+
+const json& array_field(const json& object, const char* key) {
+    static const json empty = json::array();
+    auto it = object.find(key);
+    return it != object.end() && it->is_array() ? *it : empty;
+}
+
+// Most-voted entry of a MusicBrainz tags/genres array
+std::string top_tag(const json& tags) {
+    std::string best;
+    int best_count = -1;
+    for (const auto& tag : tags) {
+        if (!tag.is_object() || !tag.contains("name") || !tag["name"].is_string()) continue;
+        int count = int_field(tag, "count", 0);
+        if (count > best_count) {
+            best_count = count;
+            best = tag["name"].get<std::string>();
+        }
+    }
+    return best;
+}
+
+// Shared by every client; registered on first use
+Counter& dropped_lookups_metric() {
+    static Counter& counter = metrics_registry().counter(
+        "webradio_musicbrainz_dropped_lookups", "MusicBrainz lookups dropped because the queue was full");
+    return counter;
+}
+
+} // namespace
+
+bool split_stream_title(const std::string& stream_title, std::string& artist, std::string& title) {
+    size_t sep = stream_title.find(" - ");
+    if (sep == std::string::npos) {
+        return false;
+    }
+    artist = trim_copy(stream_title.substr(0, sep));
+    title = trim_copy(stream_title.substr(sep + 3));
+    return !artist.empty() && !title.empty();
+}
+
+std::string normalize_track_key(const std::string& artist, const std::string& title) {
+    return normalize_part(artist) + '\x1f' + normalize_part(title);
+}
+
+std::optional<TrackInfo> TrackInfoCache::get(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        return std::nullopt;
+    }
+    if (it->second != entries_.begin()) {
+        entries_.splice(entries_.begin(), entries_, it->second);
+        dirty_ = true;
+    }
+    return it->second->second;
+}
+
+void TrackInfoCache::put(const std::string& key, const TrackInfo& info) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (auto it = index_.find(key); it != index_.end()) {
+        it->second->second = info;
+        entries_.splice(entries_.begin(), entries_, it->second);
+    } else {
+        entries_.emplace_front(key, info);
+        index_[key] = entries_.begin();
+        if (entries_.size() > capacity_) {
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+        }
+    }
+    dirty_ = true;
+}
+
+bool TrackInfoCache::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    json j = json::parse(file, nullptr, false);
+    if (!j.is_array()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    index_.clear();
+    for (const auto& item : j) {
+        if (entries_.size() >= capacity_) break;
+        if (!item.is_object() || !item.contains("key") || !item["key"].is_string()) continue;
+
+        std::string key = item["key"].get<std::string>();
+        if (index_.count(key)) continue;
+
+        TrackInfo info;
+        info.album = string_field(item, "album");
+        info.year = string_field(item, "year");
+        info.genre = string_field(item, "genre");
+        info.found = bool_field(item, "found", false);
+        entries_.emplace_back(std::move(key), std::move(info));
+        index_[entries_.back().first] = std::prev(entries_.end());
+    }
+    dirty_ = false;
+    return true;
+}
+
+bool TrackInfoCache::save(const std::string& path) {
+    json j = json::array();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!dirty_) return true;
+        for (const auto& [key, info] : entries_) {
+            j.push_back({{"key", key}, {"album", info.album}, {"year", info.year},
+                         {"genre", info.genre}, {"found", info.found}});
+        }
+        dirty_ = false;
+    }
+
+    if (path.empty() || !ensure_directory(std::filesystem::path(path).parent_path())) {
+        return false;
+    }
+
+    std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::trunc);
+        if (!out.is_open()) return false;
+        out << j.dump();
+        if (!out.good()) return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, path, ec);
+    return !ec;
+}
+
+MusicBrainzClient::MusicBrainzClient(Fetcher fetcher)
+    : fetcher_(std::move(fetcher)) {
+    dropped_lookups_metric();
+
+    const char* base_url = std::getenv("WEBRADIO_MUSICBRAINZ_URL");
+    base_url_ = (base_url && base_url[0]) ? base_url : DEFAULT_BASE_URL;
+    while (!base_url_.empty() && base_url_.back() == '/') {
+        base_url_.pop_back();
+    }
+
+    std::filesystem::path dir = user_cache_dir();
+    if (!dir.empty()) {
+        cache_path_ = (dir / "musicbrainz.json").string();
+        cache_.load(cache_path_);
+    }
+
+    worker_ = std::thread([this]() {
+        set_thread_name("musicbrainz");
+        worker();
+    });
+}
+
+MusicBrainzClient::~MusicBrainzClient() {
+    stop();
+}
+
+void MusicBrainzClient::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stop_requested_) return;
+        stop_requested_ = true;
+        queue_.clear();
+    }
+    cv_.notify_all();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+    cache_.save(cache_path_);
+}
+
+std::optional<TrackInfo> MusicBrainzClient::lookup(const std::string& stream_title) {
+    std::string artist;
+    std::string title;
+    if (!split_stream_title(stream_title, artist, title)) {
+        return TrackInfo{};
+    }
+
+    std::string key = normalize_track_key(artist, title);
+    if (auto cached = cache_.get(key)) {
+        return cached;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stop_requested_) return TrackInfo{};
+
+        if (key == active_key_) {
+            active_titles_.insert(stream_title);
+            return std::nullopt;
+        }
+        auto queued = std::find_if(queue_.begin(), queue_.end(),
+                                   [&key](const Request& r) { return r.key == key; });
+        if (queued != queue_.end()) {
+            queued->stream_titles.insert(stream_title);
+            return std::nullopt;
+        }
+
+        Request request;
+        request.key = std::move(key);
+        request.artist = std::move(artist);
+        request.title = std::move(title);
+        request.stream_titles.insert(stream_title);
+        queue_.push_back(std::move(request));
+        if (queue_.size() > MAX_QUEUED) {
+            // Oldest first: by the time it would be fetched the track is over
+            log_write(LogLevel::Debug, "musicbrainz", "queue full, dropped lookup for %s - %s",
+                      queue_.front().artist.c_str(), queue_.front().title.c_str());
+            queue_.pop_front();
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            dropped_lookups_metric().add();
+        }
+    }
+    cv_.notify_one();
+    return std::nullopt;
+}
+
+bool MusicBrainzClient::take_result(Result& out) {
+    if (!has_results_.load(std::memory_order_acquire)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (results_.empty()) {
+        return false;
+    }
+    out = std::move(results_.front());
+    results_.pop_front();
+    has_results_.store(!results_.empty(), std::memory_order_release);
+    return true;
+}
+
+void MusicBrainzClient::worker() {
+    std::chrono::steady_clock::duration backoff = MIN_REQUEST_INTERVAL;
+
+    while (true) {
+        Request request;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]() { return stop_requested_ || !queue_.empty(); });
+            if (stop_requested_) return;
+
+            // Rate limit; titles that arrive meanwhile coalesce into the queue
+            if (cv_.wait_until(lock, next_request_at_, [this]() { return stop_requested_.load(); })) {
+                return;
+            }
+            if (queue_.empty()) continue;
+
+            // Newest first: the track on air is the one worth looking up
+            request = std::move(queue_.back());
+            queue_.pop_back();
+            active_key_ = request.key;
+            active_titles_ = std::move(request.stream_titles);
+        }
+
+        TrackInfo info;
+        bool ok = fetcher_ ? fetcher_(request.artist, request.title, info) : query(request, info);
+
+        if (ok) {
+            cache_.put(request.key, info);
+            backoff = MIN_REQUEST_INTERVAL;
+        } else {
+            // Server refused or unreachable: back off instead of hammering it
+            backoff = std::min<std::chrono::steady_clock::duration>(backoff * 2, MAX_BACKOFF);
+        }
+
+        bool idle;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            next_request_at_ = std::chrono::steady_clock::now() + (ok ? MIN_REQUEST_INTERVAL : backoff);
+            if (ok) {
+                for (const auto& stream_title : active_titles_) {
+                    results_.push_back({stream_title, info});
+                }
+                has_results_.store(!results_.empty(), std::memory_order_release);
+            }
+            active_key_.clear();
+            active_titles_.clear();
+            idle = queue_.empty();
+        }
+
+        if (ok && idle) {
+            cache_.save(cache_path_);
+        }
+    }
+}
+
+bool MusicBrainzClient::query(const Request& request, TrackInfo& out) {
+    std::string lucene = "recording:" + lucene_phrase(request.title) +
+                         " AND artist:" + lucene_phrase(request.artist);
+    std::string url = base_url_ + "/ws/2/recording/?fmt=json&limit=5&query=" + url_encode(lucene);
+
+    AVIOInterruptCB interrupt{};
+    interrupt.callback = [](void* opaque) -> int {
+        return static_cast<std::atomic<bool>*>(opaque)->load() ? 1 : 0;
+    };
+    interrupt.opaque = &stop_requested_;
+
+    AVDictionary* opts = nullptr;
+    av_dict_set(&opts, "rw_timeout", std::to_string(FETCH_TIMEOUT_US).c_str(), 0);
+    av_dict_set(&opts, "user_agent", USER_AGENT, 0);
+    av_dict_set(&opts, "headers", "Accept: application/json\r\n", 0);
+
+    AVIOContext* io = nullptr;
+    int ret = avio_open2(&io, url.c_str(), AVIO_FLAG_READ, &interrupt, &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        return false;
+    }
+
+    std::string body;
+    unsigned char chunk[4096];
+    while (body.size() < MAX_RESPONSE_BYTES) {
+        int n = avio_read(io, chunk, sizeof(chunk));
+        if (n <= 0) break;
+        body.append(reinterpret_cast<const char*>(chunk), static_cast<size_t>(n));
+    }
+    avio_closep(&io);
+
+    return parse_recording_search(body, out);
+}
+
+bool parse_recording_search(const std::string& body, TrackInfo& out) {
+    json j = json::parse(body, nullptr, false);
+    if (!j.is_object()) {
+        return false;
+    }
+
+    out = TrackInfo{};
+    for (const auto& recording : array_field(j, "recordings")) {
+        if (!recording.is_object() || int_field(recording, "score", 0) < MIN_SCORE) continue;
+
+        out.found = true;
+        std::string date = string_field(recording, "first-release-date");
+        const json& releases = array_field(recording, "releases");
+        if (!releases.empty() && releases.front().is_object()) {
+            const json& release = releases.front();
+            out.album = string_field(release, "title");
+            if (date.empty()) date = string_field(release, "date");
+        }
+        if (date.size() >= 4) {
+            out.year = date.substr(0, 4);
+        }
+        out.genre = top_tag(array_field(recording, "genres"));
+        if (out.genre.empty()) {
+            out.genre = top_tag(array_field(recording, "tags"));
+        }
+        break;
+    }
+    return true;
+}
@@ -0,0 +1,136 @@
+#ifndef MUSICBRAINZ_HPP
+#define MUSICBRAINZ_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+struct TrackInfo {
+    std::string album;
+    std::string year;
+    std::string genre;
+    bool found = false;     // false: MusicBrainz had no match (cached too)
+};
+
+// Split an ICY StreamTitle ("Artist - Title") into its parts
+bool split_stream_title(const std::string& stream_title, std::string& artist, std::string& title);
+
+// Cache key for an artist/title pair: lowercase, bracketed suffixes such
+// as "(Radio Edit)" removed, whitespace collapsed
+std::string normalize_track_key(const std::string& artist, const std::string& title);
+
+// Fills out from the body of a /ws/2/recording search (the first
+// recording scoring 80 or more). Fields that are missing, null or of an
+// unexpected type are left empty. False if body is not a JSON object.
+bool parse_recording_search(const std::string& body, TrackInfo& out);
+
+// Least-recently-used map of track key -> TrackInfo, persisted as JSON
+// in most-recently-used order. Thread-safe.
+class TrackInfoCache {
+public:
+    explicit TrackInfoCache(size_t capacity) : capacity_(capacity) {}
+
+    std::optional<TrackInfo> get(const std::string& key);
+    void put(const std::string& key, const TrackInfo& info);
+
+    bool load(const std::string& path);
+    bool save(const std::string& path);
+
+private:
+    using Entry = std::pair<std::string, TrackInfo>;
+
+    size_t capacity_;
+    std::mutex mutex_;
+    std::list<Entry> entries_;  // front = most recently used
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    bool dirty_ = false;
+};
+
+// Looks up album/year/genre for stream titles on a background thread.
+//
+// lookup() answers from the on-disk LRU cache immediately when it can;
+// otherwise the title is queued. Requests for the same track are
+// coalesced, and the worker never issues more than one request per
+// second (MusicBrainz's rate limit for anonymous clients). Finished
+// lookups are collected by the UI thread with take_result().
+//
+// At most MAX_QUEUED distinct tracks wait; beyond that the oldest is
+// dropped (counted in dropped_lookups() and the
+// webradio_musicbrainz_dropped_lookups metric).
+//
+// The server defaults to https://musicbrainz.org and can be pointed at
+// a local mock with WEBRADIO_MUSICBRAINZ_URL, or replaced entirely by
+// passing a fetcher.
+class MusicBrainzClient {
+public:
+    static constexpr size_t CACHE_CAPACITY = 4096;
+    static constexpr size_t MAX_QUEUED = 16;
+    static constexpr std::chrono::milliseconds MIN_REQUEST_INTERVAL{1000};
+
+    struct Result {
+        std::string stream_title;
+        TrackInfo info;
+    };
+
+    // Looks up artist/title; returns false if the server could not be
+    // asked (the worker backs off), true with out.found = false for no match
+    using Fetcher = std::function<bool(const std::string& artist, const std::string& title, TrackInfo& out)>;
+
+    // Without a fetcher, lookups query the MusicBrainz web service
+    explicit MusicBrainzClient(Fetcher fetcher = {});
+    ~MusicBrainzClient();
+
+    MusicBrainzClient(const MusicBrainzClient&) = delete;
+    MusicBrainzClient& operator=(const MusicBrainzClient&) = delete;
+
+    // Cached info for stream_title, or nullopt after queueing a lookup
+    std::optional<TrackInfo> lookup(const std::string& stream_title);
+
+    bool take_result(Result& out);
+
+    // Queued lookups discarded because the queue was full
+    uint64_t dropped_lookups() const { return dropped_.load(std::memory_order_relaxed); }
+
+    void stop();
+
+private:
+    struct Request {
+        std::string key;
+        std::string artist;
+        std::string title;
+        std::unordered_set<std::string> stream_titles;  // coalesced callers
+    };
+
+    void worker();
+    bool query(const Request& request, TrackInfo& out);
+
+    Fetcher fetcher_;
+    std::string base_url_;
+    std::string cache_path_;
+    TrackInfoCache cache_{CACHE_CAPACITY};
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Request> queue_;
+    std::string active_key_;                              // request being fetched
+    std::unordered_set<std::string> active_titles_;
+    std::deque<Result> results_;
+    std::atomic<bool> has_results_{false};
+    std::chrono::steady_clock::time_point next_request_at_{};
+    std::atomic<uint64_t> dropped_{0};
+
+    std::thread worker_;
+    std::atomic<bool> stop_requested_{false};
+};
+
+#endif // MUSICBRAINZ_HPP
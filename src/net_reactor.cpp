@@ -0,0 +1,596 @@
+#include "net_reactor.hpp"
+#include "thread_name.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#ifdef __linux__
+#include <cerrno>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifdef WEBRADIO_HAVE_OPENSSL
+#include <openssl/ssl.h>
+#endif
+
+namespace {
+
+constexpr auto DNS_TTL = std::chrono::minutes(10);
+constexpr auto DNS_FAILURE_TTL = std::chrono::minutes(1);
+constexpr int MAX_EVENTS = 64;
+// epoll data of the wake eventfd; task ids start at 1
+constexpr uint64_t WAKE_ID = 0;
+
+// Every address getaddrinfo returns, in its order; empty on failure.
+// Blocking: helper thread only.
+std::vector<NetAddress> lookup_addresses(const std::string& host, const std::string& port) {
+    std::vector<NetAddress> addrs;
+#ifdef __linux__
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) == 0) {
+        for (addrinfo* ai = result; ai; ai = ai->ai_next) {
+            auto* bytes = reinterpret_cast<const unsigned char*>(ai->ai_addr);
+            addrs.emplace_back(bytes, bytes + ai->ai_addrlen);
+        }
+        freeaddrinfo(result);
+    }
+#else
+    (void)host;
+    (void)port;
+#endif
+    return addrs;
+}
+
+} // namespace
+
+ReactorTask::promise_type::~promise_type() {
+    if (reactor) {
+        reactor->forget(*this);
+    }
+}
+
+bool NetSocket::connect(const NetAddress& addr, int recv_buffer) {
+#ifdef __linux__
+    close();
+    if (addr.empty()) {
+        return false;
+    }
+    const auto* sa = reinterpret_cast<const sockaddr*>(addr.data());
+    fd_ = socket(sa->sa_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) {
+        return false;
+    }
+    if (recv_buffer > 0) {
+        setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &recv_buffer, sizeof(recv_buffer));
+    }
+    return ::connect(fd_, sa, static_cast<socklen_t>(addr.size())) == 0 || errno == EINPROGRESS;
+#else
+    (void)addr;
+    (void)recv_buffer;
+    return false;
+#endif
+}
+
+int NetSocket::connect_error() const {
+#ifdef __linux__
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(fd_, SOL_SOCKET, SO_ERROR, &err, &len) < 0) {
+        return errno;
+    }
+    return err;
+#else
+    return -1;
+#endif
+}
+
+bool NetSocket::start_tls(void* ssl_ctx, const std::string& host) {
+#ifdef WEBRADIO_HAVE_OPENSSL
+    if (!ssl_ctx || fd_ < 0) {
+        return false;
+    }
+    SSL* ssl = SSL_new(static_cast<SSL_CTX*>(ssl_ctx));
+    if (!ssl) {
+        return false;
+    }
+    ssl_ = ssl;
+    SSL_set_fd(ssl, fd_);
+    SSL_set_tlsext_host_name(ssl, host.c_str());
+    SSL_set1_host(ssl, host.c_str());
+    SSL_set_connect_state(ssl);
+    return true;
+#else
+    (void)ssl_ctx;
+    (void)host;
+    return false;
+#endif
+}
+
+int NetSocket::handshake() {
+#ifdef WEBRADIO_HAVE_OPENSSL
+    int ret = SSL_do_handshake(static_cast<SSL*>(ssl_));
+    if (ret == 1) {
+        return 1;
+    }
+    int err = SSL_get_error(static_cast<SSL*>(ssl_), ret);
+    if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
+        want_read_ = err == SSL_ERROR_WANT_READ;
+        return 0;
+    }
+#endif
+    return -1;
+}
+
+long NetSocket::read(void* buf, size_t len) {
+#ifdef WEBRADIO_HAVE_OPENSSL
+    if (ssl_) {
+        int n = SSL_read(static_cast<SSL*>(ssl_), buf, static_cast<int>(std::min<size_t>(len, INT_MAX)));
+        if (n > 0) return n;
+        int err = SSL_get_error(static_cast<SSL*>(ssl_), n);
+        if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) return IO_WOULD_BLOCK;
+        return err == SSL_ERROR_ZERO_RETURN ? 0 : IO_ERROR;
+    }
+#endif
+#ifdef __linux__
+    ssize_t n = recv(fd_, buf, len, 0);
+    if (n < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? IO_WOULD_BLOCK : IO_ERROR;
+    }
+    return static_cast<long>(n);
+#else
+    (void)buf;
+    (void)len;
+    return IO_ERROR;
+#endif
+}
+
+long NetSocket::write(const void* buf, size_t len) {
+#ifdef WEBRADIO_HAVE_OPENSSL
+    if (ssl_) {
+        int n = SSL_write(static_cast<SSL*>(ssl_), buf, static_cast<int>(std::min<size_t>(len, INT_MAX)));
+        if (n > 0) return n;
+        int err = SSL_get_error(static_cast<SSL*>(ssl_), n);
+        return (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) ? IO_WOULD_BLOCK : IO_ERROR;
+    }
+#endif
+#ifdef __linux__
+    ssize_t n = send(fd_, buf, len, MSG_NOSIGNAL);
+    if (n < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? IO_WOULD_BLOCK : IO_ERROR;
+    }
+    return static_cast<long>(n);
+#else
+    (void)buf;
+    (void)len;
+    return IO_ERROR;
+#endif
+}
+
+void NetSocket::close() {
+#ifdef WEBRADIO_HAVE_OPENSSL
+    if (ssl_) {
+        SSL_free(static_cast<SSL*>(ssl_));
+    }
+#endif
+    ssl_ = nullptr;
+    want_read_ = false;
+#ifdef __linux__
+    // Closing also drops the fd from the epoll set
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+#endif
+    fd_ = -1;
+}
+
+NetReactor::NetReactor(const std::string& name)
+    : name_(name)
+{
+}
+
+NetReactor::~NetReactor() {
+    stop();
+#ifdef __linux__
+    if (epoll_fd_ >= 0) {
+        close(epoll_fd_);
+    }
+    if (wake_fd_ >= 0) {
+        close(wake_fd_);
+    }
+#endif
+#ifdef WEBRADIO_HAVE_OPENSSL
+    SSL_CTX_free(static_cast<SSL_CTX*>(ssl_ctx_));
+#endif
+}
+
+bool NetReactor::start() {
+#ifdef __linux__
+    if (thread_.joinable()) {
+        return true;
+    }
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+        error_ = std::string("epoll_create1: ") + std::strerror(errno);
+        return false;
+    }
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+        error_ = std::string("eventfd: ") + std::strerror(errno);
+        return false;
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = WAKE_ID;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+
+#ifdef WEBRADIO_HAVE_OPENSSL
+    SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
+    if (ctx) {
+        SSL_CTX_set_default_verify_paths(ctx);
+        SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, nullptr);
+    }
+    ssl_ctx_ = ctx;
+#endif
+
+    thread_ = std::thread([this]() {
+        set_thread_name(name_.c_str());
+        run();
+    });
+    helper_thread_ = std::thread([this, thread_name = name_ + " helper"]() {
+        set_thread_name(thread_name.c_str());
+        helper();
+    });
+    return true;
+#else
+    error_ = "not supported on this platform";
+    return false;
+#endif
+}
+
+void NetReactor::stop() {
+    {
+        std::lock_guard<std::mutex> lock(inbox_mutex_);
+        stopped_ = true;
+    }
+    {
+        std::lock_guard<std::mutex> lock(helper_mutex_);
+        stop_requested_ = true;
+    }
+    helper_cv_.notify_all();
+#ifdef __linux__
+    if (wake_fd_ >= 0) {
+        uint64_t one = 1;
+        (void)!write(wake_fd_, &one, sizeof(one));
+    }
+#endif
+    if (helper_thread_.joinable()) {
+        helper_thread_.join();
+    }
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+    // Both threads are gone: free what is left. Destroying a frame
+    // unregisters it, so collect the handles first.
+    std::vector<ReactorTask::Handle> frames;
+    for (auto& [id, handle] : tasks_) {
+        frames.push_back(handle);
+    }
+    {
+        std::lock_guard<std::mutex> lock(inbox_mutex_);
+        for (auto& message : inbox_) {
+            if (message.command == Command::Start) {
+                frames.push_back(message.handle);
+            }
+        }
+        inbox_.clear();
+    }
+    for (auto& handle : frames) {
+        handle.destroy();
+    }
+    tasks_.clear();
+    timers_.clear();
+    std::lock_guard<std::mutex> lock(helper_mutex_);
+    helper_queue_.clear();
+}
+
+uint64_t NetReactor::spawn(ReactorTask task) {
+    ReactorTask::Handle handle = std::exchange(task.handle_, nullptr);
+    ReactorTask::promise_type& promise = handle.promise();
+    promise.reactor = this;
+    promise.id = next_id_.fetch_add(1, std::memory_order_relaxed);
+    task_count_.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t id = promise.id;
+    {
+        std::lock_guard<std::mutex> lock(inbox_mutex_);
+        if (!stopped_) {
+            bool signal = inbox_.empty();
+            inbox_.push_back(Message{id, Command::Start, handle});
+            if (signal) {
+#ifdef __linux__
+                uint64_t one = 1;
+                (void)!write(wake_fd_, &one, sizeof(one));
+#endif
+            }
+            return id;
+        }
+    }
+    handle.destroy();
+    return 0;
+}
+
+void NetReactor::wake(uint64_t id) {
+    post(id, Command::Wake);
+}
+
+void NetReactor::cancel(uint64_t id) {
+    post(id, Command::Cancel);
+}
+
+void NetReactor::post(uint64_t id, Command command, ReactorTask::Handle handle) {
+    std::lock_guard<std::mutex> lock(inbox_mutex_);
+    if (stopped_) {
+        return;
+    }
+    // One eventfd write per batch: the reactor drains the whole inbox
+    bool signal = inbox_.empty();
+    inbox_.push_back(Message{id, command, handle});
+    if (signal) {
+#ifdef __linux__
+        uint64_t one = 1;
+        (void)!write(wake_fd_, &one, sizeof(one));
+#endif
+    }
+}
+
+void NetReactor::run() {
+#ifdef __linux__
+    epoll_event events[MAX_EVENTS];
+    while (!stop_requested_) {
+        int timeout_ms = -1;
+        if (!timers_.empty()) {
+            auto wait = timers_.begin()->first - Clock::now();
+            // Round up, so a timer is never polled for early
+            auto ms = std::chrono::ceil<std::chrono::milliseconds>(wait).count();
+            timeout_ms = static_cast<int>(std::clamp<long long>(ms, 0, 60'000));
+        }
+
+        int n = epoll_wait(epoll_fd_, events, MAX_EVENTS, timeout_ms);
+        bool drain = false;
+        for (int i = 0; i < n; ++i) {
+            uint64_t id = events[i].data.u64;
+            if (id == WAKE_ID) {
+                uint64_t value;
+                (void)!read(wake_fd_, &value, sizeof(value));
+                drain = true;
+                continue;
+            }
+            auto it = tasks_.find(id);
+            if (it != tasks_.end() && it->second.promise().wait == ReactorTask::promise_type::Wait::Io) {
+                resume(it->second.promise(), WaitResult::Ready);
+            }
+        }
+        if (drain && !stop_requested_) {
+            drain_inbox();
+        }
+        expire_timers();
+    }
+#endif
+}
+
+void NetReactor::drain_inbox() {
+    using Wait = ReactorTask::promise_type::Wait;
+    {
+        std::lock_guard<std::mutex> lock(inbox_mutex_);
+        draining_.swap(inbox_);
+    }
+    for (const Message& message : draining_) {
+        if (message.command == Command::Start) {
+            ReactorTask::promise_type& promise = message.handle.promise();
+            promise.started = true;
+            tasks_.emplace(message.id, message.handle);
+            message.handle.resume();
+            continue;
+        }
+
+        // The task may have finished since
+        auto it = tasks_.find(message.id);
+        if (it == tasks_.end()) {
+            continue;
+        }
+        ReactorTask::promise_type& promise = it->second.promise();
+        switch (message.command) {
+        case Command::Wake:
+            if (promise.wait == Wait::Park) {
+                resume(promise, WaitResult::Ready);
+            } else {
+                promise.woken = true;
+            }
+            break;
+        case Command::Cancel:
+            promise.cancelled = true;
+            // An offloaded call still uses the frame; it ends the wait
+            if (promise.wait == Wait::Io || promise.wait == Wait::Park) {
+                resume(promise, WaitResult::Cancelled);
+            }
+            break;
+        case Command::OffloadDone:
+            if (promise.wait == Wait::Offload) {
+                resume(promise, promise.cancelled ? WaitResult::Cancelled : WaitResult::Ready);
+            }
+            break;
+        case Command::Start:
+            break;
+        }
+    }
+    draining_.clear();
+}
+
+void NetReactor::expire_timers() {
+    auto now = Clock::now();
+    while (!timers_.empty() && timers_.begin()->first <= now) {
+        auto it = tasks_.find(timers_.begin()->second);
+        if (it == tasks_.end()) {
+            timers_.erase(timers_.begin());
+            continue;
+        }
+        resume(it->second.promise(), WaitResult::Timeout);
+    }
+}
+
+void NetReactor::resume(ReactorTask::promise_type& promise, WaitResult result) {
+    if (promise.deadline != Clock::time_point::max()) {
+        timers_.erase({promise.deadline, promise.id});
+        promise.deadline = Clock::time_point::max();
+    }
+    promise.wait = ReactorTask::promise_type::Wait::None;
+    promise.wait_fd = -1;
+    promise.result = result;
+    if (promise.current) {
+        promise.current.resume();
+    } else {
+        ReactorTask::Handle::from_promise(promise).resume();
+    }
+}
+
+void NetReactor::begin_wait(ReactorTask::promise_type& promise, ReactorTask::promise_type::Wait wait,
+                            Clock::duration timeout) {
+    promise.wait = wait;
+    if (timeout != NO_TIMEOUT) {
+        promise.deadline = Clock::now() + timeout;
+        timers_.emplace(promise.deadline, promise.id);
+    }
+}
+
+bool NetReactor::arm(int fd, uint32_t events, uint64_t id) {
+#ifdef __linux__
+    // One-shot: an fd only reports while its task waits on it
+    epoll_event ev{};
+    ev.events = events | EPOLLONESHOT;
+    ev.data.u64 = id;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev) == 0) {
+        return true;
+    }
+    return errno == ENOENT && epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) == 0;
+#else
+    (void)fd;
+    (void)events;
+    (void)id;
+    return false;
+#endif
+}
+
+void NetReactor::forget(ReactorTask::promise_type& promise) {
+    // Frames that never started are not known to the reactor thread
+    if (promise.started) {
+        tasks_.erase(promise.id);
+        if (promise.deadline != Clock::time_point::max()) {
+            timers_.erase({promise.deadline, promise.id});
+        }
+    }
+    task_count_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void NetReactor::helper() {
+    for (;;) {
+        std::pair<uint64_t, std::function<void()>> job;
+        {
+            std::unique_lock<std::mutex> lock(helper_mutex_);
+            helper_cv_.wait(lock, [this]() { return stop_requested_ || !helper_queue_.empty(); });
+            if (stop_requested_) {
+                return;
+            }
+            job = std::move(helper_queue_.front());
+            helper_queue_.pop_front();
+        }
+        job.second();
+        post(job.first, Command::OffloadDone);
+    }
+}
+
+bool NetReactor::IoAwaiter::suspend(ReactorTask::promise_type& task) {
+    promise = &task;
+    if (promise->cancelled) {
+        promise->result = WaitResult::Cancelled;
+        return false;
+    }
+    if (!reactor.arm(fd, events, promise->id)) {
+        // The next call on the fd fails and reports why
+        promise->result = WaitResult::Ready;
+        return false;
+    }
+    promise->wait_fd = fd;
+    reactor.begin_wait(task, ReactorTask::promise_type::Wait::Io, timeout);
+    return true;
+}
+
+bool NetReactor::ParkAwaiter::suspend(ReactorTask::promise_type& task) {
+    promise = &task;
+    if (promise->cancelled) {
+        promise->result = WaitResult::Cancelled;
+        return false;
+    }
+    if (promise->woken) {
+        promise->woken = false;
+        promise->result = WaitResult::Ready;
+        return false;
+    }
+    reactor.begin_wait(task, ReactorTask::promise_type::Wait::Park, timeout);
+    return true;
+}
+
+bool NetReactor::OffloadAwaiter::suspend(ReactorTask::promise_type& task) {
+    promise = &task;
+    if (promise->cancelled) {
+        promise->result = WaitResult::Cancelled;
+        return false;
+    }
+    reactor.begin_wait(task, ReactorTask::promise_type::Wait::Offload, NO_TIMEOUT);
+    {
+        std::lock_guard<std::mutex> lock(reactor.helper_mutex_);
+        reactor.helper_queue_.emplace_back(promise->id, std::move(fn));
+    }
+    reactor.helper_cv_.notify_one();
+    return true;
+}
+
+bool NetReactor::ResolveAwaiter::await_ready() {
+    auto it = reactor.dns_cache_.find(host + ":" + port);
+    if (it == reactor.dns_cache_.end() || Clock::now() >= it->second.expires) {
+        return false;
+    }
+    addrs = it->second.addrs;
+    return true;
+}
+
+bool NetReactor::ResolveAwaiter::suspend(ReactorTask::promise_type& task) {
+    // The awaiter lives in the suspended frame, so the lookup can fill it
+    OffloadAwaiter lookup{reactor, [this]() { addrs = lookup_addresses(host, port); }};
+    bool suspended = lookup.suspend(task);
+    promise = lookup.promise;
+    return suspended;
+}
+
+std::vector<NetAddress> NetReactor::ResolveAwaiter::await_resume() {
+    if (!promise) {
+        // From the cache
+        return std::move(addrs);
+    }
+    if (promise->result != WaitResult::Ready) {
+        return {};
+    }
+    DnsEntry& entry = reactor.dns_cache_[host + ":" + port];
+    entry.addrs = addrs;
+    entry.expires = Clock::now() + (addrs.empty() ? Clock::duration(DNS_FAILURE_TTL) : Clock::duration(DNS_TTL));
+    return std::move(addrs);
+}
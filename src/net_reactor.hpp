@@ -0,0 +1,353 @@
+#ifndef NET_REACTOR_HPP
+#define NET_REACTOR_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class NetReactor;
+
+// Raw sockaddr bytes
+using NetAddress = std::vector<unsigned char>;
+
+enum class WaitResult {
+    Ready,          // the fd is ready, the task was woken, or the offloaded call returned
+    Timeout,
+    Cancelled,      // cancel() was called; every later wait returns this too
+};
+
+// A coroutine run by a NetReactor, started by NetReactor::spawn(). The
+// frame frees itself when the body returns; the reactor frees frames
+// still suspended when it stops, which runs their locals' destructors.
+class ReactorTask {
+public:
+    struct promise_type {
+        enum class Wait : uint8_t { None, Io, Park, Offload };
+
+        ReactorTask get_return_object() {
+            return ReactorTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+        ~promise_type();
+
+        // The task a coroutine belongs to (see ReactorCall)
+        promise_type& task() { return *this; }
+
+        NetReactor* reactor = nullptr;
+        uint64_t id = 0;
+
+        // Reactor thread only
+        std::coroutine_handle<> current;    // the ReactorCall being run, if any
+        Wait wait = Wait::None;
+        int wait_fd = -1;
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+        WaitResult result = WaitResult::Ready;
+        bool started = false;
+        bool cancelled = false;
+        bool woken = false;         // wake() arrived while not parked
+    };
+
+    using Handle = std::coroutine_handle<promise_type>;
+
+    ReactorTask(ReactorTask&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    ReactorTask& operator=(ReactorTask&&) = delete;
+    // A task that was never spawned is simply dropped
+    ~ReactorTask() {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+private:
+    friend class NetReactor;
+    explicit ReactorTask(Handle handle) : handle_(handle) {}
+
+    Handle handle_;
+};
+
+// A coroutine that a reactor task co_awaits for a step shared between
+// tasks, returning T. It runs when awaited, can wait on the same
+// awaitables as the task (its waits, wakes and cancels are the task's),
+// and is freed with the co_await expression, or with the task's frame.
+template <typename T>
+class ReactorCall {
+public:
+    struct promise_type {
+        ReactorCall get_return_object() {
+            return ReactorCall(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        auto final_suspend() noexcept { return Return{}; }
+        void return_value(T result) { value = std::move(result); }
+        void unhandled_exception() { std::terminate(); }
+
+        ReactorTask::promise_type& task() { return *root; }
+
+        ReactorTask::promise_type* root = nullptr;
+        std::coroutine_handle<> caller;
+        std::coroutine_handle<> caller_current;     // root->current while the caller ran
+        T value{};
+    };
+
+    using Handle = std::coroutine_handle<promise_type>;
+
+    ReactorCall(ReactorCall&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    ReactorCall& operator=(ReactorCall&&) = delete;
+    ~ReactorCall() {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return false; }
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> caller) {
+        promise_type& promise = handle_.promise();
+        promise.root = &caller.promise().task();
+        promise.caller = caller;
+        promise.caller_current = promise.root->current;
+        // The reactor resumes the innermost call when a wait ends
+        promise.root->current = handle_;
+        return handle_;
+    }
+    T await_resume() { return std::move(handle_.promise().value); }
+
+private:
+    // Back to the caller once the body has returned
+    struct Return {
+        bool await_ready() const noexcept { return false; }
+        std::coroutine_handle<> await_suspend(Handle handle) noexcept {
+            promise_type& promise = handle.promise();
+            promise.root->current = promise.caller_current;
+            return promise.caller;
+        }
+        void await_resume() const noexcept {}
+    };
+
+    explicit ReactorCall(Handle handle) : handle_(handle) {}
+
+    Handle handle_;
+};
+
+// A non-blocking TCP connection, optionally TLS. Owned by one reactor
+// task; closed by its destructor.
+class NetSocket {
+public:
+    static constexpr long IO_WOULD_BLOCK = -1;
+    static constexpr long IO_ERROR = -2;
+
+    NetSocket() = default;
+    ~NetSocket() { close(); }
+
+    NetSocket(const NetSocket&) = delete;
+    NetSocket& operator=(const NetSocket&) = delete;
+
+    // Starts connecting to addr; wait writable, then check connect_error().
+    // recv_buffer, if not 0, sets SO_RCVBUF first.
+    bool connect(const NetAddress& addr, int recv_buffer = 0);
+    // 0 once connected, else the errno of the failed connect
+    int connect_error() const;
+
+    // TLS over the connected socket; then call handshake() until it returns
+    // 1 (0: wait for want_read() ? readable : writable, -1: failed)
+    bool start_tls(void* ssl_ctx, const std::string& host);
+    int handshake();
+    bool want_read() const { return want_read_; }
+
+    // Bytes transferred, 0 at end of stream, or IO_WOULD_BLOCK / IO_ERROR
+    long read(void* buf, size_t len);
+    long write(const void* buf, size_t len);
+
+    int fd() const { return fd_; }
+    void close();
+
+private:
+    int fd_ = -1;
+    void* ssl_ = nullptr;   // SSL* when built with OpenSSL
+    bool want_read_ = false;
+};
+
+// One epoll thread running coroutines (ReactorTask) that each drive a
+// socket. Tasks wait with co_await on the awaitables below, which only
+// work from inside a task of this reactor (or a ReactorCall it awaits):
+//
+//   co_await reactor.io(fd, EPOLLIN, timeout)   until fd is readable/writable
+//   co_await reactor.park()                     until wake(id)
+//   co_await reactor.offload(fn)                runs fn on the helper thread
+//   co_await reactor.resolve(host, port)        getaddrinfo, cached
+//
+// io() can return Ready spuriously; retry the call and wait again on
+// IO_WOULD_BLOCK.
+//
+// Blocking calls (DNS, playlist fetches) go to a single helper thread, so
+// a slow lookup does not stall the other sockets. spawn(), wake() and
+// cancel() may be called from any thread; everything else a task does
+// runs on the reactor thread. Linux only: start() fails elsewhere.
+class NetReactor {
+public:
+    using Clock = std::chrono::steady_clock;
+    static constexpr Clock::duration NO_TIMEOUT = Clock::duration::max();
+
+    explicit NetReactor(const std::string& name = "reactor");
+    ~NetReactor();
+
+    NetReactor(const NetReactor&) = delete;
+    NetReactor& operator=(const NetReactor&) = delete;
+
+    // Returns false and sets error() on failure
+    bool start();
+    // Frees every task still suspended
+    void stop();
+    const std::string& error() const { return error_; }
+
+    // Queues task to start on the reactor thread and returns its id (never
+    // 0). After stop() the task is freed right away and 0 is returned.
+    uint64_t spawn(ReactorTask task);
+    // Resumes the task if it is parked, or makes its next park() return
+    // at once
+    void wake(uint64_t id);
+    // Resumes the task's current wait (except an offload, which finishes
+    // first) with Cancelled
+    void cancel(uint64_t id);
+
+    // Tasks started and not yet finished
+    size_t tasks() const { return task_count_.load(std::memory_order_relaxed); }
+    // SSL_CTX* for NetSocket::start_tls, nullptr without OpenSSL
+    void* ssl_context() const { return ssl_ctx_; }
+
+    struct IoAwaiter {
+        NetReactor& reactor;
+        int fd;
+        uint32_t events;
+        Clock::duration timeout;
+        ReactorTask::promise_type* promise = nullptr;
+
+        bool await_ready() const noexcept { return false; }
+        template <typename Promise>
+        bool await_suspend(std::coroutine_handle<Promise> handle) { return suspend(handle.promise().task()); }
+        bool suspend(ReactorTask::promise_type& task);
+        WaitResult await_resume() const noexcept { return promise->result; }
+    };
+
+    struct ParkAwaiter {
+        NetReactor& reactor;
+        Clock::duration timeout;
+        ReactorTask::promise_type* promise = nullptr;
+
+        bool await_ready() const noexcept { return false; }
+        template <typename Promise>
+        bool await_suspend(std::coroutine_handle<Promise> handle) { return suspend(handle.promise().task()); }
+        bool suspend(ReactorTask::promise_type& task);
+        WaitResult await_resume() const noexcept { return promise->result; }
+    };
+
+    struct OffloadAwaiter {
+        NetReactor& reactor;
+        std::function<void()> fn;
+        ReactorTask::promise_type* promise = nullptr;
+
+        bool await_ready() const noexcept { return false; }
+        template <typename Promise>
+        bool await_suspend(std::coroutine_handle<Promise> handle) { return suspend(handle.promise().task()); }
+        bool suspend(ReactorTask::promise_type& task);
+        WaitResult await_resume() const noexcept { return promise->result; }
+    };
+
+    // Every address of host:port in getaddrinfo's order, to be tried in
+    // turn; empty if it does not resolve or the task was cancelled
+    struct ResolveAwaiter {
+        NetReactor& reactor;
+        std::string host;
+        std::string port;
+        std::vector<NetAddress> addrs;
+        ReactorTask::promise_type* promise = nullptr;
+
+        bool await_ready();
+        template <typename Promise>
+        bool await_suspend(std::coroutine_handle<Promise> handle) { return suspend(handle.promise().task()); }
+        bool suspend(ReactorTask::promise_type& task);
+        std::vector<NetAddress> await_resume();
+    };
+
+    IoAwaiter io(int fd, uint32_t events, Clock::duration timeout = NO_TIMEOUT) {
+        return IoAwaiter{*this, fd, events, timeout};
+    }
+    ParkAwaiter park(Clock::duration timeout = NO_TIMEOUT) { return ParkAwaiter{*this, timeout}; }
+    OffloadAwaiter offload(std::function<void()> fn) { return OffloadAwaiter{*this, std::move(fn)}; }
+    ResolveAwaiter resolve(const std::string& host, const std::string& port) {
+        return ResolveAwaiter{*this, host, port, {}};
+    }
+
+private:
+    friend struct ReactorTask::promise_type;
+
+    enum class Command : uint8_t { Start, Wake, Cancel, OffloadDone };
+
+    struct Message {
+        uint64_t id;
+        Command command;
+        ReactorTask::Handle handle;     // Start only
+    };
+
+    struct DnsEntry {
+        std::vector<NetAddress> addrs;
+        Clock::time_point expires;
+    };
+
+    void run();
+    void helper();
+    void post(uint64_t id, Command command, ReactorTask::Handle handle = nullptr);
+    void drain_inbox();
+    void expire_timers();
+    // Ends the task's current wait with result and resumes it (or the call
+    // it is in)
+    void resume(ReactorTask::promise_type& promise, WaitResult result);
+    void begin_wait(ReactorTask::promise_type& promise, ReactorTask::promise_type::Wait wait, Clock::duration timeout);
+    bool arm(int fd, uint32_t events, uint64_t id);
+    void forget(ReactorTask::promise_type& promise);
+
+    std::string name_;
+    std::string error_;
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    void* ssl_ctx_ = nullptr;
+    std::thread thread_;
+    std::thread helper_thread_;
+
+    // Any thread
+    std::mutex inbox_mutex_;
+    std::vector<Message> inbox_;
+    bool stopped_ = false;
+    std::atomic<uint64_t> next_id_{1};
+    std::atomic<bool> stop_requested_{false};
+    std::atomic<size_t> task_count_{0};
+
+    // Reactor thread only
+    std::vector<Message> draining_;
+    std::unordered_map<uint64_t, ReactorTask::Handle> tasks_;
+    std::set<std::pair<Clock::time_point, uint64_t>> timers_;
+    std::unordered_map<std::string, DnsEntry> dns_cache_;
+
+    // Helper thread queue
+    std::mutex helper_mutex_;
+    std::condition_variable helper_cv_;
+    std::deque<std::pair<uint64_t, std::function<void()>>> helper_queue_;
+};
+
+#endif // NET_REACTOR_HPP
@@ -0,0 +1,155 @@
+#include "perf_sampler.hpp"
+#include "byte_ringbuffer.hpp"
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Format of the playback ring: 44.1 kHz, 16-bit stereo
+constexpr double PCM_BYTES_PER_SECOND = 44100.0 * 4.0;
+
+#ifdef __linux__
+// Whole small /proc file into buf; returns length or -1
+ssize_t read_small_file(const char* path, char* buf, size_t size) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t n = read(fd, buf, size - 1);
+    close(fd);
+    if (n >= 0) {
+        buf[n] = '\0';
+    }
+    return n;
+}
+#endif
+
+} // namespace
+
+const PerfSnapshot& PerfSampler::sample(const CallbackMonitor::Stats& callback) {
+    auto now = std::chrono::steady_clock::now();
+    double elapsed_s = primed_ ? std::chrono::duration<double>(now - last_time_).count() : 0.0;
+    last_time_ = now;
+
+    EngineMetrics& metrics = engine_metrics();
+    uint64_t bytes_in = metrics.bytes_in.value();
+    uint64_t pcm_bytes = metrics.pcm_bytes.value();
+    uint64_t decode_ns = metrics.decode_ns.sum();
+    uint64_t underruns = metrics.underruns.value();
+
+    PerfSnapshot& s = snapshot_;
+    s.ring_fill_bytes = metrics.ring_fill_bytes.value();
+    s.ring_fill.push_back(static_cast<float>(s.ring_fill_bytes / ByteRingbuffer::BUFFER_SIZE));
+    while (s.ring_fill.size() > RING_HISTORY) {
+        s.ring_fill.pop_front();
+    }
+    s.underruns = underruns;
+    s.callback_p99_ns = callback.p99_ns;
+    s.callback_budget_ns = callback.budget_ns;
+
+    if (primed_ && elapsed_s > 0.0) {
+        s.underruns_delta = underruns - last_underruns_;
+        s.net_kbit_s = static_cast<double>(bytes_in - last_bytes_in_) * 8.0 / 1000.0 / elapsed_s;
+        double audio_s = static_cast<double>(pcm_bytes - last_pcm_bytes_) / PCM_BYTES_PER_SECOND;
+        s.decode_ms_per_audio_s = audio_s > 0.0 ? static_cast<double>(decode_ns - last_decode_ns_) / 1e6 / audio_s : 0.0;
+    }
+    last_bytes_in_ = bytes_in;
+    last_pcm_bytes_ = pcm_bytes;
+    last_decode_ns_ = decode_ns;
+    last_underruns_ = underruns;
+
+    sample_threads(elapsed_s);
+
+#ifdef __linux__
+    char buf[256];
+    if (read_small_file("/proc/self/statm", buf, sizeof(buf)) > 0) {
+        char* p = buf;
+        std::strtoull(p, &p, 10);   // size
+        s.rss_bytes = std::strtoull(p, nullptr, 10) * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    }
+#endif
+
+    primed_ = true;
+    return s;
+}
+
+void PerfSampler::sample_threads(double elapsed_s) {
+#ifdef __linux__
+    static const double ticks_per_second = static_cast<double>(sysconf(_SC_CLK_TCK));
+
+    std::unordered_map<int, uint64_t> ticks;
+    std::vector<PerfSnapshot::ThreadCpu> threads;
+    double total = 0.0;
+
+    DIR* dir = opendir("/proc/self/task");
+    if (!dir) {
+        return;
+    }
+    char path[64];
+    char buf[512];
+    while (dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] < '0' || entry->d_name[0] > '9') {
+            continue;
+        }
+        int tid = std::atoi(entry->d_name);
+        std::snprintf(path, sizeof(path), "/proc/self/task/%d/stat", tid);
+        if (read_small_file(path, buf, sizeof(buf)) <= 0) {
+            continue;   // thread exited meanwhile
+        }
+
+        // "tid (comm) state ppid ..."; comm may contain spaces and parens
+        char* open_paren = std::strchr(buf, '(');
+        char* close_paren = std::strrchr(buf, ')');
+        if (!open_paren || !close_paren || close_paren < open_paren) {
+            continue;
+        }
+        std::string name(open_paren + 1, close_paren);
+
+        // utime and stime are fields 14 and 15; field 3 follows ") "
+        char* p = close_paren + 2;
+        for (int field = 3; field < 14 && *p; ++field) {
+            p = std::strchr(p, ' ');
+            if (!p) break;
+            ++p;
+        }
+        if (!p) {
+            continue;
+        }
+        char* end = nullptr;
+        uint64_t utime = std::strtoull(p, &end, 10);
+        uint64_t stime = std::strtoull(end, nullptr, 10);
+        uint64_t used = utime + stime;
+        ticks[tid] = used;
+
+        auto last = last_ticks_.find(tid);
+        if (last == last_ticks_.end() || elapsed_s <= 0.0) {
+            continue;
+        }
+        double percent = static_cast<double>(used - last->second) / ticks_per_second / elapsed_s * 100.0;
+        total += percent;
+        threads.push_back({std::move(name), percent});
+    }
+    closedir(dir);
+
+    std::sort(threads.begin(), threads.end(), [](const auto& a, const auto& b) {
+        return a.percent > b.percent;
+    });
+    last_ticks_ = std::move(ticks);
+    if (elapsed_s > 0.0) {
+        snapshot_.threads = std::move(threads);
+        snapshot_.process_cpu = total;
+    }
+#else
+    (void)elapsed_s;
+#endif
+}
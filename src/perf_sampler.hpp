@@ -0,0 +1,57 @@
+#ifndef PERF_SAMPLER_HPP
+#define PERF_SAMPLER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "callback_monitor.hpp"
+
+// What the performance panel shows, as of the last sample
+struct PerfSnapshot {
+    struct ThreadCpu {
+        std::string name;
+        double percent = 0.0;   // of one core
+    };
+    std::vector<ThreadCpu> threads;    // busiest first
+    double process_cpu = 0.0;
+    std::deque<float> ring_fill;       // 0..1, oldest first
+    double ring_fill_bytes = 0.0;
+    uint64_t underruns = 0;
+    uint64_t underruns_delta = 0;      // since the previous sample
+    uint32_t callback_p99_ns = 0;
+    uint32_t callback_budget_ns = 0;
+    double decode_ms_per_audio_s = 0.0;
+    double net_kbit_s = 0.0;
+    uint64_t rss_bytes = 0;
+};
+
+// Turns the engine counters and /proc into a PerfSnapshot. Reads only
+// relaxed atomics (no locks shared with the audio path) and a handful of
+// small /proc files: /proc/self/task/*/stat for per-thread CPU and
+// /proc/self/statm for RSS. Meant to be called about once a second from
+// the UI thread while the panel is open. Linux only for CPU and RSS.
+class PerfSampler {
+public:
+    static constexpr size_t RING_HISTORY = 120;   // sparkline samples
+
+    const PerfSnapshot& sample(const CallbackMonitor::Stats& callback);
+    const PerfSnapshot& snapshot() const { return snapshot_; }
+
+private:
+    void sample_threads(double elapsed_s);
+
+    PerfSnapshot snapshot_;
+    bool primed_ = false;
+    std::chrono::steady_clock::time_point last_time_{};
+    uint64_t last_bytes_in_ = 0;
+    uint64_t last_pcm_bytes_ = 0;
+    uint64_t last_decode_ns_ = 0;
+    uint64_t last_underruns_ = 0;
+    std::unordered_map<int, uint64_t> last_ticks_;   // tid -> utime + stime
+};
+
+#endif // PERF_SAMPLER_HPP
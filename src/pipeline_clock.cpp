@@ -0,0 +1,67 @@
+#include "pipeline_clock.hpp"
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+SteadyClock g_steady_clock;
+std::atomic<PipelineClock*> g_pipeline_clock{&g_steady_clock};
+
+} // namespace
+
+uint64_t SteadyClock::now_ns() {
+    return metrics_now_ns();
+}
+
+void SteadyClock::sleep_until_ns(uint64_t deadline_ns) {
+    std::this_thread::sleep_until(std::chrono::steady_clock::time_point(
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(deadline_ns))));
+}
+
+void VirtualClock::sleep_until_ns(uint64_t deadline_ns) {
+    for (;;) {
+        Timer* next = nullptr;
+        for (auto& timer : timers_) {
+            if (timer.active && timer.due_ns <= deadline_ns && (!next || timer.due_ns < next->due_ns)) {
+                next = &timer;
+            }
+        }
+        if (!next) {
+            break;
+        }
+        now_ns_ = std::max(now_ns_, next->due_ns);
+        next->due_ns += next->period_ns;
+        // Copy: the callback may add timers and move the vector
+        Callback callback = next->callback;
+        callback(now_ns_);
+    }
+    now_ns_ = std::max(now_ns_, deadline_ns);
+}
+
+size_t VirtualClock::every(uint64_t first_ns, uint64_t period_ns, Callback callback) {
+    Timer timer;
+    timer.due_ns = first_ns;
+    timer.period_ns = period_ns > 0 ? period_ns : 1;
+    timer.active = true;
+    timer.callback = std::move(callback);
+    timers_.push_back(std::move(timer));
+    return timers_.size() - 1;
+}
+
+void VirtualClock::cancel(size_t id) {
+    if (id < timers_.size()) {
+        timers_[id].active = false;
+    }
+}
+
+PipelineClock& pipeline_clock() {
+    return *g_pipeline_clock.load(std::memory_order_relaxed);
+}
+
+void set_pipeline_clock(PipelineClock* clock) {
+    g_pipeline_clock.store(clock ? clock : &g_steady_clock, std::memory_order_relaxed);
+}
@@ -0,0 +1,63 @@
+#ifndef PIPELINE_CLOCK_HPP
+#define PIPELINE_CLOCK_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Time source of the playback pipeline: play_stream, data_callback, the
+// UI loop, StreamDecoder's ring waits and session replay pacing read the
+// time and sleep through pipeline_clock(). It is real time unless a
+// simulation installs a VirtualClock. Durations that measure CPU work
+// (decode_ns, trace spans) stay on metrics_now_ns().
+class PipelineClock {
+public:
+    virtual ~PipelineClock() = default;
+
+    virtual uint64_t now_ns() = 0;
+    virtual void sleep_until_ns(uint64_t deadline_ns) = 0;
+    void sleep_for_ns(uint64_t ns) { sleep_until_ns(now_ns() + ns); }
+};
+
+// std::chrono::steady_clock, on the same timeline as metrics_now_ns()
+class SteadyClock final : public PipelineClock {
+public:
+    uint64_t now_ns() override;
+    void sleep_until_ns(uint64_t deadline_ns) override;
+};
+
+// Simulated time for a single-threaded driver. now_ns() only moves when
+// the driver sleeps, and a sleep runs every timer that falls due on the
+// way, in time order, before jumping to the deadline. A decoder waiting
+// for ring space thus lets a timer-driven device drain the ring without
+// any real waiting. Not thread-safe; timers must not sleep.
+class VirtualClock final : public PipelineClock {
+public:
+    using Callback = std::function<void(uint64_t now_ns)>;
+
+    uint64_t now_ns() override { return now_ns_; }
+    void sleep_until_ns(uint64_t deadline_ns) override;
+
+    // Runs callback at first_ns and then every period_ns until cancelled.
+    // Returns an id for cancel().
+    size_t every(uint64_t first_ns, uint64_t period_ns, Callback callback);
+    void cancel(size_t id);
+
+private:
+    struct Timer {
+        uint64_t due_ns = 0;
+        uint64_t period_ns = 0;
+        bool active = false;
+        Callback callback;
+    };
+
+    uint64_t now_ns_ = 0;
+    std::vector<Timer> timers_;
+};
+
+PipelineClock& pipeline_clock();
+// Install before the pipeline starts; nullptr restores real time
+void set_pipeline_clock(PipelineClock* clock);
+
+#endif // PIPELINE_CLOCK_HPP
@@ -0,0 +1,397 @@
+#include "playlist_resolver.hpp"
+#include "app_paths.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#include <nlohmann/json.hpp>
+
+extern "C" {
+#include <libavformat/avio.h>
+#include <libavutil/dict.h>
+}
+
+using json = nlohmann::json;
+
+static constexpr int FETCH_TIMEOUT_US = 5000000;
+static constexpr size_t MAX_PLAYLIST_BYTES = 256 * 1024;
+// How often a waiting resolve() re-checks its caller's stop flag
+static constexpr std::chrono::milliseconds CANCEL_POLL{20};
+
+namespace {
+
+bool iequals_prefix(std::string_view text, std::string_view prefix) {
+    if (text.size() < prefix.size()) return false;
+    for (size_t i = 0; i < prefix.size(); ++i) {
+        if (std::tolower(static_cast<unsigned char>(text[i])) != prefix[i]) return false;
+    }
+    return true;
+}
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front()))) s.remove_prefix(1);
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back()))) s.remove_suffix(1);
+    return s;
+}
+
+bool looks_like_url(std::string_view s) {
+    return s.find("://") != std::string_view::npos;
+}
+
+std::string xml_unescape(std::string_view s) {
+    static const std::pair<std::string_view, char> entities[] = {
+        {"&amp;", '&'}, {"&lt;", '<'}, {"&gt;", '>'}, {"&quot;", '"'}, {"&apos;", '\''},
+    };
+    std::string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size();) {
+        bool replaced = false;
+        if (s[i] == '&') {
+            for (const auto& [entity, ch] : entities) {
+                if (s.substr(i, entity.size()) == entity) {
+                    out.push_back(ch);
+                    i += entity.size();
+                    replaced = true;
+                    break;
+                }
+            }
+        }
+        if (!replaced) {
+            out.push_back(s[i++]);
+        }
+    }
+    return out;
+}
+
+void for_each_line(std::string_view text, const auto& fn) {
+    while (!text.empty()) {
+        size_t end = text.find_first_of("\r\n");
+        fn(trim(text.substr(0, end)));
+        if (end == std::string_view::npos) break;
+        text.remove_prefix(end + 1);
+    }
+}
+
+} // namespace
+
+PlaylistKind playlist_kind_for_url(std::string_view url) {
+    size_t scheme = url.find("://");
+    size_t path_start = (scheme == std::string_view::npos) ? 0 : url.find('/', scheme + 3);
+    if (path_start == std::string_view::npos) {
+        return PlaylistKind::None;
+    }
+    std::string_view path = url.substr(path_start);
+    path = path.substr(0, path.find_first_of("?#"));
+
+    size_t dot = path.rfind('.');
+    if (dot == std::string_view::npos || path.find('/', dot) != std::string_view::npos) {
+        return PlaylistKind::None;
+    }
+
+    std::string ext(path.substr(dot + 1));
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (ext == "m3u") return PlaylistKind::M3U;
+    if (ext == "pls") return PlaylistKind::PLS;
+    if (ext == "xspf") return PlaylistKind::XSPF;
+    return PlaylistKind::None;
+}
+
+std::vector<std::string> parse_playlist(std::string_view text, PlaylistKind kind) {
+    if (kind == PlaylistKind::None) {
+        std::string_view head = trim(text.substr(0, 256));
+        if (iequals_prefix(head, "[playlist]")) {
+            kind = PlaylistKind::PLS;
+        } else if (head.find("<playlist") != std::string_view::npos || iequals_prefix(head, "<?xml")) {
+            kind = PlaylistKind::XSPF;
+        } else {
+            kind = PlaylistKind::M3U;
+        }
+    }
+
+    std::vector<std::string> streams;
+    auto add = [&streams](std::string url) {
+        if (looks_like_url(url) && std::find(streams.begin(), streams.end(), url) == streams.end()) {
+            streams.push_back(std::move(url));
+        }
+    };
+
+    switch (kind) {
+        case PlaylistKind::M3U:
+            for_each_line(text, [&](std::string_view line) {
+                if (!line.empty() && line.front() != '#') {
+                    add(std::string(line));
+                }
+            });
+            break;
+
+        case PlaylistKind::PLS:
+            // File1=http://..., File2=... (keys are case-insensitive)
+            for_each_line(text, [&](std::string_view line) {
+                size_t eq = line.find('=');
+                if (eq != std::string_view::npos && iequals_prefix(line, "file")) {
+                    add(std::string(trim(line.substr(eq + 1))));
+                }
+            });
+            break;
+
+        case PlaylistKind::XSPF: {
+            size_t pos = 0;
+            while ((pos = text.find("<location>", pos)) != std::string_view::npos) {
+                pos += 10;
+                size_t end = text.find("</location>", pos);
+                if (end == std::string_view::npos) break;
+                add(xml_unescape(trim(text.substr(pos, end - pos))));
+                pos = end;
+            }
+            break;
+        }
+
+        case PlaylistKind::None:
+            break;
+    }
+    return streams;
+}
+
+PlaylistResolver::PlaylistResolver() {
+    std::filesystem::path dir = user_cache_dir();
+    if (!dir.empty()) {
+        cache_path_ = (dir / "playlists.json").string();
+        load_cache();
+    }
+
+    for (int i = 0; i < WORKER_COUNT; ++i) {
+        workers_.emplace_back([this]() { worker(); });
+    }
+}
+
+PlaylistResolver::~PlaylistResolver() {
+    stop();
+}
+
+void PlaylistResolver::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stop_requested_) return;
+        stop_requested_ = true;
+        queue_.clear();
+    }
+    queue_cv_.notify_all();
+    done_cv_.notify_all();
+    for (auto& t : workers_) {
+        if (t.joinable()) t.join();
+    }
+
+    save_cache();
+}
+
+bool PlaylistResolver::is_fresh(const CacheEntry& entry) const {
+    auto now = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    return now - entry.fetched_at < std::chrono::duration_cast<std::chrono::seconds>(CACHE_TTL).count();
+}
+
+bool PlaylistResolver::enqueue_locked(const std::string& url) {
+    if (in_flight_.count(url)) {
+        return false;
+    }
+    if (auto it = cache_.find(url); it != cache_.end() && is_fresh(it->second)) {
+        return false;
+    }
+    in_flight_.insert(url);
+    queue_.push_back(url);
+    return true;
+}
+
+void PlaylistResolver::prefetch(const std::vector<Station>& stations) {
+    size_t queued = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stop_requested_) return;
+        for (const auto& station : stations) {
+            if (station.is_playlist() && enqueue_locked(station.url)) {
+                ++queued;
+            }
+        }
+    }
+    if (queued > 0) {
+        queue_cv_.notify_all();
+    }
+}
+
+std::vector<std::string> PlaylistResolver::resolve(const std::string& playlist_url,
+                                                   const std::atomic<bool>* cancel) {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    if (auto it = cache_.find(playlist_url); it != cache_.end()) {
+        if (!is_fresh(it->second) && enqueue_locked(playlist_url)) {
+            queue_cv_.notify_one();
+        }
+        return it->second.streams;
+    }
+
+    if (in_flight_.count(playlist_url)) {
+        // Move it to the front so the tune does not wait behind other prefetches
+        auto queued = std::find(queue_.begin(), queue_.end(), playlist_url);
+        if (queued != queue_.end()) {
+            queue_.erase(queued);
+            queue_.push_front(playlist_url);
+        }
+    } else {
+        in_flight_.insert(playlist_url);
+        queue_.push_front(playlist_url);
+        queue_cv_.notify_one();
+    }
+
+    // The fetch itself is not abandoned: it still fills the cache for
+    // the next tune
+    auto done = [&]() { return stop_requested_ || !in_flight_.count(playlist_url); };
+    while (!done_cv_.wait_for(lock, CANCEL_POLL, done)) {
+        if (cancel && cancel->load()) {
+            return {};
+        }
+    }
+
+    auto it = cache_.find(playlist_url);
+    return it != cache_.end() ? it->second.streams : std::vector<std::string>{};
+}
+
+void PlaylistResolver::worker() {
+    while (true) {
+        std::string url;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            queue_cv_.wait(lock, [this]() { return stop_requested_ || !queue_.empty(); });
+            if (stop_requested_) return;
+            url = std::move(queue_.front());
+            queue_.pop_front();
+        }
+
+        fetch_and_store(url);
+
+        bool idle;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            in_flight_.erase(url);
+            idle = queue_.empty() && in_flight_.empty() && cache_dirty_;
+        }
+        done_cv_.notify_all();
+        if (idle) {
+            save_cache();
+        }
+    }
+}
+
+void PlaylistResolver::fetch_and_store(const std::string& url) {
+    AVIOInterruptCB interrupt{};
+    interrupt.callback = [](void* opaque) -> int {
+        return static_cast<std::atomic<bool>*>(opaque)->load() ? 1 : 0;
+    };
+    interrupt.opaque = &stop_requested_;
+
+    AVDictionary* opts = nullptr;
+    av_dict_set(&opts, "rw_timeout", std::to_string(FETCH_TIMEOUT_US).c_str(), 0);
+
+    AVIOContext* io = nullptr;
+    int ret = avio_open2(&io, url.c_str(), AVIO_FLAG_READ, &interrupt, &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        return;
+    }
+
+    std::string body;
+    unsigned char chunk[4096];
+    while (body.size() < MAX_PLAYLIST_BYTES) {
+        int n = avio_read(io, chunk, sizeof(chunk));
+        if (n <= 0) break;
+        body.append(reinterpret_cast<const char*>(chunk), static_cast<size_t>(n));
+    }
+    avio_closep(&io);
+
+    std::vector<std::string> streams = parse_playlist(body, playlist_kind_for_url(url));
+    if (streams.empty()) {
+        return;
+    }
+
+    CacheEntry entry;
+    entry.streams = std::move(streams);
+    entry.fetched_at = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    cache_[url] = std::move(entry);
+    cache_dirty_ = true;
+}
+
+void PlaylistResolver::load_cache() {
+    std::ifstream file(cache_path_);
+    if (!file.is_open()) {
+        return;
+    }
+
+    json j = json::parse(file, nullptr, false);
+    if (!j.is_object()) {
+        return;
+    }
+
+    for (auto& [url, value] : j.items()) {
+        if (!value.is_object() || !value.contains("streams") || !value["streams"].is_array()) {
+            continue;
+        }
+        CacheEntry entry;
+        entry.fetched_at = value.value("fetched_at", int64_t{0});
+        for (const auto& stream : value["streams"]) {
+            if (stream.is_string()) {
+                entry.streams.push_back(stream.get<std::string>());
+            }
+        }
+        if (!entry.streams.empty()) {
+            cache_[url] = std::move(entry);
+        }
+    }
+}
+
+void PlaylistResolver::save_cache() {
+    if (cache_path_.empty()) {
+        return;
+    }
+    // One writer at a time, so an older snapshot never replaces a newer one
+    std::lock_guard<std::mutex> save_lock(save_mutex_);
+
+    json j = json::object();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!cache_dirty_) {
+            return;
+        }
+        for (const auto& [url, entry] : cache_) {
+            j[url] = {{"fetched_at", entry.fetched_at}, {"streams", entry.streams}};
+        }
+        // A fetch stored while writing marks it dirty again
+        cache_dirty_ = false;
+    }
+
+    auto failed = [this]() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cache_dirty_ = true;
+    };
+    if (!ensure_directory(std::filesystem::path(cache_path_).parent_path())) {
+        return failed();
+    }
+
+    std::string tmp_path = cache_path_ + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::trunc);
+        if (!out.is_open()) return failed();
+        out << j.dump(1, '\t');
+        if (!out.good()) return failed();
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, cache_path_, ec);
+    if (ec) {
+        failed();
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef PLAYLIST_RESOLVER_HPP
+#define PLAYLIST_RESOLVER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "station.hpp"
+
+// Parse playlist text into stream URLs. The format is taken from kind,
+// or sniffed from the content when kind is None.
+std::vector<std::string> parse_playlist(std::string_view text, PlaylistKind kind);
+
+// Resolves .m3u/.pls/.xspf station URLs to the stream URLs they list.
+//
+// Playlists are fetched by a small pool of background workers as soon
+// as stations are known (prefetch()), so tuning a playlist station
+// normally finds its stream list already in memory. Results are kept
+// in a JSON file in the user cache directory and reused across runs
+// until they are older than the TTL; stale entries are still returned
+// immediately and refreshed in the background.
+class PlaylistResolver {
+public:
+    static constexpr int WORKER_COUNT = 4;
+    static constexpr std::chrono::hours CACHE_TTL{6};
+
+    PlaylistResolver();
+    ~PlaylistResolver();
+
+    PlaylistResolver(const PlaylistResolver&) = delete;
+    PlaylistResolver& operator=(const PlaylistResolver&) = delete;
+
+    // Queue every playlist station for background resolution
+    void prefetch(const std::vector<Station>& stations);
+
+    // Stream URLs for a playlist URL. Returns the cached list (fresh or
+    // stale) without blocking; otherwise waits for the in-flight or a new
+    // fetch. Empty if the playlist could not be fetched or parsed, or if
+    // cancel (the caller's stop flag) was set while waiting.
+    std::vector<std::string> resolve(const std::string& playlist_url,
+                                     const std::atomic<bool>* cancel = nullptr);
+
+    void stop();
+
+private:
+    struct CacheEntry {
+        std::vector<std::string> streams;
+        int64_t fetched_at = 0;  // unix seconds
+    };
+
+    void worker();
+    bool enqueue_locked(const std::string& url);
+    void fetch_and_store(const std::string& url);
+    bool is_fresh(const CacheEntry& entry) const;
+    void load_cache();
+    // Writes the cache if it changed; takes mutex_ only for the snapshot
+    void save_cache();
+
+    std::string cache_path_;
+
+    std::mutex mutex_;
+    std::condition_variable queue_cv_;
+    std::condition_variable done_cv_;
+    std::deque<std::string> queue_;
+    std::unordered_set<std::string> in_flight_;  // queued or being fetched
+    std::unordered_map<std::string, CacheEntry> cache_;
+    bool cache_dirty_ = false;
+    std::mutex save_mutex_;     // serializes writers of the cache file
+
+    std::vector<std::thread> workers_;
+    std::atomic<bool> stop_requested_{false};
+};
+
+#endif // PLAYLIST_RESOLVER_HPP
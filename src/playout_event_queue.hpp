@@ -0,0 +1,88 @@
+#ifndef PLAYOUT_EVENT_QUEUE_HPP
+#define PLAYOUT_EVENT_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+// Events tagged with a position in the audio byte stream.
+//
+// The producer (decode thread) tags each event with the ring buffer's
+// write position at the moment the event was seen, i.e. the first byte
+// of audio that belongs to it. The consumer (UI thread) calls release()
+// with the position that is currently audible; events whose tag has been
+// reached are handed out in order. Positions are the monotonically
+// increasing head/tail counters of ByteRingbuffer, compared wrap-safe.
+//
+// push_now() queues an event with no position of its own (e.g. "stream
+// stopped"); it is released as soon as the events ahead of it are.
+template <typename T>
+class PlayoutEventQueue {
+public:
+    void push(size_t position, T event) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        events_.push_back({position, false, std::move(event)});
+        has_events_.store(true, std::memory_order_release);
+    }
+
+    void push_now(T event) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        events_.push_back({0, true, std::move(event)});
+        has_events_.store(true, std::memory_order_release);
+    }
+
+    // Hands every event at or before played_position to fn, oldest first.
+    // Returns the number of events released.
+    template <typename Fn>
+    size_t release(size_t played_position, Fn&& fn) {
+        if (!has_events_.load(std::memory_order_acquire)) {
+            return 0;
+        }
+
+        size_t released = 0;
+        while (true) {
+            T event;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (events_.empty()) {
+                    has_events_.store(false, std::memory_order_release);
+                    break;
+                }
+                Entry& front = events_.front();
+                if (!front.immediate &&
+                    static_cast<std::ptrdiff_t>(played_position - front.position) < 0) {
+                    break;
+                }
+                event = std::move(front.event);
+                events_.pop_front();
+            }
+            fn(event);
+            ++released;
+        }
+        return released;
+    }
+
+    // Drops events that have not been released yet (e.g. on station change)
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        events_.clear();
+        has_events_.store(false, std::memory_order_release);
+    }
+
+    bool has_events() const { return has_events_.load(std::memory_order_acquire); }
+
+private:
+    struct Entry {
+        size_t position;
+        bool immediate;
+        T event;
+    };
+
+    std::mutex mutex_;
+    std::deque<Entry> events_;
+    std::atomic<bool> has_events_{false};
+};
+
+#endif // PLAYOUT_EVENT_QUEUE_HPP
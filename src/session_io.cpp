@@ -0,0 +1,367 @@
+#include "session_io.hpp"
+#include "async_log.hpp"
+#include "pipeline_clock.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavformat/avio.h>
+#include <libavutil/dict.h>
+#include <libavutil/opt.h>
+}
+
+namespace {
+
+constexpr char SESSION_MAGIC[8] = {'W', 'R', 'S', 'E', 'S', 'S', '0', '1'};
+constexpr size_t RECORD_HEADER_SIZE = 16;
+constexpr int IO_BUFFER_SIZE = 32 * 1024;
+// Larger than any single read, so a replay cannot be made to allocate
+// gigabytes by a corrupt size field
+constexpr uint32_t MAX_RECORD_SIZE = 16 * 1024 * 1024;
+// Replay waits are sliced so the interrupt callback is polled
+constexpr uint64_t WAIT_SLICE_NS = 10'000'000;
+
+std::string av_error_text(int err) {
+    char buf[AV_ERROR_MAX_STRING_SIZE] = {};
+    av_strerror(err, buf, sizeof(buf));
+    return buf;
+}
+
+std::filesystem::path session_file_name(const std::filesystem::path& dir) {
+    std::time_t now = std::time(nullptr);
+    std::tm tm{};
+    localtime_r(&now, &tm);
+    char stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm);
+
+    std::filesystem::path path = dir / (std::string("session-") + stamp + ".wrs");
+    std::error_code ec;
+    for (int i = 2; std::filesystem::exists(path, ec); i++) {
+        path = dir / (std::string("session-") + stamp + "-" + std::to_string(i) + ".wrs");
+    }
+    return path;
+}
+
+} // namespace
+
+SessionWriter::~SessionWriter() {
+    close();
+}
+
+bool SessionWriter::open(const std::filesystem::path& path, std::string& error) {
+    close();
+    path_ = path;
+    error_.clear();
+    file_ = std::fopen(path.c_str(), "wb");
+    if (!file_) {
+        error = "cannot write " + path.string() + ": " + std::strerror(errno);
+        return false;
+    }
+    // Reads arrive every few ms; keep them off the disk until the buffer fills
+    std::setvbuf(file_, nullptr, _IOFBF, 256 * 1024);
+    if (std::fwrite(SESSION_MAGIC, 1, sizeof(SESSION_MAGIC), file_) != sizeof(SESSION_MAGIC)) {
+        fail();
+        error = error_;
+        return false;
+    }
+    return true;
+}
+
+bool SessionWriter::write(SessionRecord type, const void* payload, uint32_t size, uint64_t time_ns) {
+    if (!file_) {
+        return false;
+    }
+    uint8_t header[RECORD_HEADER_SIZE] = {};
+    header[0] = static_cast<uint8_t>(type);
+    std::memcpy(header + 4, &size, sizeof(size));
+    std::memcpy(header + 8, &time_ns, sizeof(time_ns));
+    if (std::fwrite(header, 1, sizeof(header), file_) != sizeof(header) ||
+        (size > 0 && std::fwrite(payload, 1, size, file_) != size)) {
+        return fail();
+    }
+    return true;
+}
+
+bool SessionWriter::flush() {
+    if (file_ && std::fflush(file_) != 0) {
+        return fail();
+    }
+    return error_.empty();
+}
+
+bool SessionWriter::close() {
+    if (file_) {
+        bool closed = std::fclose(file_) == 0;
+        file_ = nullptr;
+        if (!closed && error_.empty()) {
+            error_ = "cannot write " + path_.string() + ": " + std::strerror(errno);
+        }
+    }
+    return error_.empty();
+}
+
+// A partial record is worse than none: stop writing at the first failure
+bool SessionWriter::fail() {
+    error_ = "cannot write " + path_.string() + ": " + std::strerror(errno);
+    std::fclose(file_);
+    file_ = nullptr;
+    return false;
+}
+
+SessionIo::~SessionIo() {
+    if (avio_) {
+        av_freep(&avio_->buffer);
+        avio_context_free(&avio_);
+    }
+    if (inner_) {
+        avio_closep(&inner_);
+    }
+    if (file_) {
+        std::fclose(file_);
+    }
+}
+
+std::unique_ptr<SessionIo> SessionIo::record(const std::string& url, AVDictionary** options,
+                                             const std::filesystem::path& dir, std::string& error) {
+    std::unique_ptr<SessionIo> session(new SessionIo());
+    session->url_ = url;
+    session->start_ns_ = pipeline_clock().now_ns();
+
+    int ret = avio_open2(&session->inner_, url.c_str(), AVIO_FLAG_READ, nullptr, options);
+    if (ret < 0) {
+        session->inner_ = nullptr;
+        error = "cannot open " + url + ": " + av_error_text(ret);
+        return nullptr;
+    }
+    uint64_t opened_ns = session->elapsed_ns();
+
+    // Only sessions that connected are written; a failed connect has
+    // nothing to replay
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    session->path_ = session_file_name(dir);
+    if (!session->writer_.open(session->path_, error)) {
+        return nullptr;
+    }
+    SessionWriter& writer = session->writer_;
+    // The open happened before there was a file to log it to. Metadata
+    // here is an ICY block already read while connecting; the icy-*
+    // response headers are in icy_metadata_headers, not "metadata", and
+    // are not recorded.
+    if (!writer.write(SessionRecord::Url, url.data(), static_cast<uint32_t>(url.size()), 0) ||
+        !writer.write(SessionRecord::Opened, nullptr, 0, opened_ns) ||
+        !session->record_metadata()) {
+        error = writer.error();
+        return nullptr;
+    }
+
+    if (!session->alloc_avio(error)) {
+        return nullptr;
+    }
+    return session;
+}
+
+std::unique_ptr<SessionIo> SessionIo::replay(const std::filesystem::path& path, double speed,
+                                             std::string& error) {
+    std::unique_ptr<SessionIo> session(new SessionIo());
+    session->replaying_ = true;
+    session->speed_ = speed;
+    session->path_ = path;
+    session->start_ns_ = pipeline_clock().now_ns();
+
+    session->file_ = std::fopen(path.c_str(), "rb");
+    if (!session->file_) {
+        error = "cannot read " + path.string() + ": " + std::strerror(errno);
+        return nullptr;
+    }
+    char magic[sizeof(SESSION_MAGIC)];
+    if (std::fread(magic, 1, sizeof(magic), session->file_) != sizeof(magic) ||
+        std::memcmp(magic, SESSION_MAGIC, sizeof(magic)) != 0) {
+        error = path.string() + " is not a session recording";
+        return nullptr;
+    }
+
+    // Url, then Opened at the original connect time
+    SessionRecord type;
+    uint64_t time_ns;
+    while (session->read_record(type, time_ns)) {
+        if (type == SessionRecord::Url) {
+            session->url_.assign(session->pending_.begin(), session->pending_.end());
+        } else if (type == SessionRecord::Opened) {
+            session->pending_.clear();
+            session->wait_until(time_ns);
+            if (!session->alloc_avio(error)) {
+                return nullptr;
+            }
+            return session;
+        }
+        session->pending_.clear();
+    }
+    error = path.string() + " ends before the stream was opened";
+    return nullptr;
+}
+
+bool SessionIo::alloc_avio(std::string& error) {
+    auto* buffer = static_cast<unsigned char*>(av_malloc(IO_BUFFER_SIZE));
+    if (buffer) {
+        avio_ = avio_alloc_context(buffer, IO_BUFFER_SIZE, 0, this, read_callback, nullptr, nullptr);
+    }
+    if (!avio_) {
+        av_free(buffer);
+        error = "cannot allocate I/O context";
+        return false;
+    }
+    // Live streams cannot seek, and neither can a replay of one
+    avio_->seekable = 0;
+    return true;
+}
+
+uint64_t SessionIo::elapsed_ns() const {
+    return pipeline_clock().now_ns() - start_ns_;
+}
+
+int SessionIo::read_callback(void* opaque, uint8_t* buf, int size) {
+    auto* self = static_cast<SessionIo*>(opaque);
+    return self->replaying_ ? self->replay_read(buf, size) : self->record_read(buf, size);
+}
+
+int SessionIo::record_read(uint8_t* buf, int size) {
+    if (end_error_ != 0) {
+        return end_error_;
+    }
+    int n = avio_read_partial(inner_, buf, size);
+    if (n <= 0) {
+        end_error_ = n == 0 ? AVERROR_EOF : n;
+        int32_t err = end_error_;
+        writer_.write(SessionRecord::End, &err, sizeof(err), elapsed_ns());
+        writer_.flush();
+        return end_error_;
+    }
+    if (!writer_.write(SessionRecord::Data, buf, static_cast<uint32_t>(n), elapsed_ns()) || !record_metadata()) {
+        // A recording with a hole would replay as a different session
+        log_write(LogLevel::Error, "session", "%s", writer_.error().c_str());
+        end_error_ = AVERROR(EIO);
+        return end_error_;
+    }
+    return n;
+}
+
+// The http protocol exports each ICY block it strips as its "metadata"
+// option; the demuxer would poll it through fmt_ctx->pb, which is now ours
+bool SessionIo::record_metadata() {
+    AVDictionary* dict = nullptr;
+    if (av_opt_get_dict_val(inner_, "metadata", AV_OPT_SEARCH_CHILDREN, &dict) < 0 || !dict) {
+        return true;
+    }
+    av_opt_set_dict_val(inner_, "metadata", nullptr, AV_OPT_SEARCH_CHILDREN);
+
+    std::string payload;
+    const AVDictionaryEntry* entry = nullptr;
+    while ((entry = av_dict_get(dict, "", entry, AV_DICT_IGNORE_SUFFIX))) {
+        payload.append(entry->key).push_back('\0');
+        payload.append(entry->value).push_back('\0');
+    }
+    bool written = writer_.write(SessionRecord::Metadata, payload.data(), static_cast<uint32_t>(payload.size()),
+                                 elapsed_ns());
+    publish_metadata(dict);
+    av_dict_free(&dict);
+    return written;
+}
+
+void SessionIo::publish_metadata(AVDictionary* dict) {
+    if (!fmt_ctx_) {
+        return;
+    }
+    av_dict_copy(&fmt_ctx_->metadata, dict, 0);
+    fmt_ctx_->event_flags |= AVFMT_EVENT_FLAG_METADATA_UPDATED;
+}
+
+bool SessionIo::read_record(SessionRecord& type, uint64_t& time_ns) {
+    uint8_t header[RECORD_HEADER_SIZE];
+    if (std::fread(header, 1, sizeof(header), file_) != sizeof(header)) {
+        return false;
+    }
+    uint32_t size;
+    std::memcpy(&size, header + 4, sizeof(size));
+    std::memcpy(&time_ns, header + 8, sizeof(time_ns));
+    if (size > MAX_RECORD_SIZE) {
+        return false;
+    }
+    type = static_cast<SessionRecord>(header[0]);
+    pending_.resize(size);
+    pending_offset_ = 0;
+    return size == 0 || std::fread(pending_.data(), 1, size, file_) == size;
+}
+
+// False when the interrupt callback asked to stop
+bool SessionIo::wait_until(uint64_t time_ns) const {
+    if (speed_ <= 0.0) {
+        return true;
+    }
+    PipelineClock& clock = pipeline_clock();
+    uint64_t deadline = start_ns_ + static_cast<uint64_t>(static_cast<double>(time_ns) / speed_);
+    while (clock.now_ns() < deadline) {
+        if (fmt_ctx_ && fmt_ctx_->interrupt_callback.callback &&
+            fmt_ctx_->interrupt_callback.callback(fmt_ctx_->interrupt_callback.opaque)) {
+            return false;
+        }
+        clock.sleep_until_ns(std::min(deadline, clock.now_ns() + WAIT_SLICE_NS));
+    }
+    return true;
+}
+
+int SessionIo::replay_read(uint8_t* buf, int size) {
+    while (pending_offset_ >= pending_.size()) {
+        if (end_error_ != 0) {
+            return end_error_;
+        }
+        SessionRecord type;
+        uint64_t time_ns;
+        if (!read_record(type, time_ns)) {
+            // Truncated recording, e.g. the player was killed mid-session
+            pending_.clear();
+            end_error_ = AVERROR_EOF;
+            continue;
+        }
+        if (!wait_until(time_ns)) {
+            pending_.clear();
+            return AVERROR_EXIT;
+        }
+        if (type == SessionRecord::Data) {
+            continue;
+        }
+        if (type == SessionRecord::Metadata) {
+            AVDictionary* dict = nullptr;
+            const char* p = reinterpret_cast<const char*>(pending_.data());
+            const char* end = p + pending_.size();
+            while (p < end) {
+                const char* key_end = static_cast<const char*>(std::memchr(p, '\0', end - p));
+                const char* value = key_end ? key_end + 1 : end;
+                const char* value_end = value < end
+                    ? static_cast<const char*>(std::memchr(value, '\0', end - value)) : nullptr;
+                if (!value_end) {
+                    break;
+                }
+                av_dict_set(&dict, p, value, 0);
+                p = value_end + 1;
+            }
+            publish_metadata(dict);
+            av_dict_free(&dict);
+        } else if (type == SessionRecord::End) {
+            int32_t err = AVERROR_EOF;
+            if (pending_.size() == sizeof(err)) {
+                std::memcpy(&err, pending_.data(), sizeof(err));
+            }
+            end_error_ = err < 0 ? err : AVERROR_EOF;
+        }
+        pending_.clear();
+    }
+
+    size_t n = std::min(pending_.size() - pending_offset_, static_cast<size_t>(size));
+    std::memcpy(buf, pending_.data() + pending_offset_, n);
+    pending_offset_ += n;
+    return static_cast<int>(n);
+}
@@ -0,0 +1,126 @@
+#ifndef SESSION_IO_HPP
+#define SESSION_IO_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+extern "C" {
+struct AVDictionary;
+struct AVFormatContext;
+struct AVIOContext;
+}
+
+// URL prefix that makes StreamDecoder replay a session file instead of
+// connecting, e.g. "replay:/home/me/session-20260101-120000.wrs"
+constexpr const char* REPLAY_URL_PREFIX = "replay:";
+
+// Session file layout (little-endian): "WRSESS01", then records of a 16-byte
+// header {u8 type, u8[3] zero, u32 size, u64 ns since start} and size
+// bytes of payload.
+enum class SessionRecord : uint8_t {
+    Url = 1,        // payload: the URL as opened
+    Opened = 2,     // connected, headers parsed
+    Data = 3,       // payload: bytes returned by one read
+    Metadata = 4,   // payload: key\0value\0 pairs
+    End = 5,        // payload: i32 AVERROR that ended the session
+};
+
+// Writes a session file. Used by recording, and by webradio-sim to turn a
+// local file into synthetic network arrivals.
+class SessionWriter {
+public:
+    SessionWriter() = default;
+    ~SessionWriter();
+
+    SessionWriter(const SessionWriter&) = delete;
+    SessionWriter& operator=(const SessionWriter&) = delete;
+
+    bool open(const std::filesystem::path& path, std::string& error);
+    // Records must come in time order. Returns false once a write failed
+    // (disk full, ...); the file is closed then and error() says why.
+    bool write(SessionRecord type, const void* payload, uint32_t size, uint64_t time_ns);
+    bool flush();
+    // False if any write failed
+    bool close();
+    const std::string& error() const { return error_; }
+
+private:
+    bool fail();
+
+    std::FILE* file_ = nullptr;
+    std::filesystem::path path_;
+    std::string error_;
+};
+
+// Record and replay of one network session at the byte level, below the
+// demuxer. Both modes hand avformat_open_input a custom AVIOContext, so a
+// replay runs the same demux/decode/ring/callback path as the original.
+//
+// Recording opens the URL with FFmpeg's own protocol stack (http, tls,
+// icy) and logs every read as it arrives: the audio bytes with their
+// arrival time, ICY metadata changes, and how the session ended. Replay
+// serves the same reads at the same offsets from session start, divided
+// by the speed factor (0 = as fast as the decoder takes them).
+class SessionIo {
+public:
+    ~SessionIo();
+
+    SessionIo(const SessionIo&) = delete;
+    SessionIo& operator=(const SessionIo&) = delete;
+
+    // Connects to url and writes the session to a new file in dir.
+    // options is consumed like avio_open2 does.
+    static std::unique_ptr<SessionIo> record(const std::string& url, AVDictionary** options,
+                                             const std::filesystem::path& dir, std::string& error);
+    // Opens a recorded session; waits out the original connect time
+    // before returning
+    static std::unique_ptr<SessionIo> replay(const std::filesystem::path& path, double speed,
+                                             std::string& error);
+
+    // For avformat_open_input with AVFMT_FLAG_CUSTOM_IO; owned by this
+    AVIOContext* avio() const { return avio_; }
+    // Metadata changes are copied into fmt_ctx->metadata and flagged with
+    // AVFMT_EVENT_FLAG_METADATA_UPDATED, as the icy protocol would
+    void attach(AVFormatContext* fmt_ctx) { fmt_ctx_ = fmt_ctx; }
+
+    bool replaying() const { return replaying_; }
+    // The URL the session was recorded from
+    const std::string& url() const { return url_; }
+    const std::filesystem::path& path() const { return path_; }
+
+private:
+    SessionIo() = default;
+
+    static int read_callback(void* opaque, uint8_t* buf, int size);
+    int record_read(uint8_t* buf, int size);
+    int replay_read(uint8_t* buf, int size);
+
+    bool alloc_avio(std::string& error);
+    bool record_metadata();
+    bool read_record(SessionRecord& type, uint64_t& time_ns);
+    bool wait_until(uint64_t time_ns) const;
+    void publish_metadata(AVDictionary* dict);
+    uint64_t elapsed_ns() const;
+
+    bool replaying_ = false;
+    double speed_ = 1.0;
+    std::string url_;
+    std::filesystem::path path_;
+    SessionWriter writer_;              // recording
+    std::FILE* file_ = nullptr;         // replay
+    AVIOContext* avio_ = nullptr;
+    AVIOContext* inner_ = nullptr;      // recording: the real connection
+    AVFormatContext* fmt_ctx_ = nullptr;
+    uint64_t start_ns_ = 0;             // pipeline_clock()
+
+    // Replay: the data record being served and how much of it is left
+    std::vector<uint8_t> pending_;
+    size_t pending_offset_ = 0;
+    int end_error_ = 0;
+};
+
+#endif // SESSION_IO_HPP
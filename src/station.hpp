@@ -0,0 +1,36 @@
+#ifndef STATION_HPP
+#define STATION_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class PlaylistKind {
+    None,
+    M3U,
+    PLS,
+    XSPF
+};
+
+// Classify a URL by the extension of its path (query and fragment ignored).
+// .m3u8 is HLS, which FFmpeg plays directly, so it is not treated as a playlist.
+PlaylistKind playlist_kind_for_url(std::string_view url);
+
+struct Station {
+    std::string name;
+    std::string url;
+
+    PlaylistKind playlist_kind() const { return playlist_kind_for_url(url); }
+    bool is_playlist() const { return playlist_kind() != PlaylistKind::None; }
+};
+
+// Row-level difference between two station lists, keyed by name
+struct StationChanges {
+    std::vector<Station> added;
+    std::vector<Station> updated;       // same name, new URL
+    std::vector<std::string> removed;   // names
+
+    bool empty() const { return added.empty() && updated.empty() && removed.empty(); }
+};
+
+#endif // STATION_HPP
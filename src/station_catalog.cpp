@@ -0,0 +1,489 @@
+#include "station_catalog.hpp"
+#include "app_paths.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+#include <nlohmann/json.hpp>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using json = nlohmann::json;
+
+namespace {
+
+constexpr char CACHE_MAGIC[8] = {'W', 'R', 'S', 'T', 'C', 'A', 'T', '1'};
+constexpr uint32_t CACHE_VERSION = 1;
+
+// On-disk layout: CacheHeader, Entry[entry_count], char strings[strings_size]
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_count;
+    uint64_t strings_size;
+    uint64_t source_size;
+    int64_t source_mtime_ns;
+    uint64_t source_hash;
+    uint64_t reserved[3];
+};
+static_assert(sizeof(CacheHeader) == 72, "cache header layout changed");
+static_assert(sizeof(StationCatalog::Entry) == 16, "cache entry layout changed");
+
+uint64_t fnv1a64(const char* data, size_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// SAX handler for the stations.json format: one top-level object
+// mapping station name -> stream URL. Strings are appended directly
+// into the catalog arena. Values that are not strings, and anything
+// nested below the top-level object, are skipped.
+class StationSaxHandler : public json::json_sax_t {
+public:
+    StationSaxHandler(std::string& arena, std::vector<StationCatalog::Entry>& entries)
+        : arena_(arena), entries_(entries) {}
+
+    bool null() override { return true; }
+    bool boolean(bool) override { return true; }
+    bool number_integer(number_integer_t) override { return true; }
+    bool number_unsigned(number_unsigned_t) override { return true; }
+    bool number_float(number_float_t, const string_t&) override { return true; }
+    bool binary(binary_t&) override { return true; }
+
+    bool string(string_t& val) override {
+        if (depth_ != 1 || !has_key_) {
+            return true;
+        }
+        if (!fits(val.size())) {
+            return false;
+        }
+        StationCatalog::Entry entry{};
+        entry.name_offset = key_offset_;
+        entry.name_length = key_length_;
+        entry.url_offset = static_cast<uint32_t>(arena_.size());
+        entry.url_length = static_cast<uint32_t>(val.size());
+        arena_.append(val);
+        entries_.push_back(entry);
+        has_key_ = false;
+        return true;
+    }
+
+    bool key(string_t& val) override {
+        if (depth_ != 1) {
+            return true;
+        }
+        if (has_key_) {
+            // Previous key had a non-string value; reclaim its arena bytes
+            arena_.resize(key_offset_);
+        }
+        if (!fits(val.size())) {
+            return false;
+        }
+        key_offset_ = static_cast<uint32_t>(arena_.size());
+        key_length_ = static_cast<uint32_t>(val.size());
+        arena_.append(val);
+        has_key_ = true;
+        return true;
+    }
+
+    bool start_object(std::size_t) override {
+        if (depth_ == 0) {
+            saw_root_object_ = true;
+        }
+        ++depth_;
+        return true;
+    }
+
+    bool end_object() override {
+        --depth_;
+        if (depth_ <= 1) {
+            drop_pending_key();
+        }
+        return true;
+    }
+
+    bool start_array(std::size_t) override {
+        ++depth_;
+        return true;
+    }
+
+    bool end_array() override {
+        --depth_;
+        if (depth_ == 1) {
+            drop_pending_key();
+        }
+        return true;
+    }
+
+    bool parse_error(std::size_t position, const std::string&, const json::exception& ex) override {
+        error_ = "parse error at byte " + std::to_string(position) + ": " + ex.what();
+        return false;
+    }
+
+    bool saw_root_object() const { return saw_root_object_; }
+    const std::string& error() const { return error_; }
+
+private:
+    bool fits(size_t extra) {
+        if (arena_.size() + extra > UINT32_MAX) {
+            error_ = "station catalog exceeds 4 GiB";
+            return false;
+        }
+        return true;
+    }
+
+    void drop_pending_key() {
+        if (has_key_) {
+            arena_.resize(key_offset_);
+            has_key_ = false;
+        }
+    }
+
+    std::string& arena_;
+    std::vector<StationCatalog::Entry>& entries_;
+    int depth_ = 0;
+    bool has_key_ = false;
+    bool saw_root_object_ = false;
+    uint32_t key_offset_ = 0;
+    uint32_t key_length_ = 0;
+    std::string error_;
+};
+
+#ifdef __linux__
+// Read-only mapping of a whole file; empty files map to {nullptr, 0}
+struct MappedFile {
+    void* data = nullptr;
+    size_t size = 0;
+    bool ok = false;
+
+    explicit MappedFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return;
+        struct stat st{};
+        if (::fstat(fd, &st) == 0) {
+            size = static_cast<size_t>(st.st_size);
+            if (size == 0) {
+                ok = true;
+            } else {
+                void* p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED) {
+                    ::madvise(p, size, MADV_SEQUENTIAL);
+                    data = p;
+                    ok = true;
+                }
+            }
+        }
+        ::close(fd);
+    }
+
+    ~MappedFile() {
+        if (data) ::munmap(data, size);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+};
+#endif
+
+} // namespace
+
+StationCatalog::~StationCatalog() {
+    reset();
+}
+
+void StationCatalog::reset() {
+#ifdef __linux__
+    if (map_) {
+        ::munmap(map_, map_size_);
+    }
+#endif
+    map_ = nullptr;
+    map_size_ = 0;
+    arena_.clear();
+    entries_.clear();
+    strings_ = nullptr;
+    index_ = nullptr;
+    count_ = 0;
+}
+
+std::string_view StationCatalog::name(size_t index) const {
+    const Entry& e = index_[index];
+    return std::string_view(strings_ + e.name_offset, e.name_length);
+}
+
+std::string_view StationCatalog::url(size_t index) const {
+    const Entry& e = index_[index];
+    return std::string_view(strings_ + e.url_offset, e.url_length);
+}
+
+std::vector<Station> StationCatalog::to_stations() const {
+    std::vector<Station> stations;
+    stations.reserve(count_);
+    for (size_t i = 0; i < count_; ++i) {
+        stations.push_back({std::string(name(i)), std::string(url(i))});
+    }
+    return stations;
+}
+
+std::string StationCatalog::cache_path_for(const std::string& json_path) {
+    std::filesystem::path dir = user_cache_dir();
+    if (dir.empty()) {
+        return {};
+    }
+
+    std::error_code ec;
+    std::string absolute = std::filesystem::absolute(json_path, ec).lexically_normal().string();
+    if (ec) {
+        absolute = json_path;
+    }
+
+    char name[40];
+    std::snprintf(name, sizeof(name), "stations-%016llx.bin",
+                  static_cast<unsigned long long>(fnv1a64(absolute.data(), absolute.size())));
+    return (dir / name).string();
+}
+
+bool StationCatalog::parse_buffer(const char* data, size_t size) {
+    arena_.clear();
+    entries_.clear();
+    // Rough guess: a station costs ~100 bytes of JSON and ~80 of arena
+    arena_.reserve(size);
+    entries_.reserve(size / 100 + 1);
+
+    StationSaxHandler handler(arena_, entries_);
+    bool ok = json::sax_parse(data, data + size, &handler);
+    if (!ok || !handler.saw_root_object()) {
+        error_ = ok ? "stations file is not a JSON object" : handler.error();
+        arena_.clear();
+        entries_.clear();
+        return false;
+    }
+
+    sort_and_dedupe();
+    arena_.shrink_to_fit();
+    entries_.shrink_to_fit();
+
+    strings_ = arena_.data();
+    index_ = entries_.data();
+    count_ = entries_.size();
+    return true;
+}
+
+void StationCatalog::sort_and_dedupe() {
+    const char* base = arena_.data();
+    auto name_of = [base](const Entry& e) {
+        return std::string_view(base + e.name_offset, e.name_length);
+    };
+
+    std::stable_sort(entries_.begin(), entries_.end(), [&](const Entry& a, const Entry& b) {
+        return name_of(a) < name_of(b);
+    });
+
+    // Keep the last occurrence of each name (stable sort preserves file order)
+    size_t out = 0;
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        if (i + 1 < entries_.size() && name_of(entries_[i]) == name_of(entries_[i + 1])) {
+            continue;
+        }
+        entries_[out++] = entries_[i];
+    }
+    entries_.resize(out);
+}
+
+bool StationCatalog::parse_json(const std::string& json_path) {
+    reset();
+    error_.clear();
+
+#ifdef __linux__
+    MappedFile source(json_path);
+    if (!source.ok) {
+        error_ = "cannot open " + json_path;
+        return false;
+    }
+    return parse_buffer(static_cast<const char*>(source.data), source.size);
+#else
+    std::ifstream file(json_path, std::ios::binary);
+    if (!file.is_open()) {
+        error_ = "cannot open " + json_path;
+        return false;
+    }
+    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return parse_buffer(content.data(), content.size());
+#endif
+}
+
+bool StationCatalog::load(const std::string& json_path, bool use_cache) {
+#ifdef __linux__
+    reset();
+    error_.clear();
+
+    struct stat st{};
+    if (::stat(json_path.c_str(), &st) != 0) {
+        error_ = "cannot open " + json_path;
+        return false;
+    }
+    SourceInfo source;
+    source.size = static_cast<uint64_t>(st.st_size);
+    source.mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+
+    std::string cache_path = use_cache ? cache_path_for(json_path) : std::string();
+    if (!cache_path.empty() && map_cache(cache_path, json_path, source)) {
+        return true;
+    }
+
+    MappedFile file(json_path);
+    if (!file.ok) {
+        error_ = "cannot open " + json_path;
+        return false;
+    }
+    const char* data = static_cast<const char*>(file.data);
+    if (!parse_buffer(data, file.size)) {
+        return false;
+    }
+
+    if (!cache_path.empty()) {
+        write_cache(cache_path, source, fnv1a64(data, file.size));
+    }
+    return true;
+#else
+    (void)use_cache;
+    return parse_json(json_path);
+#endif
+}
+
+bool StationCatalog::map_cache(const std::string& cache_path, const std::string& json_path, const SourceInfo& source) {
+#ifdef __linux__
+    int fd = ::open(cache_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(CacheHeader)) {
+        ::close(fd);
+        return false;
+    }
+
+    size_t file_size = static_cast<size_t>(st.st_size);
+    void* p = ::mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+        ::close(fd);
+        return false;
+    }
+
+    auto fail = [&]() {
+        ::munmap(p, file_size);
+        ::close(fd);
+        return false;
+    };
+
+    CacheHeader header;
+    std::memcpy(&header, p, sizeof(header));
+    if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+        header.version != CACHE_VERSION ||
+        header.source_size != source.size) {
+        return fail();
+    }
+
+    size_t index_bytes = static_cast<size_t>(header.entry_count) * sizeof(Entry);
+    if (sizeof(CacheHeader) + index_bytes + header.strings_size != file_size) {
+        return fail();
+    }
+
+    if (header.source_mtime_ns != source.mtime_ns) {
+        // Same size but touched (e.g. saved without edits): compare the
+        // content hash, then stamp the new mtime so later starts skip the
+        // hash. The stamp is best effort; a read-only cache still loads.
+        MappedFile json_file(json_path);
+        if (!json_file.ok ||
+            fnv1a64(static_cast<const char*>(json_file.data), json_file.size) != header.source_hash) {
+            return fail();
+        }
+        int stamp_fd = ::open(cache_path.c_str(), O_WRONLY | O_CLOEXEC);
+        if (stamp_fd >= 0) {
+            (void)!::pwrite(stamp_fd, &source.mtime_ns, sizeof(source.mtime_ns),
+                            offsetof(CacheHeader, source_mtime_ns));
+            ::close(stamp_fd);
+        }
+    }
+    ::close(fd);
+
+    const char* base = static_cast<const char*>(p);
+    const Entry* index = reinterpret_cast<const Entry*>(base + sizeof(CacheHeader));
+    for (uint32_t i = 0; i < header.entry_count; ++i) {
+        const Entry& e = index[i];
+        if (uint64_t(e.name_offset) + e.name_length > header.strings_size ||
+            uint64_t(e.url_offset) + e.url_length > header.strings_size) {
+            ::munmap(p, file_size);
+            return false;
+        }
+    }
+
+    map_ = p;
+    map_size_ = file_size;
+    index_ = index;
+    strings_ = base + sizeof(CacheHeader) + index_bytes;
+    count_ = header.entry_count;
+    return true;
+#else
+    (void)cache_path;
+    (void)json_path;
+    (void)source;
+    return false;
+#endif
+}
+
+bool StationCatalog::write_cache(const std::string& cache_path, const SourceInfo& source, uint64_t source_hash) const {
+    if (!ensure_directory(std::filesystem::path(cache_path).parent_path())) {
+        return false;
+    }
+
+    CacheHeader header{};
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.entry_count = static_cast<uint32_t>(entries_.size());
+    header.strings_size = arena_.size();
+    header.source_size = source.size;
+    header.source_mtime_ns = source.mtime_ns;
+    header.source_hash = source_hash;
+
+    // Write to a temp file and rename so readers never see a partial cache
+    std::string tmp_path = cache_path + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(entries_.data()),
+                  static_cast<std::streamsize>(entries_.size() * sizeof(Entry)));
+        out.write(arena_.data(), static_cast<std::streamsize>(arena_.size()));
+        if (!out.good()) {
+            out.close();
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, cache_path, ec);
+    if (ec) {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
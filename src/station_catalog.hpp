@@ -0,0 +1,86 @@
+#ifndef STATION_CATALOG_HPP
+#define STATION_CATALOG_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "station.hpp"
+
+// Station list stored as one string arena plus a fixed-size index.
+//
+// load() first tries the binary cache for the given stations.json
+// (see cache_path_for()). The cache is a single file that is mmap'ed
+// and used in place, so a warm start costs one open + one mmap
+// regardless of catalog size. If the cache is missing or stale the
+// JSON file is parsed with a streaming SAX handler that appends
+// straight into the arena (no DOM), and the cache is rewritten.
+//
+// Stations are ordered by name and duplicate names keep the last URL,
+// matching what the previous nlohmann::json DOM loader produced.
+// Malformed JSON never throws; load() returns false and error() says why.
+class StationCatalog {
+public:
+    struct Entry {
+        uint32_t name_offset;
+        uint32_t name_length;
+        uint32_t url_offset;
+        uint32_t url_length;
+    };
+
+    StationCatalog() = default;
+    ~StationCatalog();
+
+    StationCatalog(const StationCatalog&) = delete;
+    StationCatalog& operator=(const StationCatalog&) = delete;
+
+    // Load stations from json_path, going through the binary cache
+    // when use_cache is true. Returns false if nothing could be loaded.
+    bool load(const std::string& json_path, bool use_cache = true);
+
+    // Parse json_path directly with the SAX loader, bypassing the cache.
+    bool parse_json(const std::string& json_path);
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    std::string_view name(size_t index) const;
+    std::string_view url(size_t index) const;
+
+    std::vector<Station> to_stations() const;
+
+    bool loaded_from_cache() const { return map_ != nullptr; }
+    const std::string& error() const { return error_; }
+
+    // Cache file used for json_path (empty if no cache directory is available)
+    static std::string cache_path_for(const std::string& json_path);
+
+private:
+    struct SourceInfo {
+        uint64_t size = 0;
+        int64_t mtime_ns = 0;
+    };
+
+    bool parse_buffer(const char* data, size_t size);
+    void sort_and_dedupe();
+    bool map_cache(const std::string& cache_path, const std::string& json_path, const SourceInfo& source);
+    bool write_cache(const std::string& cache_path, const SourceInfo& source, uint64_t source_hash) const;
+    void reset();
+
+    // Owned storage (after a JSON parse)
+    std::string arena_;
+    std::vector<Entry> entries_;
+
+    // Active view: points into arena_/entries_ or into the mapped cache
+    const char* strings_ = nullptr;
+    const Entry* index_ = nullptr;
+    size_t count_ = 0;
+
+    void* map_ = nullptr;
+    size_t map_size_ = 0;
+
+    std::string error_;
+};
+
+#endif // STATION_CATALOG_HPP
@@ -0,0 +1,550 @@
+#include "station_directory.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+namespace {
+
+// Lower bounds (kbps) of the bitrate buckets; bucket 0 holds unknown bitrates
+constexpr uint16_t BITRATE_BUCKETS[] = {0, 1, 32, 64, 96, 128, 160, 192, 256, 320};
+constexpr size_t NUM_BITRATE_BUCKETS = std::size(BITRATE_BUCKETS);
+
+size_t bitrate_bucket(uint16_t kbps) {
+    size_t bucket = 0;
+    while (bucket + 1 < NUM_BITRATE_BUCKETS && kbps >= BITRATE_BUCKETS[bucket + 1]) {
+        ++bucket;
+    }
+    return bucket;
+}
+
+std::string to_lower(std::string_view s) {
+    std::string out(s);
+    std::transform(out.begin(), out.end(), out.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return out;
+}
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front()))) s.remove_prefix(1);
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back()))) s.remove_suffix(1);
+    return s;
+}
+
+// Split a name into lowercase word tokens. Non-ASCII bytes count as word
+// characters so UTF-8 words stay intact.
+template <typename Fn>
+void for_each_token(std::string_view text, Fn&& fn) {
+    size_t start = std::string_view::npos;
+    for (size_t i = 0; i <= text.size(); ++i) {
+        unsigned char c = i < text.size() ? static_cast<unsigned char>(text[i]) : ' ';
+        bool word = std::isalnum(c) || c >= 0x80;
+        if (word && start == std::string_view::npos) {
+            start = i;
+        } else if (!word && start != std::string_view::npos) {
+            fn(to_lower(text.substr(start, i - start)));
+            start = std::string_view::npos;
+        }
+    }
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// RowBitset
+
+RowBitset::RowBitset(size_t bits, bool value)
+    : words_((bits + 63) / 64, value ? ~uint64_t(0) : 0), bits_(bits) {
+    clear_tail();
+}
+
+void RowBitset::clear_tail() {
+    if (bits_ % 64 != 0 && !words_.empty()) {
+        words_.back() &= (uint64_t(1) << (bits_ % 64)) - 1;
+    }
+}
+
+RowBitset& RowBitset::operator&=(const RowBitset& other) {
+    for (size_t i = 0; i < words_.size(); ++i) {
+        words_[i] &= other.words_[i];
+    }
+    return *this;
+}
+
+RowBitset& RowBitset::operator|=(const RowBitset& other) {
+    for (size_t i = 0; i < words_.size(); ++i) {
+        words_[i] |= other.words_[i];
+    }
+    return *this;
+}
+
+void RowBitset::flip() {
+    for (auto& word : words_) {
+        word = ~word;
+    }
+    clear_tail();
+}
+
+size_t RowBitset::count() const {
+    size_t total = 0;
+    for (uint64_t word : words_) {
+        total += static_cast<size_t>(std::popcount(word));
+    }
+    return total;
+}
+
+void RowBitset::collect(std::vector<uint32_t>& out, size_t limit) const {
+    for (size_t i = 0; i < words_.size() && out.size() < limit; ++i) {
+        uint64_t word = words_[i];
+        while (word != 0 && out.size() < limit) {
+            out.push_back(static_cast<uint32_t>(i * 64 + std::countr_zero(word)));
+            word &= word - 1;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Postings
+
+void StationDirectory::Postings::finalize(size_t row_count) {
+    // A bitset costs row_count/8 bytes, a row list 4 bytes per entry
+    if (rows.size() * 32 > row_count) {
+        bits = RowBitset(row_count);
+        for (uint32_t row : rows) {
+            bits.set(row);
+        }
+        rows.clear();
+        rows.shrink_to_fit();
+        dense = true;
+    } else {
+        rows.shrink_to_fit();
+    }
+}
+
+void StationDirectory::Postings::merge_into(RowBitset& out) const {
+    if (dense) {
+        out |= bits;
+    } else {
+        for (uint32_t row : rows) {
+            out.set(row);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Import
+
+// Streams an array of station objects. Only the fields we index are
+// kept; anything else (including nested values) is skipped.
+class StationDirectory::ImportHandler : public json::json_sax_t {
+public:
+    ImportHandler(StationDirectory& dir, const std::atomic<bool>* cancel) : dir_(dir), cancel_(cancel) {}
+
+    bool null() override { return true; }
+    bool boolean(bool) override { return true; }
+    bool binary(binary_t&) override { return true; }
+
+    bool number_integer(number_integer_t val) override {
+        if (depth_ == 2 && key_ == "bitrate") set_bitrate(static_cast<int64_t>(val));
+        return true;
+    }
+    bool number_unsigned(number_unsigned_t val) override {
+        if (depth_ == 2 && key_ == "bitrate") set_bitrate(static_cast<int64_t>(val));
+        return true;
+    }
+    bool number_float(number_float_t val, const string_t&) override {
+        if (depth_ == 2 && key_ == "bitrate") set_bitrate(static_cast<int64_t>(val));
+        return true;
+    }
+
+    bool string(string_t& val) override {
+        if (depth_ == 3 && key_ == "tags") {
+            // "tags": ["jazz", "smooth"] variant
+            add_tag(val);
+        } else if (depth_ == 2) {
+            if (key_ == "name") name_ = val;
+            else if (key_ == "url_resolved") url_resolved_ = val;
+            else if (key_ == "url") url_ = val;
+            else if (key_ == "codec") codec_ = val;
+            else if (key_ == "countrycode") countrycode_ = val;
+            else if (key_ == "country") country_ = val;
+            else if (key_ == "bitrate") set_bitrate(std::atoll(val.c_str()));
+            else if (key_ == "tags") {
+                std::string_view tags = val;
+                while (!tags.empty()) {
+                    size_t comma = tags.find(',');
+                    add_tag(tags.substr(0, comma));
+                    if (comma == std::string_view::npos) break;
+                    tags.remove_prefix(comma + 1);
+                }
+            }
+        }
+        return true;
+    }
+
+    bool key(string_t& val) override {
+        if (depth_ == 2) key_ = val;
+        return true;
+    }
+
+    bool start_object(std::size_t) override {
+        ++depth_;
+        if (depth_ == 2) reset_row();
+        return true;
+    }
+
+    bool end_object() override {
+        if (depth_ == 2) {
+            finish_row();
+            if (cancel_ && cancel_->load(std::memory_order_relaxed)) {
+                error_ = "import cancelled";
+                return false;
+            }
+        }
+        --depth_;
+        return true;
+    }
+
+    bool start_array(std::size_t) override {
+        if (depth_ == 0) saw_root_array_ = true;
+        ++depth_;
+        return true;
+    }
+
+    bool end_array() override {
+        --depth_;
+        return true;
+    }
+
+    bool parse_error(std::size_t position, const std::string&, const json::exception& ex) override {
+        error_ = "parse error at byte " + std::to_string(position) + ": " + ex.what();
+        return false;
+    }
+
+    bool saw_root_array() const { return saw_root_array_; }
+    const std::string& error() const { return error_; }
+
+private:
+    void set_bitrate(int64_t kbps) {
+        bitrate_ = static_cast<uint16_t>(std::clamp<int64_t>(kbps, 0, 65535));
+    }
+
+    void add_tag(std::string_view tag) {
+        tag = trim(tag);
+        if (!tag.empty()) {
+            tags_.push_back(to_lower(tag));
+        }
+    }
+
+    void reset_row() {
+        name_.clear();
+        url_.clear();
+        url_resolved_.clear();
+        codec_.clear();
+        countrycode_.clear();
+        country_.clear();
+        tags_.clear();
+        bitrate_ = 0;
+    }
+
+    void finish_row() {
+        const std::string& url = url_resolved_.empty() ? url_ : url_resolved_;
+        std::string_view name = trim(name_);
+        if (name.empty() || url.empty() || dir_.rows_.size() >= UINT32_MAX ||
+            dir_.arena_.size() + name.size() + url.size() > UINT32_MAX) {
+            return;
+        }
+
+        uint32_t row_id = static_cast<uint32_t>(dir_.rows_.size());
+        Row row{};
+        row.name_offset = static_cast<uint32_t>(dir_.arena_.size());
+        row.name_length = static_cast<uint32_t>(name.size());
+        dir_.arena_.append(name);
+        row.url_offset = static_cast<uint32_t>(dir_.arena_.size());
+        row.url_length = static_cast<uint32_t>(url.size());
+        dir_.arena_.append(url);
+
+        std::string country = countrycode_.empty() ? country_ : countrycode_;
+        std::transform(country.begin(), country.end(), country.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+        row.codec = dir_.intern(dir_.codecs_, dir_.codec_ids_, to_lower(trim(codec_)));
+        row.country = dir_.intern(dir_.countries_, dir_.country_ids_, country);
+        row.bitrate = bitrate_;
+        dir_.rows_.push_back(row);
+
+        if (!country.empty()) {
+            dir_.country_index_[to_lower(country)].add(row_id);
+        }
+        std::sort(tags_.begin(), tags_.end());
+        tags_.erase(std::unique(tags_.begin(), tags_.end()), tags_.end());
+        for (const auto& tag : tags_) {
+            dir_.tags_[tag].add(row_id);
+        }
+        for_each_token(name, [&](std::string token) {
+            auto& postings = dir_.name_tokens_[token];
+            // A name may repeat a word; keep row lists unique and sorted
+            if (postings.rows.empty() || postings.rows.back() != row_id) {
+                postings.add(row_id);
+            }
+        });
+    }
+
+    StationDirectory& dir_;
+    const std::atomic<bool>* cancel_;
+    int depth_ = 0;
+    bool saw_root_array_ = false;
+    std::string key_;
+    std::string name_, url_, url_resolved_, codec_, countrycode_, country_;
+    std::vector<std::string> tags_;
+    uint16_t bitrate_ = 0;
+    std::string error_;
+};
+
+uint16_t StationDirectory::intern(std::vector<std::string>& table,
+                                  std::unordered_map<std::string, uint16_t>& ids,
+                                  std::string value) {
+    if (auto it = ids.find(value); it != ids.end()) {
+        return it->second;
+    }
+    if (table.size() >= UINT16_MAX) {
+        return 0;
+    }
+    uint16_t id = static_cast<uint16_t>(table.size());
+    ids.emplace(value, id);
+    table.push_back(std::move(value));
+    return id;
+}
+
+bool StationDirectory::import_file(const std::string& path, const std::atomic<bool>* cancel) {
+    *this = StationDirectory{};
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        error_ = "cannot open " + path;
+        return false;
+    }
+
+    // Row 0 of the interned tables is "unknown"
+    intern(codecs_, codec_ids_, "");
+    intern(countries_, country_ids_, "");
+
+    ImportHandler handler(*this, cancel);
+    bool ok = json::sax_parse(file, &handler);
+    if (!ok || !handler.saw_root_array()) {
+        std::string message = ok ? "directory dump is not a JSON array" : handler.error();
+        *this = StationDirectory{};
+        error_ = message;
+        return false;
+    }
+
+    build_indexes();
+    return true;
+}
+
+void StationDirectory::build_indexes() {
+    size_t n = rows_.size();
+    arena_.shrink_to_fit();
+    rows_.shrink_to_fit();
+
+    codec_bits_.assign(codecs_.size(), RowBitset(n));
+    bitrate_bits_.assign(NUM_BITRATE_BUCKETS, RowBitset(n));
+    for (size_t i = 0; i < n; ++i) {
+        codec_bits_[rows_[i].codec].set(i);
+        bitrate_bits_[bitrate_bucket(rows_[i].bitrate)].set(i);
+    }
+
+    for (auto* index : {&tags_, &country_index_, &name_tokens_}) {
+        for (auto& [term, postings] : *index) {
+            postings.finalize(n);
+        }
+    }
+
+    sorted_tokens_.clear();
+    sorted_tokens_.reserve(name_tokens_.size());
+    for (const auto& [token, postings] : name_tokens_) {
+        sorted_tokens_.push_back(token);
+    }
+    std::sort(sorted_tokens_.begin(), sorted_tokens_.end());
+}
+
+// ---------------------------------------------------------------------------
+// Queries
+
+std::string_view StationDirectory::name(uint32_t row) const {
+    const Row& r = rows_[row];
+    return std::string_view(arena_.data() + r.name_offset, r.name_length);
+}
+
+std::string_view StationDirectory::url(uint32_t row) const {
+    const Row& r = rows_[row];
+    return std::string_view(arena_.data() + r.url_offset, r.url_length);
+}
+
+Station StationDirectory::station(uint32_t row) const {
+    return {std::string(name(row)), std::string(url(row))};
+}
+
+void StationDirectory::match_prefix(std::string_view prefix, RowBitset& out) const {
+    auto it = std::lower_bound(sorted_tokens_.begin(), sorted_tokens_.end(), prefix,
+                               [](const std::string& token, std::string_view p) { return token < p; });
+    for (; it != sorted_tokens_.end() && it->compare(0, prefix.size(), prefix) == 0; ++it) {
+        name_tokens_.at(*it).merge_into(out);
+    }
+}
+
+bool StationDirectory::eval_bitrate(std::string_view term, RowBitset& out) const {
+    size_t op_len = (term.size() > 1 && term[1] == '=') ? 2 : 1;
+    std::string_view op = term.substr(0, op_len);
+    std::string_view number = term.substr(op_len);
+    if (!number.empty() && (number.back() == 'k' || number.back() == 'K')) {
+        number.remove_suffix(1);
+    }
+    if (number.empty() || !std::all_of(number.begin(), number.end(),
+                                       [](char c) { return std::isdigit(static_cast<unsigned char>(c)); })) {
+        return false;
+    }
+    long value = std::strtol(std::string(number).c_str(), nullptr, 10);
+
+    auto matches = [&](long kbps) {
+        if (op == ">=") return kbps >= value;
+        if (op == ">") return kbps > value;
+        if (op == "<=") return kbps <= value;
+        if (op == "<") return kbps < value;
+        return kbps == value;
+    };
+
+    // Whole buckets are OR'ed in; only the bucket straddling the bound is scanned.
+    // Unknown bitrates (bucket 0) never match a comparison.
+    for (size_t b = 1; b < NUM_BITRATE_BUCKETS; ++b) {
+        long lo = BITRATE_BUCKETS[b];
+        long hi = (b + 1 < NUM_BITRATE_BUCKETS) ? BITRATE_BUCKETS[b + 1] - 1 : 65535;
+        bool lo_ok = matches(lo);
+        bool hi_ok = matches(hi);
+        if (lo_ok && hi_ok && op != "=") {
+            out |= bitrate_bits_[b];
+        } else if (lo_ok || hi_ok || (op == "=" && value >= lo && value <= hi)) {
+            std::vector<uint32_t> rows;
+            bitrate_bits_[b].collect(rows, SIZE_MAX);
+            for (uint32_t row : rows) {
+                if (matches(rows_[row].bitrate)) out.set(row);
+            }
+        }
+    }
+    return true;
+}
+
+bool StationDirectory::eval_term(std::string_view term, RowBitset& out, std::string& error) const {
+    if (term.empty()) {
+        return true;
+    }
+    if (term[0] == '>' || term[0] == '<' || term[0] == '=') {
+        if (!eval_bitrate(term, out)) {
+            error = "bad bitrate filter: " + std::string(term);
+            return false;
+        }
+        return true;
+    }
+
+    auto lookup = [&out](const std::unordered_map<std::string, Postings>& index, const std::string& key) {
+        if (auto it = index.find(key); it != index.end()) {
+            it->second.merge_into(out);
+        }
+    };
+
+    size_t colon = term.find(':');
+    if (colon != std::string_view::npos) {
+        std::string field = to_lower(term.substr(0, colon));
+        std::string value = to_lower(term.substr(colon + 1));
+        if (field == "tag") {
+            lookup(tags_, value);
+        } else if (field == "codec") {
+            if (auto it = codec_ids_.find(value); it != codec_ids_.end()) out |= codec_bits_[it->second];
+        } else if (field == "country") {
+            lookup(country_index_, value);
+        } else if (field == "name") {
+            match_prefix(value, out);
+        } else if (field == "bitrate") {
+            return eval_term(term.substr(colon + 1), out, error);
+        } else {
+            error = "unknown field: " + field;
+            return false;
+        }
+        return true;
+    }
+
+    std::string word = to_lower(term);
+    if (auto it = codec_ids_.find(word); it != codec_ids_.end() && !word.empty()) {
+        out |= codec_bits_[it->second];
+        return true;
+    }
+    lookup(tags_, word);
+    lookup(country_index_, word);
+    match_prefix(word, out);
+    return true;
+}
+
+StationDirectory::QueryResult StationDirectory::query(std::string_view text, size_t limit) const {
+    auto start = std::chrono::steady_clock::now();
+    QueryResult result;
+    size_t n = rows_.size();
+
+    // Tokenize on whitespace, then fold into AND-of-OR groups
+    std::vector<std::string_view> words;
+    while (!text.empty()) {
+        text = trim(text);
+        size_t end = 0;
+        while (end < text.size() && !std::isspace(static_cast<unsigned char>(text[end]))) ++end;
+        if (end > 0) words.push_back(text.substr(0, end));
+        text.remove_prefix(end);
+    }
+
+    RowBitset matched(n, true);
+    RowBitset group(n);
+    bool group_open = false;
+    bool join_or = false;
+    bool negate = false;
+
+    auto close_group = [&]() {
+        if (group_open) {
+            matched &= group;
+            group = RowBitset(n);
+            group_open = false;
+        }
+    };
+
+    for (std::string_view word : words) {
+        if (word == "AND" || word == "and") continue;
+        if (word == "OR" || word == "or") { join_or = true; continue; }
+        if (word == "NOT" || word == "not") { negate = true; continue; }
+
+        if (word.size() > 1 && word[0] == '-') {
+            negate = true;
+            word.remove_prefix(1);
+        }
+
+        RowBitset term_bits(n);
+        if (!eval_term(word, term_bits, result.error)) {
+            return result;
+        }
+        if (negate) term_bits.flip();
+
+        if (!join_or) close_group();
+        group |= term_bits;
+        group_open = true;
+        join_or = false;
+        negate = false;
+    }
+    close_group();
+
+    result.total = matched.count();
+    matched.collect(result.rows, limit);
+    result.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
@@ -0,0 +1,130 @@
+#ifndef STATION_DIRECTORY_HPP
+#define STATION_DIRECTORY_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "station.hpp"
+
+// Fixed-size bitset over directory rows
+class RowBitset {
+public:
+    RowBitset() = default;
+    explicit RowBitset(size_t bits, bool value = false);
+
+    void set(size_t bit) { words_[bit >> 6] |= uint64_t(1) << (bit & 63); }
+    bool test(size_t bit) const { return (words_[bit >> 6] >> (bit & 63)) & 1; }
+
+    RowBitset& operator&=(const RowBitset& other);
+    RowBitset& operator|=(const RowBitset& other);
+    void flip();
+
+    size_t count() const;
+    size_t size() const { return bits_; }
+
+    // Appends the indices of set bits (at most limit of them) to out
+    void collect(std::vector<uint32_t>& out, size_t limit) const;
+
+private:
+    void clear_tail();
+
+    std::vector<uint64_t> words_;
+    size_t bits_ = 0;
+};
+
+// Local, searchable copy of a station directory dump.
+//
+// import_file() streams a radio-browser style JSON array
+// ([{"name", "url_resolved"/"url", "tags", "countrycode"/"country",
+// "codec", "bitrate"}, ...]) into a string arena and builds:
+//   - postings for every tag, country and name token
+//     (dense bitsets for common terms, sorted row lists for rare ones)
+//   - one bitset per codec and per bitrate bucket
+//
+// query() takes a conjunction of terms, each of which may be a
+// disjunction joined with OR:
+//   jazz AND aac AND >=128k
+//   tag:jazz OR tag:blues codec:mp3 country:SE -talk
+// Bare words match a codec name exactly, or a tag, country code or
+// name-token prefix. Comparisons (>=, >, <=, <, =) filter on bitrate
+// in kbps; a trailing 'k' is allowed. A leading '-' or NOT negates.
+class StationDirectory {
+public:
+    struct Row {
+        uint32_t name_offset;
+        uint32_t name_length;
+        uint32_t url_offset;
+        uint32_t url_length;
+        uint16_t codec;      // index into codecs_
+        uint16_t country;    // index into countries_
+        uint16_t bitrate;    // kbps, 0 if unknown
+        uint16_t reserved;
+    };
+
+    struct QueryResult {
+        std::vector<uint32_t> rows;   // first `limit` matches, in directory order
+        size_t total = 0;
+        double elapsed_ms = 0.0;
+        std::string error;
+    };
+
+    // Returns false and sets error() on failure. Setting cancel abandons
+    // the import between rows and leaves the directory empty.
+    bool import_file(const std::string& path, const std::atomic<bool>* cancel = nullptr);
+
+    QueryResult query(std::string_view text, size_t limit) const;
+
+    size_t size() const { return rows_.size(); }
+    std::string_view name(uint32_t row) const;
+    std::string_view url(uint32_t row) const;
+    const std::string& codec(uint32_t row) const { return codecs_[rows_[row].codec]; }
+    const std::string& country(uint32_t row) const { return countries_[rows_[row].country]; }
+    uint16_t bitrate(uint32_t row) const { return rows_[row].bitrate; }
+    Station station(uint32_t row) const;
+
+    const std::string& error() const { return error_; }
+
+private:
+    class ImportHandler;
+
+    // Posting list that is converted to a dense bitset once it is large
+    struct Postings {
+        std::vector<uint32_t> rows;   // sorted, used while sparse
+        RowBitset bits;               // used once dense
+        bool dense = false;
+
+        void add(uint32_t row) { rows.push_back(row); }
+        void finalize(size_t row_count);
+        void merge_into(RowBitset& out) const;
+    };
+
+    void build_indexes();
+    bool eval_term(std::string_view term, RowBitset& out, std::string& error) const;
+    bool eval_bitrate(std::string_view term, RowBitset& out) const;
+    void match_prefix(std::string_view prefix, RowBitset& out) const;
+    uint16_t intern(std::vector<std::string>& table, std::unordered_map<std::string, uint16_t>& ids, std::string value);
+
+    std::string arena_;
+    std::vector<Row> rows_;
+
+    std::vector<std::string> codecs_;
+    std::unordered_map<std::string, uint16_t> codec_ids_;
+    std::vector<std::string> countries_;
+    std::unordered_map<std::string, uint16_t> country_ids_;
+
+    std::unordered_map<std::string, Postings> tags_;
+    std::unordered_map<std::string, Postings> country_index_;
+    std::unordered_map<std::string, Postings> name_tokens_;
+    std::vector<std::string> sorted_tokens_;          // for prefix search
+    std::vector<RowBitset> codec_bits_;               // indexed by codec id
+    std::vector<RowBitset> bitrate_bits_;             // indexed by bucket
+
+    std::string error_;
+};
+
+#endif // STATION_DIRECTORY_HPP
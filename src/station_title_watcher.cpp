@@ -0,0 +1,279 @@
+#include "station_title_watcher.hpp"
+#include "icy_http.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <unordered_set>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr auto POLL_TIMEOUT = std::chrono::seconds(15);
+static constexpr auto MAX_BACKOFF = std::chrono::minutes(10);
+static constexpr auto NO_METADATA_RETRY = std::chrono::minutes(30);
+static constexpr size_t MAX_METAINT = 64 * 1024;
+
+namespace {
+
+// Spread polls of different stations over a few seconds
+Clock::duration poll_jitter(const std::string& name) {
+    return std::chrono::milliseconds(std::hash<std::string>{}(name) % 5000);
+}
+
+} // namespace
+
+StationTitleWatcher::~StationTitleWatcher() {
+    stop();
+}
+
+bool StationTitleWatcher::start(const std::vector<Station>& stations) {
+    stop();
+
+    // A stopped reactor cannot start again; each start gets a new one
+    reactor_ = std::make_unique<NetReactor>("title-watch");
+    if (!reactor_->start()) {
+        reactor_.reset();
+        return false;
+    }
+    // Polls start only once the stations arrive through stations_mutex_,
+    // after scheduler_ is set
+    scheduler_ = reactor_->spawn(schedule());
+    set_stations(stations);
+    return true;
+}
+
+void StationTitleWatcher::stop() {
+    if (!reactor_) {
+        return;
+    }
+    // Frees the scheduler and every poll, closing their sockets
+    reactor_->stop();
+    reactor_.reset();
+    scheduler_ = 0;
+    watches_.clear();
+    active_ = 0;
+}
+
+void StationTitleWatcher::set_stations(const std::vector<Station>& stations) {
+    {
+        std::lock_guard<std::mutex> lock(stations_mutex_);
+        pending_stations_ = stations;
+        has_pending_stations_ = true;
+    }
+    if (reactor_) {
+        reactor_->wake(scheduler_);
+    }
+}
+
+bool StationTitleWatcher::take_titles(std::unordered_map<std::string, std::string>& out) {
+    if (!has_titles_.load(std::memory_order_acquire)) {
+        return false;
+    }
+    std::unique_lock<std::mutex> lock(titles_mutex_, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        return false;
+    }
+    out = std::move(titles_);
+    titles_.clear();
+    has_titles_.store(false, std::memory_order_release);
+    return !out.empty();
+}
+
+void StationTitleWatcher::sync_stations() {
+    std::vector<Station> stations;
+    {
+        std::lock_guard<std::mutex> lock(stations_mutex_);
+        if (!has_pending_stations_) return;
+        stations = std::move(pending_stations_);
+        pending_stations_.clear();
+        has_pending_stations_ = false;
+    }
+
+    std::unordered_map<std::string, const Station*> wanted;
+    for (const auto& station : stations) {
+        if (!station.is_playlist()) {
+            wanted[station.name] = &station;
+        }
+    }
+
+    std::unordered_set<std::string> kept;
+    for (auto it = watches_.begin(); it != watches_.end();) {
+        auto want = wanted.find(it->second.name);
+        if (want == wanted.end() || want->second->url != it->second.station_url) {
+            // Its poll ends at its next wait and finds no watch
+            if (it->second.task != 0) {
+                reactor_->cancel(it->second.task);
+                --active_;
+            }
+            it = watches_.erase(it);
+        } else {
+            kept.insert(it->second.name);
+            ++it;
+        }
+    }
+
+    auto now = Clock::now();
+    for (const auto& [name, station] : wanted) {
+        if (kept.count(name)) continue;
+        Watch w;
+        w.name = name;
+        w.station_url = station->url;
+        w.next_poll = now + poll_jitter(name) / 10;
+        watches_.emplace(next_id_++, std::move(w));
+    }
+}
+
+ReactorTask StationTitleWatcher::schedule() {
+    while (true) {
+        sync_stations();
+
+        auto now = Clock::now();
+        auto next_wake = Clock::time_point::max();
+        for (auto& [id, w] : watches_) {
+            if (w.disabled || w.task != 0) continue;
+            if (now < w.next_poll) {
+                next_wake = std::min(next_wake, w.next_poll);
+            } else if (active_ < MAX_CONNECTIONS) {
+                begin_poll(id, w);
+            }
+        }
+
+        // end_poll() wakes us when a slot frees up, set_stations() on a
+        // new list
+        auto timeout = next_wake == Clock::time_point::max() ? NetReactor::NO_TIMEOUT : next_wake - now;
+        if (co_await reactor_->park(timeout) == WaitResult::Cancelled) {
+            co_return;
+        }
+    }
+}
+
+void StationTitleWatcher::begin_poll(uint64_t id, Watch& w) {
+    ParsedUrl url;
+    if (!parse_url(w.station_url, url) || (url.tls && !reactor_->ssl_context())) {
+        w.disabled = true;
+        return;
+    }
+    w.task = reactor_->spawn(poll(id, w.station_url));
+    if (w.task != 0) {
+        ++active_;
+    }
+}
+
+ReactorTask StationTitleWatcher::poll(uint64_t id, std::string url) {
+    NetReactor& reactor = *reactor_;
+    auto deadline = Clock::now() + POLL_TIMEOUT;
+
+    NetSocket socket;
+    IcyResponse response;
+    std::string error;
+    // A small window keeps the server from pushing much audio at us
+    if (!co_await open_icy_stream(reactor, socket, url, deadline, RECV_BUFFER_BYTES, response, error)) {
+        end_poll(id, PollResult::Failed, {});
+        co_return;
+    }
+    if (response.metaint == 0 || response.metaint > MAX_METAINT) {
+        end_poll(id, PollResult::NoMetadata, {});
+        co_return;
+    }
+
+    // Audio is skipped, never decoded; the poll ends with the first block
+    IcyMetadataSplitter splitter;
+    splitter.reset(response.metaint);
+    auto consume = [&](const uint8_t* data, size_t len) -> bool {
+        while (len > 0) {
+            size_t take = std::min(len, splitter.audio_left());
+            if (take > 0) {
+                splitter.audio_read(take);
+            } else {
+                take = std::min(len, splitter.metadata_wanted());
+                if (splitter.feed_metadata(data, take)) {
+                    return true;
+                }
+                // An empty block: back to audio at once
+                if (splitter.audio_left() > 0) {
+                    return true;
+                }
+            }
+            data += take;
+            len -= take;
+        }
+        return false;
+    };
+
+    bool done = consume(reinterpret_cast<const uint8_t*>(response.body.data()), response.body.size());
+    uint8_t chunk[RECV_BUFFER_BYTES];
+    while (!done) {
+        long n = socket.read(chunk, sizeof(chunk));
+        if (n > 0) {
+            done = consume(chunk, static_cast<size_t>(n));
+            continue;
+        }
+        if (n == NetSocket::IO_WOULD_BLOCK) {
+            auto left = deadline - Clock::now();
+            if (left > Clock::duration::zero() &&
+                co_await reactor.io(socket.fd(), EPOLLIN, left) == WaitResult::Ready) {
+                continue;
+            }
+        }
+        // Closed, failed, timed out or cancelled before a metadata block
+        end_poll(id, PollResult::Failed, {});
+        co_return;
+    }
+
+    if (splitter.metadata().empty()) {
+        // The server has nothing to announce right now
+        end_poll(id, PollResult::NoTitle, {});
+    } else {
+        end_poll(id, PollResult::Title, parse_stream_title(splitter.metadata()));
+    }
+}
+
+void StationTitleWatcher::end_poll(uint64_t id, PollResult result, std::string title) {
+    auto it = watches_.find(id);
+    if (it == watches_.end()) {
+        // Removed by set_stations() while polling
+        return;
+    }
+    Watch& w = it->second;
+    w.task = 0;
+    --active_;
+
+    auto now = Clock::now();
+    switch (result) {
+        case PollResult::Title:
+            publish(w, std::move(title));
+            [[fallthrough]];
+        case PollResult::NoTitle:
+            w.failures = 0;
+            w.next_poll = now + POLL_INTERVAL + poll_jitter(w.name);
+            break;
+        case PollResult::NoMetadata:
+            // No inline metadata from this server; check again much later
+            w.failures = 0;
+            w.next_poll = now + NO_METADATA_RETRY;
+            break;
+        case PollResult::Failed: {
+            if (w.failures < 8) {
+                ++w.failures;
+            }
+            Clock::duration backoff = POLL_INTERVAL * (1 << w.failures);
+            w.next_poll = now + std::min(backoff, Clock::duration(MAX_BACKOFF));
+            break;
+        }
+    }
+    reactor_->wake(scheduler_);
+}
+
+void StationTitleWatcher::publish(Watch& w, std::string title) {
+    if (title == w.last_title) {
+        return;
+    }
+    w.last_title = title;
+
+    std::lock_guard<std::mutex> lock(titles_mutex_);
+    titles_[w.name] = std::move(title);
+    has_titles_.store(true, std::memory_order_release);
+}
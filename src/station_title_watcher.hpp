@@ -0,0 +1,90 @@
+#ifndef STATION_TITLE_WATCHER_HPP
+#define STATION_TITLE_WATCHER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "net_reactor.hpp"
+#include "station.hpp"
+
+// Polls the current StreamTitle of every station without playing it.
+//
+// Polls run as coroutines on a NetReactor of the watcher's own, so one
+// thread multiplexes all connections. A poll opens an ICY connection
+// (open_icy_stream), skips the audio bytes up to the first metadata block,
+// parses it and closes the socket; nothing is decoded. Sockets get a
+// small receive buffer so a poll costs roughly one icy-metaint interval
+// of audio. Each station is polled every POLL_INTERVAL, at most
+// MAX_CONNECTIONS at a time; between polls a station costs only its name,
+// URL and last title.
+//
+// https stations need OpenSSL (WEBRADIO_HAVE_OPENSSL); playlist URLs
+// are not watched. Linux only.
+class StationTitleWatcher {
+public:
+    static constexpr std::chrono::seconds POLL_INTERVAL{30};
+    static constexpr size_t MAX_CONNECTIONS = 32;
+    static constexpr int RECV_BUFFER_BYTES = 4096;
+
+    StationTitleWatcher() = default;
+    ~StationTitleWatcher();
+
+    StationTitleWatcher(const StationTitleWatcher&) = delete;
+    StationTitleWatcher& operator=(const StationTitleWatcher&) = delete;
+
+    bool start(const std::vector<Station>& stations);
+    void stop();
+
+    // Replace the watched list; unchanged stations keep their schedule
+    void set_stations(const std::vector<Station>& stations);
+
+    // Non-blocking: returns true and fills out (station name -> title)
+    // if any title changed since the last call
+    bool take_titles(std::unordered_map<std::string, std::string>& out);
+
+private:
+    enum class PollResult : uint8_t { Title, NoTitle, NoMetadata, Failed };
+
+    struct Watch {
+        std::string name;
+        std::string station_url;
+        std::string last_title;
+        std::chrono::steady_clock::time_point next_poll{};
+        uint64_t task = 0;        // the poll's reactor task while one runs
+        uint8_t failures = 0;
+        bool disabled = false;
+    };
+
+    // Reactor thread: starts due polls, parks until the next one is due
+    ReactorTask schedule();
+    ReactorTask poll(uint64_t id, std::string url);
+    void sync_stations();
+    void begin_poll(uint64_t id, Watch& w);
+    void end_poll(uint64_t id, PollResult result, std::string title);
+    void publish(Watch& w, std::string title);
+
+    std::unique_ptr<NetReactor> reactor_;
+    uint64_t scheduler_ = 0;
+
+    // Reactor thread only
+    std::unordered_map<uint64_t, Watch> watches_;
+    uint64_t next_id_ = 1;
+    size_t active_ = 0;
+
+    std::mutex stations_mutex_;
+    std::vector<Station> pending_stations_;
+    bool has_pending_stations_ = false;
+
+    std::mutex titles_mutex_;
+    std::unordered_map<std::string, std::string> titles_;
+    std::atomic<bool> has_titles_{false};
+};
+
+#endif // STATION_TITLE_WATCHER_HPP
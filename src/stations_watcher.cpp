@@ -0,0 +1,230 @@
+#include "stations_watcher.hpp"
+#include "thread_name.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iterator>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// Editors often write a file in several steps; wait for quiet before reloading
+static constexpr int RELOAD_DEBOUNCE_MS = 200;
+
+StationChanges diff_stations(const StationCatalog& old_list, const StationCatalog& new_list) {
+    StationChanges changes;
+
+    size_t i = 0;
+    size_t j = 0;
+    while (i < old_list.size() || j < new_list.size()) {
+        if (j == new_list.size() || (i < old_list.size() && old_list.name(i) < new_list.name(j))) {
+            changes.removed.emplace_back(old_list.name(i));
+            ++i;
+        } else if (i == old_list.size() || new_list.name(j) < old_list.name(i)) {
+            changes.added.push_back({std::string(new_list.name(j)), std::string(new_list.url(j))});
+            ++j;
+        } else {
+            if (old_list.url(i) != new_list.url(j)) {
+                changes.updated.push_back({std::string(new_list.name(j)), std::string(new_list.url(j))});
+            }
+            ++i;
+            ++j;
+        }
+    }
+
+    return changes;
+}
+
+void apply_station_changes(std::vector<Station>& stations, const StationChanges& changes) {
+    if (changes.empty()) return;
+
+    std::unordered_set<std::string_view> removed(changes.removed.begin(), changes.removed.end());
+    std::unordered_map<std::string_view, const std::string*> updated;
+    for (const auto& station : changes.updated) {
+        updated[station.name] = &station.url;
+    }
+
+    // Only changed rows are touched
+    std::vector<Station> kept;
+    kept.reserve(stations.size() + changes.added.size());
+    for (auto& station : stations) {
+        if (removed.count(station.name)) continue;
+        if (auto it = updated.find(station.name); it != updated.end()) {
+            station.url = *it->second;
+        }
+        kept.push_back(std::move(station));
+    }
+
+    // Added rows arrive in name order (diff_stations); merge them in
+    auto by_name = [](const Station& a, const Station& b) { return a.name < b.name; };
+    if (!std::is_sorted(kept.begin(), kept.end(), by_name)) {
+        std::stable_sort(kept.begin(), kept.end(), by_name);
+    }
+    stations.clear();
+    stations.reserve(kept.size() + changes.added.size());
+    std::merge(std::make_move_iterator(kept.begin()), std::make_move_iterator(kept.end()),
+               changes.added.begin(), changes.added.end(),
+               std::back_inserter(stations), by_name);
+}
+
+StationsWatcher::~StationsWatcher() {
+    stop();
+}
+
+bool StationsWatcher::start(const std::string& path, std::unique_ptr<StationCatalog> current) {
+#ifdef __linux__
+    stop();
+
+    std::filesystem::path file_path = std::filesystem::absolute(path);
+    std::filesystem::path dir = file_path.parent_path();
+    path_ = file_path.string();
+    file_name_ = file_path.filename().string();
+    current_ = current ? std::move(current) : std::make_unique<StationCatalog>();
+
+    inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd_ < 0) {
+        return false;
+    }
+
+    uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE;
+    if (inotify_add_watch(inotify_fd_, dir.c_str(), mask) < 0) {
+        close(inotify_fd_);
+        inotify_fd_ = -1;
+        return false;
+    }
+
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+        close(inotify_fd_);
+        inotify_fd_ = -1;
+        return false;
+    }
+
+    stop_requested_ = false;
+    thread_ = std::thread([this]() {
+        set_thread_name("stations-watch");
+        run();
+    });
+    return true;
+#else
+    (void)path;
+    (void)current;
+    return false;
+#endif
+}
+
+void StationsWatcher::stop() {
+#ifdef __linux__
+    stop_requested_ = true;
+    if (wake_fd_ >= 0) {
+        uint64_t one = 1;
+        (void)!write(wake_fd_, &one, sizeof(one));
+    }
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    if (inotify_fd_ >= 0) {
+        close(inotify_fd_);
+        inotify_fd_ = -1;
+    }
+    if (wake_fd_ >= 0) {
+        close(wake_fd_);
+        wake_fd_ = -1;
+    }
+#endif
+}
+
+bool StationsWatcher::take_changes(StationChanges& out) {
+    if (!has_pending_.load(std::memory_order_acquire)) {
+        return false;
+    }
+    // Never wait on the watcher thread: if it is mid-reload, try next tick
+    std::unique_lock<std::mutex> lock(pending_mutex_, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        return false;
+    }
+    out = std::move(pending_);
+    pending_ = StationChanges{};
+    has_pending_.store(false, std::memory_order_release);
+    baseline_.reset();
+    return true;
+}
+
+void StationsWatcher::reload() {
+    auto catalog = std::make_unique<StationCatalog>();
+    if (!catalog->load(path_)) {
+        // Half-written or invalid file: keep the current list
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    if (!has_pending_) {
+        // baseline_ is what the UI shows until it takes these changes
+        baseline_ = std::move(current_);
+    }
+    StationChanges changes = diff_stations(*baseline_, *catalog);
+    current_ = std::move(catalog);
+
+    pending_ = std::move(changes);
+    has_pending_.store(!pending_.empty(), std::memory_order_release);
+    if (pending_.empty()) {
+        baseline_.reset();
+    }
+}
+
+void StationsWatcher::run() {
+#ifdef __linux__
+    alignas(inotify_event) char events[4096];
+    bool reload_scheduled = false;
+    auto reload_at = std::chrono::steady_clock::now();
+
+    while (!stop_requested_) {
+        int timeout_ms = -1;
+        if (reload_scheduled) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                reload_at - std::chrono::steady_clock::now()).count();
+            timeout_ms = remaining > 0 ? static_cast<int>(remaining) : 0;
+        }
+
+        pollfd fds[2] = {
+            {inotify_fd_, POLLIN, 0},
+            {wake_fd_, POLLIN, 0},
+        };
+        int ret = poll(fds, 2, timeout_ms);
+        if (ret < 0) {
+            continue;
+        }
+        if (fds[1].revents & POLLIN) {
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            ssize_t len;
+            while ((len = read(inotify_fd_, events, sizeof(events))) > 0) {
+                for (char* p = events; p < events + len;) {
+                    auto* ev = reinterpret_cast<inotify_event*>(p);
+                    if (ev->len > 0 && file_name_ == ev->name) {
+                        reload_scheduled = true;
+                        reload_at = std::chrono::steady_clock::now() +
+                                    std::chrono::milliseconds(RELOAD_DEBOUNCE_MS);
+                    }
+                    p += sizeof(inotify_event) + ev->len;
+                }
+            }
+        }
+
+        if (reload_scheduled && std::chrono::steady_clock::now() >= reload_at) {
+            reload_scheduled = false;
+            reload();
+        }
+    }
+#endif
+}
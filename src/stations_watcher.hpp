@@ -0,0 +1,65 @@
+#ifndef STATIONS_WATCHER_HPP
+#define STATIONS_WATCHER_HPP
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "station.hpp"
+#include "station_catalog.hpp"
+
+// Compute row-level changes from old_list to new_list (matched by name).
+// Both catalogs are sorted by name, so this is one merge pass; only the
+// changed rows are copied out.
+StationChanges diff_stations(const StationCatalog& old_list, const StationCatalog& new_list);
+
+// Apply changes to a list in name order, in one pass: removed rows are
+// dropped, updated URLs replaced and added rows merged in. A list that is
+// not sorted yet (the debug/fallback list) is sorted first.
+void apply_station_changes(std::vector<Station>& stations, const StationChanges& changes);
+
+// Watches a stations.json file with inotify and reloads it on a
+// background thread. The directory is watched rather than the file so
+// that editors which save via rename are picked up. Each reload is
+// parsed and diffed off the UI thread; the UI thread only collects the
+// resulting change set with take_changes(). Reloads keep the catalog
+// as loaded (usually the mmap'ed cache) rather than copying it.
+class StationsWatcher {
+public:
+    StationsWatcher() = default;
+    ~StationsWatcher();
+
+    StationsWatcher(const StationsWatcher&) = delete;
+    StationsWatcher& operator=(const StationsWatcher&) = delete;
+
+    // Start watching path. current is the catalog the UI's list was built
+    // from (nullptr if the UI did not come from path).
+    bool start(const std::string& path, std::unique_ptr<StationCatalog> current);
+    void stop();
+
+    // Non-blocking: returns true and fills out if a reload produced changes
+    bool take_changes(StationChanges& out);
+
+private:
+    void run();
+    void reload();
+
+    std::string path_;
+    std::string file_name_;
+    std::unique_ptr<StationCatalog> current_;  // watcher thread only
+
+    std::thread thread_;
+    int inotify_fd_ = -1;
+    int wake_fd_ = -1;
+    std::atomic<bool> stop_requested_{false};
+
+    std::mutex pending_mutex_;
+    StationChanges pending_;
+    std::unique_ptr<StationCatalog> baseline_;  // UI's list while pending_ is untaken
+    std::atomic<bool> has_pending_{false};
+};
+
+#endif // STATIONS_WATCHER_HPP
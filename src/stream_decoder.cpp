@@ -0,0 +1,365 @@
+#include "stream_decoder.hpp"
+#include "metrics.hpp"
+#include "pipeline_clock.hpp"
+#include "trace.hpp"
+
+#include <cstring>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/samplefmt.h>
+#include <libswresample/swresample.h>
+}
+
+namespace {
+
+// Poll interval while the ring is full
+constexpr uint64_t RING_WAIT_NS = 1'000'000;
+
+} // namespace
+
+StreamDecoder::~StreamDecoder() {
+    close();
+}
+
+bool StreamDecoder::fail(int err, const std::string& what) {
+    last_error_ = err;
+    char buf[AV_ERROR_MAX_STRING_SIZE] = {};
+    if (err < 0) {
+        av_strerror(err, buf, sizeof(buf));
+    }
+    error_ = buf[0] ? what + ": " + buf : what;
+    return false;
+}
+
+bool StreamDecoder::open_input(const std::string& url, AVDictionary** options) {
+    close();
+    int ret;
+    {
+        TRACE_SCOPE("open");
+        std::string session_error;
+        if (url.rfind(REPLAY_URL_PREFIX, 0) == 0) {
+            session_ = SessionIo::replay(url.substr(std::strlen(REPLAY_URL_PREFIX)), replay_speed_, session_error);
+        } else if (!record_dir_.empty()) {
+            session_ = SessionIo::record(url, options, record_dir_, session_error);
+        }
+        if (!session_error.empty()) {
+            return fail(0, session_error);
+        }
+
+        if (session_) {
+            fmt_ctx_ = avformat_alloc_context();
+            if (!fmt_ctx_) {
+                session_.reset();
+                return fail(AVERROR(ENOMEM), "cannot allocate demuxer");
+            }
+            fmt_ctx_->pb = session_->avio();
+            fmt_ctx_->flags |= AVFMT_FLAG_CUSTOM_IO;
+            session_->attach(fmt_ctx_);
+        }
+        // The recorded URL still tells the demuxer what to expect
+        const std::string& input_url = session_ ? session_->url() : url;
+        ret = avformat_open_input(&fmt_ctx_, input_url.c_str(), nullptr, options);
+    }
+    if (ret < 0) {
+        fmt_ctx_ = nullptr;
+        session_.reset();
+        return fail(ret, "cannot open " + url);
+    }
+    return true;
+}
+
+bool StreamDecoder::open_input(AVIOContext* io, const std::string& url) {
+    close();
+    int ret;
+    {
+        TRACE_SCOPE("open");
+        fmt_ctx_ = avformat_alloc_context();
+        if (!fmt_ctx_) {
+            return fail(AVERROR(ENOMEM), "cannot allocate demuxer");
+        }
+        fmt_ctx_->pb = io;
+        fmt_ctx_->flags |= AVFMT_FLAG_CUSTOM_IO;
+        ret = avformat_open_input(&fmt_ctx_, url.c_str(), nullptr, nullptr);
+    }
+    if (ret < 0) {
+        fmt_ctx_ = nullptr;
+        return fail(ret, "cannot open " + url);
+    }
+    return true;
+}
+
+bool StreamDecoder::find_stream_info() {
+    int ret;
+    {
+        TRACE_SCOPE("probe");
+        ret = avformat_find_stream_info(fmt_ctx_, nullptr);
+    }
+    if (ret < 0) {
+        return fail(ret, "no stream info");
+    }
+    return true;
+}
+
+bool StreamDecoder::open_codec() {
+    for (unsigned int i = 0; i < fmt_ctx_->nb_streams; i++) {
+        AVStream* stream = fmt_ctx_->streams[i];
+        if (stream->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
+            audio_stream_idx_ = static_cast<int>(i);
+            codec_ = avcodec_find_decoder(stream->codecpar->codec_id);
+            break;
+        }
+    }
+    if (audio_stream_idx_ == -1) {
+        return fail(0, "no audio stream");
+    }
+    if (!codec_) {
+        return fail(0, "no decoder for the audio stream");
+    }
+
+    codec_ctx_ = avcodec_alloc_context3(codec_);
+    if (!codec_ctx_) {
+        return fail(AVERROR(ENOMEM), "cannot allocate decoder");
+    }
+    int ret = avcodec_parameters_to_context(codec_ctx_, fmt_ctx_->streams[audio_stream_idx_]->codecpar);
+    if (ret < 0) {
+        return fail(ret, "bad codec parameters");
+    }
+    ret = avcodec_open2(codec_ctx_, codec_, nullptr);
+    if (ret < 0) {
+        return fail(ret, std::string("cannot open ") + codec_->name + " decoder");
+    }
+
+    bool passthrough_pcm =
+        codec_ctx_->sample_fmt == AV_SAMPLE_FMT_S16 &&
+        codec_ctx_->sample_rate == OUTPUT_SAMPLE_RATE &&
+        codec_ctx_->ch_layout.nb_channels == OUTPUT_CHANNELS;
+
+    if (!passthrough_pcm) {
+        AVChannelLayout out_ch_layout;
+        av_channel_layout_default(&out_ch_layout, OUTPUT_CHANNELS);
+
+        ret = swr_alloc_set_opts2(&swr_ctx_,
+            &out_ch_layout,
+            AV_SAMPLE_FMT_S16,
+            OUTPUT_SAMPLE_RATE,
+            &codec_ctx_->ch_layout,
+            codec_ctx_->sample_fmt,
+            codec_ctx_->sample_rate,
+            0, nullptr);
+        if (ret < 0) {
+            return fail(ret, "cannot set up resampler");
+        }
+        ret = swr_init(swr_ctx_);
+        if (ret < 0) {
+            return fail(ret, "cannot set up resampler");
+        }
+    }
+
+    packet_ = av_packet_alloc();
+    frame_ = av_frame_alloc();
+    if (!packet_ || !frame_) {
+        return fail(AVERROR(ENOMEM), "cannot allocate packet");
+    }
+    return true;
+}
+
+bool StreamDecoder::read_packet() {
+    int ret;
+    {
+        TRACE_SCOPE("read");
+        ret = av_read_frame(fmt_ctx_, packet_);
+    }
+    if (ret < 0) {
+        return fail(ret, "stream ended");
+    }
+    EngineMetrics& metrics = engine_metrics();
+    metrics.bytes_in.add(static_cast<uint64_t>(packet_->size));
+    metrics.packets.add();
+    return true;
+}
+
+bool StreamDecoder::is_audio_packet() const {
+    return packet_->stream_index == audio_stream_idx_;
+}
+
+void StreamDecoder::unref_packet() {
+    av_packet_unref(packet_);
+}
+
+bool StreamDecoder::send_packet(uint64_t& decode_ns) {
+    uint64_t decode_start = metrics_now_ns();
+    int ret;
+    {
+        TRACE_SCOPE("decode");
+        ret = avcodec_send_packet(codec_ctx_, packet_);
+    }
+    decode_ns = metrics_now_ns() - decode_start;
+    if (ret < 0) {
+        return fail(ret, "decode error");
+    }
+    return true;
+}
+
+// True with the next decoded frame in frame_; decode time since the
+// previous frame is recorded against it
+bool StreamDecoder::receive_frame(uint64_t& decode_ns) {
+    uint64_t decode_start = metrics_now_ns();
+    int ret;
+    {
+        TRACE_SCOPE("decode");
+        ret = avcodec_receive_frame(codec_ctx_, frame_);
+    }
+    decode_ns += metrics_now_ns() - decode_start;
+    if (ret < 0) {
+        return false;
+    }
+
+    EngineMetrics& metrics = engine_metrics();
+    metrics.frames_decoded.add();
+    metrics.decode_ns.record(decode_ns);
+    decode_ns = 0;
+    return true;
+}
+
+bool StreamDecoder::decode_packet(ByteRingbuffer& ring, const std::atomic<bool>& stop) {
+    uint64_t decode_ns = 0;
+    if (!send_packet(decode_ns)) {
+        return false;
+    }
+
+    while (receive_frame(decode_ns)) {
+        if (passthrough()) {
+            int data_size = av_samples_get_buffer_size(
+                nullptr,
+                codec_ctx_->ch_layout.nb_channels,
+                frame_->nb_samples,
+                codec_ctx_->sample_fmt,
+                1);
+            if (data_size > 0 && frame_->data[0] != nullptr) {
+                write_pcm(ring, frame_->data[0], static_cast<size_t>(data_size), stop);
+            }
+        } else {
+            convert_frame(ring, stop);
+        }
+    }
+    return true;
+}
+
+bool StreamDecoder::decode_packet(AudioAnalyzer& analyzer) {
+    uint64_t decode_ns = 0;
+    if (!send_packet(decode_ns)) {
+        return false;
+    }
+
+    while (receive_frame(decode_ns)) {
+        if (passthrough()) {
+            if (frame_->data[0] != nullptr && frame_->nb_samples > 0) {
+                analyzer.push_samples(reinterpret_cast<const int16_t*>(frame_->data[0]),
+                                      static_cast<size_t>(frame_->nb_samples));
+                engine_metrics().pcm_bytes.add(static_cast<uint64_t>(frame_->nb_samples) * OUTPUT_BYTES_PER_FRAME);
+            }
+            continue;
+        }
+
+        int max_samples = swr_get_out_samples(swr_ctx_, frame_->nb_samples);
+        if (max_samples <= 0) {
+            continue;
+        }
+        convert_buffer_.resize(static_cast<size_t>(max_samples) * OUTPUT_BYTES_PER_FRAME);
+        uint8_t* dst = convert_buffer_.data();
+        int converted_samples;
+        {
+            TRACE_SCOPE("swr");
+            converted_samples = swr_convert(
+                swr_ctx_,
+                &dst,
+                max_samples,
+                const_cast<const uint8_t**>(frame_->extended_data),
+                frame_->nb_samples);
+        }
+        if (converted_samples > 0) {
+            analyzer.push_samples(reinterpret_cast<const int16_t*>(dst), static_cast<size_t>(converted_samples));
+            engine_metrics().pcm_bytes.add(static_cast<uint64_t>(converted_samples) * OUTPUT_BYTES_PER_FRAME);
+        }
+    }
+    return true;
+}
+
+void StreamDecoder::write_pcm(ByteRingbuffer& ring, const uint8_t* src, size_t size,
+                              const std::atomic<bool>& stop) {
+    TRACE_SCOPE("ring write");
+    size_t written = 0;
+    while (written < size && !stop) {
+        uint8_t* dst = nullptr;
+        size_t available = ring.reserve_write_contiguous(dst);
+        if (available == 0 || dst == nullptr) {
+            ring_full_waits_++;
+            engine_metrics().ring_full_waits.add();
+            pipeline_clock().sleep_for_ns(RING_WAIT_NS);
+            continue;
+        }
+
+        size_t chunk = std::min(available, size - written);
+        std::memcpy(dst, src + written, chunk);
+        ring.produce(chunk);
+        engine_metrics().pcm_bytes.add(chunk);
+        written += chunk;
+    }
+}
+
+// Resamples straight into the ring's free space; swr keeps what does not
+// fit and the next loop flushes it
+void StreamDecoder::convert_frame(ByteRingbuffer& ring, const std::atomic<bool>& stop) {
+    TRACE_SCOPE("ring write");
+    const uint8_t** input = const_cast<const uint8_t**>(frame_->extended_data);
+    int input_samples = frame_->nb_samples;
+    bool input_sent = false;
+
+    while (!stop) {
+        uint8_t* dst = nullptr;
+        size_t available = ring.reserve_write_contiguous(dst);
+        if (available < OUTPUT_BYTES_PER_FRAME || dst == nullptr) {
+            ring_full_waits_++;
+            engine_metrics().ring_full_waits.add();
+            pipeline_clock().sleep_for_ns(RING_WAIT_NS);
+            continue;
+        }
+
+        int max_samples = static_cast<int>(available / OUTPUT_BYTES_PER_FRAME);
+        int converted_samples;
+        {
+            TRACE_SCOPE("swr");
+            converted_samples = swr_convert(
+                swr_ctx_,
+                &dst,
+                max_samples,
+                input_sent ? nullptr : input,
+                input_sent ? 0 : input_samples);
+        }
+
+        if (converted_samples <= 0) {
+            return;
+        }
+
+        size_t produced_bytes = static_cast<size_t>(converted_samples) * OUTPUT_BYTES_PER_FRAME;
+        ring.produce(produced_bytes);
+        engine_metrics().pcm_bytes.add(produced_bytes);
+        input_sent = true;
+    }
+}
+
+void StreamDecoder::close() {
+    av_packet_free(&packet_);
+    av_frame_free(&frame_);
+    swr_free(&swr_ctx_);
+    avcodec_free_context(&codec_ctx_);
+    if (fmt_ctx_) {
+        avformat_close_input(&fmt_ctx_);
+    }
+    session_.reset();
+    codec_ = nullptr;
+    audio_stream_idx_ = -1;
+}
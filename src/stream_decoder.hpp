@@ -0,0 +1,127 @@
+#ifndef STREAM_DECODER_HPP
+#define STREAM_DECODER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+#include <vector>
+
+#include "audio_analyzer.hpp"
+#include "byte_ringbuffer.hpp"
+#include "session_io.hpp"
+
+extern "C" {
+struct AVCodec;
+struct AVCodecContext;
+struct AVDictionary;
+struct AVFormatContext;
+struct AVFrame;
+struct AVIOContext;
+struct AVPacket;
+struct SwrContext;
+}
+
+// Demuxing, decoding and resampling of one stream into the playback ring
+// as 44.1 kHz 16-bit stereo. Used by the player's playback thread, by
+// MonitorEngine's decode tasks and by webradio-bench, so all measure the
+// same code.
+//
+// Opening is split into the steps the tune timeline stamps separately:
+// open_input(), find_stream_info(), open_codec(). After that, per packet:
+// read_packet(), then decode_packet() for audio packets, then
+// unref_packet(). Each failing call sets error(); the destructor frees
+// whatever was opened.
+//
+// A "replay:FILE" URL plays a session recording instead of connecting;
+// with set_record_dir() every session opened is recorded (session_io.hpp).
+//
+// Updates the engine metrics (bytes_in, packets, frames_decoded,
+// decode_ns, pcm_bytes). Decode time excludes waiting for ring space.
+class StreamDecoder {
+public:
+    static constexpr int OUTPUT_SAMPLE_RATE = 44100;
+    static constexpr int OUTPUT_CHANNELS = 2;
+    static constexpr size_t OUTPUT_BYTES_PER_FRAME = 4;
+    static constexpr size_t OUTPUT_BYTES_PER_SECOND = OUTPUT_SAMPLE_RATE * OUTPUT_BYTES_PER_FRAME;
+
+    StreamDecoder() = default;
+    ~StreamDecoder();
+
+    StreamDecoder(const StreamDecoder&) = delete;
+    StreamDecoder& operator=(const StreamDecoder&) = delete;
+
+    // Record sessions opened from now on into dir; empty turns it off
+    void set_record_dir(const std::filesystem::path& dir) { record_dir_ = dir; }
+    // Pacing of replay: URLs. 1 = original timing, 2 = twice as fast,
+    // 0 = as fast as the decoder reads.
+    void set_replay_speed(double speed) { replay_speed_ = speed; }
+
+    // avformat_open_input; options is consumed like FFmpeg does
+    bool open_input(const std::string& url, AVDictionary** options);
+    // Demuxes from io instead of connecting; the caller owns io and keeps
+    // it until close(). url only helps the format probe.
+    bool open_input(AVIOContext* io, const std::string& url);
+    bool find_stream_info();
+    // First audio stream, its decoder, and a resampler unless the decoder
+    // already produces the output format
+    bool open_codec();
+
+    // Reads the next packet into packet(). False at end of stream or on a
+    // read error (see last_error()).
+    bool read_packet();
+    bool is_audio_packet() const;
+    // Decodes packet() and writes every frame into ring, waiting for space
+    // until stop is set. False if the decoder rejected the packet.
+    bool decode_packet(ByteRingbuffer& ring, const std::atomic<bool>& stop);
+    // Decodes packet() and hands each frame to analyzer, with no ring in
+    // between (monitoring: nothing is played)
+    bool decode_packet(AudioAnalyzer& analyzer);
+    void unref_packet();
+
+    void close();
+
+    AVFormatContext* format_context() const { return fmt_ctx_; }
+    AVCodecContext* codec_context() const { return codec_ctx_; }
+    const AVCodec* codec() const { return codec_; }
+    AVPacket* packet() const { return packet_; }
+    int audio_stream_index() const { return audio_stream_idx_; }
+    bool passthrough() const { return swr_ctx_ == nullptr; }
+
+    // Times decode_packet() found the ring full and had to wait
+    uint64_t ring_full_waits() const { return ring_full_waits_; }
+
+    // The file being recorded or replayed, if any
+    const SessionIo* session() const { return session_.get(); }
+
+    int last_error() const { return last_error_; }
+    const std::string& error() const { return error_; }
+
+private:
+    bool fail(int err, const std::string& what);
+    bool send_packet(uint64_t& decode_ns);
+    bool receive_frame(uint64_t& decode_ns);
+    void write_pcm(ByteRingbuffer& ring, const uint8_t* src, size_t size, const std::atomic<bool>& stop);
+    void convert_frame(ByteRingbuffer& ring, const std::atomic<bool>& stop);
+
+    AVFormatContext* fmt_ctx_ = nullptr;
+    AVCodecContext* codec_ctx_ = nullptr;
+    const AVCodec* codec_ = nullptr;
+    SwrContext* swr_ctx_ = nullptr;
+    AVPacket* packet_ = nullptr;
+    AVFrame* frame_ = nullptr;
+    std::vector<uint8_t> convert_buffer_;  // decode_packet(AudioAnalyzer&) resampling
+    int audio_stream_idx_ = -1;
+    uint64_t ring_full_waits_ = 0;
+    int last_error_ = 0;
+    std::string error_;
+    std::filesystem::path record_dir_;
+    double replay_speed_ = 1.0;
+    // Must outlive fmt_ctx_, which reads through its AVIOContext
+    std::unique_ptr<SessionIo> session_;
+};
+
+#endif // STREAM_DECODER_HPP
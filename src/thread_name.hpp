@@ -0,0 +1,18 @@
+#ifndef THREAD_NAME_HPP
+#define THREAD_NAME_HPP
+
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+// Name the calling thread for top -H, gdb and the performance panel.
+// Linux keeps at most 15 characters.
+inline void set_thread_name(const char* name) {
+#ifdef __linux__
+    pthread_setname_np(pthread_self(), name);
+#else
+    (void)name;
+#endif
+}
+
+#endif // THREAD_NAME_HPP
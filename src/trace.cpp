@@ -0,0 +1,208 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+// Rings allocated up front: UI, playback and audio callback threads plus one spare
+constexpr size_t PREALLOCATED_BUFFERS = 4;
+
+// One span slot, guarded by a sequence number so trace_dump() can skip
+// slots that were overwritten while it read them (seq is index + 1, or
+// 0 while the owner is writing)
+struct TraceEvent {
+    std::atomic<uint64_t> seq{0};
+    std::atomic<const char*> name{nullptr};
+    std::atomic<uint64_t> start_ns{0};
+    std::atomic<uint64_t> duration_ns{0};
+};
+
+struct TraceBuffer {
+    uint32_t id = 0;
+    std::atomic<const char*> thread_name{nullptr};
+    std::atomic<bool> in_use{false};
+    uint64_t head = 0;                      // owning thread only
+    std::array<TraceEvent, TRACE_BUFFER_EVENTS> events;
+};
+
+std::mutex g_buffers_mutex;
+std::vector<std::unique_ptr<TraceBuffer>> g_buffers;   // never shrinks
+
+void add_buffer_locked() {
+    auto buffer = std::make_unique<TraceBuffer>();
+    buffer->id = static_cast<uint32_t>(g_buffers.size() + 1);
+    g_buffers.push_back(std::move(buffer));
+}
+
+TraceBuffer* acquire_buffer() {
+    std::lock_guard<std::mutex> lock(g_buffers_mutex);
+    for (auto& buffer : g_buffers) {
+        bool expected = false;
+        if (buffer->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            return buffer.get();
+        }
+    }
+    add_buffer_locked();
+    g_buffers.back()->in_use.store(true, std::memory_order_relaxed);
+    return g_buffers.back().get();
+}
+
+// The calling thread's ring, handed back to the pool when the thread exits
+struct ThreadSlot {
+    TraceBuffer* buffer = nullptr;
+    const char* name = nullptr;
+
+    ~ThreadSlot() {
+        if (buffer) {
+            buffer->in_use.store(false, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ThreadSlot t_slot;
+
+void append_escaped(std::string& out, const char* s) {
+    for (; s && *s; ++s) {
+        if (*s == '"' || *s == '\\') {
+            out += '\\';
+        }
+        out += *s;
+    }
+}
+
+} // namespace
+
+void trace_enable(bool enabled) {
+    if (enabled) {
+        std::lock_guard<std::mutex> lock(g_buffers_mutex);
+        while (g_buffers.size() < PREALLOCATED_BUFFERS) {
+            add_buffer_locked();
+        }
+    }
+    g_trace_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void trace_set_thread_name(const char* name) {
+    t_slot.name = name;
+    if (t_slot.buffer) {
+        t_slot.buffer->thread_name.store(name, std::memory_order_relaxed);
+    }
+}
+
+void trace_record(const char* name, uint64_t start_ns, uint64_t duration_ns) {
+    ThreadSlot& slot = t_slot;
+    if (!slot.buffer) {
+        // Once per thread; normally served from the preallocated pool
+        slot.buffer = acquire_buffer();
+        slot.buffer->thread_name.store(slot.name, std::memory_order_relaxed);
+    }
+
+    TraceBuffer& buffer = *slot.buffer;
+    uint64_t index = buffer.head++;
+    TraceEvent& event = buffer.events[index & (TRACE_BUFFER_EVENTS - 1)];
+    event.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    event.name.store(name, std::memory_order_relaxed);
+    event.start_ns.store(start_ns, std::memory_order_relaxed);
+    event.duration_ns.store(duration_ns, std::memory_order_relaxed);
+    event.seq.store(index + 1, std::memory_order_release);
+}
+
+bool trace_dump(const std::filesystem::path& path, std::string& error) {
+    struct Span {
+        const char* name;
+        uint64_t start_ns;
+        uint64_t duration_ns;
+        uint32_t tid;
+    };
+    std::vector<Span> spans;
+    std::vector<std::pair<uint32_t, const char*>> threads;
+
+    {
+        std::lock_guard<std::mutex> lock(g_buffers_mutex);
+        spans.reserve(g_buffers.size() * TRACE_BUFFER_EVENTS / 4);
+        for (const auto& buffer : g_buffers) {
+            bool any = false;
+            for (const auto& event : buffer->events) {
+                uint64_t seq = event.seq.load(std::memory_order_acquire);
+                if (seq == 0) {
+                    continue;
+                }
+                Span span{
+                    event.name.load(std::memory_order_relaxed),
+                    event.start_ns.load(std::memory_order_relaxed),
+                    event.duration_ns.load(std::memory_order_relaxed),
+                    buffer->id,
+                };
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (event.seq.load(std::memory_order_relaxed) != seq || !span.name) {
+                    continue;   // overwritten while we read it
+                }
+                spans.push_back(span);
+                any = true;
+            }
+            if (any) {
+                threads.emplace_back(buffer->id, buffer->thread_name.load(std::memory_order_relaxed));
+            }
+        }
+    }
+
+    std::sort(spans.begin(), spans.end(), [](const Span& a, const Span& b) {
+        return a.start_ns < b.start_ns;
+    });
+    uint64_t origin = spans.empty() ? 0 : spans.front().start_ns;
+
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    auto separator = [&]() {
+        if (!first) {
+            out += ",\n";
+        }
+        first = false;
+    };
+    for (const auto& [tid, name] : threads) {
+        separator();
+        out += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + std::to_string(tid) +
+               ",\"args\":{\"name\":\"";
+        append_escaped(out, name ? name : "thread");
+        out += "\"}}";
+    }
+    char buf[96];
+    for (const auto& span : spans) {
+        separator();
+        out += "{\"name\":\"";
+        append_escaped(out, span.name);
+        std::snprintf(buf, sizeof(buf), "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                      span.tid, (span.start_ns - origin) / 1000.0, span.duration_ns / 1000.0);
+        out += buf;
+    }
+    out += "\n]}\n";
+
+    std::filesystem::path tmp = path;
+    tmp += ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            error = "cannot write " + tmp.string();
+            return false;
+        }
+        file.write(out.data(), static_cast<std::streamsize>(out.size()));
+        if (!file) {
+            error = "cannot write " + tmp.string();
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        error = ec.message();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,73 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+#include "metrics.hpp"
+
+// Scoped trace spans, exported as Chrome trace-event JSON (chrome://tracing,
+// ui.perfetto.dev).
+//
+// Each thread writes complete spans (name, start, duration) into its own
+// fixed ring of TRACE_BUFFER_EVENTS; the oldest spans are overwritten.
+// A span costs two clock reads and a few relaxed stores, no locks or
+// allocation. Rings come from a pool allocated by trace_enable() and are
+// returned when their thread exits, keeping their spans for the next dump.
+// trace_dump() may run on any thread while the others keep recording.
+//
+// Recording is off until trace_enable(true). Building without
+// WEBRADIO_TRACE removes the TRACE_* macros entirely.
+//
+// Span names must be string literals (only the pointer is stored).
+
+inline constexpr size_t TRACE_BUFFER_EVENTS = 16384;   // per thread, power of two
+
+inline std::atomic<bool> g_trace_enabled{false};
+
+inline bool trace_enabled() {
+    return g_trace_enabled.load(std::memory_order_relaxed);
+}
+
+void trace_enable(bool enabled);
+
+// Name shown for the calling thread's track
+void trace_set_thread_name(const char* name);
+
+void trace_record(const char* name, uint64_t start_ns, uint64_t duration_ns);
+
+// Write every buffered span to path. Returns false and sets error on failure.
+bool trace_dump(const std::filesystem::path& path, std::string& error);
+
+class TraceScope {
+public:
+    explicit TraceScope(const char* name)
+        : name_(name), start_ns_(trace_enabled() ? metrics_now_ns() : 0) {}
+    ~TraceScope() {
+        if (start_ns_ != 0) {
+            trace_record(name_, start_ns_, metrics_now_ns() - start_ns_);
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name_;
+    uint64_t start_ns_;
+};
+
+#ifdef WEBRADIO_TRACE
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) trace_set_thread_name(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
+
+#endif // TRACE_HPP
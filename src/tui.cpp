@@ -1,9 +1,16 @@
 #include "tui.hpp"
+#include "app_paths.hpp"
+#include "stations_watcher.hpp"
+#include <cstdio>
 #include <cstring>
 #include <chrono>
 #include <clocale>
 #include <ctime>
 #include <algorithm>
+#include <iterator>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 
 #ifndef WEBRADIO_VERSION
 #define WEBRADIO_VERSION "0.0.0"
@@ -61,6 +68,9 @@ bool RadioTUI::init() {
         station_width_ = 22;
     }
 
+    // Falls back to an in-memory log if the data directory is unusable
+    history_log_.open(user_data_dir());
+
     create_windows();
     draw_all();
 
@@ -116,6 +126,34 @@ void RadioTUI::destroy_windows() {
 void RadioTUI::set_stations(const std::vector<Station>& stations) {
     stations_ = stations;
     selected_station_ = 0;
+    station_scroll_ = 0;
+    draw_stations();
+}
+
+void RadioTUI::apply_station_changes(const StationChanges& changes) {
+    if (changes.empty()) return;
+
+    std::string selected_name;
+    if (selected_station_ < stations_.size()) {
+        selected_name = stations_[selected_station_].name;
+    }
+
+    ::apply_station_changes(stations_, changes);
+
+    selected_station_ = 0;
+    for (size_t i = 0; i < stations_.size(); ++i) {
+        if (stations_[i].name == selected_name) {
+            selected_station_ = i;
+            break;
+        }
+    }
+    draw_stations();
+}
+
+void RadioTUI::update_station_titles(const std::unordered_map<std::string, std::string>& titles) {
+    for (const auto& [name, title] : titles) {
+        station_titles_[name] = title;
+    }
     draw_stations();
 }
 
@@ -158,6 +196,24 @@ void RadioTUI::update_stream_kbps(int kbps)
 }
 
 
+void RadioTUI::update_callback_stats(const CallbackMonitor::Stats& stats)
+{
+    callback_stats_ = stats;
+}
+
+
+void RadioTUI::set_tune_breakdown(TuneBreakdown breakdown)
+{
+    tune_breakdown_ = std::move(breakdown);
+}
+
+
+void RadioTUI::set_perf_snapshot(const PerfSnapshot& snapshot)
+{
+    perf_ = snapshot;
+}
+
+
 void RadioTUI::update_track_metadata(const std::string& album, const std::string& year, const std::string& genre) {
     current_album_ = album;
     current_year_ = year;
@@ -173,20 +229,28 @@ void RadioTUI::update_spectrum(const std::array<float, FFTSpectrum::NUM_BARS>& b
 
 void RadioTUI::add_to_history(const std::string& title, const std::string& station)
 {
-//	if(title != current_title_)
-    {
-        std::lock_guard<std::mutex> lock(history_mutex_);
-        SongHistoryEntry entry;
-        entry.title = title;
-        entry.station_name = station;
-        entry.played_at = std::chrono::system_clock::now();
-        history_.push_back(entry);
+    auto now = std::chrono::system_clock::now();
+    size_t before = history_log_.size();
+    history_log_.append(title, station, std::chrono::system_clock::to_time_t(now));
+    history_grew(before);
+}
 
-        // Keep only last 5
-        if (history_.size() > 5) {
-            history_.erase(history_.begin());
-        }
+bool RadioTUI::flush_history() {
+    if (!history_log_.has_pending()) {
+        return false;
+    }
+    size_t before = history_log_.size();
+    history_log_.flush();
+    return history_grew(before);
+}
+
+bool RadioTUI::history_grew(size_t before) {
+    size_t added = history_log_.size() - before;
+    if (added > 0 && history_mode_ && !history_filtered_ && history_scroll_ > 0) {
+        // Keep the rows on screen steady while the list grows at the top
+        history_scroll_ += added;
     }
+    return added > 0;
 }
 
 void RadioTUI::draw_all() {
@@ -222,6 +286,10 @@ void RadioTUI::draw_header() {
 
 void RadioTUI::draw_stations() {
     if (!station_win_) return;
+    if (browse_mode_) {
+        draw_directory();
+        return;
+    }
 
     werase(station_win_);
 
@@ -238,8 +306,18 @@ void RadioTUI::draw_stations() {
     int start_y = 2;
     int max_display = getmaxy(station_win_) - start_y - 2;
 
-    for (size_t i = 0; i < stations_.size() && i < static_cast<size_t>(max_display); ++i) {
-        int y = start_y + i;
+    // Scroll so the selected station stays visible in long lists
+    if (max_display > 0) {
+        size_t visible = static_cast<size_t>(max_display);
+        if (selected_station_ < station_scroll_) {
+            station_scroll_ = selected_station_;
+        } else if (selected_station_ >= station_scroll_ + visible) {
+            station_scroll_ = selected_station_ - visible + 1;
+        }
+    }
+
+    for (size_t i = station_scroll_; i < stations_.size() && i < station_scroll_ + static_cast<size_t>(std::max(max_display, 0)); ++i) {
+        int y = start_y + static_cast<int>(i - station_scroll_);
         int x = 2;
 
         // Selection marker (cyan bold for selected, dim for others)
@@ -284,15 +362,422 @@ void RadioTUI::draw_stations() {
             name = name.substr(0, max_name_len - 3) + "...";
         }
         mvwaddstr(station_win_, y, x, name.c_str());
+        x += name.length();
+        if (has_colors()) {
+            wattroff(station_win_, COLOR_PAIR(color_title_) | A_BOLD);
+        }
+
+        // What the station is playing now, in the space left (dim)
+        auto playing = station_titles_.find(stations_[i].name);
+        int max_title_len = station_width_ - x - 4;
+        if (playing != station_titles_.end() && !playing->second.empty() && max_title_len >= 6) {
+            std::string now_playing = playing->second;
+            if (static_cast<int>(now_playing.length()) > max_title_len) {
+                now_playing = now_playing.substr(0, max_title_len - 3) + "...";
+            }
+            if (has_colors()) {
+                wattron(station_win_, COLOR_PAIR(color_history_));
+            }
+            mvwaddstr(station_win_, y, x + 2, now_playing.c_str());
+            if (has_colors()) {
+                wattroff(station_win_, COLOR_PAIR(color_history_));
+            }
+        }
+    }
+    wrefresh(station_win_);
+}
+
+void RadioTUI::draw_directory() {
+    if (!station_win_) return;
+
+    werase(station_win_);
+
+    wattron(station_win_, COLOR_PAIR(color_border_));
+    box(station_win_, 0, 0);
+    wattroff(station_win_, COLOR_PAIR(color_border_));
+
+    std::string title = " DIRECTORY ";
+    mvwaddstr(station_win_, 0, (station_width_ - title.length()) / 2, title.c_str());
+
+    int inner_width = station_width_ - 4;
+
+    // Query line
+    std::string query = "/" + browse_query_ + (browse_editing_ ? "_" : "");
+    if (static_cast<int>(query.length()) > inner_width) {
+        query = "/..." + query.substr(query.length() - inner_width + 4);
+    }
+    if (has_colors()) {
+        wattron(station_win_, COLOR_PAIR(color_controls_) | A_BOLD);
+    }
+    mvwaddstr(station_win_, 1, 2, query.c_str());
+    if (has_colors()) {
+        wattroff(station_win_, COLOR_PAIR(color_controls_) | A_BOLD);
+    }
+
+    // Match count / timing
+    std::string status = browse_status_.substr(0, std::max(inner_width, 0));
+    if (has_colors()) {
+        wattron(station_win_, COLOR_PAIR(color_history_time_));
+    }
+    mvwaddstr(station_win_, 2, 2, status.c_str());
+    if (has_colors()) {
+        wattroff(station_win_, COLOR_PAIR(color_history_time_));
+    }
+
+    int start_y = 4;
+    int max_display = getmaxy(station_win_) - start_y - 1;
+    if (max_display <= 0) {
+        wrefresh(station_win_);
+        return;
+    }
+
+    size_t visible = static_cast<size_t>(max_display);
+    if (browse_selected_ < browse_scroll_) {
+        browse_scroll_ = browse_selected_;
+    } else if (browse_selected_ >= browse_scroll_ + visible) {
+        browse_scroll_ = browse_selected_ - visible + 1;
+    }
+
+    for (size_t i = browse_scroll_; i < browse_results_.size() && i < browse_scroll_ + visible; ++i) {
+        const auto& entry = browse_results_[i];
+        int y = start_y + static_cast<int>(i - browse_scroll_);
+        bool selected = (i == browse_selected_);
+
+        if (has_colors()) {
+            wattron(station_win_, COLOR_PAIR(color_history_num_) | A_BOLD);
+        }
+        mvwaddstr(station_win_, y, 2, selected ? "> " : "  ");
+        if (has_colors()) {
+            wattroff(station_win_, COLOR_PAIR(color_history_num_) | A_BOLD);
+        }
+
+        // Info is right-aligned; the name gets whatever is left
+        int info_len = static_cast<int>(entry.info.length());
+        int max_name_len = inner_width - 2 - info_len - 1;
+        std::string name = entry.station.name;
+        if (max_name_len < 4) {
+            max_name_len = inner_width - 2;
+            info_len = 0;
+        }
+        if (static_cast<int>(name.length()) > max_name_len) {
+            name = name.substr(0, max_name_len - 3) + "...";
+        }
+
+        if (has_colors()) {
+            wattron(station_win_, COLOR_PAIR(color_title_) | (selected ? A_BOLD : 0));
+        }
+        mvwaddstr(station_win_, y, 4, name.c_str());
         if (has_colors()) {
             wattroff(station_win_, COLOR_PAIR(color_title_) | A_BOLD);
         }
+
+        if (info_len > 0) {
+            if (has_colors()) {
+                wattron(station_win_, COLOR_PAIR(color_history_));
+            }
+            mvwaddstr(station_win_, y, station_width_ - 2 - info_len, entry.info.c_str());
+            if (has_colors()) {
+                wattroff(station_win_, COLOR_PAIR(color_history_));
+            }
+        }
     }
     wrefresh(station_win_);
 }
 
+void RadioTUI::set_directory_results(std::vector<BrowseEntry> results, const std::string& status) {
+    browse_results_ = std::move(results);
+    browse_status_ = status;
+    browse_selected_ = 0;
+    browse_scroll_ = 0;
+    draw_stations();
+}
+
+// Keys for directory browse mode. Returns true if the key was consumed.
+bool RadioTUI::handle_browse_input(int ch) {
+    if (browse_editing_) {
+        switch (ch) {
+            case 27:  // Esc
+                browse_editing_ = false;
+                break;
+            case '\n':
+            case '\r':
+            case KEY_ENTER:
+                browse_editing_ = false;
+                if (on_directory_search_) on_directory_search_(browse_query_);
+                break;
+            case KEY_BACKSPACE:
+            case 127:
+            case 8:
+                if (!browse_query_.empty()) browse_query_.pop_back();
+                break;
+            default:
+                if (ch >= 32 && ch < 256 && ch != 127) {
+                    browse_query_.push_back(static_cast<char>(ch));
+                }
+                break;
+        }
+        draw_stations();
+        return true;
+    }
+
+    if (ch == 'b' || ch == 'B') {
+        browse_mode_ = !browse_mode_;
+        draw_stations();
+        return true;
+    }
+    if (ch == '/') {
+        browse_mode_ = true;
+        browse_editing_ = true;
+        draw_stations();
+        return true;
+    }
+    if (!browse_mode_) {
+        return false;
+    }
+
+    switch (ch) {
+        case 27:
+            browse_mode_ = false;
+            draw_stations();
+            return true;
+        case KEY_UP:
+        case 'k':
+        case 'K':
+            if (!browse_results_.empty()) {
+                browse_selected_ = (browse_selected_ + browse_results_.size() - 1) % browse_results_.size();
+                draw_stations();
+            }
+            return true;
+        case KEY_DOWN:
+        case 'j':
+        case 'J':
+            if (!browse_results_.empty()) {
+                browse_selected_ = (browse_selected_ + 1) % browse_results_.size();
+                draw_stations();
+            }
+            return true;
+        case '\n':
+        case '\r':
+        case KEY_ENTER:
+            if (browse_selected_ < browse_results_.size() && on_station_select_) {
+                on_station_select_(browse_results_[browse_selected_].station);
+            }
+            return true;
+        case '1': case '2': case '3': case '4': case '5':
+        case '6': case '7': case '8': case '9':
+            // Quick keys address the station list, not search results
+            return true;
+    }
+    return false;
+}
+
+// Full, searchable play history in the main panel
+void RadioTUI::draw_history() {
+    if (!main_win_) return;
+
+    werase(main_win_);
+
+    wattron(main_win_, COLOR_PAIR(color_border_));
+    box(main_win_, 0, 0);
+    wattroff(main_win_, COLOR_PAIR(color_border_));
+
+    int max_x = getmaxx(main_win_);
+    int inner_width = max_x - 6;
+
+    std::string title = " HISTORY ";
+    mvwaddstr(main_win_, 0, (max_x - title.length()) / 2, title.c_str());
+
+    size_t total = history_filtered_ ? history_results_.records.size() : history_log_.size();
+
+    // Query line
+    std::string query = "/" + history_query_ + (history_editing_ ? "_" : "");
+    if (static_cast<int>(query.length()) > inner_width) {
+        query = "/..." + query.substr(query.length() - inner_width + 4);
+    }
+    if (has_colors()) {
+        wattron(main_win_, COLOR_PAIR(color_controls_) | A_BOLD);
+    }
+    mvwaddstr(main_win_, 1, 3, query.c_str());
+    if (has_colors()) {
+        wattroff(main_win_, COLOR_PAIR(color_controls_) | A_BOLD);
+    }
+
+    // Match count / timing, or the search error
+    char status[96];
+    if (!history_results_.error.empty()) {
+        std::snprintf(status, sizeof(status), "%s", history_results_.error.c_str());
+    } else if (history_filtered_) {
+        std::snprintf(status, sizeof(status), "%zu matches, %.2f ms", total, history_search_ms_);
+    } else {
+        std::snprintf(status, sizeof(status), "%zu plays%s", total, history_log_.persistent() ? "" : " (not saved)");
+    }
+    if (has_colors()) {
+        wattron(main_win_, COLOR_PAIR(color_history_time_));
+    }
+    mvwaddstr(main_win_, 2, 3, std::string(status).substr(0, std::max(inner_width, 0)).c_str());
+    if (has_colors()) {
+        wattroff(main_win_, COLOR_PAIR(color_history_time_));
+    }
+
+    int start_y = 4;
+    int max_display = getmaxy(main_win_) - start_y - 1;
+    if (max_display <= 0) {
+        wrefresh(main_win_);
+        return;
+    }
+    size_t visible = static_cast<size_t>(max_display);
+    if (history_scroll_ + visible > total) {
+        history_scroll_ = total > visible ? total - visible : 0;
+    }
+
+    for (size_t i = history_scroll_; i < total && i < history_scroll_ + visible; ++i) {
+        // Row 0 is the most recent play
+        size_t record = history_filtered_ ? history_results_.records[i] : history_log_.size() - 1 - i;
+        HistoryLog::Entry entry = history_log_.entry(record);
+        int y = start_y + static_cast<int>(i - history_scroll_);
+        int x = 3;
+
+        std::time_t played_at = static_cast<std::time_t>(entry.played_at);
+        std::tm local_tm = *std::localtime(&played_at);
+        char when[20];
+        std::strftime(when, sizeof(when), "%Y-%m-%d %H:%M ", &local_tm);
+        if (has_colors()) {
+            wattron(main_win_, COLOR_PAIR(color_history_num_) | A_BOLD);
+        }
+        mvwaddstr(main_win_, y, x, when);
+        x += static_cast<int>(std::strlen(when));
+        if (has_colors()) {
+            wattroff(main_win_, COLOR_PAIR(color_history_num_) | A_BOLD);
+        }
+
+        // Station is right-aligned; the title gets whatever is left
+        std::string station(entry.station);
+        int station_space = std::min(static_cast<int>(station.length()), inner_width / 4);
+        if (static_cast<int>(station.length()) > station_space) {
+            station = station_space > 3 ? station.substr(0, station_space - 3) + "..." : "";
+        }
+        std::string song(entry.title);
+        int max_title_len = max_x - 3 - x - static_cast<int>(station.length()) - 1;
+        if (static_cast<int>(song.length()) > max_title_len) {
+            song = max_title_len > 3 ? song.substr(0, max_title_len - 3) + "..." : "";
+        }
+
+        if (has_colors()) {
+            wattron(main_win_, COLOR_PAIR(color_title_));
+        }
+        mvwaddstr(main_win_, y, x, song.c_str());
+        if (has_colors()) {
+            wattroff(main_win_, COLOR_PAIR(color_title_));
+            wattron(main_win_, COLOR_PAIR(color_history_station_));
+        }
+        mvwaddstr(main_win_, y, max_x - 3 - static_cast<int>(station.length()), station.c_str());
+        if (has_colors()) {
+            wattroff(main_win_, COLOR_PAIR(color_history_station_));
+        }
+    }
+    wrefresh(main_win_);
+}
+
+// Keys for the history view. Returns true if the key was consumed.
+bool RadioTUI::handle_history_input(int ch) {
+    if (browse_editing_) {
+        return false;
+    }
+
+    if (history_editing_) {
+        switch (ch) {
+            case 27:  // Esc
+                history_editing_ = false;
+                break;
+            case '\n':
+            case '\r':
+            case KEY_ENTER: {
+                history_editing_ = false;
+                auto start = std::chrono::steady_clock::now();
+                history_results_ = history_log_.search(history_query_);
+                history_search_ms_ = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start).count();
+                history_filtered_ = !history_query_.empty();
+                history_scroll_ = 0;
+                break;
+            }
+            case KEY_BACKSPACE:
+            case 127:
+            case 8:
+                if (!history_query_.empty()) history_query_.pop_back();
+                break;
+            default:
+                if (ch >= 32 && ch < 256 && ch != 127) {
+                    history_query_.push_back(static_cast<char>(ch));
+                }
+                break;
+        }
+        draw_history();
+        return true;
+    }
+
+    if (ch == 'h' || ch == 'H') {
+        history_mode_ = !history_mode_;
+        history_scroll_ = 0;
+        draw_main();
+        return true;
+    }
+    if (!history_mode_) {
+        return false;
+    }
+
+    size_t total = history_filtered_ ? history_results_.records.size() : history_log_.size();
+    size_t page = static_cast<size_t>(std::max(getmaxy(main_win_) - 5, 1));
+    switch (ch) {
+        case '/':
+            history_editing_ = true;
+            break;
+        case 27:
+            // Esc clears the search first, then leaves the view
+            if (history_filtered_ || !history_results_.error.empty()) {
+                history_query_.clear();
+                history_results_ = {};
+                history_filtered_ = false;
+                history_scroll_ = 0;
+            } else {
+                history_mode_ = false;
+            }
+            break;
+        case KEY_UP:
+        case 'k':
+        case 'K':
+            if (history_scroll_ > 0) --history_scroll_;
+            break;
+        case KEY_DOWN:
+        case 'j':
+        case 'J':
+            if (history_scroll_ + 1 < total) ++history_scroll_;
+            break;
+        case KEY_PPAGE:
+            history_scroll_ -= std::min(history_scroll_, page);
+            break;
+        case KEY_NPAGE:
+            history_scroll_ = std::min(history_scroll_ + page, total > 0 ? total - 1 : 0);
+            break;
+        case KEY_HOME:
+            history_scroll_ = 0;
+            break;
+        case KEY_END:
+            history_scroll_ = total > 0 ? total - 1 : 0;
+            break;
+        default:
+            return false;
+    }
+    draw_main();
+    return true;
+}
+
 void RadioTUI::draw_main() {
     if (!main_win_) return;
+    if (history_mode_) {
+        draw_history();
+        return;
+    }
 
     werase(main_win_);
 
@@ -605,27 +1090,75 @@ void RadioTUI::draw_main() {
     wattron(main_win_, COLOR_PAIR(color_border_));
     mvwhline(main_win_, y, 3, ACS_HLINE, max_x - 6);
     wattroff(main_win_, COLOR_PAIR(color_border_));
+
+    // Audio callback timing against its period, right-aligned on the separator
+    if (is_playing_ && callback_stats_.callbacks > 0) {
+        auto ms = [](uint32_t ns) {
+            char buf[16];
+            snprintf(buf, sizeof(buf), "%.2f", ns / 1e6);
+            return std::string(buf);
+        };
+        std::string timing = " callback p50 " + ms(callback_stats_.p50_ns) +
+                             " p99 " + ms(callback_stats_.p99_ns) +
+                             " max " + ms(callback_stats_.max_ns) +
+                             " / " + ms(callback_stats_.budget_ns) + " ms";
+        std::string late = " " + std::to_string(callback_stats_.misses) + " late ";
+        int width = static_cast<int>(timing.length() + late.length());
+        if (width <= max_x - 10) {
+            int x = max_x - 4 - width;
+            if (has_colors()) {
+                wattron(main_win_, COLOR_PAIR(color_history_));
+            }
+            mvwaddstr(main_win_, y, x, timing.c_str());
+            if (has_colors()) {
+                wattroff(main_win_, COLOR_PAIR(color_history_));
+            }
+            x += static_cast<int>(timing.length());
+            int late_attr = callback_stats_.misses > 0 ? COLOR_PAIR(color_stopped_) | A_BOLD : COLOR_PAIR(color_history_);
+            if (has_colors()) {
+                wattron(main_win_, late_attr);
+            }
+            mvwaddstr(main_win_, y, x, late.c_str());
+            if (has_colors()) {
+                wattroff(main_win_, late_attr);
+            }
+        }
+    }
     y += 2;
 
+    if (perf_panel_) {
+        draw_perf_panel(y, max_x);
+        wrefresh(main_win_);
+        return;
+    }
+    if (tune_panel_) {
+        draw_tune_panel(y, max_x);
+        wrefresh(main_win_);
+        return;
+    }
+
     // History section
     std::string history_title = "HISTORY";
     mvwaddstr(main_win_, y, (max_x - history_title.length()) / 2, history_title.c_str());
     y += 2;
 
     {
-        std::lock_guard<std::mutex> lock(history_mutex_);
-        if (history_.empty()) {
+        // The five most recent plays; [h] opens the full history
+        constexpr size_t RECENT_ROWS = 5;
+        size_t history_size = history_log_.size();
+        if (history_size == 0) {
             mvwaddstr(main_win_, y, 3, "No songs played yet.");
         } else {
-            for (size_t i = 0; i < history_.size(); ++i) {
-                const auto& entry = history_[history_.size() - 1 - i];
+            for (size_t i = 0; i < std::min(history_size, RECENT_ROWS); ++i) {
+                HistoryLog::Entry entry = history_log_.entry(history_size - 1 - i);
+                auto played_at = std::chrono::system_clock::from_time_t(static_cast<std::time_t>(entry.played_at));
                 int x = 3;
 
                 // Clock [HH:MM] (cyan bold)
                 if (has_colors()) {
                     wattron(main_win_, COLOR_PAIR(color_history_num_) | A_BOLD);
                 }
-                std::string clock_str = "[" + format_time_clock(entry.played_at) + "] ";
+                std::string clock_str = "[" + format_time_clock(played_at) + "] ";
                 mvwaddstr(main_win_, y, x, clock_str.c_str());
                 x += clock_str.length();
                 if (has_colors()) {
@@ -639,7 +1172,7 @@ void RadioTUI::draw_main() {
                 mvwaddstr(main_win_, y, x, "\"");
                 x += 1;
 
-                std::string title = entry.title;
+                std::string title(entry.title);
                 int remaining = max_x - x - 25; // Reserve space for station, clock and ago time
                 if (static_cast<int>(title.length()) > remaining) {
                     title = title.substr(0, remaining - 3) + "...";
@@ -654,7 +1187,7 @@ void RadioTUI::draw_main() {
                 }
 
                 // " on " (dim white)
-                if (!entry.station_name.empty()) {
+                if (!entry.station.empty()) {
                     if (has_colors()) {
                         wattron(main_win_, COLOR_PAIR(color_history_));
                     }
@@ -668,7 +1201,7 @@ void RadioTUI::draw_main() {
                     if (has_colors()) {
                         wattron(main_win_, COLOR_PAIR(color_history_station_));
                     }
-                    std::string station = entry.station_name;
+                    std::string station(entry.station);
                     int station_space = max_x - x - 15; // Reserve space for ago time
                     if (static_cast<int>(station.length()) > station_space) {
                         station = station.substr(0, station_space - 3) + "...";
@@ -684,7 +1217,7 @@ void RadioTUI::draw_main() {
                 if (has_colors()) {
                     wattron(main_win_, COLOR_PAIR(color_history_time_));
                 }
-                std::string time_str = " (" + format_time_ago(entry.played_at) + ")";
+                std::string time_str = " (" + format_time_ago(played_at) + ")";
                 mvwaddstr(main_win_, y, x, time_str.c_str());
                 if (has_colors()) {
                     wattroff(main_win_, COLOR_PAIR(color_history_time_));
@@ -698,8 +1231,159 @@ void RadioTUI::draw_main() {
     wrefresh(main_win_);
 }
 
+// Where the last tune's time to first audio went, one bar per phase
+void RadioTUI::draw_tune_panel(int y, int max_x) {
+    std::string title = "TUNE TIMING";
+    mvwaddstr(main_win_, y, (max_x - title.length()) / 2, title.c_str());
+    y += 2;
+
+    const TuneBreakdown& tune = tune_breakdown_;
+    if (tune.phases.empty()) {
+        mvwaddstr(main_win_, y, 3, "Tune a station to see where its startup time goes.");
+        return;
+    }
+
+    char buf[64];
+    if (has_colors()) {
+        wattron(main_win_, COLOR_PAIR(color_history_station_));
+    }
+    mvwaddstr(main_win_, y, 3, tune.station.c_str());
+    if (has_colors()) {
+        wattroff(main_win_, COLOR_PAIR(color_history_station_));
+    }
+    std::snprintf(buf, sizeof(buf), tune.complete ? "  %.0f ms to first audio" : "  %.0f ms so far...", tune.total_ms);
+    waddstr(main_win_, buf);
+    y += 2;
+
+    constexpr int NAME_WIDTH = 14;
+    constexpr int MS_WIDTH = 10;
+    int bar_x = 3 + NAME_WIDTH + MS_WIDTH + 2;
+    int bar_width = max_x - bar_x - 3;
+    int max_y = getmaxy(main_win_) - 1;
+    for (const auto& phase : tune.phases) {
+        if (y >= max_y) break;
+        if (has_colors()) {
+            wattron(main_win_, COLOR_PAIR(color_history_));
+        }
+        mvwaddstr(main_win_, y, 3, phase.name);
+        if (has_colors()) {
+            wattroff(main_win_, COLOR_PAIR(color_history_));
+        }
+        std::snprintf(buf, sizeof(buf), "%*.1f ms", MS_WIDTH - 3, phase.ms);
+        mvwaddstr(main_win_, y, 3 + NAME_WIDTH, buf);
+
+        if (bar_width > 0 && tune.total_ms > 0.0) {
+            int filled = static_cast<int>(phase.ms / tune.total_ms * bar_width + 0.5);
+            if (has_colors()) {
+                wattron(main_win_, COLOR_PAIR(color_controls_));
+            }
+            for (int i = 0; i < filled && i < bar_width; ++i) {
+                mvwaddstr(main_win_, y, bar_x + i, "█");
+            }
+            if (has_colors()) {
+                wattroff(main_win_, COLOR_PAIR(color_controls_));
+            }
+        }
+        y++;
+    }
+}
+
+// Live resource use; fed once a second from PerfSampler
+void RadioTUI::draw_perf_panel(int y, int max_x) {
+    std::string title = "PERFORMANCE";
+    mvwaddstr(main_win_, y, (max_x - title.length()) / 2, title.c_str());
+    y += 2;
+
+    const PerfSnapshot& perf = perf_;
+    if (perf.ring_fill.empty()) {
+        mvwaddstr(main_win_, y, 3, "Collecting...");
+        return;
+    }
+
+    char buf[128];
+    int max_y = getmaxy(main_win_) - 1;
+    auto label = [&](const char* text) {
+        if (has_colors()) {
+            wattron(main_win_, COLOR_PAIR(color_history_));
+        }
+        mvwaddstr(main_win_, y, 3, text);
+        if (has_colors()) {
+            wattroff(main_win_, COLOR_PAIR(color_history_));
+        }
+    };
+
+    // Busiest threads first, as many as fit
+    if (y < max_y) {
+        label("CPU");
+        std::snprintf(buf, sizeof(buf), "%5.1f%%", perf.process_cpu);
+        mvwaddstr(main_win_, y, 10, buf);
+        int x = 18;
+        for (const auto& thread : perf.threads) {
+            std::snprintf(buf, sizeof(buf), "%s %.1f%%  ", thread.name.c_str(), thread.percent);
+            int len = static_cast<int>(std::strlen(buf));
+            if (x + len > max_x - 3) break;
+            mvwaddstr(main_win_, y, x, buf);
+            x += len;
+        }
+        y++;
+    }
+
+    // Ring fill history, newest on the right
+    if (y < max_y) {
+        static const char* levels[] = {"▁", "▂", "▃", "▄", "▅", "▆", "▇", "█"};
+        label("Ring");
+        std::snprintf(buf, sizeof(buf), "%4.0f KiB ", perf.ring_fill_bytes / 1024.0);
+        mvwaddstr(main_win_, y, 10, buf);
+        int x = 10 + static_cast<int>(std::strlen(buf));
+        int width = std::min<int>(max_x - 3 - x, static_cast<int>(perf.ring_fill.size()));
+        if (has_colors()) {
+            wattron(main_win_, COLOR_PAIR(color_controls_));
+        }
+        for (int i = 0; i < width; ++i) {
+            float fill = perf.ring_fill[perf.ring_fill.size() - width + i];
+            int level = std::clamp(static_cast<int>(fill * 8.0f), 0, 7);
+            mvwaddstr(main_win_, y, x + i, levels[level]);
+        }
+        if (has_colors()) {
+            wattroff(main_win_, COLOR_PAIR(color_controls_));
+        }
+        y++;
+    }
+
+    if (y < max_y) {
+        label("Audio");
+        std::snprintf(buf, sizeof(buf), "underruns %llu (+%llu)  callback p99 %.2f / %.2f ms",
+                      static_cast<unsigned long long>(perf.underruns),
+                      static_cast<unsigned long long>(perf.underruns_delta),
+                      perf.callback_p99_ns / 1e6, perf.callback_budget_ns / 1e6);
+        int attr = perf.underruns_delta > 0 ? COLOR_PAIR(color_stopped_) | A_BOLD : A_NORMAL;
+        if (has_colors()) {
+            wattron(main_win_, attr);
+        }
+        mvwaddnstr(main_win_, y, 10, buf, max_x - 13);
+        if (has_colors()) {
+            wattroff(main_win_, attr);
+        }
+        y++;
+    }
+
+    if (y < max_y) {
+        label("Decode");
+        std::snprintf(buf, sizeof(buf), "%.2f ms per second of audio", perf.decode_ms_per_audio_s);
+        mvwaddnstr(main_win_, y, 10, buf, max_x - 13);
+        y++;
+    }
+
+    if (y < max_y) {
+        label("Net");
+        std::snprintf(buf, sizeof(buf), "%.0f kbit/s   RSS %.1f MiB", perf.net_kbit_s,
+                      static_cast<double>(perf.rss_bytes) / (1024.0 * 1024.0));
+        mvwaddnstr(main_win_, y, 10, buf, max_x - 13);
+    }
+}
+
 void RadioTUI::draw_spectrum_overlay() {
-    if (!main_win_) return;
+    if (!main_win_ || history_mode_) return;
     if (!is_playing_ || !spectrum_updated_) return;
 
     int max_x = getmaxx(main_win_);
@@ -802,8 +1486,13 @@ void RadioTUI::draw_controls() {
         {"Playback", "[Enter]/[s]"},
         {"Volume", "[+/-]"},
         {"Quick", "[1-9]"},
+        {"Browse", "[b]/[/]"},
+        {"History", "[h]"},
+        {"Timing", "[d]"},
+        {"Perf", "[p]"},
         {"Quit", "[q]"}
     };
+    constexpr size_t section_count = sizeof(sections) / sizeof(sections[0]);
 
     // Calculate total width needed
     int total_width = 0;
@@ -818,7 +1507,7 @@ void RadioTUI::draw_controls() {
 
     int x = start_x;
 
-    for (size_t i = 0; i < 6; ++i) {
+    for (size_t i = 0; i < section_count; ++i) {
         // Category label (dim)
         if (has_colors()) {
             wattron(controls_win_, COLOR_PAIR(color_history_));
@@ -843,7 +1532,7 @@ void RadioTUI::draw_controls() {
         }
 
         // Separator between sections
-        if (i < 5) {
+        if (i + 1 < section_count) {
             if (has_colors()) {
                 wattron(controls_win_, COLOR_PAIR(color_border_));
             }
@@ -876,6 +1565,13 @@ void RadioTUI::handle_input(int ch) {
     // mvprintw(0, 0, "Key: %d (%c)", ch, ch);
     // refresh();
 
+    if (handle_history_input(ch)) {
+        return;
+    }
+    if (handle_browse_input(ch)) {
+        return;
+    }
+
     switch (ch) {
         case KEY_UP:
         case 'k':
@@ -916,6 +1612,24 @@ void RadioTUI::handle_input(int ch) {
             if (on_volume_down_) on_volume_down_();
             break;
 
+        case 'T':
+            if (on_trace_dump_) on_trace_dump_();
+            break;
+
+        case 'd':
+        case 'D':
+            tune_panel_ = !tune_panel_;
+            perf_panel_ = false;
+            draw_main();
+            break;
+
+        case 'p':
+        case 'P':
+            perf_panel_ = !perf_panel_;
+            tune_panel_ = false;
+            draw_main();
+            break;
+
         case '1': case '2': case '3': case '4': case '5':
         case '6': case '7': case '8': case '9':
             if (ch - '1' < static_cast<int>(stations_.size())) {
@@ -975,6 +1689,14 @@ void RadioTUI::set_on_volume_down(std::function<void()> cb) {
     on_volume_down_ = cb;
 }
 
+void RadioTUI::set_on_directory_search(std::function<void(const std::string&)> cb) {
+    on_directory_search_ = cb;
+}
+
+void RadioTUI::set_on_trace_dump(std::function<void()> cb) {
+    on_trace_dump_ = cb;
+}
+
 std::string RadioTUI::format_time_ago(const std::chrono::system_clock::time_point& tp) {
     auto elapsed = std::chrono::system_clock::now() - tp;
     auto minutes = std::chrono::duration_cast<std::chrono::minutes>(elapsed).count();
@@ -982,7 +1704,8 @@ std::string RadioTUI::format_time_ago(const std::chrono::system_clock::time_poin
     if (minutes < 1) return "now";
     if (minutes < 60) return std::to_string(minutes) + "m";
     auto hours = minutes / 60;
-    return std::to_string(hours) + "h";
+    if (hours < 48) return std::to_string(hours) + "h";
+    return std::to_string(hours / 24) + "d";
 }
 
 std::string RadioTUI::format_time_clock(const std::chrono::system_clock::time_point& tp) {
@@ -8,24 +8,19 @@
 #include <atomic>
 #include <functional>
 #include <array>
+#include <chrono>
+#include <unordered_map>
 #include "fft_spectrum.hpp"
+#include "station.hpp"
+#include "history_log.hpp"
+#include "callback_monitor.hpp"
+#include "tune_timeline.hpp"
+#include "perf_sampler.hpp"
 
-struct Station {
-    std::string name;
-    std::string url;
-};
-
-struct SongHistoryEntry {
-    std::string title;
-    std::string station_name;
-    std::chrono::system_clock::time_point played_at;
-};
-
-struct StreamMetadata
-{
-	std::string title;
-	std::string genre;
-	bool pending = false;
+// One row of directory search results shown in browse mode
+struct BrowseEntry {
+    Station station;
+    std::string info;   // short codec/bitrate/country summary
 };
 
 
@@ -41,16 +36,31 @@ private:
     
     std::vector<Station> stations_;
     size_t selected_station_ = 0;
+    size_t station_scroll_ = 0;
+    std::unordered_map<std::string, std::string> station_titles_;  // from StationTitleWatcher
     std::string current_title_;
     std::string current_station_;
-    std::vector<SongHistoryEntry> history_;
-    std::mutex history_mutex_;
+    HistoryLog history_log_;
+
+    // History view (replaces the main panel while open)
+    bool history_mode_ = false;
+    bool history_editing_ = false;
+    std::string history_query_;
+    bool history_filtered_ = false;
+    HistoryLog::SearchResult history_results_;
+    double history_search_ms_ = 0.0;
+    size_t history_scroll_ = 0;
     int buffer_percent_ = 0;
     bool is_playing_ = false;
     int volume_percent_ = 100;
     std::string stream_format_;
     int stream_kbps_ = 0;
     std::string stream_genre_;
+    CallbackMonitor::Stats callback_stats_;
+    TuneBreakdown tune_breakdown_;
+    bool tune_panel_ = false;       // [d]: tune timing instead of recent history
+    bool perf_panel_ = false;       // [p]: performance instead of recent history
+    PerfSnapshot perf_;
     
     std::string current_album_;
     std::string current_year_;
@@ -62,6 +72,17 @@ private:
     std::function<void()> on_quit_;
     std::function<void()> on_volume_up_;
     std::function<void()> on_volume_down_;
+    std::function<void(const std::string&)> on_directory_search_;
+    std::function<void()> on_trace_dump_;
+
+    // Directory browse mode (replaces the station list while active)
+    bool browse_mode_ = false;
+    bool browse_editing_ = false;
+    std::string browse_query_;
+    std::vector<BrowseEntry> browse_results_;
+    std::string browse_status_;
+    size_t browse_selected_ = 0;
+    size_t browse_scroll_ = 0;
     
     int color_header_ = 1;
     int color_selected_ = 2;
@@ -92,6 +113,9 @@ public:
     void destroy_windows();
     
     void set_stations(const std::vector<Station>& stations);
+    void apply_station_changes(const StationChanges& changes);
+    const std::vector<Station>& stations() const { return stations_; }
+    void update_station_titles(const std::unordered_map<std::string, std::string>& titles);
 	void set_current_station(const std::string& station);
 
     void set_song_title(const std::string& title, const std::string& genre);
@@ -100,13 +124,25 @@ public:
     void set_volume(int percent);
 	void set_stream_format(const std::string& format);
     void update_stream_kbps(int kbps);
+    void update_callback_stats(const CallbackMonitor::Stats& stats);
+    void set_tune_breakdown(TuneBreakdown breakdown);
+    bool perf_panel_visible() const { return perf_panel_; }
+    void set_perf_snapshot(const PerfSnapshot& snapshot);
     void add_to_history(const std::string& title, const std::string& station);
+    // Writes plays that waited for the history lock; true if any were
+    bool flush_history();
+    // Keeps the history view's rows in place as the log grows past before
+    bool history_grew(size_t before);
     void update_track_metadata(const std::string& album, const std::string& year, const std::string& genre);
     void update_spectrum(const std::array<float, FFTSpectrum::NUM_BARS>& bars);
     
     void draw_all();
     void draw_header();
     void draw_stations();
+    void draw_directory();
+    void draw_history();
+    void draw_tune_panel(int y, int max_x);
+    void draw_perf_panel(int y, int max_x);
     void draw_main();
     void draw_controls();
     void draw_spectrum(int y, int max_x);
@@ -125,6 +161,11 @@ public:
     void set_on_quit(std::function<void()> cb);
     void set_on_volume_up(std::function<void()> cb);
     void set_on_volume_down(std::function<void()> cb);
+    void set_on_directory_search(std::function<void(const std::string&)> cb);
+    void set_on_trace_dump(std::function<void()> cb);
+    void set_directory_results(std::vector<BrowseEntry> results, const std::string& status);
+    bool handle_browse_input(int ch);
+    bool handle_history_input(int ch);
     
     void show_message(const std::string& msg);
     std::string format_time_ago(const std::chrono::system_clock::time_point& tp);
@@ -0,0 +1,198 @@
+#include "tune_timeline.hpp"
+
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <mutex>
+#include <utility>
+
+#include <nlohmann/json.hpp>
+
+#include "app_paths.hpp"
+#include "metrics.hpp"
+
+extern "C" {
+#include <libavutil/log.h>
+}
+
+namespace {
+
+// Phase names, indexed by the mark that ends the phase
+constexpr const char* PHASE_NAMES[TuneTimeline::MARK_COUNT] = {
+    "",
+    "dns",
+    "connect",
+    "tls",
+    "http response",
+    "open input",
+    "stream info",
+    "codec open",
+    "device init",
+    "prebuffer",
+    "device start",
+    "first audio",
+};
+
+// FFmpeg log format strings (libavformat/network.c, http.c) that mark
+// connection progress
+struct LogMilestone {
+    const char* prefix;
+    TuneMark mark;
+};
+
+constexpr LogMilestone LOG_MILESTONES[] = {
+    {"Starting connection attempt", TuneMark::ConnectStarted},
+    {"Successfully connected", TuneMark::Connected},
+    {"request: ", TuneMark::RequestSent},
+    {"header='", TuneMark::ResponseReceived},
+};
+
+thread_local TuneTimeline* t_capture = nullptr;
+
+// Captures running on all threads; the level to restore when the last
+// one ends is published for the log hook (INT_MAX: none running)
+std::mutex g_capture_mutex;
+int g_capture_count = 0;
+int g_saved_level = AV_LOG_INFO;
+std::atomic<int> g_base_level{INT_MAX};
+
+} // namespace
+
+void TuneTimeline::begin(const std::string& station, const std::string& url, uint64_t now_ns) {
+    station_ = station;
+    url_ = url;
+    for (auto& m : marks_) {
+        m.store(0, std::memory_order_relaxed);
+    }
+    marks_[static_cast<size_t>(TuneMark::Requested)].store(now_ns, std::memory_order_relaxed);
+    generation_.fetch_add(1, std::memory_order_release);
+}
+
+TuneBreakdown TuneTimeline::breakdown() const {
+    TuneBreakdown result;
+    result.station = station_;
+    result.url = url_;
+    uint64_t start = marks_[0].load(std::memory_order_acquire);
+    if (start == 0) {
+        return result;
+    }
+
+    uint64_t prev = start;
+    for (size_t i = 1; i < MARK_COUNT; ++i) {
+        uint64_t stamp = marks_[i].load(std::memory_order_acquire);
+        if (stamp == 0) {
+            continue;
+        }
+        // The first callback can fire before ma_device_start returns
+        double ms = stamp > prev ? static_cast<double>(stamp - prev) / 1e6 : 0.0;
+        result.phases.push_back({PHASE_NAMES[i], ms});
+        if (stamp > prev) {
+            prev = stamp;
+        }
+    }
+    result.total_ms = static_cast<double>(prev - start) / 1e6;
+    result.complete = complete();
+    return result;
+}
+
+void TuneLog::set_error(const std::string& message) {
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    error_ = message;
+}
+
+std::string TuneLog::take_error() {
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    return std::exchange(error_, std::string());
+}
+
+bool TuneLog::update(const TuneTimeline& timeline, bool playing) {
+    bool written = false;
+    if (timeline.generation() != generation_) {
+        // play() stopped the old tune (its error, if any, is in) before
+        // clearing the marks; the last update() saw how far it got
+        std::string error = take_error();
+        if (!logged_) {
+            written = write(last_, error);
+        }
+        generation_ = timeline.generation();
+        logged_ = false;
+    }
+    if (logged_) {
+        return written;
+    }
+
+    TuneBreakdown tune = timeline.breakdown();
+    if (tune.complete || !playing) {
+        logged_ = true;
+        return write(tune, tune.complete ? std::string() : take_error()) || written;
+    }
+    last_ = std::move(tune);
+    return written;
+}
+
+bool TuneLog::write(const TuneBreakdown& tune, const std::string& error) const {
+    if (dir_.empty() || !ensure_directory(dir_)) {
+        return false;
+    }
+    nlohmann::ordered_json phases = nlohmann::ordered_json::object();
+    for (const auto& phase : tune.phases) {
+        phases[phase.name] = static_cast<int64_t>(phase.ms * 1000.0 + 0.5) / 1000.0;
+    }
+    nlohmann::ordered_json line = {
+        {"time", static_cast<int64_t>(std::time(nullptr))},
+        {"station", tune.station},
+        {"url", tune.url},
+        {"total_ms", static_cast<int64_t>(tune.total_ms * 1000.0 + 0.5) / 1000.0},
+        {"phases", phases},
+        {"complete", tune.complete},
+    };
+    if (!error.empty()) {
+        line["error"] = error;
+    }
+
+    std::ofstream out(dir_ / "tunes.jsonl", std::ios::app);
+    if (!out) {
+        return false;
+    }
+    out << line.dump() << '\n';
+    return static_cast<bool>(out);
+}
+
+ScopedNetworkCapture::ScopedNetworkCapture(TuneTimeline& timeline) {
+    t_capture = &timeline;
+    std::lock_guard<std::mutex> lock(g_capture_mutex);
+    if (g_capture_count++ == 0) {
+        // The milestones are logged at verbose/debug/trace level; av_log
+        // drops anything above the current level before it reaches the
+        // callback
+        g_saved_level = av_log_get_level();
+        g_base_level.store(g_saved_level, std::memory_order_relaxed);
+        av_log_set_level(AV_LOG_TRACE);
+    }
+}
+
+ScopedNetworkCapture::~ScopedNetworkCapture() {
+    {
+        std::lock_guard<std::mutex> lock(g_capture_mutex);
+        if (--g_capture_count == 0) {
+            av_log_set_level(g_saved_level);
+            g_base_level.store(INT_MAX, std::memory_order_relaxed);
+        }
+    }
+    t_capture = nullptr;
+}
+
+bool tune_timeline_log_hook(int level, const char* fmt) {
+    TuneTimeline* timeline = t_capture;
+    if (timeline && fmt) {
+        for (const auto& milestone : LOG_MILESTONES) {
+            if (std::strncmp(fmt, milestone.prefix, std::strlen(milestone.prefix)) == 0) {
+                timeline->mark(milestone.mark, metrics_now_ns());
+                return true;
+            }
+        }
+    }
+    // Only visible because a capture raised the level
+    return level > g_base_level.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,129 @@
+#ifndef TUNE_TIMELINE_HPP
+#define TUNE_TIMELINE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Where the time to first audio goes, for one tune.
+//
+// The playback thread (and, for FirstAudio, the audio callback) stamps
+// each milestone once; phases are the gaps between consecutive stamps.
+// A milestone that never happened (no TLS on http, a build of FFmpeg
+// that does not log connection steps) folds its time into the next
+// phase.
+//
+// Connection milestones come from FFmpeg's own log lines: while
+// avformat_open_input runs, the playback thread raises the log level
+// (ScopedNetworkCapture) and tune_timeline_log_hook() matches the format
+// strings for "connection attempt", "connected", "request:" and the
+// first response header. Nothing is formatted.
+enum class TuneMark : uint8_t {
+    Requested,          // play() called
+    ConnectStarted,     // DNS done, first connect() issued
+    Connected,          // TCP connected
+    RequestSent,        // TLS done (https), HTTP request written
+    ResponseReceived,   // first response header line
+    InputOpened,        // avformat_open_input returned (format probed)
+    StreamInfo,         // avformat_find_stream_info returned
+    CodecOpened,        // decoder and resampler ready
+    DeviceOpened,       // ma_device_init returned
+    Prebuffered,        // ring holds the prebuffer target
+    DeviceStarted,      // ma_device_start returned
+    FirstAudio,         // first callback that played stream audio
+    Count
+};
+
+struct TunePhase {
+    const char* name;
+    double ms;
+};
+
+struct TuneBreakdown {
+    std::string station;
+    std::string url;
+    std::vector<TunePhase> phases;
+    double total_ms = 0.0;
+    bool complete = false;      // FirstAudio reached
+};
+
+class TuneTimeline {
+public:
+    static constexpr size_t MARK_COUNT = static_cast<size_t>(TuneMark::Count);
+
+    // UI thread: a new tune. Clears all marks and stamps Requested.
+    void begin(const std::string& station, const std::string& url, uint64_t now_ns);
+
+    // Any thread; only the first stamp of each mark in a tune counts
+    void mark(TuneMark m, uint64_t now_ns) {
+        uint64_t expected = 0;
+        marks_[static_cast<size_t>(m)].compare_exchange_strong(expected, now_ns, std::memory_order_release,
+                                                              std::memory_order_relaxed);
+    }
+
+    uint64_t generation() const { return generation_.load(std::memory_order_acquire); }
+    bool complete() const { return marks_[MARK_COUNT - 1].load(std::memory_order_acquire) != 0; }
+
+    // UI thread
+    TuneBreakdown breakdown() const;
+
+private:
+    std::array<std::atomic<uint64_t>, MARK_COUNT> marks_{};
+    std::atomic<uint64_t> generation_{0};
+    std::string station_;       // UI thread only
+    std::string url_;
+};
+
+// Appends every tune to tunes.jsonl in a directory, once: when it reaches
+// audio, or else when it fails, is stopped or is replaced by the next
+// tune, with the marks it got to and the stream error if there was one.
+// update() belongs to the UI thread that calls Player::play().
+class TuneLog {
+public:
+    explicit TuneLog(std::filesystem::path dir) : dir_(std::move(dir)) {}
+
+    // Any thread (the player's on_error callback)
+    void set_error(const std::string& message);
+
+    // Once per loop tick, and after the player stopped. Returns true when
+    // a tune was just written.
+    bool update(const TuneTimeline& timeline, bool playing);
+    // The current tune has not reached audio or ended yet
+    bool pending() const { return !logged_; }
+
+private:
+    std::string take_error();
+    bool write(const TuneBreakdown& tune, const std::string& error) const;
+
+    std::filesystem::path dir_;
+    uint64_t generation_ = 0;
+    bool logged_ = true;
+    TuneBreakdown last_;        // the pending tune as of the last update()
+    std::mutex error_mutex_;
+    std::string error_;
+};
+
+// Playback thread: route FFmpeg's connection log lines into timeline for
+// the lifetime of this object. Captures on several threads (one per
+// Player) share the raised level; the first one raises it and the last
+// one to end restores it.
+class ScopedNetworkCapture {
+public:
+    explicit ScopedNetworkCapture(TuneTimeline& timeline);
+    ~ScopedNetworkCapture();
+
+    ScopedNetworkCapture(const ScopedNetworkCapture&) = delete;
+    ScopedNetworkCapture& operator=(const ScopedNetworkCapture&) = delete;
+};
+
+// Called from the FFmpeg log callback. Returns true if the line should
+// not be logged: a milestone of a capture running on this thread, or a
+// line (from any thread) that only got through because of the raised
+// level.
+bool tune_timeline_log_hook(int level, const char* fmt);
+
+#endif // TUNE_TIMELINE_HPP
@@ -13,6 +13,8 @@
 #include <filesystem>
 #include <array>
 #include <cstdlib>
+#include <cstdio>
+#include <utility>
 
 #include <nlohmann/json.hpp>
 #include <fstream>
@@ -22,41 +24,36 @@
 #include <limits.h>
 #endif
 
-#include "byte_ringbuffer.hpp"
 #include "tui.hpp"
 #include "fft_spectrum.hpp"
-
-#ifdef WEBRADIO_USE_SSE2
-#ifdef _MSC_VER
-#include <intrin.h>
-#else
-#include <emmintrin.h>
-#endif
-#endif
+#include "station_catalog.hpp"
+#include "stations_watcher.hpp"
+#include "station_title_watcher.hpp"
+#include "playlist_resolver.hpp"
+#include "musicbrainz.hpp"
+#include "station_directory.hpp"
+#include "metadata_events.hpp"
+#include "metrics.hpp"
+#include "metrics_server.hpp"
+#include "callback_monitor.hpp"
+#include "trace.hpp"
+#include "tune_timeline.hpp"
+#include "app_paths.hpp"
+#include "thread_name.hpp"
+#include "perf_sampler.hpp"
+#include "async_log.hpp"
+#include "session_io.hpp"
+#include "pipeline_clock.hpp"
+#include "engine.hpp"
+#include "control_server.hpp"
+#include "monitor_engine.hpp"
 
 using namespace std::chrono_literals;
 
-#ifndef FFMPEG_DEBUG_LOGGING
-static void suppress_ffmpeg_logging(void* ptr, int level, const char* fmt, va_list vl) {
-    (void)ptr;
-    (void)level;
-    (void)fmt;
-    (void)vl;
-}
-#endif
-
 extern "C" {
-#include <libavformat/avformat.h>
-#include <libavcodec/avcodec.h>
-#include <libavutil/opt.h>
-#include <libavutil/channel_layout.h>
-#include <libavutil/samplefmt.h>
-#include <libswresample/swresample.h>
+#include <libavutil/log.h>
 }
 
-#define MINIAUDIO_IMPLEMENTATION
-#include "miniaudio.h"
-
 using json = nlohmann::json;
 
 #ifndef WEBRADIO_VERSION
@@ -64,122 +61,31 @@ using json = nlohmann::json;
 #endif
 
 std::atomic<bool> g_running{true};
-std::atomic<bool> g_playing{false};
-std::atomic<float> g_volume{1.0f};
-std::string g_current_metadata;
-std::string g_current_station_name;
-
-
-uint64_t g_bytes_accumulated = 0;
-auto g_last_kbps_calc = std::chrono::steady_clock::now();
-
-std::mutex g_metadata_mutex;
-StreamMetadata g_pending_metadata;
-
-std::atomic<int> g_pending_buffer_percent{-1};
-std::atomic<bool> g_pending_playing_state{false};
-std::atomic<bool> g_has_playing_state_update{false};
-
-
-//std::atomic<bool> g_pending_genre_update{false};
-//std::string g_pending_genre;
-
-std::atomic<uint64_t> g_bytes_received{0};
-std::atomic<uint64_t> g_last_bandwidth_update{0};
 
 std::unique_ptr<RadioTUI> g_tui;
-std::unique_ptr<FFTSpectrum> g_fft_spectrum;
+std::unique_ptr<MusicBrainzClient> g_musicbrainz;
 
 void signal_handler(int) {
     g_running = false;
 }
 
-void data_callback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount) {
-    (void)pInput;
-    
-    ByteRingbuffer* buffer = static_cast<ByteRingbuffer*>(pDevice->pUserData);
-    if (!buffer) return;
-
-    uint8_t* output = static_cast<uint8_t*>(pOutput);
-    constexpr size_t bytesPerFrame = 4;
-    size_t bytesToWrite = static_cast<size_t>(frameCount) * bytesPerFrame;
-   
-	// copy PCM data to audio playback buffer
-    size_t bytesRead = 0;
-    while (bytesRead < bytesToWrite) {
-        const uint8_t* src = nullptr;
-        size_t available = buffer->reserve_read_contiguous(src);
-        if (available == 0 || src == nullptr) {
-            break;
-        }
-
-        size_t chunk = std::min(available, bytesToWrite - bytesRead);
-        std::memcpy(output + bytesRead, src, chunk);
-        buffer->consume(chunk);
-        bytesRead += chunk;
-    }
-
-    if (bytesRead < bytesToWrite) {
-        std::memset(output + bytesRead, 0, bytesToWrite - bytesRead);
-    }
-
-	if (bytesRead > 0) {
-		float volume = g_volume.load();
-		if (volume <= 0.99f) {
-			int16_t* samples = reinterpret_cast<int16_t*>(output);
-			size_t sampleCount = bytesRead / 2;
-
-#ifdef WEBRADIO_USE_SSE2
-			// SSE2: process 8 x int16 per iteration
-			// int16 -> int32 -> float -> scale -> int32 -> int16 (saturated)
-			const __m128 vol_vec = _mm_set1_ps(volume);
-			size_t i = 0;
-			for (; i + 7 < sampleCount; i += 8) {
-				__m128i s16 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&samples[i]));
-				// Sign-extend int16 -> int32 using arithmetic shift to fill upper bits
-				__m128i sign = _mm_srai_epi16(s16, 15);
-				__m128i lo_i32 = _mm_unpacklo_epi16(s16, sign);
-				__m128i hi_i32 = _mm_unpackhi_epi16(s16, sign);
-				// Convert to float, scale, convert back, pack with saturation
-				__m128i result = _mm_packs_epi32(
-					_mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(lo_i32), vol_vec)),
-					_mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(hi_i32), vol_vec)));
-				_mm_storeu_si128(reinterpret_cast<__m128i*>(&samples[i]), result);
-			}
-			// Scalar tail for remaining samples
-			for (; i < sampleCount; ++i) {
-				samples[i] = static_cast<int16_t>(samples[i] * volume);
-			}
-#else
-			for (size_t i = 0; i < sampleCount; ++i) {
-				samples[i] = static_cast<int16_t>(samples[i] * volume);
-			}
-#endif
-		}
-	}
-    
-    if (g_fft_spectrum && bytesRead > 0) {
-        const int16_t* samples = reinterpret_cast<const int16_t*>(output);
-        g_fft_spectrum->push_samples(samples, bytesRead / bytesPerFrame);
-    }
+// SIGUSR1: write the trace file from the main loop
+std::atomic<bool> g_trace_dump_requested{false};
+
+void trace_signal_handler(int) {
+    g_trace_dump_requested = true;
 }
 
-std::vector<Station> load_stations(const std::string& filename) {
-    std::vector<Station> stations;
-    std::ifstream file(filename);
-    
-    if (!file.is_open()) {
-        return stations;
-    }
-    
-    json j;
-    file >> j;
-    
-    for (auto& [name, url] : j.items()) {
-        stations.push_back({name, url.get<std::string>()});
+// The UI edits its own copy of the list; catalog stays mapped for the
+// stations watcher to diff reloads against
+std::vector<Station> load_stations(const std::string& filename, StationCatalog& catalog) {
+    if (!catalog.load(filename)) {
+        if (!catalog.error().empty()) {
+            std::cerr << "Failed to load " << filename << ": " << catalog.error() << std::endl;
+        }
+        return {};
     }
-    
-    return stations;
+    return catalog.to_stations();
 }
 
 std::string get_executable_directory() {
@@ -222,447 +128,451 @@ std::string resolve_default_stations_file() {
     return "stations.json";
 }
 
-class AudioPlayer {
-private:
-    std::thread playback_thread_;
-    std::atomic<bool> stop_requested_{false};
-    std::string current_url_;
-    ByteRingbuffer audio_buffer_;
-    
-public:
-    void play(const std::string& url, const std::string& station_name) {
-        stop();
-        current_url_ = url;
-        g_current_station_name = station_name;
-        stop_requested_ = false;
-        g_playing = true;
-        
-        g_pending_playing_state = true;
-        g_has_playing_state_update = true;
-
-		playback_thread_ = std::thread([this]() {
-            play_stream(current_url_);
-        });
+// --daemon without --control: $XDG_RUNTIME_DIR/webradio.sock, else next to
+// the log in the data directory
+std::filesystem::path default_control_socket() {
+    if (const char* runtime_dir = std::getenv("XDG_RUNTIME_DIR"); runtime_dir && *runtime_dir) {
+        return std::filesystem::path(runtime_dir) / "webradio.sock";
     }
-    
-    void stop() {
-        stop_requested_ = true;
-        g_playing = false;
-
-        
-        if (playback_thread_.joinable()) {
-            playback_thread_.join();
-        }
-
-		g_pending_metadata = StreamMetadata{};
-		g_pending_metadata.pending = true;
-
-        g_pending_playing_state = false;
-        g_has_playing_state_update = true;
-    }
-    
-    bool is_playing() const {
-        return g_playing;
+    std::filesystem::path data_dir = user_data_dir();
+    if (!data_dir.empty() && ensure_directory(data_dir)) {
+        return data_dir / "webradio.sock";
     }
+    return "webradio.sock";
+}
 
-private:
-	void update_metadata_tui(AVFormatContext * fmt_ctx, int audio_stream_idx)
-	{
-		auto check_metadata = [&](const char* key) -> AVDictionaryEntry*
-		{
-			AVDictionaryEntry* t = nullptr;
-			if (audio_stream_idx >= 0 && fmt_ctx->streams[audio_stream_idx]) {
-				t = av_dict_get(fmt_ctx->streams[audio_stream_idx]->metadata, key, nullptr, 0);
-			}
-			if (!t) {
-				t = av_dict_get(fmt_ctx->metadata, key, nullptr, 0);
-			}
-			return t;
-		};
-
-		// Extract stream title (e.g., "a-ha - The Sun Always Shines on T.V.")
-		if (AVDictionaryEntry* tag = check_metadata("StreamTitle"); tag && tag->value)
-		{
-			if (g_pending_metadata.title != tag->value)
-			{
-				g_pending_metadata.title = tag->value;
-				g_pending_metadata.pending = true; // !g_pending_metadata.title.empty();
-			}
-		}
-
-		// Extract genre information
-		if (AVDictionaryEntry* tag = check_metadata("cy-genre"); tag && tag->value)
-		{
-			if (g_pending_metadata.genre != tag->value)
-			{
-				g_pending_metadata.genre = tag->value;
-				g_pending_metadata.pending = true; // !g_pending_metadata.genre.empty();
-			}
-		}
+// --daemon: what the control thread reports; the main loop fills in the
+// parts that come from playback
+struct DaemonStatus {
+    std::mutex mutex;
+    std::vector<Station> stations;
+    std::string station;
+    std::string title;
+    std::string genre;
+    std::string format;
+    std::string error;          // last stream error, cleared on play
+    int buffer_percent = 0;
+    int kbps = 0;
+
+    // play/stop from the control thread, carried out by the main loop
+    // (stopping joins the playback thread); a newer one replaces it
+    enum class Command { None, Play, Stop };
+    Command command = Command::None;
+    Station command_station;
+};
 
-		//AVDictionaryEntry* artist_tag = check_metadata("artist");
-		//AVDictionaryEntry* title_tag = check_metadata("title");
-	}
+// Station indexes in the "stations" reply and event follow the daemon's
+// list, which is kept in name order; they are only valid until the next
+// "stations" event
+static json station_list(const std::vector<Station>& stations) {
+    json list = json::array();
+    for (size_t i = 0; i < stations.size(); ++i) {
+        list.push_back({{"index", i}, {"name", stations[i].name}, {"url", stations[i].url}});
+    }
+    return list;
+}
 
+// Commands from the control socket; runs on the control thread. play and
+// stop are only queued for the main loop, so they are answered at once and
+// the "state" event follows when the player has switched.
+static json handle_control_command(const json& request, Player& player, DaemonStatus& status) {
+    const std::string cmd = request.at("cmd").get<std::string>();
 
-    bool play_stream(const std::string& url)
-	{
-        AVFormatContext* fmt_ctx = nullptr;
-        AVDictionary* opts = nullptr;
-        av_dict_set(&opts, "icy", "1", 0);
-        
-        int ret = avformat_open_input(&fmt_ctx, url.c_str(), nullptr, &opts);
-        av_dict_free(&opts);
-        
-        if (ret < 0) {
-            return false;
-        }
-        
-        ret = avformat_find_stream_info(fmt_ctx, nullptr);
-        if (ret < 0) {
-            avformat_close_input(&fmt_ctx);
-            return false;
-        }
-        
-        g_current_metadata = "";
-        
-        int audio_stream_idx = -1;
-        const AVCodec* codec = nullptr;
-        for (unsigned int i = 0; i < fmt_ctx->nb_streams; i++) {
-            AVStream* stream = fmt_ctx->streams[i];
-            if (stream->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
-                audio_stream_idx = i;
-                codec = avcodec_find_decoder(stream->codecpar->codec_id);
-                break;
+    if (cmd == "play") {
+        Station station;
+        {
+            std::lock_guard<std::mutex> lock(status.mutex);
+            if (request.contains("index")) {
+                size_t index = request.at("index").get<size_t>();
+                if (index >= status.stations.size()) {
+                    return {{"error", "no station at index " + std::to_string(index)}};
+                }
+                station = status.stations[index];
+            } else if (request.contains("station")) {
+                std::string name = request.at("station").get<std::string>();
+                auto it = std::find_if(status.stations.begin(), status.stations.end(),
+                                       [&](const Station& s) { return s.name == name; });
+                if (it == status.stations.end()) {
+                    return {{"error", "no station named " + name}};
+                }
+                station = *it;
+            } else if (request.contains("url")) {
+                station.url = request.at("url").get<std::string>();
+                station.name = request.value("name", station.url);
+            } else {
+                return {{"error", "play needs \"index\", \"station\" or \"url\""}};
             }
+            status.station = station.name;
+            status.title.clear();
+            status.genre.clear();
+            status.format.clear();
+            status.error.clear();
+            status.buffer_percent = 0;
+            status.command = DaemonStatus::Command::Play;
+            status.command_station = station;
         }
-        
-        if (audio_stream_idx == -1 || !codec) {
-            avformat_close_input(&fmt_ctx);
-            return false;
-        }
-        
-        AVCodecContext* codec_ctx = avcodec_alloc_context3(codec);
-        if (!codec_ctx) {
-            avformat_close_input(&fmt_ctx);
-            return false;
-        }
-        
-        ret = avcodec_parameters_to_context(codec_ctx, fmt_ctx->streams[audio_stream_idx]->codecpar);
-        if (ret < 0) {
-            avcodec_free_context(&codec_ctx);
-            avformat_close_input(&fmt_ctx);
-            return false;
+        return {{"station", station.name}};
+    }
+    if (cmd == "stop") {
+        std::lock_guard<std::mutex> lock(status.mutex);
+        status.title.clear();
+        status.genre.clear();
+        status.command = DaemonStatus::Command::Stop;
+        return json::object();
+    }
+    if (cmd == "volume") {
+        float volume = player.volume();
+        if (request.contains("value")) {
+            volume = request.at("value").get<float>();
+        } else if (request.contains("delta")) {
+            volume += request.at("delta").get<float>();
         }
-        
-        ret = avcodec_open2(codec_ctx, codec, nullptr);
+        volume = std::clamp(volume, 0.0f, 1.0f);
+        player.set_volume(volume);
+        return {{"volume", volume}};
+    }
+    if (cmd == "status") {
+        std::lock_guard<std::mutex> lock(status.mutex);
+        return {
+            {"playing", player.is_playing()},
+            {"station", status.station},
+            {"title", status.title},
+            {"genre", status.genre},
+            {"format", status.format},
+            {"stream_error", status.error},
+            {"volume", player.volume()},
+            {"buffer_percent", status.buffer_percent},
+            {"kbps", status.kbps},
+            {"underruns", engine_metrics().underruns.value()},
+        };
+    }
+    if (cmd == "stations") {
+        std::lock_guard<std::mutex> lock(status.mutex);
+        return {{"stations", station_list(status.stations)}};
+    }
+    if (cmd == "quit") {
+        g_running = false;
+        return json::object();
+    }
+    return {{"error", "unknown command: " + cmd}};
+}
 
-        if (ret < 0) {
-            avcodec_free_context(&codec_ctx);
-            avformat_close_input(&fmt_ctx);
-            return false;
-        }
-        
-        {
-            std::string format_info = codec->name;
-            if (!format_info.empty()) {
-				format_info[0] = std::toupper(format_info[0]);
-            }
-            
-            int bitrate_kbps = codec_ctx->bit_rate / 1000;
-			if (bitrate_kbps > 0) {
-				format_info = format_info + " " + std::to_string(bitrate_kbps) + "kbps";
-			}
+// Main loop without a terminal: commands are served by the control thread,
+// this loop publishes titles (when heard), levels and state changes.
+// replay_url, if set, starts playing at once.
+static int run_daemon(Engine& engine, Player& player, FFTSpectrum& spectrum, std::vector<Station> stations,
+                      StationsWatcher& stations_watcher, const std::filesystem::path& control_path,
+                      const std::string& trace_file, const std::string& replay_url, const std::string& replay_name) {
+    DaemonStatus status;
+    TuneLog tune_log(user_data_dir());
+    status.stations = std::move(stations);
+    // The catalog is sorted already; the debug/fallback list is not
+    std::stable_sort(status.stations.begin(), status.stations.end(),
+                     [](const Station& a, const Station& b) { return a.name < b.name; });
+
+    PlayerCallbacks callbacks;
+    callbacks.on_stream_format = [&status](const std::string& format, int) {
+        std::lock_guard<std::mutex> lock(status.mutex);
+        status.format = format;
+    };
+    callbacks.on_error = [&status, &tune_log](const std::string& message) {
+        tune_log.set_error(message);
+        std::lock_guard<std::mutex> lock(status.mutex);
+        status.error = message;
+    };
+    player.set_callbacks(std::move(callbacks));
+    player.set_analyzer(&spectrum);
+
+    if (!replay_url.empty()) {
+        status.station = replay_name;
+        player.play(replay_url, replay_name);
+    }
 
-			g_tui->set_stream_format(format_info);
-			g_tui->update_stream_kbps(bitrate_kbps);
+    ControlServer control;
+    if (!control.start(control_path, [&](const json& request) {
+            return handle_control_command(request, player, status);
+        })) {
+        log_write(LogLevel::Error, "main", "control socket: %s", control.error().c_str());
+        std::cerr << "Control socket: " << control.error() << std::endl;
+        return 1;
+    }
+    log_write(LogLevel::Info, "main", "daemon listening on %s", control_path.c_str());
+
+    uint64_t input_bytes = 0;
+    uint64_t last_kbps_calc_ns = pipeline_clock().now_ns();
+    auto publish_state = [&]() {
+        std::lock_guard<std::mutex> lock(status.mutex);
+        control.publish("state", {
+            {"playing", player.is_playing()},
+            {"station", status.station},
+            {"buffer_percent", status.buffer_percent},
+            {"kbps", status.kbps},
+        });
+    };
 
+    while (g_running) {
+        if (g_trace_dump_requested.exchange(false)) {
+            std::string trace_error;
+            trace_dump(trace_file, trace_error);
         }
-        
-        constexpr int OUTPUT_SAMPLE_RATE = 44100;
-        constexpr int OUTPUT_CHANNELS = 2;
-        constexpr size_t OUTPUT_BYTES_PER_FRAME = 4;
-
-        bool passthrough_pcm =
-            codec_ctx->sample_fmt == AV_SAMPLE_FMT_S16 &&
-            codec_ctx->sample_rate == OUTPUT_SAMPLE_RATE &&
-            codec_ctx->ch_layout.nb_channels == OUTPUT_CHANNELS;
-
-        SwrContext* swr_ctx = nullptr;
-        if (!passthrough_pcm) {
-            swr_ctx = swr_alloc();
-            if (!swr_ctx) {
-                avcodec_free_context(&codec_ctx);
-                avformat_close_input(&fmt_ctx);
-                return false;
-            }
-
-            AVChannelLayout out_ch_layout;
-            av_channel_layout_default(&out_ch_layout, OUTPUT_CHANNELS);
-
-            ret = swr_alloc_set_opts2(&swr_ctx,
-                &out_ch_layout,
-                AV_SAMPLE_FMT_S16,
-                OUTPUT_SAMPLE_RATE,
-                &codec_ctx->ch_layout,
-                codec_ctx->sample_fmt,
-                codec_ctx->sample_rate,
-                0, nullptr);
-
-            if (ret < 0) {
-                swr_free(&swr_ctx);
-                avcodec_free_context(&codec_ctx);
-                avformat_close_input(&fmt_ctx);
-                return false;
-            }
 
-            ret = swr_init(swr_ctx);
-            if (ret < 0) {
-                swr_free(&swr_ctx);
-                avcodec_free_context(&codec_ctx);
-                avformat_close_input(&fmt_ctx);
-                return false;
-            }
+        DaemonStatus::Command command;
+        Station command_station;
+        {
+            std::lock_guard<std::mutex> lock(status.mutex);
+            command = std::exchange(status.command, DaemonStatus::Command::None);
+            command_station = std::move(status.command_station);
         }
-        
-        ma_device_config deviceConfig = ma_device_config_init(ma_device_type_playback);
-        deviceConfig.playback.format = ma_format_s16;
-        deviceConfig.playback.channels = OUTPUT_CHANNELS;
-        deviceConfig.sampleRate = OUTPUT_SAMPLE_RATE;
-        deviceConfig.dataCallback = data_callback;
-        deviceConfig.pUserData = &audio_buffer_;
-        
-        ma_device device;
-        ret = ma_device_init(nullptr, &deviceConfig, &device);
-        if (ret != MA_SUCCESS) {
-            swr_free(&swr_ctx);
-            avcodec_free_context(&codec_ctx);
-            avformat_close_input(&fmt_ctx);
-            return false;
+        if (command == DaemonStatus::Command::Play) {
+            player.play(command_station.url, command_station.name);
+        } else if (command == DaemonStatus::Command::Stop) {
+            player.stop();
         }
-        
-        AVPacket* packet = av_packet_alloc();
-        AVFrame* frame = av_frame_alloc();
-        
-        if (!packet || !frame) {
-            ma_device_uninit(&device);
-            swr_free(&swr_ctx);
-            avcodec_free_context(&codec_ctx);
-            avformat_close_input(&fmt_ctx);
-            return false;
+
+        bool playing = false;
+        if (player.take_state_change(playing)) {
+            publish_state();
         }
-        
-        audio_buffer_.consumer_clear();
-        constexpr size_t PREBUFFER_TARGET = 65536;
-
-        auto write_to_audio_buffer = [&](const uint8_t* src, size_t data_size) {
-            size_t written = 0;
-            while (written < data_size && !stop_requested_) {
-                uint8_t* dst = nullptr;
-                size_t available = audio_buffer_.reserve_write_contiguous(dst);
-                if (available == 0 || dst == nullptr) {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
-                    continue;
-                }
 
-                size_t chunk = std::min(available, data_size - written);
-                std::memcpy(dst, src + written, chunk);
-                audio_buffer_.produce(chunk);
-                written += chunk;
+        StationChanges station_changes;
+        if (stations_watcher.take_changes(station_changes)) {
+            engine.playlist_resolver().prefetch(station_changes.added);
+            engine.playlist_resolver().prefetch(station_changes.updated);
+            std::lock_guard<std::mutex> lock(status.mutex);
+            apply_station_changes(status.stations, station_changes);
+            // Indexes may have moved; clients get the whole new list
+            if (control.has_subscribers("stations")) {
+                control.publish("stations", {{"stations", station_list(status.stations)}});
             }
-        };
+        }
 
-        auto convert_frame_to_audio_buffer = [&](AVFrame* decoded_frame) {
-            const uint8_t** input = const_cast<const uint8_t**>(decoded_frame->extended_data);
-            int input_samples = decoded_frame->nb_samples;
-            bool input_sent = false;
-
-            while (!stop_requested_) {
-                uint8_t* dst = nullptr;
-                size_t available = audio_buffer_.reserve_write_contiguous(dst);
-                if (available < OUTPUT_BYTES_PER_FRAME || dst == nullptr) {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
-                    continue;
-                }
+        int buffer_percent = player.take_buffer_percent();
+        if (buffer_percent >= 0) {
+            std::lock_guard<std::mutex> lock(status.mutex);
+            status.buffer_percent = buffer_percent;
+        }
 
-                int max_samples = static_cast<int>(available / OUTPUT_BYTES_PER_FRAME);
-                int converted_samples = swr_convert(
-                    swr_ctx,
-                    &dst,
-                    max_samples,
-                    input_sent ? nullptr : input,
-                    input_sent ? 0 : input_samples);
+        player.release_metadata([&](const MetadataEvent& metadata_event) {
+            std::lock_guard<std::mutex> lock(status.mutex);
+            status.title = metadata_event.title;
+            status.genre = metadata_event.genre;
+            control.publish("metadata", {
+                {"station", status.station},
+                {"title", metadata_event.title},
+                {"genre", metadata_event.genre},
+            });
+        });
 
-                if (converted_samples <= 0) {
-                    return;
-                }
+        player.callback_monitor().drain();
+        tune_log.update(player.tune_timeline(), player.is_playing());
 
-                size_t produced_bytes = static_cast<size_t>(converted_samples) * OUTPUT_BYTES_PER_FRAME;
-                audio_buffer_.produce(produced_bytes);
-                input_sent = true;
+        input_bytes += player.take_input_bytes();
+        uint64_t now_ns = pipeline_clock().now_ns();
+        auto elapsed = static_cast<int64_t>((now_ns - last_kbps_calc_ns) / 1'000'000);
+        if (elapsed >= 1000) {
+            {
+                std::lock_guard<std::mutex> lock(status.mutex);
+                status.kbps = static_cast<int>((input_bytes * 1000) / (elapsed * 1024));
             }
-        };
-        
-        while (!stop_requested_ && audio_buffer_.read_available() < PREBUFFER_TARGET) {
-            ret = av_read_frame(fmt_ctx, packet);
-            if (ret < 0) break;
-            
-            if (packet->stream_index == audio_stream_idx) {
-                ret = avcodec_send_packet(codec_ctx, packet);
-                if (ret < 0) {
-                    av_packet_unref(packet);
-                    continue;
-                }
-                
-                while (ret >= 0) {
-                    ret = avcodec_receive_frame(codec_ctx, frame);
-                    if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) break;
-                    if (ret < 0) break;
-                    
-                    if (passthrough_pcm) {
-                        int data_size = av_samples_get_buffer_size(
-                            nullptr,
-                            codec_ctx->ch_layout.nb_channels,
-                            frame->nb_samples,
-                            codec_ctx->sample_fmt,
-                            1);
-                        if (data_size > 0 && frame->data[0] != nullptr) {
-                            write_to_audio_buffer(frame->data[0], static_cast<size_t>(data_size));
-                        }
-                    } else {
-                        convert_frame_to_audio_buffer(frame);
-                    }
+            input_bytes = 0;
+            last_kbps_calc_ns = now_ns;
+            publish_state();
+        }
+
+        // The FFT only runs while someone is watching the levels
+        if (control.has_subscribers("levels")) {
+            spectrum.process_samples();
+            std::array<float, FFTSpectrum::NUM_BARS> spectrum_bars;
+            bool updated = false;
+            spectrum.get_spectrum(spectrum_bars, updated);
+            if (updated) {
+                json bars = json::array();
+                for (float bar : spectrum_bars) {
+                    bars.push_back(std::round(bar * 1000.0f) / 1000.0f);
                 }
+                control.publish("levels", {{"bars", std::move(bars)}});
             }
-            av_packet_unref(packet);
-            
-            size_t filled = audio_buffer_.read_available();
-            int percent = static_cast<int>((filled * 100) / ByteRingbuffer::BUFFER_SIZE);
-            if (percent > 100) percent = 100;
-            g_pending_buffer_percent = percent;
-        }
-        
-        if (stop_requested_) {
-            av_packet_free(&packet);
-            av_frame_free(&frame);
-            ma_device_uninit(&device);
-            swr_free(&swr_ctx);
-            avcodec_free_context(&codec_ctx);
-            avformat_close_input(&fmt_ctx);
-            return true;
         }
 
+        pipeline_clock().sleep_for_ns(20'000'000);
+    }
 
-		update_metadata_tui(fmt_ctx, audio_stream_idx);
+    // A tune still starting is logged as stopped
+    player.stop();
+    tune_log.update(player.tune_timeline(), false);
+    control.stop();
+    return 0;
+}
 
-        
-        ret = ma_device_start(&device);
-        if (ret != MA_SUCCESS) {
-            av_packet_free(&packet);
-            av_frame_free(&frame);
-            ma_device_uninit(&device);
-            swr_free(&swr_ctx);
-            avcodec_free_context(&codec_ctx);
-            avformat_close_input(&fmt_ctx);
-            return false;
+// --monitor: decode every station at once without playing any, printing
+// a JSON line per station every interval_s seconds. Streams that end or
+// fail are reconnected at the next report.
+static int run_monitor(const std::vector<Station>& stations, size_t threads, size_t reactors, int interval_s) {
+    MonitorOptions options;
+    options.threads = threads;
+    options.reactor_threads = reactors;
+    MonitorEngine monitor(options);
+
+    std::vector<int> ids;
+    std::vector<uint64_t> reconnects(stations.size(), 0);
+    std::vector<uint64_t> last_input_bytes(stations.size(), 0);
+    for (const auto& station : stations) {
+        ids.push_back(monitor.add_stream(station.url, station.name));
+    }
+    log_write(LogLevel::Info, "main", "monitoring %zu stations on %zu decode and %zu network threads",
+              stations.size(), monitor.threads(), monitor.reactor_threads());
+
+    const uint64_t interval_ns = static_cast<uint64_t>(interval_s) * 1'000'000'000ull;
+    uint64_t next_report_ns = pipeline_clock().now_ns() + interval_ns;
+    while (g_running) {
+        pipeline_clock().sleep_for_ns(100'000'000);
+        if (pipeline_clock().now_ns() < next_report_ns) {
+            continue;
         }
-        
-		g_bytes_accumulated = 0;
-		g_last_kbps_calc = std::chrono::steady_clock::now();
-		auto last_buffer_update = std::chrono::steady_clock::now();
-		int old_buffer_percent = 0;
-        while (!stop_requested_)
-		{
-            ret = av_read_frame(fmt_ctx, packet);
-            if (ret < 0) break;
-            
-            g_bytes_accumulated += packet->size;
-            
-            if (packet->stream_index == audio_stream_idx)
-			{
-                ret = avcodec_send_packet(codec_ctx, packet);
-                if (ret < 0) {
-                    av_packet_unref(packet);
-                    continue;
-                }
-                
-                while (ret >= 0) {
-                    ret = avcodec_receive_frame(codec_ctx, frame);
-                    if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) break;
-                    if (ret < 0) break;
-                    
-                    if (passthrough_pcm) {
-                        int data_size = av_samples_get_buffer_size(
-                            nullptr,
-                            codec_ctx->ch_layout.nb_channels,
-                            frame->nb_samples,
-                            codec_ctx->sample_fmt,
-                            1);
-                        if (data_size > 0 && frame->data[0] != nullptr) {
-                            write_to_audio_buffer(frame->data[0], static_cast<size_t>(data_size));
-                        }
-                    } else {
-                        convert_frame_to_audio_buffer(frame);
-                    }
-				}
-
-				auto now_buffer = std::chrono::steady_clock::now();
-				auto elapsed_buffer = std::chrono::duration_cast<std::chrono::milliseconds>(now_buffer - last_buffer_update).count();
-				if (elapsed_buffer >= 1000)
-				{
-					update_metadata_tui(fmt_ctx, audio_stream_idx);
-
-
-					size_t filled = audio_buffer_.read_available();
-					int percent = static_cast<int>((filled * 100) / ByteRingbuffer::BUFFER_SIZE);
-					if (percent > 100) percent = 100;
-					if (old_buffer_percent != percent)
-					{
-						g_pending_buffer_percent = percent;
-						old_buffer_percent = percent;
-					}
-					last_buffer_update = now_buffer;
-				}
+        next_report_ns += interval_ns;
+
+        std::vector<MonitorStreamStatus> statuses = monitor.status();
+        for (size_t i = 0; i < ids.size(); i++) {
+            auto it = std::find_if(statuses.begin(), statuses.end(),
+                                   [&](const MonitorStreamStatus& s) { return s.id == ids[i]; });
+            if (it == statuses.end()) {
+                continue;
+            }
+            const MonitorStreamStatus& s = *it;
+            uint64_t new_bytes = s.input_bytes - last_input_bytes[i];
+            last_input_bytes[i] = s.input_bytes;
+            json line = {
+                {"station", s.name},
+                {"state", monitor_state_name(s.state)},
+                {"codec", s.codec},
+                {"title", s.title},
+                {"kbps", static_cast<int>(new_bytes * 8 / 1000 / static_cast<uint64_t>(interval_s))},
+                {"peak_db", std::round(s.peak_db * 10.0f) / 10.0f},
+                {"rms_db", std::round(s.rms_db * 10.0f) / 10.0f},
+                {"silent_s", s.silent_seconds},
+                {"reconnects", reconnects[i]},
+            };
+            if (!s.error.empty()) {
+                line["error"] = s.error;
+            }
+            std::cout << line.dump() << "\n";
 
-			}
-			av_packet_unref(packet);
+            if (s.state == MonitorState::Ended || s.state == MonitorState::Failed) {
+                monitor.remove_stream(ids[i]);
+                ids[i] = monitor.add_stream(stations[i].url, stations[i].name);
+                last_input_bytes[i] = 0;
+                reconnects[i]++;
+            }
         }
-
-        av_packet_free(&packet);
-        av_frame_free(&frame);
-        ma_device_stop(&device);
-        ma_device_uninit(&device);
-        swr_free(&swr_ctx);
-        avcodec_free_context(&codec_ctx);
-        avformat_close_input(&fmt_ctx);
-
-        audio_buffer_.consumer_clear();
-        return true;
+        std::cout.flush();
     }
-};
 
-int main(int argc, char* argv[]) {
-#ifndef FFMPEG_DEBUG_LOGGING
-    av_log_set_callback(suppress_ffmpeg_logging);
-#endif
+    monitor.stop();
+    return 0;
+}
 
-    if (argc > 1) {
-        std::string arg = argv[1];
+int main(int argc, char* argv[]) {
+    std::string stations_file = resolve_default_stations_file();
+    std::string directory_file;
+    bool use_musicbrainz = true;
+    bool watch_titles = false;
+    std::string metrics_listen;
+    std::string metrics_json;
+    int metrics_interval = 10;
+    std::string trace_file;
+    std::string log_file;
+    std::string log_level_name = "info";
+    std::string replay_file;
+    EngineOptions engine_options;
+    bool daemon_mode = false;
+    std::filesystem::path control_path;
+    bool monitor_mode = false;
+    size_t monitor_threads = 0;
+    size_t monitor_reactors = MonitorOptions().reactor_threads;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
         if (arg == "--version" || arg == "-v") {
             std::cout << WEBRADIO_VERSION << std::endl;
             return 0;
+        } else if (arg == "--directory" && i + 1 < argc) {
+            directory_file = argv[++i];
+        } else if (arg == "--no-musicbrainz") {
+            use_musicbrainz = false;
+        } else if (arg == "--watch-titles") {
+            watch_titles = true;
+        } else if (arg == "--metrics-listen" && i + 1 < argc) {
+            metrics_listen = argv[++i];
+        } else if (arg == "--metrics-json" && i + 1 < argc) {
+            metrics_json = argv[++i];
+        } else if (arg == "--trace" && i + 1 < argc) {
+            trace_file = argv[++i];
+        } else if (arg == "--log" && i + 1 < argc) {
+            log_file = argv[++i];
+        } else if (arg == "--log-level" && i + 1 < argc) {
+            log_level_name = argv[++i];
+        } else if (arg == "--record" && i + 1 < argc) {
+            engine_options.record_dir = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            replay_file = argv[++i];
+        } else if (arg == "--replay-speed" && i + 1 < argc) {
+            engine_options.replay_speed = std::max(0.0, std::atof(argv[++i]));
+        } else if (arg == "--daemon") {
+            daemon_mode = true;
+        } else if (arg == "--control" && i + 1 < argc) {
+            control_path = argv[++i];
+        } else if (arg == "--monitor") {
+            monitor_mode = true;
+        } else if (arg == "--monitor-threads" && i + 1 < argc) {
+            monitor_threads = static_cast<size_t>(std::max(0, std::atoi(argv[++i])));
+        } else if (arg == "--monitor-reactors" && i + 1 < argc) {
+            monitor_reactors = static_cast<size_t>(std::max(0, std::atoi(argv[++i])));
+        } else if (arg == "--metrics-interval" && i + 1 < argc) {
+            metrics_interval = std::max(1, std::atoi(argv[++i]));
+        } else {
+            stations_file = arg;
         }
     }
 
     std::signal(SIGINT, signal_handler);
     std::signal(SIGTERM, signal_handler);
-    
-    std::string stations_file = resolve_default_stations_file();
-    if (argc > 1) {
-        stations_file = argv[1];
+
+    LogLevel log_level = LogLevel::Info;
+    if (log_level_name != "off") {
+        if (!log_level_from_string(log_level_name, log_level)) {
+            std::cerr << "--log-level: expected error, warning, info, debug or off" << std::endl;
+            return 1;
+        }
+        std::filesystem::path log_path = log_file;
+        if (log_path.empty() && !user_data_dir().empty() && ensure_directory(user_data_dir())) {
+            log_path = user_data_dir() / "webradio.log";
+        }
+        std::string log_error;
+        if (!log_path.empty() && !log_start(log_path, log_level, log_error)) {
+            std::cerr << "Log: " << log_error << std::endl;
+            return 1;
+        }
+        if (log_level == LogLevel::Debug) {
+            av_log_set_level(AV_LOG_DEBUG);
+        }
+        log_write(LogLevel::Info, "main", "webradio %s", WEBRADIO_VERSION);
+    }
+#ifdef WEBRADIO_TRACE
+    if (!trace_file.empty()) {
+        trace_enable(true);
+        TRACE_THREAD_NAME("ui");
+#ifdef SIGUSR1
+        std::signal(SIGUSR1, trace_signal_handler);
+#endif
     }
+#else
+    if (!trace_file.empty()) {
+        std::cerr << "--trace: built without WEBRADIO_TRACE" << std::endl;
+        return 1;
+    }
+#endif
 
-	std::vector<Station> stations = load_stations(stations_file);
+	auto catalog = std::make_unique<StationCatalog>();
+	std::vector<Station> stations = load_stations(stations_file, *catalog);
 
 #ifndef NDEBUG
 	if (stations.empty()) {
@@ -686,23 +596,90 @@ int main(int argc, char* argv[]) {
         std::cerr << "No stations loaded" << std::endl;
         return 1;
     }
-    
-    g_tui = std::make_unique<RadioTUI>();
-    if (!g_tui->init()) {
-        std::cerr << "Failed to initialize TUI" << std::endl;
-        return 1;
+
+    // Register the engine metrics before any thread can touch them
+    engine_metrics();
+    MetricsServer metrics_server;
+    if (!metrics_listen.empty() || !metrics_json.empty()) {
+        if (!metrics_server.start(metrics_listen, metrics_json, std::chrono::seconds(metrics_interval))) {
+            std::cerr << "Metrics: " << metrics_server.error() << std::endl;
+            return 1;
+        }
+    }
+
+    if (monitor_mode) {
+        int status = run_monitor(stations, monitor_threads, monitor_reactors, metrics_interval);
+        metrics_server.stop();
+        log_stop();
+        return status;
     }
     
-    g_fft_spectrum = std::make_unique<FFTSpectrum>();
+    if (!daemon_mode) {
+        g_tui = std::make_unique<RadioTUI>();
+        if (!g_tui->init()) {
+            std::cerr << "Failed to initialize TUI" << std::endl;
+            return 1;
+        }
+        g_tui->set_stations(stations);
+    }
     
-    g_tui->set_stations(stations);
+    // Also routes FFmpeg's log from here on
+    Engine engine(engine_options);
+    engine.playlist_resolver().prefetch(stations);
+
+    if (use_musicbrainz && !daemon_mode) {
+        g_musicbrainz = std::make_unique<MusicBrainzClient>();
+    }
+    std::string current_stream_title;
+
+    // Reload the station file on edit; the active stream keeps its own URL copy
+    StationsWatcher stations_watcher;
+    stations_watcher.start(stations_file, std::move(catalog));
+
+    // Now-playing titles for every station in the list, without tuning
+    StationTitleWatcher title_watcher;
+    if (watch_titles && !daemon_mode) {
+        title_watcher.start(stations);
+    }
     
-    AudioPlayer player;
+    std::unique_ptr<Player> player_ptr = engine.create_player(std::make_unique<DeviceSink>());
+    Player& player = *player_ptr;
+    auto spectrum = std::make_unique<FFTSpectrum>();
+
+    // A recorded session plays straight away, through the same path as a tune
+    std::string replay_url;
+    std::string replay_name;
+    if (!replay_file.empty()) {
+        std::error_code ec;
+        std::filesystem::path replay_path = std::filesystem::absolute(replay_file, ec);
+        replay_url = REPLAY_URL_PREFIX + replay_path.string();
+        replay_name = "Replay " + replay_path.filename().string();
+    }
+
+    if (daemon_mode) {
+        if (control_path.empty()) {
+            control_path = default_control_socket();
+        }
+        int status = run_daemon(engine, player, *spectrum, stations, stations_watcher, control_path, trace_file,
+                                replay_url, replay_name);
+        stations_watcher.stop();
+        player.stop();
+        engine.stop();
+        metrics_server.stop();
+        log_stop();
+        if (!trace_file.empty()) {
+            std::string trace_error;
+            if (!trace_dump(trace_file, trace_error)) {
+                std::cerr << "Trace: " << trace_error << std::endl;
+            }
+        }
+        return status;
+    }
     
     g_tui->set_on_station_select([&player](const Station& station) {
         if (g_tui) {
             g_tui->set_song_title("","");
-			g_pending_buffer_percent = 0;
+			g_tui->update_cache_info(0);
         }
         player.play(station.url, station.name);
     });
@@ -717,29 +694,120 @@ int main(int argc, char* argv[]) {
     g_tui->set_on_quit([]() {
         g_running = false;
     });
-    
-    g_tui->set_on_volume_up([]() {
-        float vol = g_volume.load();
+
+    // Called on the playback thread, as before the engine split
+    TuneLog tune_log(user_data_dir());
+    PlayerCallbacks callbacks;
+    callbacks.on_stream_format = [](const std::string& format, int kbps) {
+        g_tui->set_stream_format(format);
+        g_tui->update_stream_kbps(kbps);
+    };
+    callbacks.on_error = [&tune_log](const std::string& message) {
+        tune_log.set_error(message);
+    };
+    player.set_callbacks(std::move(callbacks));
+    player.set_analyzer(spectrum.get());
+
+    if (!replay_url.empty()) {
+        player.play(replay_url, replay_name);
+    }
+
+    // Station directory: imported in the background, searched from browse mode
+    StationDirectory directory;
+    std::atomic<bool> directory_ready{false};
+    std::atomic<bool> directory_cancel{false};
+    std::thread directory_loader;
+    if (!directory_file.empty()) {
+        directory_loader = std::thread([&directory, &directory_ready, &directory_cancel, directory_file]() {
+            directory.import_file(directory_file, &directory_cancel);
+            directory_ready = true;
+        });
+    }
+
+    g_tui->set_on_directory_search([&directory, &directory_ready, &directory_file](const std::string& query) {
+        if (directory_file.empty()) {
+            g_tui->set_directory_results({}, "No directory (--directory)");
+            return;
+        }
+        if (!directory_ready) {
+            g_tui->set_directory_results({}, "Loading directory...");
+            return;
+        }
+        if (directory.size() == 0) {
+            g_tui->set_directory_results({}, directory.error().empty() ? "Directory is empty" : directory.error());
+            return;
+        }
+
+        constexpr size_t MAX_RESULTS = 500;
+        StationDirectory::QueryResult result = directory.query(query, MAX_RESULTS);
+        if (!result.error.empty()) {
+            g_tui->set_directory_results({}, result.error);
+            return;
+        }
+
+        std::vector<BrowseEntry> entries;
+        entries.reserve(result.rows.size());
+        for (uint32_t row : result.rows) {
+            BrowseEntry entry;
+            entry.station = directory.station(row);
+            entry.info = directory.codec(row);
+            if (directory.bitrate(row) > 0) {
+                entry.info += " " + std::to_string(directory.bitrate(row)) + "k";
+            }
+            if (!directory.country(row).empty()) {
+                entry.info += " " + directory.country(row);
+            }
+            entries.push_back(std::move(entry));
+        }
+
+        char status[64];
+        std::snprintf(status, sizeof(status), "%zu matches, %.2f ms", result.total, result.elapsed_ms);
+        g_tui->set_directory_results(std::move(entries), status);
+    });
+
+    g_tui->set_on_volume_up([&player]() {
+        float vol = player.volume();
         vol = std::min(vol + 0.05f, 1.0f);
-        g_volume.store(vol);
+        player.set_volume(vol);
         if (g_tui) {
             g_tui->set_volume(static_cast<int>(vol * 100));
         }
     });
     
-    g_tui->set_on_volume_down([]() {
-        float vol = g_volume.load();
+    g_tui->set_on_volume_down([&player]() {
+        float vol = player.volume();
         vol = std::max(vol - 0.05f, 0.0f);
-        g_volume.store(vol);
+        player.set_volume(vol);
         if (g_tui) {
             g_tui->set_volume(static_cast<int>(vol * 100));
         }
     });
     
+    if (!trace_file.empty()) {
+        g_tui->set_on_trace_dump([]() {
+            g_trace_dump_requested = true;
+        });
+    }
+
+    // Tune timing: shown live while a station starts, logged once it plays
+    // or ends
+    TuneTimeline& tune_timeline = player.tune_timeline();
+    CallbackMonitor& callback_monitor = player.callback_monitor();
+
+    uint64_t input_bytes = 0;
+    uint64_t last_kbps_calc_ns = pipeline_clock().now_ns();
+
+    PerfSampler perf_sampler;
+
     g_tui->draw_all();
     
 	while (g_running)
 	{
+        if (g_trace_dump_requested.exchange(false)) {
+            std::string trace_error;
+            trace_dump(trace_file, trace_error);
+        }
+
 		bool update_tui = false;
 		bool only_spectrum_update = false;
         int ch = g_tui->get_input();
@@ -748,53 +816,99 @@ int main(int argc, char* argv[]) {
         }
         
         {
-            if (g_has_playing_state_update) {
-				g_tui->set_current_station(g_current_station_name);
-                g_tui->set_playing(g_pending_playing_state);
-                g_has_playing_state_update = false;
+            bool playing = false;
+            if (player.take_state_change(playing)) {
+				g_tui->set_current_station(player.station_name());
+                g_tui->set_playing(playing);
             }
             
-            int buffer_percent = g_pending_buffer_percent.load();
-            if (buffer_percent >= 0 && g_tui) {
+            StationChanges station_changes;
+            if (stations_watcher.take_changes(station_changes)) {
+                g_tui->apply_station_changes(station_changes);
+                engine.playlist_resolver().prefetch(station_changes.added);
+                engine.playlist_resolver().prefetch(station_changes.updated);
+                if (watch_titles) {
+                    title_watcher.set_stations(g_tui->stations());
+                }
+            }
+
+            std::unordered_map<std::string, std::string> station_titles;
+            if (title_watcher.take_titles(station_titles)) {
+                g_tui->update_station_titles(station_titles);
+            }
+
+            int buffer_percent = player.take_buffer_percent();
+            if (buffer_percent >= 0) {
                 g_tui->update_cache_info(buffer_percent);
-                g_pending_buffer_percent = -1;
 				update_tui = true;
             }
             
             
-            if (g_pending_metadata.pending)
+            // Titles are released once the audio they arrived with is playing
+            player.release_metadata([&](const MetadataEvent& metadata_event)
 			{
-				{
-					std::lock_guard<std::mutex> lock(g_metadata_mutex);
-					g_tui->set_song_title(g_pending_metadata.title, g_pending_metadata.genre);
-					if (!g_pending_metadata.title.empty()) {
-						g_tui->add_to_history(g_pending_metadata.title, g_current_station_name);
+				g_tui->set_song_title(metadata_event.title, metadata_event.genre);
+				if (!metadata_event.title.empty()) {
+					g_tui->add_to_history(metadata_event.title, player.station_name());
+				}
+				if (metadata_event.title != current_stream_title) {
+					current_stream_title = metadata_event.title;
+					TrackInfo info;
+					if (g_musicbrainz && !current_stream_title.empty()) {
+						// Cached tracks resolve here; the rest arrive via take_result()
+						info = g_musicbrainz->lookup(current_stream_title).value_or(TrackInfo{});
 					}
-					g_pending_metadata.pending = false;
+					g_tui->update_track_metadata(info.album, info.year, info.genre);
 				}
 				update_tui = true;
+			});
+
+			if (g_tui->flush_history()) {
+				update_tui = true;
+			}
+
+			MusicBrainzClient::Result track_result;
+			while (g_musicbrainz && g_musicbrainz->take_result(track_result)) {
+				if (track_result.stream_title == current_stream_title) {
+					g_tui->update_track_metadata(track_result.info.album, track_result.info.year, track_result.info.genre);
+					update_tui = true;
+				}
 			}
             
-			auto now = std::chrono::steady_clock::now();
-			auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - g_last_kbps_calc).count();
+			callback_monitor.drain();
+
+			if (tune_log.update(tune_timeline, player.is_playing())) {
+				g_tui->set_tune_breakdown(tune_timeline.breakdown());
+				update_tui = true;
+			}
+
+			input_bytes += player.take_input_bytes();
+			uint64_t now_ns = pipeline_clock().now_ns();
+			auto elapsed = static_cast<int64_t>((now_ns - last_kbps_calc_ns) / 1'000'000);
 			if (elapsed >= 1000)
 			{
-				int kbps = static_cast<int>((g_bytes_accumulated * 1000) / (elapsed * 1024));
+				int kbps = static_cast<int>((input_bytes * 1000) / (elapsed * 1024));
 				g_tui->update_stream_kbps(kbps);
-				g_bytes_accumulated = 0;
-				g_last_kbps_calc = now;
+				g_tui->update_callback_stats(callback_monitor.stats());
+				if (tune_log.pending()) {
+					g_tui->set_tune_breakdown(tune_timeline.breakdown());
+				}
+				if (g_tui->perf_panel_visible()) {
+					g_tui->set_perf_snapshot(perf_sampler.sample(callback_monitor.stats()));
+				}
+				input_bytes = 0;
+				last_kbps_calc_ns = now_ns;
 				update_tui = true;
 			}
 
 		
-			if(g_fft_spectrum)
 			{
-				g_fft_spectrum->process_samples();
+				spectrum->process_samples();
 
-	            if (g_fft_spectrum->has_new_data()) {
+	            if (spectrum->has_new_data()) {
 		            std::array<float, FFTSpectrum::NUM_BARS> spectrum_bars;
 			        bool updated = false;
-				    g_fft_spectrum->get_spectrum(spectrum_bars, updated);
+				    spectrum->get_spectrum(spectrum_bars, updated);
 					if (updated) {
 						g_tui->update_spectrum(spectrum_bars);
 						if (!update_tui) {
@@ -806,6 +920,7 @@ int main(int argc, char* argv[]) {
 			}
 
 			if (update_tui) {
+				TRACE_SCOPE("draw");
 				if (only_spectrum_update) {
 					g_tui->draw_spectrum_overlay();
 				} else {
@@ -814,12 +929,33 @@ int main(int argc, char* argv[]) {
 			}
        }
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        pipeline_clock().sleep_for_ns(50'000'000);
     }
     
+    stations_watcher.stop();
+    title_watcher.stop();
     player.stop();
+    tune_log.update(tune_timeline, false);
+    engine.stop();
+    if (g_musicbrainz) {
+        g_musicbrainz->stop();
+    }
+    if (directory_loader.joinable()) {
+        // A large dump may still be importing; abandon it rather than wait
+        directory_cancel = true;
+        directory_loader.join();
+    }
+    metrics_server.stop();
+    log_stop();
     
     g_tui->cleanup();
+
+    if (!trace_file.empty()) {
+        std::string trace_error;
+        if (!trace_dump(trace_file, trace_error)) {
+            std::cerr << "Trace: " << trace_error << std::endl;
+        }
+    }
     
     return 0;
 }
@@ -0,0 +1,139 @@
+#include "work_stealing_pool.hpp"
+#include "thread_name.hpp"
+
+#include <algorithm>
+
+#include <time.h>
+
+namespace {
+
+// Set on worker threads, so submit() knows whose deque to use
+thread_local const WorkStealingPool* t_pool = nullptr;
+thread_local size_t t_worker = 0;
+
+uint64_t thread_cpu_ns() {
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1'000'000'000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+} // namespace
+
+WorkStealingPool::WorkStealingPool(size_t threads, const std::string& name) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < threads; i++) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    // All deques exist before any worker looks for work to steal
+    for (size_t i = 0; i < threads; i++) {
+        workers_[i]->thread = std::thread([this, i, thread_name = name + " " + std::to_string(i)]() {
+            set_thread_name(thread_name.c_str());
+            run(i);
+        });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    stop();
+}
+
+void WorkStealingPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stop_requested_ = true;
+    }
+    wake_cv_.notify_all();
+    for (auto& worker : workers_) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+    for (auto& worker : workers_) {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        worker->tasks.clear();
+    }
+    queued_ = 0;
+}
+
+void WorkStealingPool::submit(Task task) {
+    size_t index = t_pool == this ? t_worker
+                                  : next_worker_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+    // Counted first, so a worker never takes a task queued_ does not know
+    // about. Pairs with run(): either the sleeper sees queued_ or we see it
+    // asleep.
+    queued_.fetch_add(1);
+    {
+        Worker& worker = *workers_[index];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+    }
+    if (sleepers_.load() > 0) {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        wake_cv_.notify_one();
+    }
+}
+
+bool WorkStealingPool::take(size_t index, Task& task, bool& stolen) {
+    {
+        Worker& own = *workers_[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.front());
+            own.tasks.pop_front();
+            stolen = false;
+            return true;
+        }
+    }
+    for (size_t i = 1; i < workers_.size(); i++) {
+        Worker& victim = *workers_[(index + i) % workers_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            stolen = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::run(size_t index) {
+    t_pool = this;
+    t_worker = index;
+    Worker& self = *workers_[index];
+
+    while (!stop_requested_) {
+        Task task;
+        bool stolen = false;
+        if (take(index, task, stolen)) {
+            queued_.fetch_sub(1);
+            uint64_t cpu_start = thread_cpu_ns();
+            task();
+            // Whatever the task captured is released on this thread too
+            task = nullptr;
+            self.cpu_ns.fetch_add(thread_cpu_ns() - cpu_start, std::memory_order_relaxed);
+            self.tasks_run.fetch_add(1, std::memory_order_relaxed);
+            if (stolen) {
+                self.steals.fetch_add(1, std::memory_order_relaxed);
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        sleepers_.fetch_add(1);
+        wake_cv_.wait(lock, [this]() { return stop_requested_ || queued_.load() > 0; });
+        sleepers_.fetch_sub(1);
+    }
+}
+
+WorkStealingPool::Stats WorkStealingPool::stats() const {
+    Stats stats;
+    for (const auto& worker : workers_) {
+        stats.tasks += worker->tasks_run.load(std::memory_order_relaxed);
+        stats.steals += worker->steals.load(std::memory_order_relaxed);
+        stats.cpu_ns += worker->cpu_ns.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
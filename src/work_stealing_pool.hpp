@@ -0,0 +1,75 @@
+#ifndef WORK_STEALING_POOL_HPP
+#define WORK_STEALING_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads, each with its own task deque. A worker
+// runs its own tasks oldest first and, when its deque is empty, steals
+// the newest task of another worker, so a burst of work submitted to one
+// worker spreads over the whole pool. Tasks submitted from a worker go to
+// that worker's deque (the data they touch is likely in its cache);
+// tasks from other threads are dealt round-robin.
+//
+// Deques are mutex-protected: tasks here are slices of decoding, hundreds
+// of microseconds or more, so the locks are not the bottleneck.
+// Idle workers sleep until a task is submitted.
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    struct Stats {
+        uint64_t tasks = 0;
+        uint64_t steals = 0;    // tasks run by a worker other than the one queued on
+        uint64_t cpu_ns = 0;    // worker thread CPU time spent in tasks
+    };
+
+    // threads = 0: one per hardware thread. Workers are named
+    // "<name> N" (Linux keeps 15 characters).
+    explicit WorkStealingPool(size_t threads = 0, const std::string& name = "pool");
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    void submit(Task task);
+
+    size_t size() const { return workers_.size(); }
+    Stats stats() const;
+
+    // Joins the workers; tasks still queued are dropped
+    void stop();
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::thread thread;
+        std::atomic<uint64_t> tasks_run{0};
+        std::atomic<uint64_t> steals{0};
+        std::atomic<uint64_t> cpu_ns{0};
+    };
+
+    void run(size_t index);
+    bool take(size_t index, Task& task, bool& stolen);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<size_t> next_worker_{0};
+    std::atomic<size_t> queued_{0};
+    std::atomic<bool> stop_requested_{false};
+
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_cv_;
+    std::atomic<size_t> sleepers_{0};
+};
+
+#endif // WORK_STEALING_POOL_HPP